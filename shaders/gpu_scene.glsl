@@ -0,0 +1,96 @@
+//shared by the gpu driven scene's shaders, the layouts match vk_gpu_scene.h
+
+struct Object {
+    mat4 transform;
+    vec4 boundingSphere;
+    uint meshIndex;
+    float scale;
+    uint padding0;
+    uint padding1;
+};
+
+struct MeshInfo {
+    vec4 boundingSphere;
+    int vertexOffset;
+    uint firstLod;
+    uint lodCount;
+    uint padding;
+};
+
+struct MeshLod {
+    uint firstIndex;
+    uint indexCount;
+    float error;
+    uint firstCluster;
+    uint clusterCount;
+    uint padding0;
+    uint padding1;
+    uint padding2;
+};
+
+struct Cluster {
+    vec4 boundingSphere;
+    vec3 coneAxis;
+    float coneCutoff;
+    uint firstIndex;
+    uint indexCount;
+    uint padding0;
+    uint padding1;
+};
+
+//VkDrawIndexedIndirectCommand
+struct DrawCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout (buffer_reference, std430) readonly buffer ObjectBuffer { Object objects[]; };
+layout (buffer_reference, std430) readonly buffer MeshBuffer { MeshInfo meshes[]; };
+layout (buffer_reference, std430) readonly buffer LodBuffer { MeshLod lods[]; };
+layout (buffer_reference, std430) readonly buffer ClusterBuffer { Cluster clusters[]; };
+layout (buffer_reference, std430) writeonly buffer DrawBuffer { DrawCommand draws[]; };
+//object and cluster index pairs the object pass hands to the cluster pass
+layout (buffer_reference, std430) buffer ClusterWorkBuffer { uvec2 work[]; };
+//VkDispatchIndirectCommand for the cluster pass
+layout (buffer_reference, std430) buffer DispatchBuffer { uint groupCountX; uint groupCountY; uint groupCountZ; };
+
+//cleared every frame. the geometry pass reads drawCount, the triangle counts are read back for stats.
+layout (buffer_reference, std430) buffer CounterBuffer {
+    uint drawCount;
+    uint clusterWorkCount;
+    uint objectCulledTriangles;
+    uint clusterCulledTriangles;
+    uint drawnTriangles;
+};
+
+layout (buffer_reference, std430) readonly buffer SceneBuffer {
+    ObjectBuffer objectBuffer;
+    MeshBuffer meshBuffer;
+    LodBuffer lodBuffer;
+    ClusterBuffer clusterBuffer;
+    DrawBuffer drawBuffer;
+    CounterBuffer counterBuffer;
+    ClusterWorkBuffer clusterWorkBuffer;
+    DispatchBuffer clusterDispatchBuffer;
+};
+
+//planes from the rows of the view projection (gribb and hartmann). with a 0 to 1 depth range
+//near and far are z >= 0 and z <= w, which holds for reverse z too
+bool sphere_in_frustum(mat4 viewProj, vec3 center, float radius){
+    mat4 rows = transpose(viewProj);
+    vec4 planes[6] = vec4[6](
+        rows[3] + rows[0], rows[3] - rows[0],
+        rows[3] + rows[1], rows[3] - rows[1],
+        rows[2], rows[3] - rows[2]);
+
+    for(int i = 0; i < 6; i++){
+        vec4 plane = planes[i] / length(planes[i].xyz);
+        if(dot(plane.xyz, center) + plane.w < -radius){
+            return false;
+        }
+    }
+    return true;
+}
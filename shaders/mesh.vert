@@ -0,0 +1,33 @@
+#version 460
+#extension GL_EXT_buffer_reference : require
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+
+//matches Vertex in vk_types.h
+struct Vertex {
+    vec3 position;
+    float uv_x;
+    vec3 normal;
+    float uv_y;
+    vec4 color;
+};
+
+layout (buffer_reference, std430) readonly buffer VertexBuffer {
+    Vertex vertices[];
+};
+
+layout (push_constant) uniform PushConstants
+{
+    mat4 worldViewProj;
+    VertexBuffer vertexBuffer;
+} pc;
+
+void main(){
+    Vertex v = pc.vertexBuffer.vertices[gl_VertexIndex];
+
+    gl_Position = pc.worldViewProj * vec4(v.position, 1.0);
+    //instances are only translated and uniformly scaled, object space normals are world space
+    outNormal = v.normal;
+    outColor = v.color.rgb;
+}
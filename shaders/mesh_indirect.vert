@@ -0,0 +1,37 @@
+#version 460
+#extension GL_EXT_buffer_reference : require
+#extension GL_GOOGLE_include_directive : require
+
+#include "gpu_scene.glsl"
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+
+//matches Vertex in vk_types.h
+struct Vertex {
+    vec3 position;
+    float uv_x;
+    vec3 normal;
+    float uv_y;
+    vec4 color;
+};
+
+layout (buffer_reference, std430) readonly buffer VertexBuffer { Vertex vertices[]; };
+
+layout (push_constant) uniform PushConstants
+{
+    mat4 viewProj;
+    VertexBuffer vertexBuffer;
+    ObjectBuffer objectBuffer;
+} pc;
+
+void main(){
+    //the cull pass stores the object index in firstInstance, and the mesh's vertex offset is already in gl_VertexIndex
+    mat4 transform = pc.objectBuffer.objects[gl_InstanceIndex].transform;
+    Vertex v = pc.vertexBuffer.vertices[gl_VertexIndex];
+
+    gl_Position = pc.viewProj * (transform * vec4(v.position, 1.0));
+    //transforms only scale uniformly, mesh.frag normalizes
+    outNormal = mat3(transform) * v.normal;
+    outColor = v.color.rgb;
+}
@@ -0,0 +1,36 @@
+#version 460
+#extension GL_EXT_buffer_reference : require
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+
+//matches Vertex in vk_types.h
+struct Vertex {
+    vec3 position;
+    float uv_x;
+    vec3 normal;
+    float uv_y;
+    vec4 color;
+};
+
+layout (buffer_reference, std430) readonly buffer VertexBuffer { Vertex vertices[]; };
+//the visible transforms the cpu cull packed for this frame
+layout (buffer_reference, std430) readonly buffer InstanceBuffer { mat4 transforms[]; };
+
+layout (push_constant) uniform PushConstants
+{
+    mat4 viewProj;
+    VertexBuffer vertexBuffer;
+    InstanceBuffer instanceBuffer;
+} pc;
+
+void main(){
+    //firstInstance is the batch's first visible instance, gl_InstanceIndex already includes it
+    mat4 transform = pc.instanceBuffer.transforms[gl_InstanceIndex];
+    Vertex v = pc.vertexBuffer.vertices[gl_VertexIndex];
+
+    gl_Position = pc.viewProj * (transform * vec4(v.position, 1.0));
+    //transforms only scale uniformly, mesh.frag normalizes
+    outNormal = mat3(transform) * v.normal;
+    outColor = v.color.rgb;
+}
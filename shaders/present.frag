@@ -0,0 +1,182 @@
+#version 460
+
+//global bindless heap, see vk_bindless.h
+layout (set = 0, binding = 1) uniform texture2D sampledImages[];
+layout (set = 0, binding = 2) uniform sampler samplers[];
+
+layout (push_constant) uniform PushConstants
+{
+    uint sourceImage;
+    uint sourceSampler;
+    //the top left of the source the frame was rendered into
+    uint renderWidth;
+    uint renderHeight;
+    uint outputWidth;
+    uint outputHeight;
+    float exposure;
+    //0 is off, 1 is the strongest
+    float sharpness;
+    uint flags;
+    uint frame;
+} pc;
+
+//see PresentPass in vk_present.h
+const uint PRESENT_TONEMAP = 1;
+const uint PRESENT_DITHER = 2;
+const uint PRESENT_SRGB_TARGET = 4;
+
+layout (location = 0) out vec4 outColor;
+
+//aces fit by krzysztof narkowicz, hdr to display linear
+vec3 tonemap(vec3 color){
+    color *= pc.exposure;
+    if((pc.flags & PRESENT_TONEMAP) != 0){
+        color = (color * (2.51 * color + 0.03)) / (color * (2.43 * color + 0.59) + 0.14);
+    }
+    return clamp(color, 0.0, 1.0);
+}
+
+//texels outside the rendered region hold an older frame, so coordinates clamp to it
+vec3 load(ivec2 coord){
+    coord = clamp(coord, ivec2(0), ivec2(pc.renderWidth, pc.renderHeight) - 1);
+    return tonemap(texelFetch(sampler2D(sampledImages[pc.sourceImage], samplers[pc.sourceSampler]), coord, 0).rgb);
+}
+
+float luma(vec3 color){
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+//the lanczos2 approximation from fsr1. d2 is the squared distance, lobe the negative lobe
+//strength, a quarter for a full lanczos2 and a half for a softer kernel without ringing
+float lanczos2(float d2, float lobe){
+    d2 = min(d2, 1.0 / lobe);
+    float window = lobe * d2 - 1.0;
+    float base = 2.0 / 5.0 * d2 - 1.0;
+    return (25.0 / 16.0 * base * base - (25.0 / 16.0 - 1.0)) * window * window;
+}
+
+//how much of the gap to the local extremes sharpening may use, after amd's cas
+float sharpen_amount(float minLuma, float maxLuma){
+    return pc.sharpness * sqrt(clamp(min(minLuma, 1.0 - maxLuma) / max(maxLuma, 1.0 / 4096.0), 0.0, 1.0));
+}
+
+//interleaved gradient noise, shifted every frame so the pattern does not sit still
+float dither_noise(vec2 pixel){
+    pixel += 5.588238 * float(pc.frame & 63u);
+    return fract(52.9829189 * fract(dot(pixel, vec2(0.06711056, 0.00583715))));
+}
+
+vec3 srgb_encode(vec3 color){
+    return mix(color * 12.92, 1.055 * pow(color, vec3(1.0 / 2.4)) - 0.055, step(0.0031308, color));
+}
+
+vec3 srgb_decode(vec3 color){
+    return mix(color / 12.92, pow((color + 0.055) / 1.055, vec3(2.4)), step(0.04045, color));
+}
+
+//render and output extents match, only the center and its cross are needed
+vec3 sharpen_native(ivec2 pixel){
+    vec3 center = load(pixel);
+    vec3 up = load(pixel + ivec2(0, -1));
+    vec3 left = load(pixel + ivec2(-1, 0));
+    vec3 right = load(pixel + ivec2(1, 0));
+    vec3 down = load(pixel + ivec2(0, 1));
+
+    vec3 minColor = min(center, min(min(up, down), min(left, right)));
+    vec3 maxColor = max(center, max(max(up, down), max(left, right)));
+
+    float amount = sharpen_amount(luma(minColor), luma(maxColor));
+    vec3 blur = (up + left + right + down) * 0.25;
+    return clamp(center + (center - blur) * amount, minColor, maxColor);
+}
+
+//edge adaptive upscale after fsr1's easu. the 12 texels around the sample position are weighted
+//by a lanczos2 kernel stretched along the local edge, so edges stay sharp without staircasing
+vec3 upscale(vec2 fragCoord){
+    vec2 scale = vec2(pc.renderWidth, pc.renderHeight) / vec2(pc.outputWidth, pc.outputHeight);
+    vec2 position = fragCoord * scale - 0.5;
+    ivec2 base = ivec2(floor(position));
+    vec2 pp = position - floor(position);
+
+    //    b c
+    //  e f g h
+    //  i j k l
+    //    n o
+    vec3 b = load(base + ivec2(0, -1));
+    vec3 c = load(base + ivec2(1, -1));
+    vec3 e = load(base + ivec2(-1, 0));
+    vec3 f = load(base);
+    vec3 g = load(base + ivec2(1, 0));
+    vec3 h = load(base + ivec2(2, 0));
+    vec3 i = load(base + ivec2(-1, 1));
+    vec3 j = load(base + ivec2(0, 1));
+    vec3 k = load(base + ivec2(1, 1));
+    vec3 l = load(base + ivec2(2, 1));
+    vec3 n = load(base + ivec2(0, 2));
+    vec3 o = load(base + ivec2(1, 2));
+
+    float lb = luma(b), lc = luma(c), le = luma(e), lf = luma(f), lg = luma(g), lh = luma(h);
+    float li = luma(i), lj = luma(j), lk = luma(k), ll = luma(l), ln = luma(n), lo = luma(o);
+
+    //gradient at each texel of the center quad, blended to the sample position
+    vec4 quadWeights = vec4((1.0 - pp.x) * (1.0 - pp.y), pp.x * (1.0 - pp.y), (1.0 - pp.x) * pp.y, pp.x * pp.y);
+    vec2 gradient =
+        vec2(lg - le, lj - lb) * quadWeights.x +
+        vec2(lh - lf, lk - lc) * quadWeights.y +
+        vec2(lk - li, ln - lf) * quadWeights.z +
+        vec2(ll - lj, lo - lg) * quadWeights.w;
+
+    float minLuma = min(min(min(lf, lg), min(lj, lk)), min(min(min(lb, lc), min(le, lh)), min(min(li, ll), min(ln, lo))));
+    float maxLuma = max(max(max(lf, lg), max(lj, lk)), max(max(max(lb, lc), max(le, lh)), max(max(li, ll), max(ln, lo))));
+
+    //0 on flat areas, 1 on a clean edge
+    float edge = clamp(length(gradient) / (1.41421356 * (maxLuma - minLuma) + 1.0 / 4096.0), 0.0, 1.0);
+    edge *= edge;
+
+    vec2 direction = dot(gradient, gradient) > 1.0 / 65536.0 ? normalize(gradient) : vec2(1.0, 0.0);
+    //axis aligned is 1, diagonal is sqrt(2)
+    float stretch = 1.0 / max(abs(direction.x), abs(direction.y));
+    //narrow across the edge, long along it
+    vec2 axisScale = vec2(1.0 + (stretch - 1.0) * edge, 1.0 - 0.5 * edge);
+    float lobe = 0.5 + (0.25 - 0.04 - 0.5) * edge;
+
+    vec3 colorSum = vec3(0.0);
+    float weightSum = 0.0;
+    #define TAP(color, offset) { \
+        vec2 d = vec2(offset) - pp; \
+        vec2 v = vec2(dot(d, direction), dot(d, vec2(-direction.y, direction.x))) * axisScale; \
+        float w = lanczos2(dot(v, v), lobe); \
+        colorSum += color * w; \
+        weightSum += w; }
+    TAP(b, ivec2(0, -1)) TAP(c, ivec2(1, -1))
+    TAP(e, ivec2(-1, 0)) TAP(f, ivec2(0, 0)) TAP(g, ivec2(1, 0)) TAP(h, ivec2(2, 0))
+    TAP(i, ivec2(-1, 1)) TAP(j, ivec2(0, 1)) TAP(k, ivec2(1, 1)) TAP(l, ivec2(2, 1))
+    TAP(n, ivec2(0, 2)) TAP(o, ivec2(1, 2))
+    #undef TAP
+
+    //the negative lobes ring, so the result stays within the quad it was sampled from
+    vec3 quadMin = min(min(f, g), min(j, k));
+    vec3 quadMax = max(max(f, g), max(j, k));
+    vec3 color = clamp(colorSum / max(weightSum, 1.0 / 4096.0), quadMin, quadMax);
+
+    //sharpened against plain bilinear, limited by the whole neighbourhood
+    vec3 bilinear = f * quadWeights.x + g * quadWeights.y + j * quadWeights.z + k * quadWeights.w;
+    vec3 minColor = min(quadMin, min(min(min(b, c), min(e, h)), min(min(i, l), min(n, o))));
+    vec3 maxColor = max(quadMax, max(max(max(b, c), max(e, h)), max(max(i, l), max(n, o))));
+    float amount = sharpen_amount(minLuma, maxLuma);
+    return clamp(color + (color - bilinear) * amount, minColor, maxColor);
+}
+
+void main(){
+    bool native = pc.renderWidth == pc.outputWidth && pc.renderHeight == pc.outputHeight;
+    vec3 color = native ? sharpen_native(ivec2(gl_FragCoord.xy)) : upscale(gl_FragCoord.xy);
+
+    //dithered in the encoded space the target quantizes in. an srgb target encodes on store,
+    //so the dithered value is decoded again and the hardware encode lands on the same steps.
+    vec3 encoded = srgb_encode(color);
+    if((pc.flags & PRESENT_DITHER) != 0){
+        encoded = clamp(encoded + (dither_noise(gl_FragCoord.xy) - 0.5) / 255.0, 0.0, 1.0);
+    }
+
+    outColor = vec4((pc.flags & PRESENT_SRGB_TARGET) != 0 ? srgb_decode(encoded) : encoded, 1.0);
+}
@@ -1,14 +1,120 @@
+#include <algorithm>
+#include <cstdlib>
+#include <string_view>
+
+#include <vk_bench.h>
 #include <vk_engine.h>
 
 int main(int argc, char* argv[])
 {
 	VulkanEngine engine;
+	std::string_view benchmark;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string_view arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+
+		if (arg == "--headless")
+		{
+			engine.headless = true;
+		}
+		else if (arg == "--frames" && hasValue)
+		{
+			engine.headlessFrameCount = std::atoi(argv[++i]);
+		}
+		else if (arg == "--capture" && hasValue)
+		{
+			engine.captureDirectory = argv[++i];
+		}
+		else if (arg == "--capture-interval" && hasValue)
+		{
+			engine.captureInterval = std::atoi(argv[++i]);
+		}
+		else if (arg == "--frames-in-flight" && hasValue)
+		{
+			engine.set_frames_in_flight(std::atoi(argv[++i]));
+		}
+		else if (arg == "--pipeline-cache" && hasValue)
+		{
+			engine.pipelineCachePath = argv[++i];
+		}
+		else if (arg == "--workgroup-sizes" && hasValue)
+		{
+			engine.workgroupSizesPath = argv[++i];
+		}
+		else if (arg == "--retune-workgroups")
+		{
+			engine.retuneWorkgroups = true;
+		}
+		else if (arg == "--gpu-profile" && hasValue)
+		{
+			engine.gpuProfilePath = argv[++i];
+		}
+		else if (arg == "--cpu-trace" && hasValue)
+		{
+			engine.cpuTracePath = argv[++i];
+		}
+		else if (arg == "--target-frame-ms" && hasValue)
+		{
+			engine.dynamicResolution.targetFrameMs = static_cast<float>(std::atof(argv[++i]));
+		}
+		else if (arg == "--min-scale" && hasValue)
+		{
+			engine.dynamicResolution.minScale = static_cast<float>(std::atof(argv[++i]));
+		}
+		else if (arg == "--max-scale" && hasValue)
+		{
+			engine.dynamicResolution.maxScale = static_cast<float>(std::atof(argv[++i]));
+		}
+		else if (arg == "--fixed-resolution")
+		{
+			engine.dynamicResolution.enabled = false;
+		}
+		else if (arg == "--draws" && hasValue)
+		{
+			// a negative count would reach the reserve calls in init_scene
+			engine.sceneDrawCount = std::max(std::atoi(argv[++i]), 0);
+		}
+		else if (arg == "--serial-recording")
+		{
+			engine.parallelRecording = false;
+		}
+		else if (arg == "--cpu-driven")
+		{
+			engine.gpuDriven = false;
+		}
+		else if (arg == "--no-cluster-culling")
+		{
+			engine.gpuScene.clusterCulling = false;
+		}
+		else if (arg == "--no-draw-sorting")
+		{
+			engine.geometryQueue.enabled = false;
+		}
+		else if (arg == "--no-cpu-culling")
+		{
+			engine.cpuCulling = false;
+		}
+		else if (arg == "--bench" && hasValue)
+		{
+			benchmark = argv[++i];
+		}
+	}
 
 	engine.init();	
 	
-	engine.run();	
+	bool succeeded = true;
+	if (benchmark.empty())
+	{
+		engine.run();
+	}
+	else
+	{
+		succeeded = vkbench::run(benchmark, engine);
+	}
 
 	engine.cleanup();	
 
-	return 0;
+	return succeeded ? 0 : 1;
 }
@@ -0,0 +1,258 @@
+#include "vk_assetpack.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+#include "vk_loader.h"
+#include "vk_textures.h"
+
+static_assert(std::is_trivially_copyable_v<AssetPackHeader>);
+static_assert(std::is_trivially_copyable_v<AssetPackEntry>);
+static_assert(std::is_trivially_copyable_v<AssetPackSurface>);
+static_assert(std::is_trivially_copyable_v<Vertex>);
+
+namespace
+{
+	constexpr uint64_t align_up(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	// blobs start right after the header
+	constexpr uint64_t BLOBS_OFFSET = align_up(sizeof(AssetPackHeader), ASSET_PACK_ALIGNMENT);
+
+	void copy_name(char (&destination)[ASSET_NAME_LENGTH], const std::string& name)
+	{
+		memset(destination, 0, ASSET_NAME_LENGTH);
+		memcpy(destination, name.data(), std::min<size_t>(name.size(), ASSET_NAME_LENGTH - 1));
+	}
+}
+
+bool AssetPack::open(const std::filesystem::path& path)
+{
+	close();
+
+	if (!file.open(path))
+	{
+		return false;
+	}
+
+	const auto reject = [&](const char* reason)
+	{
+		std::cout << "Asset pack " << path.string() << " rejected: " << reason << std::endl;
+		close();
+		return false;
+	};
+
+	if (file.size() < sizeof(AssetPackHeader))
+	{
+		return reject("truncated header");
+	}
+
+	const auto* header = reinterpret_cast<const AssetPackHeader*>(file.data());
+	if (header->magic != ASSET_PACK_MAGIC)
+	{
+		return reject("not an asset pack");
+	}
+	if (header->version != ASSET_PACK_VERSION)
+	{
+		return reject("version mismatch, rebuild the AssetPack target");
+	}
+	if (header->vertexSize != sizeof(Vertex))
+	{
+		return reject("vertex layout mismatch, rebuild the AssetPack target");
+	}
+	if (header->fileSize != file.size()
+		|| header->entriesOffset % alignof(AssetPackEntry) != 0
+		|| header->entriesOffset + static_cast<uint64_t>(header->entryCount) * sizeof(AssetPackEntry) > file.size())
+	{
+		return reject("truncated");
+	}
+
+	entryTable = std::span(
+		reinterpret_cast<const AssetPackEntry*>(file.data() + header->entriesOffset),
+		header->entryCount);
+
+	for (const AssetPackEntry& entry : entryTable)
+	{
+		if (!validate(entry))
+		{
+			return reject("entry out of bounds");
+		}
+	}
+
+	return true;
+}
+
+void AssetPack::close()
+{
+	entryTable = {};
+	file.close();
+}
+
+const AssetPackEntry* AssetPack::find(std::string_view name, AssetType type) const
+{
+	for (const AssetPackEntry& entry : entryTable)
+	{
+		if (entry.type == type && name == asset_name(entry.name))
+		{
+			return &entry;
+		}
+	}
+	return nullptr;
+}
+
+std::span<const Vertex> AssetPack::vertices(const AssetPackEntry& entry) const
+{
+	return { reinterpret_cast<const Vertex*>(file.data() + entry.vertexOffset), entry.vertexCount };
+}
+
+std::span<const uint32_t> AssetPack::indices(const AssetPackEntry& entry) const
+{
+	return { reinterpret_cast<const uint32_t*>(file.data() + entry.indexOffset), entry.indexCount };
+}
+
+std::span<const AssetPackSurface> AssetPack::surfaces(const AssetPackEntry& entry) const
+{
+	return { reinterpret_cast<const AssetPackSurface*>(file.data() + entry.surfaceOffset), entry.surfaceCount };
+}
+
+std::span<const uint8_t> AssetPack::mip(const AssetPackEntry& entry, uint32_t level) const
+{
+	return { file.data() + entry.mipOffsets[level], entry.mipSizes[level] };
+}
+
+bool AssetPack::validate(const AssetPackEntry& entry) const
+{
+	const auto inside = [&](uint64_t offset, uint64_t size)
+	{
+		return offset % ASSET_PACK_ALIGNMENT == 0 && offset <= file.size() && size <= file.size() - offset;
+	};
+
+	switch (entry.type)
+	{
+	case AssetType::Mesh:
+		return inside(entry.vertexOffset, static_cast<uint64_t>(entry.vertexCount) * sizeof(Vertex))
+			&& inside(entry.indexOffset, static_cast<uint64_t>(entry.indexCount) * sizeof(uint32_t))
+			&& inside(entry.surfaceOffset, static_cast<uint64_t>(entry.surfaceCount) * sizeof(AssetPackSurface));
+	case AssetType::Texture:
+		if (entry.mipCount == 0 || entry.mipCount > ASSET_MAX_MIPS)
+		{
+			return false;
+		}
+		for (uint32_t level = 0; level < entry.mipCount; level++)
+		{
+			if (!inside(entry.mipOffsets[level], entry.mipSizes[level]))
+			{
+				return false;
+			}
+		}
+		return true;
+	default:
+		return false;
+	}
+}
+
+void AssetPackWriter::add_mesh(const std::string& name, const MeshAsset& mesh)
+{
+	AssetPackEntry entry{};
+	copy_name(entry.name, name);
+	entry.type = AssetType::Mesh;
+
+	entry.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+	entry.vertexOffset = append(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+
+	entry.indexCount = static_cast<uint32_t>(mesh.indices.size());
+	entry.indexOffset = append(mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+
+	std::vector<AssetPackSurface> surfaces;
+	for (const GeoSurface& surface : mesh.surfaces)
+	{
+		AssetPackSurface packed{};
+		packed.startIndex = surface.startIndex;
+		packed.count = surface.count;
+		copy_name(packed.material, surface.material);
+		surfaces.push_back(packed);
+	}
+
+	entry.surfaceCount = static_cast<uint32_t>(surfaces.size());
+	entry.surfaceOffset = append(surfaces.data(), surfaces.size() * sizeof(AssetPackSurface));
+
+	entryList.push_back(entry);
+}
+
+void AssetPackWriter::add_texture(const std::string& name, const TextureData& texture)
+{
+	AssetPackEntry entry{};
+	copy_name(entry.name, name);
+	entry.type = AssetType::Texture;
+
+	entry.format = texture.format;
+	entry.width = texture.width;
+	entry.height = texture.height;
+	entry.mipCount = static_cast<uint32_t>(std::min<size_t>(texture.mips.size(), ASSET_MAX_MIPS));
+
+	for (uint32_t level = 0; level < entry.mipCount; level++)
+	{
+		entry.mipSizes[level] = texture.mips[level].size();
+		entry.mipOffsets[level] = append(texture.mips[level].data(), texture.mips[level].size());
+	}
+
+	entryList.push_back(entry);
+}
+
+bool AssetPackWriter::write(const std::filesystem::path& path) const
+{
+	const uint64_t entriesOffset = align_up(BLOBS_OFFSET + blobs.size(), ASSET_PACK_ALIGNMENT);
+
+	AssetPackHeader header{};
+	header.magic = ASSET_PACK_MAGIC;
+	header.version = ASSET_PACK_VERSION;
+	header.vertexSize = sizeof(Vertex);
+	header.entryCount = static_cast<uint32_t>(entryList.size());
+	header.entriesOffset = entriesOffset;
+	header.fileSize = entriesOffset + entryList.size() * sizeof(AssetPackEntry);
+
+	const std::vector<uint8_t> padding(ASSET_PACK_ALIGNMENT, 0);
+
+	std::filesystem::path tempPath = path;
+	tempPath += ".tmp";
+
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+		{
+			return false;
+		}
+
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(padding.data()), BLOBS_OFFSET - sizeof(header));
+		out.write(reinterpret_cast<const char*>(blobs.data()), static_cast<std::streamsize>(blobs.size()));
+		out.write(reinterpret_cast<const char*>(padding.data()), entriesOffset - BLOBS_OFFSET - blobs.size());
+		out.write(reinterpret_cast<const char*>(entryList.data()),
+		          static_cast<std::streamsize>(entryList.size() * sizeof(AssetPackEntry)));
+
+		if (!out.good())
+		{
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	return !error;
+}
+
+uint64_t AssetPackWriter::append(const void* data, size_t size)
+{
+	const size_t offset = align_up(blobs.size(), ASSET_PACK_ALIGNMENT);
+	blobs.resize(offset + size);
+	if (size > 0)
+	{
+		memcpy(blobs.data() + offset, data, size);
+	}
+	return BLOBS_OFFSET + offset;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "vk_mapped_file.h"
+#include "vk_types.h"
+
+struct MeshAsset;
+struct TextureData;
+
+// binary pack of ready to upload assets, written offline by the asset_packer tool.
+// layout: header, blobs (each at a multiple of ASSET_PACK_ALIGNMENT), entry table.
+// every blob is stored exactly as the gpu consumes it, so loading is a lookup into the mapping.
+constexpr uint32_t ASSET_PACK_MAGIC = 0x5041'4B56; // "VKAP"
+constexpr uint32_t ASSET_PACK_VERSION = 1;
+constexpr uint64_t ASSET_PACK_ALIGNMENT = 64;
+constexpr uint32_t ASSET_NAME_LENGTH = 64;
+constexpr uint32_t ASSET_MAX_MIPS = 16;
+
+// names are stored nul padded in fixed size arrays
+inline std::string_view asset_name(const char (&name)[ASSET_NAME_LENGTH])
+{
+	size_t length = 0;
+	while (length < ASSET_NAME_LENGTH && name[length] != '\0')
+	{
+		length++;
+	}
+	return { name , length };
+}
+
+enum class AssetType : uint32_t
+{
+	Mesh = 1,
+	Texture = 2
+};
+
+struct AssetPackHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	// a pack written with a different vertex layout is rejected instead of misread
+	uint32_t vertexSize;
+	uint32_t entryCount;
+	uint64_t entriesOffset;
+	uint64_t fileSize;
+};
+
+struct AssetPackSurface
+{
+	uint32_t startIndex;
+	uint32_t count;
+	char material[ASSET_NAME_LENGTH];
+};
+
+struct AssetPackEntry
+{
+	char name[ASSET_NAME_LENGTH];
+	AssetType type;
+
+	// meshes
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t surfaceCount;
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint64_t surfaceOffset;
+
+	// textures
+	VkFormat format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t mipCount;
+	uint64_t mipOffsets[ASSET_MAX_MIPS];
+	uint64_t mipSizes[ASSET_MAX_MIPS];
+};
+
+// read side: maps the pack and hands out views into the mapping.
+// the views stay valid while the pack is open, so uploads can read straight from them.
+class AssetPack
+{
+public:
+	// validates the header and that every entry lies inside the file
+	bool open(const std::filesystem::path& path);
+	void close();
+
+	bool is_open() const { return file.is_open(); }
+
+	const AssetPackEntry* find(std::string_view name, AssetType type) const;
+	std::span<const AssetPackEntry> entries() const { return entryTable; }
+
+	std::span<const Vertex> vertices(const AssetPackEntry& entry) const;
+	std::span<const uint32_t> indices(const AssetPackEntry& entry) const;
+	std::span<const AssetPackSurface> surfaces(const AssetPackEntry& entry) const;
+	std::span<const uint8_t> mip(const AssetPackEntry& entry, uint32_t level) const;
+
+private:
+	bool validate(const AssetPackEntry& entry) const;
+
+	MappedFile file;
+	std::span<const AssetPackEntry> entryTable;
+};
+
+// write side, used by the packer. blobs are collected in memory and written in one go.
+class AssetPackWriter
+{
+public:
+	void add_mesh(const std::string& name, const MeshAsset& mesh);
+	void add_texture(const std::string& name, const TextureData& texture);
+
+	// writes to a temporary file and renames it over the old one
+	bool write(const std::filesystem::path& path) const;
+
+	uint64_t blob_size() const { return blobs.size(); }
+
+private:
+	// returns the file offset the data will end up at
+	uint64_t append(const void* data, size_t size);
+
+	std::vector<AssetPackEntry> entryList;
+	std::vector<uint8_t> blobs;
+};
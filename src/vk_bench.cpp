@@ -0,0 +1,881 @@
+#include "vk_bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <span>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <tiny_obj_loader.h>
+
+#include "vk_assetpack.h"
+#include "vk_blockcompress.h"
+#include "vk_cpu_cull.h"
+#include "vk_cpu_profiler.h"
+#include "vk_engine.h"
+#include "vk_images.h"
+#include "vk_loader.h"
+#include "vk_meshopt.h"
+#include "vk_pipelines.h"
+#include "vk_render_queue.h"
+#include "vk_textures.h"
+#include "vk_transforms.h"
+
+bool vkbench::run(std::string_view name, VulkanEngine& engine)
+{
+	if (name == "pipelines")
+	{
+		pipeline_builds(engine, 64);
+	}
+	else if (name == "deletion")
+	{
+		deletion_queue(engine, 1000, 256);
+	}
+	else if (name == "meshes")
+	{
+		mesh_import(engine);
+	}
+	else if (name == "assets")
+	{
+		asset_loading(engine);
+	}
+	else if (name == "textures")
+	{
+		texture_compression(engine);
+	}
+	else if (name == "zones")
+	{
+		profiler_zones(engine, 10000000);
+	}
+	else if (name == "present")
+	{
+		present_pass(engine, 100);
+	}
+	else if (name == "recording")
+	{
+		command_recording(engine, 50);
+	}
+	else if (name == "transforms")
+	{
+		transform_updates(engine, 20);
+	}
+	else if (name == "culling")
+	{
+		instance_culling(engine, 50);
+	}
+	else if (name == "sorting")
+	{
+		draw_sorting(engine, 100);
+	}
+	else
+	{
+		std::cout << "Unknown benchmark '" << name << "'" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+void vkbench::pipeline_builds(VulkanEngine& engine, const int copies)
+{
+	constexpr const char* shaderPath = "../../shaders/gradient.comp.spv";
+
+	// without the workgroup size constants every desc would build the same pipeline and the passes would time cache hits
+	{
+		MappedFile file;
+		const std::vector<uint32_t> specIds = file.open(shaderPath)
+			                                      ? vkutil::spirv_spec_ids(file.data(), file.size())
+			                                      : std::vector<uint32_t>{};
+		for (uint32_t id = 0; id < 3; id++)
+		{
+			if (std::find(specIds.begin(), specIds.end(), id) == specIds.end())
+			{
+				std::cout << "Pipeline build benchmark: " << shaderPath << " does not declare spec id " << id
+					<< ", rebuild the shaders" << std::endl;
+				return;
+			}
+		}
+	}
+
+	VkShaderModule shaderModule;
+	VK_CHECK(engine.shaderModules.load(engine.device, shaderPath, &shaderModule));
+
+	// a different workgroup width per copy, so no two pipelines of a pass can share a cache entry.
+	// widths up to 64 stay within the minimum limits every device supports.
+	std::vector<ComputePipelineDesc> descs(copies);
+	for (int i = 0; i < copies; i++)
+	{
+		descs[i].name = "gradient";
+		descs[i].shader = shaderModule;
+		descs[i].layout = engine.bindless.pipelineLayout;
+		descs[i].set_workgroup_size({ static_cast<uint32_t>(i % 64) + 1 , static_cast<uint32_t>(i / 64) + 1 , 1 });
+	}
+
+	std::cout << "Pipeline build benchmark: " << copies << " compute pipelines, "
+		<< engine.jobs.worker_count() << " workers" << std::endl;
+	std::cout << "  (set MESA_SHADER_CACHE_DISABLE=true so the driver's own cache does not hide compile cost)" << std::endl;
+
+	// each pass starts from an empty VkPipelineCache and every pipeline in it is distinct, so both measure real compiles
+	const auto measure = [&](const char* label, auto&& build)
+	{
+		VkPipelineCacheCreateInfo cacheInfo{};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+		PipelineCache scratchCache;
+		scratchCache.logEachPipeline = false;
+		VK_CHECK(vkCreatePipelineCache(engine.device, &cacheInfo, nullptr, &scratchCache.cache));
+
+		const auto start = std::chrono::steady_clock::now();
+		const std::vector<VkPipeline> pipelines = build(scratchCache);
+		const auto end = std::chrono::steady_clock::now();
+
+		const double ms = std::chrono::duration<double, std::milli>(end - start).count();
+		std::cout << "  " << label << ": " << ms << " ms total, " << ms / copies << " ms/pipeline" << std::endl;
+
+		for (VkPipeline pipeline : pipelines)
+		{
+			vkDestroyPipeline(engine.device, pipeline, nullptr);
+		}
+		scratchCache.destroy(engine.device);
+
+		return ms;
+	};
+
+	const double serialMs = measure("serial", [&](PipelineCache& cache)
+	{
+		std::vector<VkPipeline> pipelines;
+		for (int i = 0; i < copies; i++)
+		{
+			pipelines.push_back(vkutil::create_compute_pipeline(engine.device, cache, descs[i]));
+		}
+		return pipelines;
+	});
+
+	const double parallelMs = measure("parallel", [&](PipelineCache& cache)
+	{
+		PipelineBuildQueue queue;
+		queue.init(engine.device, &cache, &engine.jobs);
+
+		std::vector<std::shared_future<VkPipeline>> builds;
+		for (int i = 0; i < copies; i++)
+		{
+			builds.push_back(queue.enqueue(descs[i]));
+		}
+
+		std::vector<VkPipeline> pipelines;
+		for (const auto& build : builds)
+		{
+			pipelines.push_back(build.get());
+		}
+		return pipelines;
+	});
+
+	std::cout << "  speedup: " << serialMs / parallelMs << "x" << std::endl;
+}
+
+void vkbench::deletion_queue(VulkanEngine& engine, const int rounds, const int entriesPerRound)
+{
+	// destroying VK_NULL_HANDLE is a valid no-op, so this measures the queue and the call overhead only
+	const VkDevice device = engine.device;
+	const VmaAllocator allocator = engine.allocator;
+	const int entryCount = rounds * entriesPerRound;
+
+	std::cout << "Deletion queue benchmark: " << rounds << " flushes of " << entriesPerRound << " entries" << std::endl;
+
+	const auto report = [&](const char* label, const std::chrono::steady_clock::duration elapsed)
+	{
+		const double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+		std::cout << "  " << label << ": " << ns / 1000000.0 << " ms total, " << ns / entryCount << " ns/entry" << std::endl;
+		return ns;
+	};
+
+	// what the engine used before: one heap allocated closure per handle
+	std::deque<std::function<void()>> legacy;
+	auto start = std::chrono::steady_clock::now();
+	for (int round = 0; round < rounds; round++)
+	{
+		for (int i = 0; i < entriesPerRound; i++)
+		{
+			const VkImageView view = VK_NULL_HANDLE;
+			const VkSampler sampler = VK_NULL_HANDLE;
+			legacy.push_back([=]()
+			{
+				vkDestroyImageView(device, view, nullptr);
+				vkDestroySampler(device, sampler, nullptr);
+			});
+		}
+
+		for (auto it = legacy.rbegin(); it != legacy.rend(); ++it)
+		{
+			(*it)();
+		}
+		legacy.clear();
+	}
+	const double legacyNs = report("std::function deque", std::chrono::steady_clock::now() - start);
+
+	DeletionQueue typed;
+	start = std::chrono::steady_clock::now();
+	for (int round = 0; round < rounds; round++)
+	{
+		for (int i = 0; i < entriesPerRound; i++)
+		{
+			typed.push_image_view(VK_NULL_HANDLE);
+			typed.push_sampler(VK_NULL_HANDLE);
+		}
+		typed.flush(device, allocator);
+	}
+	const double typedNs = report("typed queue", std::chrono::steady_clock::now() - start);
+
+	std::cout << "  speedup: " << legacyNs / typedNs << "x" << std::endl;
+}
+
+void vkbench::mesh_import(VulkanEngine& engine)
+{
+	// lost_empire.obj does not ship with the repo, drop it into assets/ to include the large case
+	const char* paths[] = {
+		"../../assets/monkey_flat.obj",
+		"../../assets/monkey_smooth.obj",
+		"../../assets/lost_empire.obj"
+	};
+
+	std::cout << "Mesh import benchmark: " << engine.jobs.worker_count() + 1 << " threads, cache size "
+		<< VERTEX_CACHE_SIZE << std::endl;
+
+	for (const char* path : paths)
+	{
+		if (!std::filesystem::exists(path))
+		{
+			std::cout << "  " << path << ": skipped, file not found" << std::endl;
+			continue;
+		}
+
+		// the single threaded reference, parse only
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string warn;
+		std::string err;
+
+		const auto tinyStart = std::chrono::steady_clock::now();
+		tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path, "../../assets/");
+		const double tinyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tinyStart).count();
+
+		MeshLoadStats stats;
+		const auto loadStart = std::chrono::steady_clock::now();
+		const auto mesh = vkutil::load_obj_mesh(engine.jobs, path, true, &stats);
+		const double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+
+		if (mesh == nullptr)
+		{
+			continue;
+		}
+
+		std::cout << "  " << mesh->name << ": " << stats.fileBytes / 1024 << " KB in " << stats.chunks << " chunks, "
+			<< stats.triangles << " triangles, " << stats.corners << " corners -> " << stats.vertices << " vertices, "
+			<< mesh->surfaces.size() << " surfaces" << std::endl;
+		std::cout << "    load " << loadMs << " ms (parse " << stats.parseMs << ", dedup " << stats.dedupMs
+			<< ", optimize " << stats.optimizeMs << "), tinyobjloader parse " << tinyMs << " ms" << std::endl;
+		std::cout << "    acmr " << stats.acmrBefore << " -> " << stats.acmrAfter
+			<< ", atvr " << stats.atvrBefore << " -> " << stats.atvrAfter << std::endl;
+	}
+}
+
+void vkbench::asset_loading(VulkanEngine& engine)
+{
+	const char* packPath = "../../assets/assets.pack";
+	const char* meshNames[] = { "monkey_flat" , "monkey_smooth" , "lost_empire" };
+	const char* textureNames[] = { "lost_empire-RGB" , "lost_empire-RGBA" , "lost_empire-Alpha" };
+
+	// everything created by one run, destroyed once its uploads landed
+	struct Loaded
+	{
+		std::vector<std::shared_ptr<MeshAsset>> meshes;
+		std::vector<TextureData> textures;
+		std::vector<GPUMeshBuffers> buffers;
+		std::vector<AllocatedImage> images;
+		UploadTicket lastUpload;
+		uint64_t bytes = 0;
+	};
+
+	const auto upload_texture = [&](Loaded& loaded, VkFormat format, VkExtent2D extent,
+	                                 std::span<const std::span<const uint8_t>> levels)
+	{
+		for (const auto& level : levels)
+		{
+			loaded.bytes += level.size();
+		}
+		loaded.images.push_back(engine.upload_texture(format, extent, levels, loaded.lastUpload));
+	};
+
+	const auto finish = [&](const char* label, Loaded& loaded, std::chrono::steady_clock::time_point start)
+	{
+		const double cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		// same pumping the frame loop does: submit the copies, then acquire them on the graphics queue
+		while (!engine.uploads.is_complete(loaded.lastUpload))
+		{
+			engine.uploads.submit();
+			engine.immediate_submit([&](VkCommandBuffer cmd) { engine.uploads.record_acquires(cmd); });
+		}
+		const double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		std::cout << "  " << label << ": " << loaded.buffers.size() << " meshes, " << loaded.images.size()
+			<< " textures, " << loaded.bytes / (1024 * 1024) << " MB, cpu ready " << cpuMs << " ms, resident "
+			<< totalMs << " ms" << std::endl;
+
+		for (const GPUMeshBuffers& buffers : loaded.buffers)
+		{
+			engine.destroy_buffer(buffers.vertexBuffer);
+			engine.destroy_buffer(buffers.indexBuffer);
+		}
+		for (const AllocatedImage& image : loaded.images)
+		{
+			engine.destroy_image(image);
+		}
+	};
+
+	std::cout << "Asset loading benchmark (the page cache is likely warm, drop it first for cold numbers)" << std::endl;
+
+	// from source: parse and optimize the obj files, decode the pngs and build their mips
+	{
+		Loaded loaded;
+		const auto start = std::chrono::steady_clock::now();
+
+		for (const char* name : meshNames)
+		{
+			const std::string path = std::string("../../assets/") + name + ".obj";
+			if (!std::filesystem::exists(path))
+			{
+				continue;
+			}
+			auto mesh = vkutil::load_obj_mesh(engine.jobs, path);
+			if (mesh == nullptr)
+			{
+				continue;
+			}
+
+			loaded.bytes += mesh->vertices.size() * sizeof(Vertex) + mesh->indices.size() * sizeof(uint32_t);
+			loaded.buffers.push_back(engine.upload_mesh(mesh->indices, mesh->vertices, loaded.lastUpload));
+			loaded.meshes.push_back(std::move(mesh));
+		}
+
+		// reserved up front, the uploads keep pointing into the mips
+		loaded.textures.reserve(std::size(textureNames));
+		for (const char* name : textureNames)
+		{
+			TextureData& texture = loaded.textures.emplace_back();
+			const std::string path = std::string("../../assets/") + name + ".png";
+			if (!vkutil::load_image_rgba8(path, vkutil::is_srgb_texture(name), texture))
+			{
+				loaded.textures.pop_back();
+				continue;
+			}
+			vkutil::generate_mips_rgba8(engine.jobs, texture);
+
+			const std::vector<std::span<const uint8_t>> levels(texture.mips.begin(), texture.mips.end());
+			upload_texture(loaded, texture.format, { texture.width , texture.height }, levels);
+		}
+
+		finish("source files", loaded, start);
+	}
+
+	// from the pack: the blobs are uploaded straight out of the mapping
+	{
+		Loaded loaded;
+		const auto start = std::chrono::steady_clock::now();
+
+		AssetPack pack;
+		if (!pack.open(packPath))
+		{
+			std::cout << "  asset pack: skipped, build the AssetPack target to create " << packPath << std::endl;
+			return;
+		}
+
+		for (const char* name : meshNames)
+		{
+			if (const AssetPackEntry* entry = pack.find(name, AssetType::Mesh))
+			{
+				const auto vertices = pack.vertices(*entry);
+				const auto indices = pack.indices(*entry);
+
+				loaded.bytes += vertices.size_bytes() + indices.size_bytes();
+				loaded.buffers.push_back(engine.upload_mesh(indices, vertices, loaded.lastUpload));
+			}
+		}
+
+		// decompressed copies for gpus that cannot sample the blocks
+		loaded.textures.reserve(std::size(textureNames));
+		for (const char* name : textureNames)
+		{
+			if (const AssetPackEntry* entry = pack.find(name, AssetType::Texture))
+			{
+				VkFormat format = entry->format;
+				std::vector<std::span<const uint8_t>> levels;
+				for (uint32_t level = 0; level < entry->mipCount; level++)
+				{
+					levels.push_back(pack.mip(*entry, level));
+				}
+
+				if (vkutil::is_block_compressed(format) && !engine.supports_texture_format(format))
+				{
+					TextureData& texture = loaded.textures.emplace_back();
+					for (uint32_t level = 0; level < entry->mipCount; level++)
+					{
+						texture.mips.push_back(vkutil::decompress_surface(engine.jobs, levels[level],
+							std::max(entry->width >> level, 1u), std::max(entry->height >> level, 1u), format));
+						levels[level] = texture.mips.back();
+					}
+					format = vkutil::decompressed_format(format);
+				}
+
+				upload_texture(loaded, format, { entry->width , entry->height }, levels);
+			}
+		}
+
+		finish("asset pack", loaded, start);
+	}
+}
+
+void vkbench::texture_compression(VulkanEngine& engine)
+{
+	const char* textureNames[] = { "lost_empire-RGB" , "lost_empire-RGBA" , "lost_empire-Alpha" };
+
+	std::cout << "Texture compression benchmark: " << engine.jobs.worker_count() + 1 << " threads" << std::endl;
+
+	for (const char* name : textureNames)
+	{
+		const std::string path = std::string("../../assets/") + name + ".png";
+
+		TextureData source;
+		if (!vkutil::load_image_rgba8(path, vkutil::is_srgb_texture(name), source))
+		{
+			std::cout << "  " << path << ": skipped, cannot be decoded" << std::endl;
+			continue;
+		}
+		vkutil::generate_mips_rgba8(engine.jobs, source);
+
+		// the selected format, and BC3 next to BC7 where alpha makes them alternatives
+		std::vector<VkFormat> formats = { vkutil::select_block_format(name) };
+		if (const VkFormat bc3 = vkutil::select_block_format(name, true); bc3 != formats[0])
+		{
+			formats.push_back(bc3);
+		}
+
+		for (const VkFormat format : formats)
+		{
+			TextureData texture = source;
+			TextureCompressionStats stats;
+			vkutil::compress_texture(engine.jobs, texture, format, &stats);
+
+			const double saved = 100.0 * (1.0 - static_cast<double>(stats.compressedBytes) / stats.sourceBytes);
+			std::cout << "  " << name << " " << vkutil::block_format_name(format) << ": " << stats.encodeMs << " ms, "
+				<< stats.megapixelsPerSecond << " MP/s, psnr " << stats.psnr << " dB, "
+				<< stats.sourceBytes / (1024 * 1024) << " MB -> " << stats.compressedBytes / (1024 * 1024) << " MB ("
+				<< saved << "% saved)" << (engine.supports_texture_format(format) ? "" : ", not sampleable on this gpu")
+				<< std::endl;
+		}
+	}
+}
+
+void vkbench::profiler_zones(VulkanEngine& engine, const int zones)
+{
+	// the zone class directly, so this measures the same with the macros compiled out
+	std::cout << "Profiler zone benchmark: " << zones << " zones"
+		<< (CPU_PROFILER_ENABLED ? "" : " (PROFILE_ZONE is compiled out in this build)") << std::endl;
+
+	const auto report = [&](const char* label, const std::chrono::steady_clock::duration elapsed, const int count)
+	{
+		const double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+		std::cout << "  " << label << ": " << ns / count << " ns/zone" << std::endl;
+	};
+
+	// what a zone would cost with steady_clock, against the two tick reads it does
+	uint64_t sink = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < zones; i++)
+	{
+		sink += vkprofile::now_ns();
+		sink += vkprofile::now_ns();
+	}
+	report("two steady_clock reads", std::chrono::steady_clock::now() - start, zones);
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < zones; i++)
+	{
+		sink += vkprofile::now_ticks();
+		sink += vkprofile::now_ticks();
+	}
+	report("two tick reads", std::chrono::steady_clock::now() - start, zones);
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < zones; i++)
+	{
+		const vkprofile::ScopedZone zone("bench zone");
+	}
+	report("main thread", std::chrono::steady_clock::now() - start, zones);
+
+	// every thread writes its own ring, so this should scale without contention
+	const size_t threadCount = engine.jobs.worker_count() + 1;
+	start = std::chrono::steady_clock::now();
+	engine.jobs.parallel_for(static_cast<size_t>(zones) * threadCount, 65536, [](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const vkprofile::ScopedZone zone("bench zone");
+		}
+	});
+	const auto elapsed = std::chrono::steady_clock::now() - start;
+	report("all threads, wall time per thread", elapsed, zones);
+
+	if (sink == 0)
+	{
+		std::cout << "  clock never advanced" << std::endl;
+	}
+}
+
+void vkbench::present_pass(VulkanEngine& engine, const int iterations)
+{
+	const VkExtent2D outputExtent = engine.windowExtent;
+
+	// a source of its own, so the frames' draw image is left alone. its slot in the heap is released
+	// when the draw image becomes the source again, and reused once the frame after the bench is done.
+	const AllocatedImage sourceImage = engine.create_image(
+		engine.drawImage.imageExtent,
+		engine.drawImage.imageFormat,
+		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+	const VkImage source = sourceImage.image;
+	engine.presentPass.set_source(engine.device, engine.bindless, sourceImage.imageView, engine.frameNumber);
+
+	// stands in for a swapchain image, the format the headless present pipeline is built for
+	const AllocatedImage target = engine.create_image(
+		VkExtent3D{ outputExtent.width , outputExtent.height , 1 },
+		VK_FORMAT_B8G8R8A8_SRGB,
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+
+	VkQueryPoolCreateInfo queryPoolInfo{ .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+	queryPoolInfo.pNext = nullptr;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = 4;
+
+	VkQueryPool queryPool;
+	VK_CHECK(vkCreateQueryPool(engine.device, &queryPoolInfo, nullptr, &queryPool));
+
+	engine.presentPass.wait_for_pipeline();
+
+	std::cout << "Present benchmark: " << iterations << " iterations per extent, into "
+		<< outputExtent.width << "x" << outputExtent.height << std::endl;
+	std::cout << "  (the present pass also tonemaps, sharpens and dithers, the blit only filters)" << std::endl;
+
+	// each iteration waits for the writes of the one before, like consecutive frames
+	const auto serialize = [](VkCommandBuffer cmd, VkPipelineStageFlags2 stage, VkAccessFlags2 access)
+	{
+		VkMemoryBarrier2 barrier{ .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2 };
+		barrier.pNext = nullptr;
+		barrier.srcStageMask = stage;
+		barrier.srcAccessMask = access;
+		barrier.dstStageMask = stage;
+		barrier.dstAccessMask = access;
+
+		VkDependencyInfo depInfo{ .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+		depInfo.pNext = nullptr;
+		depInfo.memoryBarrierCount = 1;
+		depInfo.pMemoryBarriers = &barrier;
+
+		vkCmdPipelineBarrier2(cmd, &depInfo);
+	};
+
+	// the range dynamic resolution moves through by default
+	for (const float scale : { 1.0f , 0.75f , 0.5f })
+	{
+		const VkExtent2D renderExtent{
+			static_cast<uint32_t>(outputExtent.width * scale) ,
+			static_cast<uint32_t>(outputExtent.height * scale)
+		};
+
+		// the source contents do not matter for the timing
+		engine.immediate_submit([&](VkCommandBuffer cmd)
+		{
+			vkCmdResetQueryPool(cmd, queryPool, 0, 4);
+
+			vkutil::transition_image(cmd, source, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+			vkutil::transition_image(cmd, target.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+			vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, queryPool, 0);
+			for (int i = 0; i < iterations; i++)
+			{
+				serialize(cmd, VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+				vkutil::copy_image_to_image(cmd, source, target.image, renderExtent, outputExtent);
+			}
+			vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, queryPool, 1);
+
+			vkutil::transition_image(cmd, source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			vkutil::transition_image(cmd, target.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+			engine.bindless.bind(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+			vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, queryPool, 2);
+			for (int i = 0; i < iterations; i++)
+			{
+				serialize(cmd, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+				engine.presentPass.record(cmd, engine.bindless.pipelineLayout, target.imageView, outputExtent,
+				                          renderExtent, static_cast<uint64_t>(i));
+			}
+			vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, queryPool, 3);
+		});
+
+		uint64_t timestamps[4];
+		VK_CHECK(vkGetQueryPoolResults(
+			engine.device, queryPool, 0, 4, sizeof(timestamps), timestamps, sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+		const double msPerTick = engine.gpuProperties.limits.timestampPeriod / 1e6;
+		const double blitMs = static_cast<double>(timestamps[1] - timestamps[0]) * msPerTick / iterations;
+		const double presentMs = static_cast<double>(timestamps[3] - timestamps[2]) * msPerTick / iterations;
+
+		std::cout << "  " << renderExtent.width << "x" << renderExtent.height << ": blit " << blitMs
+			<< " ms, present pass " << presentMs << " ms" << std::endl;
+	}
+
+	vkDestroyQueryPool(engine.device, queryPool, nullptr);
+	engine.destroy_image(target);
+
+	// every submission above has finished, so the view can go right after its index is released
+	engine.presentPass.set_source(engine.device, engine.bindless, engine.drawImage.imageView, engine.frameNumber);
+	engine.destroy_image(sourceImage);
+}
+
+void vkbench::command_recording(VulkanEngine& engine, const int frames)
+{
+	if (engine.meshPipeline == VK_NULL_HANDLE)
+	{
+		engine.meshPipeline = engine.meshPipelineBuild.get();
+	}
+
+	const size_t threadCount = engine.jobs.worker_count() + 1;
+	std::cout << "Command recording benchmark: " << engine.sceneDraws.size() << " draws, "
+		<< engine.drawsPerSecondary << " per secondary, " << frames << " frames" << std::endl;
+
+	// nothing is submitted, so the slot can be reset right after recording
+	constexpr uint32_t frameSlot = 0;
+
+	const auto measure = [&](const char* label, const bool parallel)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			engine.record_geometry(frameSlot, engine.windowExtent, parallel);
+			engine.secondaryPools.reset(engine.device, frameSlot);
+		}
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+
+		std::cout << "  " << label << ": " << ms << " ms/frame, "
+			<< ms * 1e6 / static_cast<double>(std::max<size_t>(engine.sceneDraws.size(), 1)) << " ns/draw" << std::endl;
+		return ms;
+	};
+
+	// the first rounds allocate the secondaries, the measured ones only reuse them
+	for (const bool parallel : { false , true })
+	{
+		engine.record_geometry(frameSlot, engine.windowExtent, parallel);
+		engine.secondaryPools.reset(engine.device, frameSlot);
+	}
+
+	const double serialMs = measure("main thread", false);
+	const double parallelMs = measure("job system", true);
+
+	std::cout << "  speedup " << serialMs / parallelMs << "x on " << threadCount << " threads" << std::endl;
+}
+
+void vkbench::transform_updates(VulkanEngine& engine, const int rounds)
+{
+	// 16 roots with 4 children per node, 8 levels deep
+	constexpr uint32_t rootCount = 16;
+	constexpr uint32_t fanOut = 4;
+	constexpr uint32_t depth = 8;
+
+	TransformHierarchy hierarchy;
+	std::vector<TransformHierarchy::Node> nodes;
+	std::vector<TransformHierarchy::Node> level;
+	for (uint32_t i = 0; i < rootCount; i++)
+	{
+		level.push_back(hierarchy.add_node(TransformHierarchy::NO_PARENT));
+	}
+	nodes.insert(nodes.end(), level.begin(), level.end());
+
+	std::mt19937 random{ 1 };
+	std::uniform_real_distribution<float> offset{ -1.f , 1.f };
+	for (uint32_t d = 1; d < depth; d++)
+	{
+		std::vector<TransformHierarchy::Node> children;
+		for (const TransformHierarchy::Node parent : level)
+		{
+			for (uint32_t i = 0; i < fanOut; i++)
+			{
+				const LocalTransform local{
+					glm::vec3{ offset(random) , offset(random) , offset(random) } ,
+					glm::angleAxis(offset(random) * 3.14f, glm::vec3{ 0.f , 1.f , 0.f }) ,
+					glm::vec3{ 0.9f }
+				};
+				children.push_back(hierarchy.add_node(parent, local));
+			}
+		}
+		nodes.insert(nodes.end(), children.begin(), children.end());
+		level = std::move(children);
+	}
+	hierarchy.update(&engine.jobs);
+
+	const size_t threadCount = engine.jobs.worker_count() + 1;
+	std::cout << "Transform update benchmark: " << hierarchy.node_count() << " nodes, " << hierarchy.level_count()
+		<< " levels, " << rounds << " rounds, " << threadCount << " threads" << std::endl;
+
+	for (const double percent : { 0.1 , 1.0 , 5.0 , 25.0 , 100.0 })
+	{
+		const size_t changes = static_cast<size_t>(static_cast<double>(nodes.size()) * percent / 100.0);
+
+		const auto measure = [&](JobSystem* jobs, uint32_t& updated)
+		{
+			std::chrono::steady_clock::duration total{};
+			for (int round = 0; round < rounds; round++)
+			{
+				// the same nodes on both passes, a change dirties the node and everything below it
+				std::mt19937 changeRandom{ static_cast<uint32_t>(round) };
+				std::uniform_int_distribution<size_t> changePick{ 0 , nodes.size() - 1 };
+				for (size_t i = 0; i < changes; i++)
+				{
+					const TransformHierarchy::Node node = nodes[changePick(changeRandom)];
+					hierarchy.set_position(node, hierarchy.local(node).position);
+				}
+
+				const auto start = std::chrono::steady_clock::now();
+				updated = hierarchy.update(jobs);
+				total += std::chrono::steady_clock::now() - start;
+			}
+			return std::chrono::duration<double, std::milli>(total).count() / rounds;
+		};
+
+		uint32_t updated = 0;
+		const double serialMs = measure(nullptr, updated);
+		const double parallelMs = measure(&engine.jobs, updated);
+
+		std::cout << "  " << percent << "% changed: " << updated << " nodes recomputed ("
+			<< 100.0 * updated / hierarchy.node_count() << "%), main thread " << serialMs << " ms ("
+			<< serialMs * 1e6 / std::max<uint32_t>(updated, 1) << " ns/node), job system " << parallelMs
+			<< " ms, speedup " << serialMs / parallelMs << "x" << std::endl;
+	}
+}
+
+void vkbench::instance_culling(VulkanEngine& engine, const int frames)
+{
+	constexpr uint32_t instanceCount = 1 << 20;
+
+	// a slab of the first test mesh in front of the scene camera, part of it outside the frustum.
+	// nothing is drawn, the batch's buffers are never read.
+	const MeshAsset& mesh = *engine.testMeshes.front();
+	InstanceCuller culler;
+	const uint32_t batch = culler.add_batch(&mesh.meshBuffers, mesh.surfaces, vkutil::compute_bounding_sphere(mesh.sourceVertices));
+
+	std::mt19937 random{ 1 };
+	std::uniform_real_distribution<float> across{ -1000.f , 1000.f };
+	std::uniform_real_distribution<float> height{ -50.f , 50.f };
+	std::uniform_real_distribution<float> along{ -2000.f , 0.f };
+	for (uint32_t i = 0; i < instanceCount; i++)
+	{
+		culler.add_instance(batch, glm::translate(glm::mat4{ 1.f }, glm::vec3{ across(random) , height(random) , along(random) }));
+	}
+	culler.init_buffers(engine.device, engine.allocator, 1);
+
+	const size_t threadCount = engine.jobs.worker_count() + 1;
+	std::cout << "Instance culling benchmark (" << vkutil::cull_spheres_isa() << "): " << instanceCount << " instances, "
+		<< frames << " frames, " << threadCount << " threads" << std::endl;
+
+	const auto measure = [&](const char* label, JobSystem* jobs)
+	{
+		// one warm up frame touches the instance buffer before the timing starts
+		culler.cull(engine.allocator, engine.sceneViewProj, 0, jobs);
+
+		const auto start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			culler.cull(engine.allocator, engine.sceneViewProj, 0, jobs);
+		}
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+
+		std::cout << "  " << label << ": " << culler.last_stats().visible << " visible, " << ms << " ms/frame, "
+			<< ms * 1e6 / instanceCount << " ns/instance" << std::endl;
+		return ms;
+	};
+
+	const double serialMs = measure("main thread", nullptr);
+	const double parallelMs = measure("job system", &engine.jobs);
+
+	std::cout << "  speedup " << serialMs / parallelMs << "x on " << threadCount << " threads" << std::endl;
+
+	culler.destroy(engine.allocator);
+}
+
+void vkbench::draw_sorting(VulkanEngine& engine, const int rounds)
+{
+	// the scene's keys in a shuffled order, worse than the grid's own
+	std::vector<uint64_t> keys;
+	for (const MeshDraw& draw : engine.sceneDraws)
+	{
+		keys.push_back(DrawSortKey::pack(0, 0, draw.material, draw.mesh, -(engine.sceneView * draw.transform[3]).z));
+	}
+	std::shuffle(keys.begin(), keys.end(), std::mt19937{ 1 });
+
+	std::cout << "Draw sorting benchmark: " << keys.size() << " draws, " << rounds << " rounds" << std::endl;
+
+	std::vector<uint64_t> sortedKeys;
+	std::vector<uint32_t> draws;
+	std::vector<uint64_t> keyScratch;
+	std::vector<uint32_t> drawScratch;
+	const auto measure = [&](const char* label, const auto& sort)
+	{
+		std::chrono::steady_clock::duration total{};
+		for (int round = 0; round < rounds; round++)
+		{
+			sortedKeys = keys;
+			draws.resize(keys.size());
+			std::iota(draws.begin(), draws.end(), 0u);
+
+			const auto start = std::chrono::steady_clock::now();
+			sort();
+			total += std::chrono::steady_clock::now() - start;
+		}
+		const double ms = std::chrono::duration<double, std::milli>(total).count() / rounds;
+
+		std::cout << "  " << label << ": " << ms << " ms, "
+			<< ms * 1e6 / static_cast<double>(std::max<size_t>(keys.size(), 1)) << " ns/draw" << std::endl;
+		return ms;
+	};
+
+	const double radixMs = measure("radix sort", [&]()
+	{
+		vkutil::radix_sort(sortedKeys, draws, keyScratch, drawScratch);
+	});
+	const double stableMs = measure("std::stable_sort", [&]()
+	{
+		std::vector<std::pair<uint64_t, uint32_t>> pairs(sortedKeys.size());
+		for (size_t i = 0; i < pairs.size(); i++)
+		{
+			pairs[i] = { sortedKeys[i] , draws[i] };
+		}
+		std::stable_sort(pairs.begin(), pairs.end(), [](const auto& a, const auto& b)
+		{
+			return a.first < b.first;
+		});
+	});
+	std::cout << "  radix sort " << stableMs / radixMs << "x faster" << std::endl;
+
+	vkutil::radix_sort(sortedKeys, draws, keyScratch, drawScratch);
+	const RenderQueue::BindCounts unsorted = RenderQueue::count_binds(keys, engine.drawsPerSecondary);
+	const RenderQueue::BindCounts sorted = RenderQueue::count_binds(sortedKeys, engine.drawsPerSecondary);
+	std::cout << "  binds per frame, shuffled -> sorted: pipelines " << unsorted.pipelines << " -> " << sorted.pipelines
+		<< ", materials " << unsorted.materials << " -> " << sorted.materials
+		<< ", index buffers " << unsorted.indexBuffers << " -> " << sorted.indexBuffers << std::endl;
+}
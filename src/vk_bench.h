@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string_view>
+
+class VulkanEngine;
+
+// startup and throughput measurements, selected with --bench <name> on the command line.
+// they run against an initialized engine (usually --headless) instead of the main loop.
+namespace vkbench
+{
+	// returns false if there is no benchmark with that name
+	bool run(std::string_view name, VulkanEngine& engine);
+
+	void pipeline_builds(VulkanEngine& engine, int copies);
+	// push and flush cost of the typed deletion queue against a deque of std::function
+	void deletion_queue(VulkanEngine& engine, int rounds, int entriesPerRound);
+	// obj import time against tinyobjloader, and acmr before and after cache optimization
+	void mesh_import(VulkanEngine& engine);
+	// time until the test assets are resident on the gpu, from source files against the asset pack
+	void asset_loading(VulkanEngine& engine);
+	// encode time, quality and size of the block compressed formats picked for each texture variant
+	void texture_compression(VulkanEngine& engine);
+	// cost of one cpu profiler zone, on the main thread alone and on every thread at once
+	void profiler_zones(VulkanEngine& engine, int zones);
+	// gpu time of the present pass against the linear blit it replaced, at matching and upscaled extents
+	void present_pass(VulkanEngine& engine, int iterations);
+	// cpu time to record the scene's secondaries on the main thread alone and on every thread
+	void command_recording(VulkanEngine& engine, int frames);
+	// transform hierarchy update time against the share of nodes changed, on one thread and on every thread
+	void transform_updates(VulkanEngine& engine, int rounds);
+	// cpu frustum culling and instance buffer writes per instance, on one thread and on every thread
+	void instance_culling(VulkanEngine& engine, int frames);
+	// radix sort of the scene's draw keys against std::stable_sort, and the binds the sorted order saves
+	void draw_sorting(VulkanEngine& engine, int rounds);
+}
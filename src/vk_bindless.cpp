@@ -0,0 +1,274 @@
+#include "vk_bindless.h"
+
+#include <algorithm>
+
+namespace
+{
+	constexpr VkDescriptorType BINDLESS_DESCRIPTOR_TYPES[BINDLESS_BINDING_COUNT] = {
+		VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ,
+		VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE ,
+		VK_DESCRIPTOR_TYPE_SAMPLER ,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+	};
+}
+
+void IndexFreeList::init(uint32_t capacity)
+{
+	indexCapacity = capacity;
+	nextFree = std::make_unique<std::atomic<uint32_t>[]>(capacity);
+
+	for (uint32_t i = 0; i < capacity; i++)
+	{
+		nextFree[i].store(i + 1 < capacity ? i + 1 : BINDLESS_INVALID_INDEX, std::memory_order_relaxed);
+	}
+
+	head.store(pack(0, capacity > 0 ? 0 : BINDLESS_INVALID_INDEX), std::memory_order_release);
+}
+
+uint32_t IndexFreeList::allocate()
+{
+	uint64_t oldHead = head.load(std::memory_order_acquire);
+
+	while (true)
+	{
+		const auto index = static_cast<uint32_t>(oldHead);
+		if (index == BINDLESS_INVALID_INDEX)
+		{
+			return BINDLESS_INVALID_INDEX;
+		}
+
+		const auto tag = static_cast<uint32_t>(oldHead >> 32);
+		const uint64_t newHead = pack(tag + 1, nextFree[index].load(std::memory_order_relaxed));
+
+		if (head.compare_exchange_weak(oldHead, newHead, std::memory_order_acq_rel, std::memory_order_acquire))
+		{
+			return index;
+		}
+	}
+}
+
+void IndexFreeList::free(uint32_t index)
+{
+	uint64_t oldHead = head.load(std::memory_order_acquire);
+
+	while (true)
+	{
+		nextFree[index].store(static_cast<uint32_t>(oldHead), std::memory_order_relaxed);
+
+		const auto tag = static_cast<uint32_t>(oldHead >> 32);
+		const uint64_t newHead = pack(tag + 1, index);
+
+		if (head.compare_exchange_weak(oldHead, newHead, std::memory_order_acq_rel, std::memory_order_acquire))
+		{
+			return;
+		}
+	}
+}
+
+void BindlessHeap::init(VkDevice device, VkPhysicalDevice physicalDevice)
+{
+	VkPhysicalDeviceVulkan12Properties properties12{};
+	properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+	VkPhysicalDeviceProperties2 properties{};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &properties12;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+	// what we would like, clamped to what the device allows for update-after-bind sets
+	const uint32_t capacities[BINDLESS_BINDING_COUNT] = {
+		std::min(1024u, std::min(properties12.maxDescriptorSetUpdateAfterBindStorageImages,
+		                         properties12.maxPerStageDescriptorUpdateAfterBindStorageImages)) ,
+		std::min(16384u, std::min(properties12.maxDescriptorSetUpdateAfterBindSampledImages,
+		                          properties12.maxPerStageDescriptorUpdateAfterBindSampledImages)) ,
+		std::min(256u, std::min(properties12.maxDescriptorSetUpdateAfterBindSamplers,
+		                        properties12.maxPerStageDescriptorUpdateAfterBindSamplers)) ,
+		std::min(16384u, std::min(properties12.maxDescriptorSetUpdateAfterBindStorageBuffers,
+		                          properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers))
+	};
+
+	VkDescriptorSetLayoutBinding bindings[BINDLESS_BINDING_COUNT]{};
+	VkDescriptorBindingFlags bindingFlags[BINDLESS_BINDING_COUNT]{};
+	VkDescriptorPoolSize poolSizes[BINDLESS_BINDING_COUNT]{};
+
+	for (uint32_t i = 0; i < BINDLESS_BINDING_COUNT; i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = BINDLESS_DESCRIPTOR_TYPES[i];
+		bindings[i].descriptorCount = capacities[i];
+		bindings[i].stageFlags = VK_SHADER_STAGE_ALL;
+
+		bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+
+		poolSizes[i].type = BINDLESS_DESCRIPTOR_TYPES[i];
+		poolSizes[i].descriptorCount = capacities[i];
+
+		freeLists[i].init(capacities[i]);
+	}
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	bindingFlagsInfo.pNext = nullptr;
+	bindingFlagsInfo.bindingCount = BINDLESS_BINDING_COUNT;
+	bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &bindingFlagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	layoutInfo.bindingCount = BINDLESS_BINDING_COUNT;
+	layoutInfo.pBindings = bindings;
+
+	VK_CHECK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout));
+
+	VkDescriptorPoolCreateInfo poolInfo = { .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = BINDLESS_BINDING_COUNT;
+	poolInfo.pPoolSizes = poolSizes;
+
+	VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool));
+
+	VkDescriptorSetAllocateInfo allocInfo = { .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+	allocInfo.pNext = nullptr;
+	allocInfo.descriptorPool = pool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &setLayout;
+
+	VK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, &set));
+
+	VkPushConstantRange pushConstants{};
+	pushConstants.stageFlags = VK_SHADER_STAGE_ALL;
+	pushConstants.offset = 0;
+	pushConstants.size = BINDLESS_PUSH_CONSTANT_SIZE;
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.pNext = nullptr;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &setLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstants;
+
+	VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout));
+}
+
+void BindlessHeap::destroy(VkDevice device)
+{
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(device, pool, nullptr);
+	vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+
+	pipelineLayout = VK_NULL_HANDLE;
+	pool = VK_NULL_HANDLE;
+	setLayout = VK_NULL_HANDLE;
+	set = VK_NULL_HANDLE;
+}
+
+uint32_t BindlessHeap::register_storage_image(VkDevice device, VkImageView view)
+{
+	const uint32_t index = allocate_index(BINDLESS_STORAGE_IMAGES);
+
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageView = view;
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	write_descriptor(device, BINDLESS_STORAGE_IMAGES, index, &imageInfo, nullptr);
+	return index;
+}
+
+uint32_t BindlessHeap::register_sampled_image(VkDevice device, VkImageView view)
+{
+	const uint32_t index = allocate_index(BINDLESS_SAMPLED_IMAGES);
+
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageView = view;
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	write_descriptor(device, BINDLESS_SAMPLED_IMAGES, index, &imageInfo, nullptr);
+	return index;
+}
+
+uint32_t BindlessHeap::register_sampler(VkDevice device, VkSampler sampler)
+{
+	const uint32_t index = allocate_index(BINDLESS_SAMPLERS);
+
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.sampler = sampler;
+
+	write_descriptor(device, BINDLESS_SAMPLERS, index, &imageInfo, nullptr);
+	return index;
+}
+
+uint32_t BindlessHeap::register_storage_buffer(VkDevice device, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	const uint32_t index = allocate_index(BINDLESS_STORAGE_BUFFERS);
+
+	VkDescriptorBufferInfo bufferInfo{};
+	bufferInfo.buffer = buffer;
+	bufferInfo.offset = offset;
+	bufferInfo.range = range;
+
+	write_descriptor(device, BINDLESS_STORAGE_BUFFERS, index, nullptr, &bufferInfo);
+	return index;
+}
+
+void BindlessHeap::release(BindlessBinding binding, uint32_t index, uint64_t frameNumber)
+{
+	std::lock_guard lock(releaseMutex);
+	pendingReleases.push_back(PendingRelease{ frameNumber , binding , index });
+}
+
+void BindlessHeap::retire(uint64_t completedFrame)
+{
+	std::lock_guard lock(releaseMutex);
+
+	// partially bound slots can be left stale, nothing reads them once the frame is done
+	std::erase_if(pendingReleases, [&](const PendingRelease& pending)
+	{
+		if (pending.frameNumber > completedFrame)
+		{
+			return false;
+		}
+
+		freeLists[pending.binding].free(pending.index);
+		return true;
+	});
+}
+
+void BindlessHeap::bind(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint) const
+{
+	vkCmdBindDescriptorSets(cmd, bindPoint, pipelineLayout, 0, 1, &set, 0, nullptr);
+}
+
+uint32_t BindlessHeap::allocate_index(BindlessBinding binding)
+{
+	const uint32_t index = freeLists[binding].allocate();
+	if (index == BINDLESS_INVALID_INDEX)
+	{
+		std::cout << "Bindless heap: binding " << binding << " is full ("
+			<< freeLists[binding].capacity() << " descriptors)" << std::endl;
+		abort();
+	}
+	return index;
+}
+
+void BindlessHeap::write_descriptor(
+	VkDevice device,
+	BindlessBinding binding,
+	uint32_t index,
+	const VkDescriptorImageInfo* imageInfo,
+	const VkDescriptorBufferInfo* bufferInfo)
+{
+	VkWriteDescriptorSet write = { .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+	write.dstSet = set;
+	write.dstBinding = binding;
+	write.dstArrayElement = index;
+	write.descriptorCount = 1;
+	write.descriptorType = BINDLESS_DESCRIPTOR_TYPES[binding];
+	write.pImageInfo = imageInfo;
+	write.pBufferInfo = bufferInfo;
+
+	std::lock_guard lock(writeMutex);
+	vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "vk_types.h"
+
+// bindings of the global resource heap. shaders declare matching unsized arrays in set 0
+// and receive the indices they need through push constants.
+enum BindlessBinding : uint32_t
+{
+	BINDLESS_STORAGE_IMAGES = 0,
+	BINDLESS_SAMPLED_IMAGES = 1,
+	BINDLESS_SAMPLERS = 2,
+	BINDLESS_STORAGE_BUFFERS = 3,
+	BINDLESS_BINDING_COUNT
+};
+
+constexpr uint32_t BINDLESS_INVALID_INDEX = UINT32_MAX;
+
+// size of the push constant block shared by every pipeline on the bindless layout
+constexpr uint32_t BINDLESS_PUSH_CONSTANT_SIZE = 128;
+
+// lock-free stack of free indices. the head carries a tag that changes on every
+// update, so a pop racing with a pop and push of the same index cannot succeed.
+class IndexFreeList
+{
+public:
+	void init(uint32_t capacity);
+
+	// returns BINDLESS_INVALID_INDEX when every index is in use
+	uint32_t allocate();
+	void free(uint32_t index);
+
+	uint32_t capacity() const { return indexCapacity; }
+
+private:
+	static uint64_t pack(uint32_t tag, uint32_t index) { return (static_cast<uint64_t>(tag) << 32) | index; }
+
+	std::unique_ptr<std::atomic<uint32_t>[]> nextFree;
+	std::atomic<uint64_t> head{ pack(0, BINDLESS_INVALID_INDEX) };
+	uint32_t indexCapacity{ 0 };
+};
+
+// one large update-after-bind, partially bound descriptor set holding every resource.
+// it is bound once per command buffer, draws and dispatches only push indices.
+class BindlessHeap
+{
+public:
+	void init(VkDevice device, VkPhysicalDevice physicalDevice);
+	void destroy(VkDevice device);
+
+	uint32_t register_storage_image(VkDevice device, VkImageView view);
+	uint32_t register_sampled_image(VkDevice device, VkImageView view);
+	uint32_t register_sampler(VkDevice device, VkSampler sampler);
+	uint32_t register_storage_buffer(VkDevice device, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+
+	// the index is handed out again once frameNumber has finished on the gpu
+	void release(BindlessBinding binding, uint32_t index, uint64_t frameNumber);
+	// recycles everything released up to and including completedFrame
+	void retire(uint64_t completedFrame);
+
+	void bind(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint) const;
+
+	VkDescriptorSetLayout setLayout{ VK_NULL_HANDLE };
+	// set 0 is the heap, plus BINDLESS_PUSH_CONSTANT_SIZE bytes of push constants for all stages
+	VkPipelineLayout pipelineLayout{ VK_NULL_HANDLE };
+
+private:
+	uint32_t allocate_index(BindlessBinding binding);
+	void write_descriptor(VkDevice device, BindlessBinding binding, uint32_t index,
+	                      const VkDescriptorImageInfo* imageInfo, const VkDescriptorBufferInfo* bufferInfo);
+
+	struct PendingRelease
+	{
+		uint64_t frameNumber;
+		BindlessBinding binding;
+		uint32_t index;
+	};
+
+	VkDescriptorPool pool{ VK_NULL_HANDLE };
+	VkDescriptorSet set{ VK_NULL_HANDLE };
+
+	IndexFreeList freeLists[BINDLESS_BINDING_COUNT];
+
+	// vkUpdateDescriptorSets needs the set externally synchronized
+	std::mutex writeMutex;
+
+	std::mutex releaseMutex;
+	std::vector<PendingRelease> pendingReleases;
+};
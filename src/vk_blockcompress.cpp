@@ -0,0 +1,1207 @@
+#include "vk_blockcompress.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define VKUTIL_BLOCKCOMPRESS_SSE2 1
+#endif
+
+#include "vk_jobs.h"
+
+namespace
+{
+	// four texels of one channel, one per lane
+	struct Lanes
+	{
+#ifdef VKUTIL_BLOCKCOMPRESS_SSE2
+		__m128 v;
+#else
+		float v[4];
+#endif
+	};
+
+#ifdef VKUTIL_BLOCKCOMPRESS_SSE2
+	Lanes load(const float* values) { return { _mm_load_ps(values) }; }
+	Lanes splat(float value) { return { _mm_set1_ps(value) }; }
+	void store(float* values, Lanes a) { _mm_store_ps(values, a.v); }
+
+	Lanes operator+(Lanes a, Lanes b) { return { _mm_add_ps(a.v, b.v) }; }
+	Lanes operator-(Lanes a, Lanes b) { return { _mm_sub_ps(a.v, b.v) }; }
+	Lanes operator*(Lanes a, Lanes b) { return { _mm_mul_ps(a.v, b.v) }; }
+	Lanes lanes_min(Lanes a, Lanes b) { return { _mm_min_ps(a.v, b.v) }; }
+	Lanes lanes_max(Lanes a, Lanes b) { return { _mm_max_ps(a.v, b.v) }; }
+
+	// ifLess in the lanes where a < b, otherwise everywhere else
+	Lanes select_less(Lanes a, Lanes b, Lanes ifLess, Lanes otherwise)
+	{
+		const __m128 mask = _mm_cmplt_ps(a.v, b.v);
+		return { _mm_or_ps(_mm_and_ps(mask, ifLess.v), _mm_andnot_ps(mask, otherwise.v)) };
+	}
+#else
+	Lanes load(const float* values) { return { { values[0] , values[1] , values[2] , values[3] } }; }
+	Lanes splat(float value) { return { { value , value , value , value } }; }
+	void store(float* values, Lanes a) { std::copy(a.v, a.v + 4, values); }
+
+	template <typename Op>
+	Lanes per_lane(Lanes a, Lanes b, Op op)
+	{
+		return { { op(a.v[0], b.v[0]) , op(a.v[1], b.v[1]) , op(a.v[2], b.v[2]) , op(a.v[3], b.v[3]) } };
+	}
+
+	Lanes operator+(Lanes a, Lanes b) { return per_lane(a, b, [](float x, float y) { return x + y; }); }
+	Lanes operator-(Lanes a, Lanes b) { return per_lane(a, b, [](float x, float y) { return x - y; }); }
+	Lanes operator*(Lanes a, Lanes b) { return per_lane(a, b, [](float x, float y) { return x * y; }); }
+	Lanes lanes_min(Lanes a, Lanes b) { return per_lane(a, b, [](float x, float y) { return x < y ? x : y; }); }
+	Lanes lanes_max(Lanes a, Lanes b) { return per_lane(a, b, [](float x, float y) { return x > y ? x : y; }); }
+
+	Lanes select_less(Lanes a, Lanes b, Lanes ifLess, Lanes otherwise)
+	{
+		Lanes result;
+		for (uint32_t lane = 0; lane < 4; lane++)
+		{
+			result.v[lane] = a.v[lane] < b.v[lane] ? ifLess.v[lane] : otherwise.v[lane];
+		}
+		return result;
+	}
+#endif
+
+	float horizontal_sum(Lanes a)
+	{
+		alignas(16) float values[4];
+		store(values, a);
+		return (values[0] + values[1]) + (values[2] + values[3]);
+	}
+
+	float horizontal_min(Lanes a)
+	{
+		alignas(16) float values[4];
+		store(values, a);
+		return std::min(std::min(values[0], values[1]), std::min(values[2], values[3]));
+	}
+
+	float horizontal_max(Lanes a)
+	{
+		alignas(16) float values[4];
+		store(values, a);
+		return std::max(std::max(values[0], values[1]), std::max(values[2], values[3]));
+	}
+
+	// the 16 texels of a block, one row of floats per channel
+	struct Block
+	{
+		alignas(16) float channels[4][16];
+	};
+
+	Block load_block(const uint8_t* texels)
+	{
+		Block block;
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				block.channels[c][i] = texels[i * 4 + c];
+			}
+		}
+		return block;
+	}
+
+	struct Endpoints
+	{
+		float start[4];
+		float end[4];
+	};
+
+	// the first Count channels are fitted, the rest are left at 0
+	template <uint32_t Count>
+	Endpoints fit_principal_axis(const Block& block)
+	{
+		float mean[4] = {};
+		for (uint32_t c = 0; c < Count; c++)
+		{
+			Lanes sum = splat(0.f);
+			for (uint32_t i = 0; i < 16; i += 4)
+			{
+				sum = sum + load(&block.channels[c][i]);
+			}
+			mean[c] = horizontal_sum(sum) / 16.f;
+		}
+
+		float covariance[4][4] = {};
+		for (uint32_t a = 0; a < Count; a++)
+		{
+			for (uint32_t b = a; b < Count; b++)
+			{
+				Lanes sum = splat(0.f);
+				for (uint32_t i = 0; i < 16; i += 4)
+				{
+					sum = sum + (load(&block.channels[a][i]) - splat(mean[a])) * (load(&block.channels[b][i]) - splat(mean[b]));
+				}
+				covariance[a][b] = horizontal_sum(sum);
+				covariance[b][a] = covariance[a][b];
+			}
+		}
+
+		// power iteration, starting from the channel that varies the most
+		uint32_t largest = 0;
+		for (uint32_t c = 1; c < Count; c++)
+		{
+			if (covariance[c][c] > covariance[largest][largest])
+			{
+				largest = c;
+			}
+		}
+
+		float axis[4] = {};
+		axis[largest] = 1.f;
+		for (uint32_t iteration = 0; iteration < 8; iteration++)
+		{
+			float next[4] = {};
+			float lengthSquared = 0.f;
+			for (uint32_t a = 0; a < Count; a++)
+			{
+				for (uint32_t b = 0; b < Count; b++)
+				{
+					next[a] += covariance[a][b] * axis[b];
+				}
+				lengthSquared += next[a] * next[a];
+			}
+
+			// a flat block has no axis, both endpoints end up on the mean
+			if (lengthSquared < 1e-12f)
+			{
+				break;
+			}
+
+			const float inverseLength = 1.f / std::sqrt(lengthSquared);
+			for (uint32_t a = 0; a < Count; a++)
+			{
+				axis[a] = next[a] * inverseLength;
+			}
+		}
+
+		// the extremes of the texels projected onto the axis
+		Lanes low = splat(FLT_MAX);
+		Lanes high = splat(-FLT_MAX);
+		for (uint32_t i = 0; i < 16; i += 4)
+		{
+			Lanes t = splat(0.f);
+			for (uint32_t c = 0; c < Count; c++)
+			{
+				t = t + (load(&block.channels[c][i]) - splat(mean[c])) * splat(axis[c]);
+			}
+			low = lanes_min(low, t);
+			high = lanes_max(high, t);
+		}
+
+		const float tMin = horizontal_min(low);
+		const float tMax = horizontal_max(high);
+
+		Endpoints endpoints{};
+		for (uint32_t c = 0; c < Count; c++)
+		{
+			endpoints.start[c] = std::clamp(mean[c] + axis[c] * tMin, 0.f, 255.f);
+			endpoints.end[c] = std::clamp(mean[c] + axis[c] * tMax, 0.f, 255.f);
+		}
+		return endpoints;
+	}
+
+	// nearest palette entry per texel over Count channels starting at First, returns the summed squared error
+	template <uint32_t First, uint32_t Count>
+	float select_indices(const Block& block, const float (*palette)[4], uint32_t paletteSize, uint8_t* indices)
+	{
+		float total = 0.f;
+
+		for (uint32_t i = 0; i < 16; i += 4)
+		{
+			Lanes texel[Count];
+			for (uint32_t c = 0; c < Count; c++)
+			{
+				texel[c] = load(&block.channels[First + c][i]);
+			}
+
+			Lanes bestError = splat(FLT_MAX);
+			Lanes bestIndex = splat(0.f);
+			for (uint32_t k = 0; k < paletteSize; k++)
+			{
+				Lanes error = splat(0.f);
+				for (uint32_t c = 0; c < Count; c++)
+				{
+					const Lanes difference = texel[c] - splat(palette[k][First + c]);
+					error = error + difference * difference;
+				}
+
+				bestIndex = select_less(error, bestError, splat(static_cast<float>(k)), bestIndex);
+				bestError = lanes_min(error, bestError);
+			}
+
+			alignas(16) float index[4];
+			store(index, bestIndex);
+			for (uint32_t lane = 0; lane < 4; lane++)
+			{
+				indices[i + lane] = static_cast<uint8_t>(index[lane]);
+			}
+			total += horizontal_sum(bestError);
+		}
+
+		return total;
+	}
+
+	// least squares endpoints of Count channels starting at First for fixed indices,
+	// weights[index] is how far along the segment each index sits. fails when every texel uses the same weight.
+	template <uint32_t First, uint32_t Count>
+	bool refit_endpoints(const Block& block, const uint8_t* indices, const float* weights, Endpoints& endpoints)
+	{
+		alignas(16) float weight[16];
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			weight[i] = weights[indices[i]];
+		}
+
+		Lanes startStart = splat(0.f);
+		Lanes startEnd = splat(0.f);
+		Lanes endEnd = splat(0.f);
+		Lanes startTexel[Count];
+		Lanes endTexel[Count];
+		for (uint32_t c = 0; c < Count; c++)
+		{
+			startTexel[c] = splat(0.f);
+			endTexel[c] = splat(0.f);
+		}
+
+		for (uint32_t i = 0; i < 16; i += 4)
+		{
+			const Lanes t = load(&weight[i]);
+			const Lanes s = splat(1.f) - t;
+			startStart = startStart + s * s;
+			startEnd = startEnd + s * t;
+			endEnd = endEnd + t * t;
+
+			for (uint32_t c = 0; c < Count; c++)
+			{
+				const Lanes texel = load(&block.channels[First + c][i]);
+				startTexel[c] = startTexel[c] + s * texel;
+				endTexel[c] = endTexel[c] + t * texel;
+			}
+		}
+
+		const float a = horizontal_sum(startStart);
+		const float b = horizontal_sum(startEnd);
+		const float d = horizontal_sum(endEnd);
+		const float determinant = a * d - b * b;
+		if (std::abs(determinant) < 1e-6f)
+		{
+			return false;
+		}
+
+		const float inverse = 1.f / determinant;
+		for (uint32_t c = 0; c < Count; c++)
+		{
+			const float x = horizontal_sum(startTexel[c]);
+			const float y = horizontal_sum(endTexel[c]);
+			endpoints.start[First + c] = std::clamp((d * x - b * y) * inverse, 0.f, 255.f);
+			endpoints.end[First + c] = std::clamp((a * y - b * x) * inverse, 0.f, 255.f);
+		}
+		return true;
+	}
+
+	// little endian bit stream, the layout BC7 blocks are specified in
+	struct BitWriter
+	{
+		uint8_t* data;
+		uint32_t position = 0;
+
+		void write(uint32_t value, uint32_t count)
+		{
+			for (uint32_t bit = 0; bit < count; bit++, position++)
+			{
+				data[position >> 3] |= static_cast<uint8_t>(((value >> bit) & 1) << (position & 7));
+			}
+		}
+	};
+
+	struct BitReader
+	{
+		const uint8_t* data;
+		uint32_t position = 0;
+
+		uint32_t read(uint32_t count)
+		{
+			uint32_t value = 0;
+			for (uint32_t bit = 0; bit < count; bit++, position++)
+			{
+				value |= static_cast<uint32_t>((data[position >> 3] >> (position & 7)) & 1) << bit;
+			}
+			return value;
+		}
+	};
+
+	// BC1 color blocks, shared with BC3
+
+	uint16_t pack_565(const float* color)
+	{
+		const auto r = static_cast<uint32_t>(std::clamp(color[0] * (31.f / 255.f) + 0.5f, 0.f, 31.f));
+		const auto g = static_cast<uint32_t>(std::clamp(color[1] * (63.f / 255.f) + 0.5f, 0.f, 63.f));
+		const auto b = static_cast<uint32_t>(std::clamp(color[2] * (31.f / 255.f) + 0.5f, 0.f, 31.f));
+		return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+	}
+
+	void unpack_565(uint16_t packed, uint32_t* color)
+	{
+		const uint32_t r = (packed >> 11) & 31;
+		const uint32_t g = (packed >> 5) & 63;
+		const uint32_t b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	// three color mode puts black in the last entry. alpha stays opaque, only the rgb formats are used.
+	void color_palette(uint16_t start, uint16_t end, bool fourColor, uint32_t (*palette)[4])
+	{
+		uint32_t c0[3];
+		uint32_t c1[3];
+		unpack_565(start, c0);
+		unpack_565(end, c1);
+
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			palette[0][c] = c0[c];
+			palette[1][c] = c1[c];
+			palette[2][c] = fourColor ? (2 * c0[c] + c1[c]) / 3 : (c0[c] + c1[c]) / 2;
+			palette[3][c] = fourColor ? (c0[c] + 2 * c1[c]) / 3 : 0;
+		}
+		for (uint32_t k = 0; k < 4; k++)
+		{
+			palette[k][3] = 255;
+		}
+	}
+
+	struct ColorBlock
+	{
+		uint16_t start;
+		uint16_t end;
+		uint8_t indices[16];
+		float error;
+	};
+
+	constexpr float COLOR_WEIGHTS[4] = { 0.f , 1.f , 1.f / 3.f , 2.f / 3.f };
+
+	void try_color_endpoints(const Block& block, const Endpoints& endpoints, ColorBlock& best)
+	{
+		ColorBlock candidate;
+		candidate.start = pack_565(endpoints.start);
+		candidate.end = pack_565(endpoints.end);
+
+		// four color mode needs start > end
+		if (candidate.start < candidate.end)
+		{
+			std::swap(candidate.start, candidate.end);
+		}
+
+		uint32_t palette[4][4];
+		color_palette(candidate.start, candidate.end, true, palette);
+
+		float floatPalette[4][4];
+		for (uint32_t k = 0; k < 4; k++)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				floatPalette[k][c] = static_cast<float>(palette[k][c]);
+			}
+		}
+
+		// equal endpoints switch BC1 to three color mode, index 0 decodes the same in both
+		const uint32_t paletteSize = candidate.start == candidate.end ? 1 : 4;
+		candidate.error = select_indices<0, 3>(block, floatPalette, paletteSize, candidate.indices);
+
+		if (candidate.error < best.error)
+		{
+			best = candidate;
+		}
+	}
+
+	ColorBlock encode_color(const Block& block)
+	{
+		ColorBlock best;
+		best.error = FLT_MAX;
+
+		Endpoints endpoints = fit_principal_axis<3>(block);
+		try_color_endpoints(block, endpoints, best);
+
+		// the extremes of the axis are rarely the best endpoints once the texels are snapped to the palette
+		for (uint32_t iteration = 0; iteration < 2; iteration++)
+		{
+			if (!refit_endpoints<0, 3>(block, best.indices, COLOR_WEIGHTS, endpoints))
+			{
+				break;
+			}
+			try_color_endpoints(block, endpoints, best);
+		}
+
+		return best;
+	}
+
+	void write_color(const ColorBlock& color, uint8_t* block)
+	{
+		uint32_t indices = 0;
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			indices |= static_cast<uint32_t>(color.indices[i]) << (i * 2);
+		}
+
+		block[0] = static_cast<uint8_t>(color.start);
+		block[1] = static_cast<uint8_t>(color.start >> 8);
+		block[2] = static_cast<uint8_t>(color.end);
+		block[3] = static_cast<uint8_t>(color.end >> 8);
+		for (uint32_t b = 0; b < 4; b++)
+		{
+			block[4 + b] = static_cast<uint8_t>(indices >> (b * 8));
+		}
+	}
+
+	void decode_color(const uint8_t* block, bool forceFourColor, uint8_t* texels)
+	{
+		const auto start = static_cast<uint16_t>(block[0] | (block[1] << 8));
+		const auto end = static_cast<uint16_t>(block[2] | (block[3] << 8));
+		const uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (static_cast<uint32_t>(block[7]) << 24);
+
+		uint32_t palette[4][4];
+		color_palette(start, end, forceFourColor || start > end, palette);
+
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			const uint32_t index = (indices >> (i * 2)) & 3;
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				texels[i * 4 + c] = static_cast<uint8_t>(palette[index][c]);
+			}
+		}
+	}
+
+	// BC3 alpha blocks
+
+	void alpha_palette(uint32_t start, uint32_t end, uint32_t* palette)
+	{
+		palette[0] = start;
+		palette[1] = end;
+
+		if (start > end)
+		{
+			for (uint32_t k = 1; k < 7; k++)
+			{
+				palette[k + 1] = ((7 - k) * start + k * end) / 7;
+			}
+		}
+		else
+		{
+			for (uint32_t k = 1; k < 5; k++)
+			{
+				palette[k + 1] = ((5 - k) * start + k * end) / 5;
+			}
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	void encode_alpha(const Block& block, uint8_t* alphaBlock)
+	{
+		Lanes low = splat(255.f);
+		Lanes high = splat(0.f);
+		for (uint32_t i = 0; i < 16; i += 4)
+		{
+			const Lanes alpha = load(&block.channels[3][i]);
+			low = lanes_min(low, alpha);
+			high = lanes_max(high, alpha);
+		}
+
+		// start > end selects the eight value mode
+		const auto start = static_cast<uint32_t>(horizontal_max(high));
+		const auto end = static_cast<uint32_t>(horizontal_min(low));
+
+		uint8_t indices[16] = {};
+		if (start != end)
+		{
+			uint32_t palette[8];
+			alpha_palette(start, end, palette);
+
+			float floatPalette[8][4] = {};
+			for (uint32_t k = 0; k < 8; k++)
+			{
+				floatPalette[k][3] = static_cast<float>(palette[k]);
+			}
+			select_indices<3, 1>(block, floatPalette, 8, indices);
+		}
+
+		uint64_t bits = 0;
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			bits |= static_cast<uint64_t>(indices[i]) << (i * 3);
+		}
+
+		alphaBlock[0] = static_cast<uint8_t>(start);
+		alphaBlock[1] = static_cast<uint8_t>(end);
+		for (uint32_t b = 0; b < 6; b++)
+		{
+			alphaBlock[2 + b] = static_cast<uint8_t>(bits >> (b * 8));
+		}
+	}
+
+	void decode_alpha(const uint8_t* alphaBlock, uint8_t* texels)
+	{
+		uint32_t palette[8];
+		alpha_palette(alphaBlock[0], alphaBlock[1], palette);
+
+		uint64_t bits = 0;
+		for (uint32_t b = 0; b < 6; b++)
+		{
+			bits |= static_cast<uint64_t>(alphaBlock[2 + b]) << (b * 8);
+		}
+
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			texels[i * 4 + 3] = static_cast<uint8_t>(palette[(bits >> (i * 3)) & 7]);
+		}
+	}
+
+	// BC7 mode 6: 7 bit rgba endpoints, one p-bit per endpoint, 4 bit indices.
+	// BC7 mode 5: 7 bit rgb and 8 bit alpha endpoints, each with their own 2 bit indices.
+
+	constexpr uint32_t MODE6_WEIGHTS[16] = { 0 , 4 , 9 , 13 , 17 , 21 , 26 , 30 , 34 , 38 , 43 , 47 , 51 , 55 , 60 , 64 };
+	constexpr uint32_t MODE5_WEIGHTS[4] = { 0 , 21 , 43 , 64 };
+
+	uint32_t bc7_interpolate(uint32_t start, uint32_t end, uint32_t weight)
+	{
+		return ((64 - weight) * start + weight * end + 32) >> 6;
+	}
+
+	uint32_t expand_7bit(uint32_t value)
+	{
+		return (value << 1) | (value >> 6);
+	}
+
+	struct Mode6Block
+	{
+		uint8_t start[4];
+		uint8_t end[4];
+		uint8_t startBit;
+		uint8_t endBit;
+		uint8_t indices[16];
+		float error;
+	};
+
+	// the p-bit is shared by all four channels, so both choices are tried
+	void quantize_mode6_endpoint(const float* color, uint8_t* quantized, uint8_t& pBit)
+	{
+		float bestError = FLT_MAX;
+		for (uint32_t p = 0; p < 2; p++)
+		{
+			uint8_t candidate[4];
+			float error = 0.f;
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				candidate[c] = static_cast<uint8_t>(std::clamp((color[c] - static_cast<float>(p)) * 0.5f + 0.5f, 0.f, 127.f));
+				const float difference = static_cast<float>((candidate[c] << 1) | p) - color[c];
+				error += difference * difference;
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				std::copy(candidate, candidate + 4, quantized);
+				pBit = static_cast<uint8_t>(p);
+			}
+		}
+	}
+
+	void try_mode6_endpoints(const Block& block, const Endpoints& endpoints, Mode6Block& best)
+	{
+		Mode6Block candidate;
+		quantize_mode6_endpoint(endpoints.start, candidate.start, candidate.startBit);
+		quantize_mode6_endpoint(endpoints.end, candidate.end, candidate.endBit);
+
+		float palette[16][4];
+		for (uint32_t k = 0; k < 16; k++)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				const uint32_t start = (candidate.start[c] << 1) | candidate.startBit;
+				const uint32_t end = (candidate.end[c] << 1) | candidate.endBit;
+				palette[k][c] = static_cast<float>(bc7_interpolate(start, end, MODE6_WEIGHTS[k]));
+			}
+		}
+
+		candidate.error = select_indices<0, 4>(block, palette, 16, candidate.indices);
+
+		if (candidate.error < best.error)
+		{
+			best = candidate;
+		}
+	}
+
+	Mode6Block encode_mode6(const Block& block)
+	{
+		Mode6Block best;
+		best.error = FLT_MAX;
+
+		Endpoints endpoints = fit_principal_axis<4>(block);
+		try_mode6_endpoints(block, endpoints, best);
+
+		float weights[16];
+		for (uint32_t k = 0; k < 16; k++)
+		{
+			weights[k] = static_cast<float>(MODE6_WEIGHTS[k]) / 64.f;
+		}
+
+		for (uint32_t iteration = 0; iteration < 2; iteration++)
+		{
+			if (!refit_endpoints<0, 4>(block, best.indices, weights, endpoints))
+			{
+				break;
+			}
+			try_mode6_endpoints(block, endpoints, best);
+		}
+
+		return best;
+	}
+
+	void write_mode6(Mode6Block mode6, uint8_t* block)
+	{
+		// the anchor texel drops the top bit of its index, swapping the endpoints mirrors the weights
+		if (mode6.indices[0] & 8)
+		{
+			std::swap(mode6.start, mode6.end);
+			std::swap(mode6.startBit, mode6.endBit);
+			for (uint8_t& index : mode6.indices)
+			{
+				index = static_cast<uint8_t>(15 - index);
+			}
+		}
+
+		memset(block, 0, 16);
+		BitWriter writer{ block };
+		writer.write(1 << 6, 7);
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			writer.write(mode6.start[c], 7);
+			writer.write(mode6.end[c], 7);
+		}
+		writer.write(mode6.startBit, 1);
+		writer.write(mode6.endBit, 1);
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			writer.write(mode6.indices[i], i == 0 ? 3 : 4);
+		}
+	}
+
+	struct Mode5Block
+	{
+		uint8_t colorStart[3];
+		uint8_t colorEnd[3];
+		uint8_t alphaStart;
+		uint8_t alphaEnd;
+		uint8_t colorIndices[16];
+		uint8_t alphaIndices[16];
+		float colorError;
+		float alphaError;
+	};
+
+	void try_mode5_color(const Block& block, const Endpoints& endpoints, Mode5Block& best)
+	{
+		uint8_t start[3];
+		uint8_t end[3];
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			start[c] = static_cast<uint8_t>(std::clamp(endpoints.start[c] * (127.f / 255.f) + 0.5f, 0.f, 127.f));
+			end[c] = static_cast<uint8_t>(std::clamp(endpoints.end[c] * (127.f / 255.f) + 0.5f, 0.f, 127.f));
+		}
+
+		float palette[4][4] = {};
+		for (uint32_t k = 0; k < 4; k++)
+		{
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				palette[k][c] = static_cast<float>(bc7_interpolate(expand_7bit(start[c]), expand_7bit(end[c]), MODE5_WEIGHTS[k]));
+			}
+		}
+
+		uint8_t indices[16];
+		const float error = select_indices<0, 3>(block, palette, 4, indices);
+		if (error < best.colorError)
+		{
+			best.colorError = error;
+			std::copy(start, start + 3, best.colorStart);
+			std::copy(end, end + 3, best.colorEnd);
+			std::copy(indices, indices + 16, best.colorIndices);
+		}
+	}
+
+	void try_mode5_alpha(const Block& block, const Endpoints& endpoints, Mode5Block& best)
+	{
+		const auto start = static_cast<uint8_t>(endpoints.start[3] + 0.5f);
+		const auto end = static_cast<uint8_t>(endpoints.end[3] + 0.5f);
+
+		float palette[4][4] = {};
+		for (uint32_t k = 0; k < 4; k++)
+		{
+			palette[k][3] = static_cast<float>(bc7_interpolate(start, end, MODE5_WEIGHTS[k]));
+		}
+
+		uint8_t indices[16];
+		const float error = select_indices<3, 1>(block, palette, 4, indices);
+		if (error < best.alphaError)
+		{
+			best.alphaError = error;
+			best.alphaStart = start;
+			best.alphaEnd = end;
+			std::copy(indices, indices + 16, best.alphaIndices);
+		}
+	}
+
+	Mode5Block encode_mode5(const Block& block)
+	{
+		Mode5Block best;
+		best.colorError = FLT_MAX;
+		best.alphaError = FLT_MAX;
+
+		Endpoints endpoints = fit_principal_axis<3>(block);
+
+		// alpha is a single channel, its extremes are the axis
+		Lanes low = splat(255.f);
+		Lanes high = splat(0.f);
+		for (uint32_t i = 0; i < 16; i += 4)
+		{
+			const Lanes alpha = load(&block.channels[3][i]);
+			low = lanes_min(low, alpha);
+			high = lanes_max(high, alpha);
+		}
+		endpoints.start[3] = horizontal_min(low);
+		endpoints.end[3] = horizontal_max(high);
+
+		try_mode5_color(block, endpoints, best);
+		try_mode5_alpha(block, endpoints, best);
+
+		float weights[4];
+		for (uint32_t k = 0; k < 4; k++)
+		{
+			weights[k] = static_cast<float>(MODE5_WEIGHTS[k]) / 64.f;
+		}
+
+		for (uint32_t iteration = 0; iteration < 2; iteration++)
+		{
+			if (refit_endpoints<0, 3>(block, best.colorIndices, weights, endpoints))
+			{
+				try_mode5_color(block, endpoints, best);
+			}
+			if (refit_endpoints<3, 1>(block, best.alphaIndices, weights, endpoints))
+			{
+				try_mode5_alpha(block, endpoints, best);
+			}
+		}
+
+		return best;
+	}
+
+	void write_mode5(Mode5Block mode5, uint8_t* block)
+	{
+		// both index sets have an anchor at texel 0
+		if (mode5.colorIndices[0] & 2)
+		{
+			std::swap(mode5.colorStart, mode5.colorEnd);
+			for (uint8_t& index : mode5.colorIndices)
+			{
+				index = static_cast<uint8_t>(3 - index);
+			}
+		}
+		if (mode5.alphaIndices[0] & 2)
+		{
+			std::swap(mode5.alphaStart, mode5.alphaEnd);
+			for (uint8_t& index : mode5.alphaIndices)
+			{
+				index = static_cast<uint8_t>(3 - index);
+			}
+		}
+
+		memset(block, 0, 16);
+		BitWriter writer{ block };
+		writer.write(1 << 5, 6);
+		// no channel rotation
+		writer.write(0, 2);
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			writer.write(mode5.colorStart[c], 7);
+			writer.write(mode5.colorEnd[c], 7);
+		}
+		writer.write(mode5.alphaStart, 8);
+		writer.write(mode5.alphaEnd, 8);
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			writer.write(mode5.colorIndices[i], i == 0 ? 1 : 2);
+		}
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			writer.write(mode5.alphaIndices[i], i == 0 ? 1 : 2);
+		}
+	}
+
+	void decode_mode6(const uint8_t* block, uint8_t* texels)
+	{
+		BitReader reader{ block , 7 };
+
+		uint32_t start[4];
+		uint32_t end[4];
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			start[c] = reader.read(7) << 1;
+			end[c] = reader.read(7) << 1;
+		}
+
+		const uint32_t startBit = reader.read(1);
+		const uint32_t endBit = reader.read(1);
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			start[c] |= startBit;
+			end[c] |= endBit;
+		}
+
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			const uint32_t weight = MODE6_WEIGHTS[reader.read(i == 0 ? 3 : 4)];
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				texels[i * 4 + c] = static_cast<uint8_t>(bc7_interpolate(start[c], end[c], weight));
+			}
+		}
+	}
+
+	void decode_mode5(const uint8_t* block, uint8_t* texels)
+	{
+		BitReader reader{ block , 6 };
+		const uint32_t rotation = reader.read(2);
+
+		uint32_t start[4];
+		uint32_t end[4];
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			start[c] = expand_7bit(reader.read(7));
+			end[c] = expand_7bit(reader.read(7));
+		}
+		start[3] = reader.read(8);
+		end[3] = reader.read(8);
+
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			const uint32_t weight = MODE5_WEIGHTS[reader.read(i == 0 ? 1 : 2)];
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				texels[i * 4 + c] = static_cast<uint8_t>(bc7_interpolate(start[c], end[c], weight));
+			}
+		}
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			const uint32_t weight = MODE5_WEIGHTS[reader.read(i == 0 ? 1 : 2)];
+			texels[i * 4 + 3] = static_cast<uint8_t>(bc7_interpolate(start[3], end[3], weight));
+		}
+
+		// rotation swaps alpha with one of the color channels after decoding
+		if (rotation != 0)
+		{
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				std::swap(texels[i * 4 + 3], texels[i * 4 + rotation - 1]);
+			}
+		}
+	}
+
+	bool has_varying_alpha(const Block& block)
+	{
+		Lanes low = splat(255.f);
+		Lanes high = splat(0.f);
+		for (uint32_t i = 0; i < 16; i += 4)
+		{
+			const Lanes alpha = load(&block.channels[3][i]);
+			low = lanes_min(low, alpha);
+			high = lanes_max(high, alpha);
+		}
+		return horizontal_min(low) != horizontal_max(high);
+	}
+
+	// the formats the encoders cover, BC1 only in its opaque variants
+	struct BlockCodec
+	{
+		void (*encode)(const uint8_t* texels, uint8_t* block);
+		void (*decode)(const uint8_t* block, uint8_t* texels);
+		uint32_t bytes;
+		bool hasAlpha;
+	};
+
+	const BlockCodec* find_codec(VkFormat format)
+	{
+		static constexpr BlockCodec bc1{ vkutil::encode_bc1_block , vkutil::decode_bc1_block , 8 , false };
+		static constexpr BlockCodec bc3{ vkutil::encode_bc3_block , vkutil::decode_bc3_block , 16 , true };
+		static constexpr BlockCodec bc7{ vkutil::encode_bc7_block , vkutil::decode_bc7_block , 16 , true };
+
+		switch (format)
+		{
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+			return &bc1;
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+			return &bc3;
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			return &bc7;
+		default:
+			return nullptr;
+		}
+	}
+
+	const BlockCodec& get_codec(VkFormat format)
+	{
+		const BlockCodec* codec = find_codec(format);
+		if (codec == nullptr)
+		{
+			std::cout << "No block codec for format " << format << std::endl;
+			abort();
+		}
+		return *codec;
+	}
+
+	// the texels of one block, edges clamped to the surface
+	void gather_block(const uint8_t* texels, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY,
+	                  uint8_t* blockTexels)
+	{
+		for (uint32_t y = 0; y < 4; y++)
+		{
+			const size_t sourceY = std::min(blockY * 4 + y, height - 1);
+			for (uint32_t x = 0; x < 4; x++)
+			{
+				const size_t sourceX = std::min(blockX * 4 + x, width - 1);
+				memcpy(blockTexels + (y * 4 + x) * 4, texels + (sourceY * width + sourceX) * 4, 4);
+			}
+		}
+	}
+}
+
+void vkutil::encode_bc1_block(const uint8_t* texels, uint8_t* block)
+{
+	write_color(encode_color(load_block(texels)), block);
+}
+
+void vkutil::encode_bc3_block(const uint8_t* texels, uint8_t* block)
+{
+	const Block loaded = load_block(texels);
+	encode_alpha(loaded, block);
+	write_color(encode_color(loaded), block + 8);
+}
+
+void vkutil::encode_bc7_block(const uint8_t* texels, uint8_t* block)
+{
+	const Block loaded = load_block(texels);
+	const Mode6Block mode6 = encode_mode6(loaded);
+
+	// one rgba line cannot follow alpha that changes independently of the color, like the edge of a cutout
+	if (has_varying_alpha(loaded))
+	{
+		const Mode5Block mode5 = encode_mode5(loaded);
+		if (mode5.colorError + mode5.alphaError < mode6.error)
+		{
+			write_mode5(mode5, block);
+			return;
+		}
+	}
+
+	write_mode6(mode6, block);
+}
+
+void vkutil::decode_bc1_block(const uint8_t* block, uint8_t* texels)
+{
+	decode_color(block, false, texels);
+}
+
+void vkutil::decode_bc3_block(const uint8_t* block, uint8_t* texels)
+{
+	// the color half of BC3 is always four color
+	decode_color(block + 8, true, texels);
+	decode_alpha(block, texels);
+}
+
+void vkutil::decode_bc7_block(const uint8_t* block, uint8_t* texels)
+{
+	// the mode is the position of the lowest set bit
+	if ((block[0] & 0x7F) == (1 << 6))
+	{
+		decode_mode6(block, texels);
+		return;
+	}
+	if ((block[0] & 0x3F) == (1 << 5))
+	{
+		decode_mode5(block, texels);
+		return;
+	}
+
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		texels[i * 4 + 0] = 255;
+		texels[i * 4 + 1] = 0;
+		texels[i * 4 + 2] = 255;
+		texels[i * 4 + 3] = 255;
+	}
+}
+
+bool vkutil::is_block_compressed(VkFormat format)
+{
+	return find_codec(format) != nullptr;
+}
+
+VkFormat vkutil::decompressed_format(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		return VK_FORMAT_R8G8B8A8_SRGB;
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+		return VK_FORMAT_R8G8B8A8_UNORM;
+	default:
+		return format;
+	}
+}
+
+const char* vkutil::block_format_name(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		return "BC1";
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+		return "BC3";
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		return "BC7";
+	default:
+		return "uncompressed";
+	}
+}
+
+std::vector<uint8_t> vkutil::compress_surface(JobSystem& jobs, const uint8_t* texels, uint32_t width, uint32_t height,
+                                              VkFormat format)
+{
+	const BlockCodec& codec = get_codec(format);
+
+	const uint32_t blocksX = ceil_divide(width, 4u);
+	const uint32_t blocksY = ceil_divide(height, 4u);
+	std::vector<uint8_t> blocks(static_cast<size_t>(blocksX) * blocksY * codec.bytes);
+
+	jobs.parallel_for(blocksY, 4, [&](size_t begin, size_t end)
+	{
+		uint8_t blockTexels[64];
+		for (size_t blockY = begin; blockY < end; blockY++)
+		{
+			for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+			{
+				gather_block(texels, width, height, blockX, static_cast<uint32_t>(blockY), blockTexels);
+				codec.encode(blockTexels, blocks.data() + (blockY * blocksX + blockX) * codec.bytes);
+			}
+		}
+	});
+
+	return blocks;
+}
+
+std::vector<uint8_t> vkutil::decompress_surface(JobSystem& jobs, std::span<const uint8_t> blocks, uint32_t width,
+                                                uint32_t height, VkFormat format)
+{
+	const BlockCodec& codec = get_codec(format);
+
+	const uint32_t blocksX = ceil_divide(width, 4u);
+	const uint32_t blocksY = ceil_divide(height, 4u);
+	std::vector<uint8_t> texels(static_cast<size_t>(width) * height * 4);
+
+	jobs.parallel_for(blocksY, 4, [&](size_t begin, size_t end)
+	{
+		uint8_t blockTexels[64];
+		for (size_t blockY = begin; blockY < end; blockY++)
+		{
+			for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+			{
+				codec.decode(blocks.data() + (blockY * blocksX + blockX) * codec.bytes, blockTexels);
+
+				const uint32_t columns = std::min(4u, width - blockX * 4);
+				const uint32_t rows = std::min(4u, height - static_cast<uint32_t>(blockY) * 4);
+				for (uint32_t y = 0; y < rows; y++)
+				{
+					memcpy(texels.data() + ((blockY * 4 + y) * width + blockX * 4) * 4, blockTexels + y * 16, columns * 4);
+				}
+			}
+		}
+	});
+
+	return texels;
+}
+
+double vkutil::compute_psnr(JobSystem& jobs, const uint8_t* texels, std::span<const uint8_t> blocks, uint32_t width,
+                            uint32_t height, VkFormat format)
+{
+	const BlockCodec& codec = get_codec(format);
+	const uint32_t channels = codec.hasAlpha ? 4 : 3;
+
+	const uint32_t blocksX = ceil_divide(width, 4u);
+	const uint32_t blocksY = ceil_divide(height, 4u);
+
+	// one sum per row of blocks keeps the result independent of how the rows were split
+	std::vector<double> rowErrors(blocksY, 0.0);
+
+	jobs.parallel_for(blocksY, 4, [&](size_t begin, size_t end)
+	{
+		uint8_t decoded[64];
+		for (size_t blockY = begin; blockY < end; blockY++)
+		{
+			uint64_t error = 0;
+			for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+			{
+				codec.decode(blocks.data() + (blockY * blocksX + blockX) * codec.bytes, decoded);
+
+				const uint32_t columns = std::min(4u, width - blockX * 4);
+				const uint32_t rows = std::min(4u, height - static_cast<uint32_t>(blockY) * 4);
+				for (uint32_t y = 0; y < rows; y++)
+				{
+					const uint8_t* source = texels + ((blockY * 4 + y) * width + blockX * 4) * 4;
+					for (uint32_t x = 0; x < columns; x++)
+					{
+						for (uint32_t c = 0; c < channels; c++)
+						{
+							const int difference = static_cast<int>(source[x * 4 + c]) - decoded[(y * 4 + x) * 4 + c];
+							error += static_cast<uint64_t>(difference * difference);
+						}
+					}
+				}
+			}
+			rowErrors[blockY] = static_cast<double>(error);
+		}
+	});
+
+	double totalError = 0.0;
+	for (const double error : rowErrors)
+	{
+		totalError += error;
+	}
+
+	const double meanError = totalError / (static_cast<double>(width) * height * channels);
+	if (meanError == 0.0)
+	{
+		return std::numeric_limits<double>::infinity();
+	}
+	return 10.0 * std::log10(255.0 * 255.0 / meanError);
+}
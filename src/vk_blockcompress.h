@@ -0,0 +1,45 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "vk_types.h"
+
+class JobSystem;
+
+// cpu encoders for the block compressed formats textures ship in.
+// a block is 4x4 rgba8 texels in row order, encoded to 8 (BC1) or 16 (BC3, BC7) bytes.
+// the per texel math runs four texels at a time with sse2, or scalar where sse2 is missing.
+namespace vkutil
+{
+	// opaque, always in four color mode. alpha is ignored.
+	void encode_bc1_block(const uint8_t* texels, uint8_t* block);
+	void encode_bc3_block(const uint8_t* texels, uint8_t* block);
+	// single subset modes only: mode 6 (one rgba line, 4 bit indices), or mode 5
+	// (separate rgb and alpha lines, 2 bit indices each) where the alpha does not follow the color
+	void encode_bc7_block(const uint8_t* texels, uint8_t* block);
+
+	void decode_bc1_block(const uint8_t* block, uint8_t* texels);
+	void decode_bc3_block(const uint8_t* block, uint8_t* texels);
+	// decodes the mode 5 and 6 blocks encode_bc7_block writes. other modes come out opaque magenta.
+	void decode_bc7_block(const uint8_t* block, uint8_t* texels);
+
+	// the BC1 (rgb), BC3 and BC7 formats the encoders above produce
+	bool is_block_compressed(VkFormat format);
+	// the rgba8 format with the same color space, for devices that cannot sample the blocks
+	VkFormat decompressed_format(VkFormat format);
+	// "BC1", "BC3" or "BC7" for reports, "uncompressed" for anything else
+	const char* block_format_name(VkFormat format);
+
+	// blocks of a whole surface, rows of blocks are spread over the job system.
+	// edge blocks of sizes that are not a multiple of 4 repeat the last row and column.
+	std::vector<uint8_t> compress_surface(JobSystem& jobs, const uint8_t* texels, uint32_t width, uint32_t height,
+	                                      VkFormat format);
+	std::vector<uint8_t> decompress_surface(JobSystem& jobs, std::span<const uint8_t> blocks, uint32_t width,
+	                                        uint32_t height, VkFormat format);
+
+	// peak signal to noise ratio of the blocks against the texels they were made from, in dB.
+	// BC1 is compared on rgb only. identical surfaces return infinity.
+	double compute_psnr(JobSystem& jobs, const uint8_t* texels, std::span<const uint8_t> blocks, uint32_t width,
+	                    uint32_t height, VkFormat format);
+}
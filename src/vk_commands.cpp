@@ -0,0 +1,104 @@
+#include "vk_commands.h"
+
+#include <cassert>
+
+#include "vk_initializers.h"
+
+namespace
+{
+	// grown in steps, so a pool settles after the first few frames
+	constexpr uint32_t SECONDARY_ALLOCATION_STEP = 8;
+}
+
+void SecondaryCommandPools::init(VkDevice device, uint32_t queueFamily, uint32_t frameSlots, uint32_t threadCount)
+{
+	this->threadCount = threadCount;
+
+	// the buffers are rerecorded every frame and only ever reset with their pool
+	const VkCommandPoolCreateInfo poolInfo =
+		vkinit::command_pool_create_info(queueFamily, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+
+	pools = std::vector<ThreadPool>(static_cast<size_t>(frameSlots) * threadCount);
+	for (auto& threadPool : pools)
+	{
+		VK_CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &threadPool.pool));
+	}
+}
+
+void SecondaryCommandPools::destroy(VkDevice device)
+{
+	// destroying a pool frees its buffers
+	for (const auto& threadPool : pools)
+	{
+		vkDestroyCommandPool(device, threadPool.pool, nullptr);
+	}
+	pools.clear();
+}
+
+void SecondaryCommandPools::reset(VkDevice device, uint32_t frameSlot)
+{
+	for (uint32_t thread = 0; thread < threadCount; thread++)
+	{
+		auto& threadPool = pool_for(frameSlot, thread);
+		if (threadPool.used == 0)
+		{
+			continue;
+		}
+
+		VK_CHECK(vkResetCommandPool(device, threadPool.pool, 0));
+		threadPool.used = 0;
+	}
+}
+
+VkCommandBuffer SecondaryCommandPools::allocate(VkDevice device, uint32_t frameSlot, uint32_t thread)
+{
+	auto& threadPool = pool_for(frameSlot, thread);
+
+	if (threadPool.used == threadPool.buffers.size())
+	{
+		VkCommandBufferAllocateInfo allocInfo = vkinit::command_buffer_allocate_info(threadPool.pool, SECONDARY_ALLOCATION_STEP);
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+
+		threadPool.buffers.resize(threadPool.buffers.size() + SECONDARY_ALLOCATION_STEP);
+		VK_CHECK(vkAllocateCommandBuffers(device, &allocInfo, &threadPool.buffers[threadPool.used]));
+	}
+
+	return threadPool.buffers[threadPool.used++];
+}
+
+uint32_t SecondaryCommandPools::used_count(uint32_t frameSlot) const
+{
+	uint32_t used = 0;
+	for (uint32_t thread = 0; thread < threadCount; thread++)
+	{
+		used += pools[static_cast<size_t>(frameSlot) * threadCount + thread].used;
+	}
+	return used;
+}
+
+SecondaryCommandPools::ThreadPool& SecondaryCommandPools::pool_for(uint32_t frameSlot, uint32_t thread)
+{
+	assert(thread < threadCount);
+	return pools[static_cast<size_t>(frameSlot) * threadCount + thread];
+}
+
+vkinit::SecondaryRenderingInheritance::SecondaryRenderingInheritance(
+	const VkFormat* colorFormats, uint32_t colorFormatCount, VkFormat depthFormat)
+{
+	rendering = {};
+	rendering.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+	rendering.pNext = nullptr;
+	rendering.colorAttachmentCount = colorFormatCount;
+	rendering.pColorAttachmentFormats = colorFormats;
+	rendering.depthAttachmentFormat = depthFormat;
+	rendering.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+	rendering.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	inheritance = {};
+	inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritance.pNext = &rendering;
+
+	begin = vkinit::command_buffer_begin_info(
+		VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
+	begin.pInheritanceInfo = &inheritance;
+}
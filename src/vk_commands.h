@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+
+#include "vk_types.h"
+
+// command pools for recording secondaries on several threads. a pool may only be used by one
+// thread at a time, so every recording thread has its own pool in every frame slot. nothing is
+// freed or reset one buffer at a time: when a slot's frame has finished on the gpu, all of its
+// pools are reset at once and the secondaries they handed out are reused.
+class SecondaryCommandPools
+{
+public:
+	// threadCount covers every JobSystem::thread_index() that will record, workers plus the main thread
+	void init(VkDevice device, uint32_t queueFamily, uint32_t frameSlots, uint32_t threadCount);
+	void destroy(VkDevice device);
+
+	// every command buffer from the slot must be done executing
+	void reset(VkDevice device, uint32_t frameSlot);
+
+	// a secondary in the initial state from the calling thread's pool. thread is the caller's
+	// JobSystem::thread_index(), which keeps threads off each other's pools without locks.
+	VkCommandBuffer allocate(VkDevice device, uint32_t frameSlot, uint32_t thread);
+
+	// secondaries handed out from the slot since its last reset
+	uint32_t used_count(uint32_t frameSlot) const;
+
+private:
+	// a cache line each, the counters are written from different threads
+	struct alignas(64) ThreadPool
+	{
+		VkCommandPool pool{ VK_NULL_HANDLE };
+		std::vector<VkCommandBuffer> buffers;
+		uint32_t used{ 0 };
+	};
+
+	ThreadPool& pool_for(uint32_t frameSlot, uint32_t thread);
+
+	std::vector<ThreadPool> pools;
+	uint32_t threadCount{ 0 };
+};
+
+namespace vkinit
+{
+	// begin info for a secondary that runs inside a vkCmdBeginRendering of the given formats
+	struct SecondaryRenderingInheritance
+	{
+		VkCommandBufferInheritanceRenderingInfo rendering;
+		VkCommandBufferInheritanceInfo inheritance;
+		VkCommandBufferBeginInfo begin;
+
+		SecondaryRenderingInheritance(const VkFormat* colorFormats, uint32_t colorFormatCount, VkFormat depthFormat);
+
+		// points into itself
+		SecondaryRenderingInheritance(const SecondaryRenderingInheritance&) = delete;
+		SecondaryRenderingInheritance& operator=(const SecondaryRenderingInheritance&) = delete;
+	};
+}
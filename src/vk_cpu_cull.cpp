@@ -0,0 +1,499 @@
+#include "vk_cpu_cull.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <type_traits>
+
+#include <glm/geometric.hpp>
+#include <imgui.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define VKUTIL_CULL_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <xmmintrin.h>
+#define VKUTIL_CULL_SSE2 1
+#endif
+
+#include "vk_bindless.h"
+#include "vk_cpu_profiler.h"
+#include "vk_jobs.h"
+#include "vk_pipelines.h"
+
+namespace
+{
+	// instances per cull job, small enough to balance, large enough to outweigh the queueing
+	constexpr uint32_t CULL_CHUNK = 4096;
+	// the sphere arrays are readable this far past the last instance
+	constexpr uint32_t CULL_PADDING = 8;
+
+	struct DrawPushConstants
+	{
+		glm::mat4 viewProj;
+		VkDeviceAddress vertices;
+		VkDeviceAddress instances;
+	};
+
+	static_assert(sizeof(DrawPushConstants) <= BINDLESS_PUSH_CONSTANT_SIZE);
+
+	// turns a mask of visible lanes into instance indices
+	uint32_t append_lanes(uint32_t mask, uint32_t first, uint32_t* visible, uint32_t count)
+	{
+		while (mask != 0)
+		{
+			visible[count++] = first + static_cast<uint32_t>(std::countr_zero(mask));
+			mask &= mask - 1;
+		}
+		return count;
+	}
+}
+
+FrustumPlanes vkutil::frustum_planes(const glm::mat4& viewProj)
+{
+	const glm::mat4 rows = glm::transpose(viewProj);
+
+	// with a 0 to 1 depth range near and far are z >= 0 and z <= w, which holds for reverse z too
+	FrustumPlanes frustum{ {
+		rows[3] + rows[0] , rows[3] - rows[0] ,
+		rows[3] + rows[1] , rows[3] - rows[1] ,
+		rows[2] , rows[3] - rows[2]
+	} };
+	for (glm::vec4& plane : frustum.planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+	return frustum;
+}
+
+#if defined(VKUTIL_CULL_AVX2)
+
+uint32_t vkutil::cull_spheres(const FrustumPlanes& frustum, const float* centerX, const float* centerY,
+                              const float* centerZ, const float* radius, uint32_t begin, uint32_t end, uint32_t* visible)
+{
+	__m256 planes[6][4];
+	for (uint32_t i = 0; i < 6; i++)
+	{
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			planes[i][c] = _mm256_set1_ps(frustum.planes[i][c]);
+		}
+	}
+
+	const __m256 zero = _mm256_setzero_ps();
+	uint32_t count = 0;
+	for (uint32_t first = begin; first < end; first += 8)
+	{
+		const __m256 x = _mm256_loadu_ps(centerX + first);
+		const __m256 y = _mm256_loadu_ps(centerY + first);
+		const __m256 z = _mm256_loadu_ps(centerZ + first);
+		const __m256 negativeRadius = _mm256_sub_ps(zero, _mm256_loadu_ps(radius + first));
+
+		// outside as soon as the sphere is wholly behind any plane
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (uint32_t i = 0; i < 6; i++)
+		{
+			const __m256 distance = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(planes[i][0], x), _mm256_mul_ps(planes[i][1], y)),
+				_mm256_add_ps(_mm256_mul_ps(planes[i][2], z), planes[i][3]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+		}
+
+		uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+		if (end - first < 8)
+		{
+			mask &= (1u << (end - first)) - 1;
+		}
+		count = append_lanes(mask, first, visible, count);
+	}
+
+	return count;
+}
+
+const char* vkutil::cull_spheres_isa()
+{
+	return "avx2";
+}
+
+#elif defined(VKUTIL_CULL_SSE2)
+
+uint32_t vkutil::cull_spheres(const FrustumPlanes& frustum, const float* centerX, const float* centerY,
+                              const float* centerZ, const float* radius, uint32_t begin, uint32_t end, uint32_t* visible)
+{
+	__m128 planes[6][4];
+	for (uint32_t i = 0; i < 6; i++)
+	{
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			planes[i][c] = _mm_set1_ps(frustum.planes[i][c]);
+		}
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	uint32_t count = 0;
+	for (uint32_t first = begin; first < end; first += 4)
+	{
+		const __m128 x = _mm_loadu_ps(centerX + first);
+		const __m128 y = _mm_loadu_ps(centerY + first);
+		const __m128 z = _mm_loadu_ps(centerZ + first);
+		const __m128 negativeRadius = _mm_sub_ps(zero, _mm_loadu_ps(radius + first));
+
+		// outside as soon as the sphere is wholly behind any plane
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+		for (uint32_t i = 0; i < 6; i++)
+		{
+			const __m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(planes[i][0], x), _mm_mul_ps(planes[i][1], y)),
+				_mm_add_ps(_mm_mul_ps(planes[i][2], z), planes[i][3]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+		}
+
+		uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(inside));
+		if (end - first < 4)
+		{
+			mask &= (1u << (end - first)) - 1;
+		}
+		count = append_lanes(mask, first, visible, count);
+	}
+
+	return count;
+}
+
+const char* vkutil::cull_spheres_isa()
+{
+	return "sse2";
+}
+
+#else
+
+uint32_t vkutil::cull_spheres(const FrustumPlanes& frustum, const float* centerX, const float* centerY,
+                              const float* centerZ, const float* radius, uint32_t begin, uint32_t end, uint32_t* visible)
+{
+	uint32_t count = 0;
+	for (uint32_t i = begin; i < end; i++)
+	{
+		bool inside = true;
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			inside &= plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w >= -radius[i];
+		}
+		if (inside)
+		{
+			visible[count++] = i;
+		}
+	}
+
+	return count;
+}
+
+const char* vkutil::cull_spheres_isa()
+{
+	return "scalar";
+}
+
+#endif
+
+uint32_t InstanceCuller::add_batch(const GPUMeshBuffers* meshBuffers, std::span<const GeoSurface> surfaces,
+                                   const glm::vec4& boundingSphere)
+{
+	assert(!initialized);
+
+	batches.push_back({ meshBuffers , surfaces , boundingSphere , 0 , 0 , 0 , 0 });
+	return static_cast<uint32_t>(batches.size() - 1);
+}
+
+uint32_t InstanceCuller::add_instance(uint32_t batch, const glm::mat4& transform)
+{
+	assert(!initialized && batch < batches.size());
+
+	// the sphere goes through the transform, its radius grows with the largest axis scale
+	const glm::vec4& sphere = batches[batch].boundingSphere;
+	const float scale = std::max({
+		glm::length(glm::vec3(transform[0])) ,
+		glm::length(glm::vec3(transform[1])) ,
+		glm::length(glm::vec3(transform[2]))
+	});
+	const glm::vec3 center = glm::vec3(transform * glm::vec4(glm::vec3(sphere), 1.f));
+
+	instanceBatches.push_back(batch);
+	transforms.push_back(transform);
+	centerX.push_back(center.x);
+	centerY.push_back(center.y);
+	centerZ.push_back(center.z);
+	radius.push_back(sphere.w * scale);
+	return static_cast<uint32_t>(instanceBatches.size() - 1);
+}
+
+void InstanceCuller::init_buffers(VkDevice device, VmaAllocator allocator, uint32_t frameSlots)
+{
+	const uint32_t count = instance_count();
+	if (count == 0)
+	{
+		return;
+	}
+
+	// group the instances by batch, keeping their order, so each batch culls and draws as one run
+	std::vector<uint32_t> order(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+	{
+		return instanceBatches[a] < instanceBatches[b];
+	});
+
+	auto permute = [&](auto& values)
+	{
+		std::remove_reference_t<decltype(values)> sorted(values.size());
+		for (uint32_t i = 0; i < count; i++)
+		{
+			sorted[i] = values[order[i]];
+		}
+		values = std::move(sorted);
+	};
+	permute(instanceBatches);
+	permute(transforms);
+	for (std::vector<float>* component : { &centerX , &centerY , &centerZ , &radius })
+	{
+		permute(*component);
+		component->resize(count + CULL_PADDING, 0.f);
+	}
+	visibleScratch.resize(count);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		Batch& batch = batches[instanceBatches[i]];
+		if (batch.instanceCount == 0)
+		{
+			batch.firstInstance = i;
+		}
+		batch.instanceCount++;
+	}
+	for (uint32_t b = 0; b < batch_count(); b++)
+	{
+		const Batch& batch = batches[b];
+		for (uint32_t begin = batch.firstInstance; begin < batch.firstInstance + batch.instanceCount; begin += CULL_CHUNK)
+		{
+			chunks.push_back({ b , begin , std::min(begin + CULL_CHUNK, batch.firstInstance + batch.instanceCount) , 0 , 0 });
+		}
+	}
+
+	VkBufferCreateInfo bufferInfo = { .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+	bufferInfo.pNext = nullptr;
+	bufferInfo.size = static_cast<VkDeviceSize>(frameSlots) * count * sizeof(glm::mat4);
+	bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+	// written by the cpu every frame and read once by the gpu, so it stays in host memory
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+	allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+	VK_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &instanceBuffer.buffer, &instanceBuffer.allocation,
+		&instanceBuffer.info));
+
+	VkBufferDeviceAddressInfo addressInfo{};
+	addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+	addressInfo.buffer = instanceBuffer.buffer;
+	instanceAddress = vkGetBufferDeviceAddress(device, &addressInfo);
+
+	initialized = true;
+}
+
+void InstanceCuller::destroy(VmaAllocator allocator)
+{
+	if (!initialized)
+	{
+		return;
+	}
+
+	vmaDestroyBuffer(allocator, instanceBuffer.buffer, instanceBuffer.allocation);
+	initialized = false;
+}
+
+void InstanceCuller::init_pipelines(VkDevice device, const BindlessHeap& bindless, ShaderModuleCache& shaderModules,
+                                    PipelineBuildQueue& pipelineBuilds, VkFormat colorFormat, VkFormat depthFormat)
+{
+	VkShaderModule vertexShader;
+	VK_CHECK(shaderModules.load(device, "../../shaders/mesh_instanced.vert.spv", &vertexShader));
+	VkShaderModule fragmentShader;
+	VK_CHECK(shaderModules.load(device, "../../shaders/mesh.frag.spv", &fragmentShader));
+
+	GraphicsPipelineDesc drawDesc{};
+	drawDesc.name = "mesh instanced";
+	drawDesc.vertexShader = vertexShader;
+	drawDesc.fragmentShader = fragmentShader;
+	drawDesc.layout = bindless.pipelineLayout;
+	drawDesc.depthTest = true;
+	drawDesc.depthWrite = true;
+	drawDesc.colorFormats = { colorFormat };
+	drawDesc.depthFormat = depthFormat;
+
+	drawPipelineBuild = pipelineBuilds.enqueue(std::move(drawDesc));
+}
+
+void InstanceCuller::wait_for_pipelines()
+{
+	if (drawPipeline == VK_NULL_HANDLE)
+	{
+		drawPipeline = drawPipelineBuild.get();
+	}
+}
+
+void InstanceCuller::cull(VmaAllocator allocator, const glm::mat4& viewProj, uint32_t frameSlot, JobSystem* jobs)
+{
+	if (!initialized)
+	{
+		return;
+	}
+
+	PROFILE_ZONE("cpu cull");
+	const auto start = std::chrono::steady_clock::now();
+
+	const FrustumPlanes frustum = vkutil::frustum_planes(viewProj);
+
+	auto run = [&](size_t count, const auto& function)
+	{
+		if (jobs != nullptr)
+		{
+			jobs->parallel_for(count, 1, function);
+		}
+		else
+		{
+			function(0, count);
+		}
+	};
+
+	// every chunk compacts its visible instances in place
+	run(chunks.size(), [&](size_t begin, size_t end)
+	{
+		for (size_t c = begin; c < end; c++)
+		{
+			Chunk& chunk = chunks[c];
+			chunk.visibleCount = vkutil::cull_spheres(frustum, centerX.data(), centerY.data(), centerZ.data(), radius.data(),
+			                                          chunk.begin, chunk.end, visibleScratch.data() + chunk.begin);
+		}
+	});
+
+	// the chunks are in batch order, so each batch's visible instances end up side by side
+	uint32_t visible = 0;
+	for (Batch& batch : batches)
+	{
+		batch.visibleCount = 0;
+	}
+	for (Chunk& chunk : chunks)
+	{
+		Batch& batch = batches[chunk.batch];
+		if (batch.visibleCount == 0)
+		{
+			batch.firstVisible = visible;
+		}
+		chunk.firstVisible = visible;
+		batch.visibleCount += chunk.visibleCount;
+		visible += chunk.visibleCount;
+	}
+
+	glm::mat4* slotInstances = static_cast<glm::mat4*>(instanceBuffer.info.pMappedData) + static_cast<size_t>(frameSlot) * instance_count();
+	run(chunks.size(), [&](size_t begin, size_t end)
+	{
+		for (size_t c = begin; c < end; c++)
+		{
+			const Chunk& chunk = chunks[c];
+			for (uint32_t i = 0; i < chunk.visibleCount; i++)
+			{
+				slotInstances[chunk.firstVisible + i] = transforms[visibleScratch[chunk.begin + i]];
+			}
+		}
+	});
+
+	// a no-op on coherent memory
+	if (visible > 0)
+	{
+		const VkDeviceSize slotOffset = static_cast<VkDeviceSize>(frameSlot) * instance_count() * sizeof(glm::mat4);
+		VK_CHECK(vmaFlushAllocation(allocator, instanceBuffer.allocation, slotOffset, visible * sizeof(glm::mat4)));
+	}
+	culledSlot = frameSlot;
+
+	lastStats = { instance_count() , visible , std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() };
+	totalInstances += lastStats.instances;
+	totalVisible += lastStats.visible;
+	totalCullMs += lastStats.cullMs;
+	statsFrames++;
+}
+
+void InstanceCuller::record_draws(VkCommandBuffer cmd, VkPipelineLayout layout, const glm::mat4& viewProj, VkExtent2D extent) const
+{
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, drawPipeline);
+
+	VkViewport viewport{};
+	viewport.x = 0.f;
+	viewport.y = 0.f;
+	viewport.width = static_cast<float>(extent.width);
+	viewport.height = static_cast<float>(extent.height);
+	viewport.minDepth = 0.f;
+	viewport.maxDepth = 1.f;
+	vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+	const VkRect2D scissor{ VkOffset2D{ 0 , 0 } , extent };
+	vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+	const VkDeviceAddress slotAddress = instanceAddress + static_cast<VkDeviceSize>(culledSlot) * instance_count() * sizeof(glm::mat4);
+
+	for (const Batch& batch : batches)
+	{
+		if (batch.visibleCount == 0)
+		{
+			continue;
+		}
+
+		vkCmdBindIndexBuffer(cmd, batch.meshBuffers->indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+		const DrawPushConstants pushConstants{ viewProj , batch.meshBuffers->vertexBufferAddress , slotAddress };
+		vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_ALL, 0, sizeof(pushConstants), &pushConstants);
+
+		// firstInstance points the batch's instances at its run of the slot
+		for (const GeoSurface& surface : batch.surfaces)
+		{
+			vkCmdDrawIndexed(cmd, surface.count, batch.visibleCount, surface.startIndex, 0, batch.firstVisible);
+		}
+	}
+}
+
+void InstanceCuller::print_summary() const
+{
+	if (statsFrames == 0)
+	{
+		return;
+	}
+
+	const double frames = static_cast<double>(statsFrames);
+	const double instances = static_cast<double>(totalInstances) / frames;
+	const double visible = static_cast<double>(totalVisible) / frames;
+	const double cullMs = totalCullMs / frames;
+
+	std::cout << "CPU culling (" << vkutil::cull_spheres_isa() << "): " << instance_count() << " instances in "
+		<< batch_count() << " batches, per frame " << static_cast<uint64_t>(visible) << " visible and "
+		<< static_cast<uint64_t>(instances - visible) << " culled, " << cullMs << " ms ("
+		<< (instances > 0.0 ? cullMs * 1e6 / instances : 0.0) << " ns/instance)" << std::endl;
+}
+
+void InstanceCuller::draw_panel()
+{
+	if (!ImGui::Begin("CPU culling"))
+	{
+		ImGui::End();
+		return;
+	}
+
+	ImGui::Text("%u instances in %u batches, %s", instance_count(), batch_count(), vkutil::cull_spheres_isa());
+
+	ImGui::Separator();
+	ImGui::Text("Visible: %u", lastStats.visible);
+	ImGui::Text("Culled: %u", lastStats.instances - lastStats.visible);
+	ImGui::Text("Cull: %.3f ms (%.1f ns/instance)", lastStats.cullMs,
+	            lastStats.instances > 0 ? lastStats.cullMs * 1e6 / lastStats.instances : 0.0);
+
+	ImGui::End();
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <array>
+#include <future>
+#include <span>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+
+#include "vk_loader.h"
+#include "vk_types.h"
+
+class BindlessHeap;
+class JobSystem;
+class PipelineBuildQueue;
+struct ShaderModuleCache;
+
+// world space planes facing inwards, normalized so dot(plane.xyz, p) + plane.w is a distance
+struct FrustumPlanes
+{
+	std::array<glm::vec4, 6> planes;
+};
+
+namespace vkutil
+{
+	// the planes of a view projection with a 0 to 1 depth range, reverse z or not (gribb and hartmann)
+	FrustumPlanes frustum_planes(const glm::mat4& viewProj);
+
+	// writes the index of every sphere in [begin, end) that touches the frustum to visible, in order, and
+	// returns how many. the spheres are a component per array, tested eight at a time with avx2, four with sse2.
+	// the arrays must stay readable up to 8 floats past end.
+	uint32_t cull_spheres(const FrustumPlanes& frustum, const float* centerX, const float* centerY,
+	                      const float* centerZ, const float* radius, uint32_t begin, uint32_t end, uint32_t* visible);
+
+	// "avx2", "sse2" or "scalar", whichever cull_spheres was built with
+	const char* cull_spheres_isa();
+}
+
+// the cpu path's culling and instancing. every object is an instance of its mesh's batch. each frame
+// the objects are culled against the frustum on the job system, and the visible transforms are packed
+// per batch into the frame slot's instance buffer. a batch then draws with one instanced
+// vkCmdDrawIndexed per surface, however many of its objects are visible.
+class InstanceCuller
+{
+public:
+	// per frame, from the last cull
+	struct CullStats
+	{
+		uint32_t instances;
+		uint32_t visible;
+		// wall time of the cull and the instance buffer writes
+		double cullMs;
+	};
+
+	// the mesh's buffers and surfaces must outlive the culler. boundingSphere is in object space.
+	uint32_t add_batch(const GPUMeshBuffers* meshBuffers, std::span<const GeoSurface> surfaces, const glm::vec4& boundingSphere);
+	uint32_t add_instance(uint32_t batch, const glm::mat4& transform);
+
+	uint32_t instance_count() const { return static_cast<uint32_t>(instanceBatches.size()); }
+	uint32_t batch_count() const { return static_cast<uint32_t>(batches.size()); }
+
+	// groups the instances by batch and creates an instance buffer per frame slot with room for all of them.
+	// instances can not be added afterwards.
+	void init_buffers(VkDevice device, VmaAllocator allocator, uint32_t frameSlots);
+	void destroy(VmaAllocator allocator);
+
+	void init_pipelines(VkDevice device, const BindlessHeap& bindless, ShaderModuleCache& shaderModules,
+	                    PipelineBuildQueue& pipelineBuilds, VkFormat colorFormat, VkFormat depthFormat);
+	bool is_ready() const { return drawPipeline != VK_NULL_HANDLE; }
+	void wait_for_pipelines();
+
+	// the slot's instance buffer must not be in use on the gpu. with jobs, the instances are split across its threads.
+	void cull(VmaAllocator allocator, const glm::mat4& viewProj, uint32_t frameSlot, JobSystem* jobs);
+
+	// inside dynamic rendering with the formats given to init_pipelines, with the bindless heap bound for graphics.
+	// draws what the last cull found visible, from the slot it wrote.
+	void record_draws(VkCommandBuffer cmd, VkPipelineLayout layout, const glm::mat4& viewProj, VkExtent2D extent) const;
+
+	const CullStats& last_stats() const { return lastStats; }
+	void print_summary() const;
+	void draw_panel();
+
+private:
+	struct Batch
+	{
+		const GPUMeshBuffers* meshBuffers;
+		std::span<const GeoSurface> surfaces;
+		glm::vec4 boundingSphere;
+		// the batch's instances after grouping, and where the last cull put its visible ones
+		uint32_t firstInstance;
+		uint32_t instanceCount;
+		uint32_t firstVisible;
+		uint32_t visibleCount;
+	};
+
+	// a run of one batch's instances, culled as one job
+	struct Chunk
+	{
+		uint32_t batch;
+		uint32_t begin;
+		uint32_t end;
+		uint32_t visibleCount;
+		uint32_t firstVisible;
+	};
+
+	std::vector<Batch> batches;
+	std::vector<Chunk> chunks;
+
+	std::vector<uint32_t> instanceBatches;
+	std::vector<glm::mat4> transforms;
+	// world space bounding spheres, padded for the wide loads
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> radius;
+	// the visible instances of each chunk, at the chunk's own offset
+	std::vector<uint32_t> visibleScratch;
+
+	// a transform per instance per frame slot, persistently mapped
+	AllocatedBuffer instanceBuffer{};
+	VkDeviceAddress instanceAddress{ 0 };
+	uint32_t culledSlot{ 0 };
+	bool initialized{ false };
+
+	CullStats lastStats{};
+	uint64_t totalInstances{ 0 };
+	uint64_t totalVisible{ 0 };
+	double totalCullMs{ 0.0 };
+	uint64_t statsFrames{ 0 };
+
+	std::shared_future<VkPipeline> drawPipelineBuild;
+	VkPipeline drawPipeline{ VK_NULL_HANDLE };
+};
@@ -0,0 +1,197 @@
+#include "vk_cpu_profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// a tick and nanosecond reading taken together. the one from startup and one taken at export
+	// give the tick rate, so it never has to be known up front.
+	struct ClockAnchor
+	{
+		uint64_t ticks;
+		uint64_t ns;
+	};
+
+	ClockAnchor take_anchor()
+	{
+		const uint64_t before = vkprofile::now_ns();
+		const uint64_t ticks = vkprofile::now_ticks();
+		const uint64_t after = vkprofile::now_ns();
+		return { ticks , before + (after - before) / 2 };
+	}
+
+	const ClockAnchor startAnchor = take_anchor();
+
+	struct ThreadRegistry
+	{
+		std::mutex mutex;
+		// rings outlive their threads, a zone recorded before a thread exits still shows up
+		std::vector<std::unique_ptr<vkprofile::ZoneRing>> rings;
+	};
+
+	ThreadRegistry& registry()
+	{
+		static ThreadRegistry threads;
+		return threads;
+	}
+
+	vkprofile::ZoneRing& gpu_ring()
+	{
+		static vkprofile::ZoneRing ring;
+		return ring;
+	}
+
+	// appends what the ring holds, oldest first
+	void copy_events(const vkprofile::ZoneRing& ring, std::vector<vkprofile::ZoneEvent>& events)
+	{
+		constexpr uint64_t capacity = vkprofile::ZONE_RING_CAPACITY;
+
+		const uint64_t head = ring.head.load(std::memory_order_acquire);
+		const uint64_t first = head > capacity ? head - capacity : 0;
+		const size_t start = events.size();
+
+		for (uint64_t i = first; i < head; i++)
+		{
+			events.push_back(ring.events[i & (capacity - 1)]);
+		}
+
+		// anything the writer came around to while we copied is torn
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const uint64_t headAfter = ring.head.load(std::memory_order_relaxed);
+		const uint64_t firstValid = headAfter > capacity ? headAfter - capacity : 0;
+		if (firstValid > first)
+		{
+			const size_t torn = static_cast<size_t>(std::min(firstValid, head) - first);
+			events.erase(events.begin() + start, events.begin() + start + torn);
+		}
+	}
+
+	struct Track
+	{
+		uint32_t process;
+		uint32_t thread;
+		std::string name;
+		// converted to now_ns time
+		std::vector<vkprofile::ZoneEvent> events;
+	};
+}
+
+vkprofile::ZoneRing* vkprofile::register_thread()
+{
+	ThreadRegistry& threads = registry();
+	std::lock_guard lock(threads.mutex);
+
+	auto ring = std::make_unique<ZoneRing>();
+	ring->threadId = static_cast<uint32_t>(threads.rings.size());
+	threadRing = ring.get();
+	threads.rings.push_back(std::move(ring));
+
+	return threadRing;
+}
+
+void vkprofile::set_thread_name(const char* name)
+{
+	ZoneRing* ring = threadRing != nullptr ? threadRing : register_thread();
+	ring->threadName.store(name, std::memory_order_relaxed);
+}
+
+void vkprofile::record_gpu_zone(const char* name, uint64_t beginNs, uint64_t endNs)
+{
+	record_zone(gpu_ring(), name, beginNs, endNs);
+}
+
+bool vkprofile::write_chrome_trace(const std::filesystem::path& path)
+{
+	std::vector<Track> tracks;
+
+	const ClockAnchor endAnchor = take_anchor();
+	const double nsPerTick = endAnchor.ticks > startAnchor.ticks
+		? static_cast<double>(endAnchor.ns - startAnchor.ns) / static_cast<double>(endAnchor.ticks - startAnchor.ticks)
+		: 1.0;
+	const auto to_ns = [&](uint64_t ticks)
+	{
+		return startAnchor.ns + static_cast<uint64_t>(static_cast<double>(ticks - startAnchor.ticks) * nsPerTick);
+	};
+
+	{
+		ThreadRegistry& threads = registry();
+		std::lock_guard lock(threads.mutex);
+
+		for (const auto& ring : threads.rings)
+		{
+			const char* threadName = ring->threadName.load(std::memory_order_relaxed);
+
+			Track& track = tracks.emplace_back();
+			track.process = 0;
+			track.thread = ring->threadId;
+			track.name = threadName != nullptr ? threadName : "thread " + std::to_string(ring->threadId);
+			copy_events(*ring, track.events);
+
+			for (ZoneEvent& event : track.events)
+			{
+				event.begin = to_ns(event.begin);
+				event.end = to_ns(event.end);
+			}
+		}
+	}
+
+	Track& gpuTrack = tracks.emplace_back();
+	gpuTrack.process = 1;
+	gpuTrack.thread = 0;
+	gpuTrack.name = "graphics queue";
+	copy_events(gpu_ring(), gpuTrack.events);
+
+	// timestamps relative to the oldest zone, the trace viewer shows them from 0
+	uint64_t baseNs = UINT64_MAX;
+	size_t zoneCount = 0;
+	for (const Track& track : tracks)
+	{
+		for (const ZoneEvent& event : track.events)
+		{
+			baseNs = std::min(baseNs, event.begin);
+		}
+		zoneCount += track.events.size();
+	}
+
+	std::ofstream out(path, std::ios::trunc);
+	if (!out.is_open())
+	{
+		std::cout << "CPU profiler: cannot write " << path.string() << std::endl;
+		return false;
+	}
+
+	// zone names are literals from the engine, nothing in them needs escaping
+	out << std::fixed << std::setprecision(3);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"GPU\"}}";
+
+	for (const Track& track : tracks)
+	{
+		out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << track.process << ",\"tid\":" << track.thread
+			<< ",\"args\":{\"name\":\"" << track.name << "\"}}";
+
+		for (const ZoneEvent& event : track.events)
+		{
+			// chrome wants microseconds
+			out << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":" << track.process
+				<< ",\"tid\":" << track.thread
+				<< ",\"ts\":" << static_cast<double>(event.begin - baseNs) / 1000.0
+				<< ",\"dur\":" << static_cast<double>(event.end - event.begin) / 1000.0 << "}";
+		}
+	}
+
+	out << "\n]}\n";
+
+	std::cout << "CPU profiler: " << zoneCount << " zones from " << tracks.size() - 1 << " threads written to "
+		<< path.string() << std::endl;
+
+	return out.good();
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+
+#if defined(_M_X64)
+#include <intrin.h>
+#elif defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+// set by the VKGUIDE_CPU_PROFILER cmake option. off, the zone macros compile to nothing.
+#ifndef CPU_PROFILER_ENABLED
+#define CPU_PROFILER_ENABLED 1
+#endif
+
+// scoped cpu zones, recorded into a ring per thread and exported as chrome trace_event json.
+// recording a zone is two tick reads and one store into memory only its thread writes, no locks.
+// the rings keep the most recent zones, so the profiler can stay on and be dumped at any point.
+namespace vkprofile
+{
+	// zones kept per thread, older ones are overwritten
+	constexpr uint32_t ZONE_RING_CAPACITY = 1 << 16;
+
+	// cpu zones hold now_ticks values, the gpu track holds now_ns values
+	struct ZoneEvent
+	{
+		const char* name;
+		uint64_t begin;
+		uint64_t end;
+	};
+
+	// single writer, the thread that owns it. readers check the head again after copying
+	// and throw away anything the writer may have overwritten meanwhile.
+	struct ZoneRing
+	{
+		ZoneEvent events[ZONE_RING_CAPACITY];
+		std::atomic<uint64_t> head{ 0 };
+		std::atomic<const char*> threadName{ nullptr };
+		uint32_t threadId{ 0 };
+	};
+
+	// steady_clock, which is CLOCK_MONOTONIC on linux and the performance counter on windows.
+	// calibrated gpu timestamps are converted into the same time base.
+	inline uint64_t now_ns()
+	{
+		return static_cast<uint64_t>(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	// the invariant tsc on x86, a fraction of the cost of a steady_clock read. nanoseconds elsewhere.
+	// zones store ticks and are converted to now_ns time when the trace is written.
+	inline uint64_t now_ticks()
+	{
+#if defined(_M_X64) || defined(__x86_64__)
+		return __rdtsc();
+#else
+		return now_ns();
+#endif
+	}
+
+	// slow path, once per thread
+	ZoneRing* register_thread();
+
+	inline thread_local ZoneRing* threadRing = nullptr;
+
+	inline void record_zone(ZoneRing& ring, const char* name, uint64_t begin, uint64_t end)
+	{
+		const uint64_t index = ring.head.load(std::memory_order_relaxed);
+		ring.events[index & (ZONE_RING_CAPACITY - 1)] = { name , begin , end };
+		ring.head.store(index + 1, std::memory_order_release);
+	}
+
+	// begin and end are now_ticks values
+	inline void record_zone(const char* name, uint64_t beginTicks, uint64_t endTicks)
+	{
+		ZoneRing* ring = threadRing != nullptr ? threadRing : register_thread();
+		record_zone(*ring, name, beginTicks, endTicks);
+	}
+
+	// names the calling thread's track in the trace. the name must outlive the profiler.
+	void set_thread_name(const char* name);
+
+	// gpu scopes already converted to now_ns time, shown on their own track.
+	// one writer only, the thread that collects the gpu queries.
+	void record_gpu_zone(const char* name, uint64_t beginNs, uint64_t endNs);
+
+	// every zone still held by the rings. safe while other threads record,
+	// zones they overwrite during the copy are left out.
+	bool write_chrome_trace(const std::filesystem::path& path);
+
+	class ScopedZone
+	{
+	public:
+		explicit ScopedZone(const char* name) : name(name), beginTicks(now_ticks()) {}
+		~ScopedZone() { record_zone(name, beginTicks, now_ticks()); }
+
+		ScopedZone(const ScopedZone&) = delete;
+		ScopedZone& operator=(const ScopedZone&) = delete;
+
+	private:
+		const char* name;
+		uint64_t beginTicks;
+	};
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if CPU_PROFILER_ENABLED
+// names must be string literals, only the pointer is stored
+#define PROFILE_ZONE(name) const vkprofile::ScopedZone PROFILE_CONCAT(profileZone, __LINE__){ name }
+#define PROFILE_THREAD(name) vkprofile::set_thread_name(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#endif
@@ -1,5 +1,7 @@
 #include "vk_descriptors.h"
 
+#include <algorithm>
+
 #include "vk_types.h"
 
 
@@ -39,49 +41,188 @@ VkDescriptorSetLayout DescriptorLayoutBuilder::build(VkDevice device, VkShaderSt
 	return set;
 }
 
-void DescriptorAllocator::init_pool(
+void DescriptorAllocator::init(
 	const VkDevice device,
-	const uint32_t maxSets,
+	const uint32_t initialSets,
 	const std::span<PoolSizeRatio> poolRatios)
+{
+	ratios.assign(poolRatios.begin(), poolRatios.end());
+
+	readyPools.push_back(create_pool(device, initialSets));
+
+	setsPerPool = std::min(static_cast<uint32_t>(static_cast<float>(initialSets) * growthFactor), maxSetsPerPool);
+}
+
+void DescriptorAllocator::clear_pools(const VkDevice device)
+{
+	for (const auto pool : readyPools)
+	{
+		vkResetDescriptorPool(device, pool, 0);
+	}
+	for (const auto pool : fullPools)
+	{
+		vkResetDescriptorPool(device, pool, 0);
+		readyPools.push_back(pool);
+	}
+	fullPools.clear();
+}
+
+void DescriptorAllocator::destroy_pools(const VkDevice device)
+{
+	for (const auto pool : readyPools)
+	{
+		vkDestroyDescriptorPool(device, pool, nullptr);
+	}
+	for (const auto pool : fullPools)
+	{
+		vkDestroyDescriptorPool(device, pool, nullptr);
+	}
+	readyPools.clear();
+	fullPools.clear();
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDevice device, VkDescriptorSetLayout layout, const void* pNext)
+{
+	VkDescriptorPool pool = get_pool(device);
+
+	VkDescriptorSetAllocateInfo allocInfo = { .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+	allocInfo.pNext = pNext;
+	allocInfo.descriptorPool = pool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &layout;
+
+	VkDescriptorSet ds;
+	VkResult result = vkAllocateDescriptorSets(device, &allocInfo, &ds);
+
+	// the pool ran out, park it until the next clear and retry once on a fresh one
+	if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+	{
+		fullPools.push_back(pool);
+
+		pool = get_pool(device);
+		allocInfo.descriptorPool = pool;
+
+		result = vkAllocateDescriptorSets(device, &allocInfo, &ds);
+	}
+	VK_CHECK(result);
+
+	readyPools.push_back(pool);
+	return ds;
+}
+
+VkDescriptorPool DescriptorAllocator::get_pool(const VkDevice device)
+{
+	if (!readyPools.empty())
+	{
+		const VkDescriptorPool pool = readyPools.back();
+		readyPools.pop_back();
+		return pool;
+	}
+
+	const VkDescriptorPool pool = create_pool(device, setsPerPool);
+	setsPerPool = std::min(static_cast<uint32_t>(static_cast<float>(setsPerPool) * growthFactor), maxSetsPerPool);
+	return pool;
+}
+
+VkDescriptorPool DescriptorAllocator::create_pool(const VkDevice device, const uint32_t setCount) const
 {
 	std::vector<VkDescriptorPoolSize> poolSizes;
-	for (PoolSizeRatio ratio : poolRatios)
+	for (const PoolSizeRatio ratio : ratios)
 	{
 		poolSizes.push_back(VkDescriptorPoolSize{
 			.type = ratio.type ,
-			.descriptorCount = static_cast<uint32_t>(ratio.ratio * static_cast<float>(maxSets))
+			.descriptorCount = std::max(1u, static_cast<uint32_t>(ratio.ratio * static_cast<float>(setCount)))
 		});
 	}
 
 	VkDescriptorPoolCreateInfo poolInfo = { .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
 	poolInfo.flags = 0;
-	poolInfo.maxSets = maxSets;
+	poolInfo.maxSets = setCount;
 	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
 	poolInfo.pPoolSizes = poolSizes.data();
 
-	vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool);
+	VkDescriptorPool pool;
+	VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool));
+	return pool;
 }
 
-void DescriptorAllocator::clear_descriptors(const VkDevice device) const
+void DescriptorWriter::write_image(
+	const uint32_t binding,
+	const VkImageView image,
+	const VkSampler sampler,
+	const VkImageLayout layout,
+	const VkDescriptorType type)
 {
-	vkResetDescriptorPool(device, pool, 0);
+	imageInfos.push_back(VkDescriptorImageInfo{
+		.sampler = sampler ,
+		.imageView = image ,
+		.imageLayout = layout
+	});
+
+	VkWriteDescriptorSet write = { .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+	write.dstBinding = binding;
+	write.dstSet = VK_NULL_HANDLE;
+	write.descriptorCount = 1;
+	write.descriptorType = type;
+
+	pendingWrites.push_back(PendingWrite{ write , imageInfos.size() - 1 });
 }
 
-void DescriptorAllocator::destroy_pool(const VkDevice device) const
+void DescriptorWriter::write_buffer(
+	const uint32_t binding,
+	const VkBuffer buffer,
+	const VkDeviceSize size,
+	const VkDeviceSize offset,
+	const VkDescriptorType type)
 {
-	vkDestroyDescriptorPool(device, pool, nullptr);
+	bufferInfos.push_back(VkDescriptorBufferInfo{
+		.buffer = buffer ,
+		.offset = offset ,
+		.range = size
+	});
+
+	VkWriteDescriptorSet write = { .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+	write.dstBinding = binding;
+	write.dstSet = VK_NULL_HANDLE;
+	write.descriptorCount = 1;
+	write.descriptorType = type;
+
+	pendingWrites.push_back(PendingWrite{ write , bufferInfos.size() - 1 });
 }
 
-VkDescriptorSet DescriptorAllocator::allocate(VkDevice device, VkDescriptorSetLayout layout)
+void DescriptorWriter::clear()
 {
-	VkDescriptorSetAllocateInfo allocInfo = { .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
-	allocInfo.pNext = nullptr;
-	allocInfo.descriptorPool = pool;
-	allocInfo.descriptorSetCount = 1;
-	allocInfo.pSetLayouts = &layout;
+	imageInfos.clear();
+	bufferInfos.clear();
+	pendingWrites.clear();
+	writes.clear();
+}
 
-	VkDescriptorSet ds;
-	VK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, &ds));
+void DescriptorWriter::update_set(VkDevice device, VkDescriptorSet set)
+{
+	writes.clear();
+	writes.reserve(pendingWrites.size());
 
-	return ds;
+	for (const auto& pending : pendingWrites)
+	{
+		VkWriteDescriptorSet write = pending.write;
+		write.dstSet = set;
+
+		switch (write.descriptorType)
+		{
+		case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+		case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+		case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+		case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+			write.pBufferInfo = &bufferInfos[pending.infoIndex];
+			break;
+		default:
+			write.pImageInfo = &imageInfos[pending.infoIndex];
+			break;
+		}
+
+		writes.push_back(write);
+	}
+
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
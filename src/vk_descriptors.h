@@ -12,6 +12,8 @@ struct DescriptorLayoutBuilder
 	VkDescriptorSetLayout build(VkDevice device, VkShaderStageFlags shaderStages);
 };
 
+// chains descriptor pools as they run out. full pools are kept around and reset
+// together by clear_pools(), so steady state allocation never creates or destroys pools.
 struct DescriptorAllocator
 {
 	struct PoolSizeRatio
@@ -20,11 +22,46 @@ struct DescriptorAllocator
 		float ratio;
 	};
 
-	VkDescriptorPool pool;
+	void init(VkDevice device, uint32_t initialSets, std::span<PoolSizeRatio> poolRatios);
+	void clear_pools(VkDevice device);
+	void destroy_pools(VkDevice device);
 
-	void init_pool(VkDevice device, uint32_t maxSets, std::span<PoolSizeRatio> poolRatios);
-	void clear_descriptors(VkDevice device) const;
-	void destroy_pool(VkDevice device) const;
+	VkDescriptorSet allocate(VkDevice device, VkDescriptorSetLayout layout, const void* pNext = nullptr);
 
-	VkDescriptorSet allocate(VkDevice device, VkDescriptorSetLayout layout);
+private:
+	// every new pool is this much bigger than the last, up to maxSetsPerPool
+	static constexpr float growthFactor = 1.5f;
+	static constexpr uint32_t maxSetsPerPool = 4092;
+
+	VkDescriptorPool get_pool(VkDevice device);
+	VkDescriptorPool create_pool(VkDevice device, uint32_t setCount) const;
+
+	std::vector<PoolSizeRatio> ratios;
+	std::vector<VkDescriptorPool> fullPools;
+	std::vector<VkDescriptorPool> readyPools;
+	uint32_t setsPerPool{ 0 };
+};
+
+// collects descriptor writes and applies them with a single vkUpdateDescriptorSets
+struct DescriptorWriter
+{
+	void write_image(uint32_t binding, VkImageView image, VkSampler sampler, VkImageLayout layout, VkDescriptorType type);
+	void write_buffer(uint32_t binding, VkBuffer buffer, VkDeviceSize size, VkDeviceSize offset, VkDescriptorType type);
+
+	void clear();
+	// writes everything collected so far into set
+	void update_set(VkDevice device, VkDescriptorSet set);
+
+private:
+	// the infos are referenced by index until the update, so growing the vectors is safe
+	struct PendingWrite
+	{
+		VkWriteDescriptorSet write;
+		size_t infoIndex;
+	};
+
+	std::vector<VkDescriptorImageInfo> imageInfos;
+	std::vector<VkDescriptorBufferInfo> bufferInfos;
+	std::vector<PendingWrite> pendingWrites;
+	std::vector<VkWriteDescriptorSet> writes;
 };
@@ -1,13 +1,19 @@
 ﻿#include "vk_engine.h"
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <string_view>
 #include <SDL.h>
 #include <SDL_vulkan.h>
 
 #include <vk_types.h>
+#include <vk_cpu_profiler.h>
 #include <vk_initializers.h>
 #include <vk_images.h>
-#include <vk_descriptors.h>
+#include <vk_meshopt.h>
 #include <vk_pipelines.h>
 
 #include <VkBootstrap.h>
@@ -15,6 +21,9 @@
 #define VMA_IMPLEMENTATION
 #include <vk_mem_alloc.h>
 
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
 #include <imgui.h>
 #include <imgui_impl_sdl.h>
 #include <imgui_impl_vulkan.h>
@@ -23,36 +32,62 @@ constexpr bool bUseValidationLayers = true;
 
 FrameData& VulkanEngine::get_current_frame()
 {
-	return frames[frameNumber % FRAME_OVERLAP];
+	return frames[frameNumber % framesInFlight];
 }
 
 
 void VulkanEngine::init()
 {
-	// We initialize SDL and create a window with it. 
-	SDL_Init(SDL_INIT_VIDEO);
+	const auto initStart = std::chrono::steady_clock::now();
+
+	PROFILE_THREAD("main");
+	PROFILE_ZONE("init");
 
-	constexpr auto windowFlags = SDL_WINDOW_VULKAN;
+	jobs.init();
 
-	window = SDL_CreateWindow(
-		"Vulkan Engine",
-		SDL_WINDOWPOS_UNDEFINED,
-		SDL_WINDOWPOS_UNDEFINED,
-		windowExtent.width,
-		windowExtent.height,
-		windowFlags
-	);
+	framesInFlight = std::clamp(framesInFlight, 1, MAX_FRAMES_IN_FLIGHT);
+
+	if (!headless)
+	{
+		// We initialize SDL and create a window with it. 
+		SDL_Init(SDL_INIT_VIDEO);
+
+		constexpr auto windowFlags = SDL_WINDOW_VULKAN;
+
+		window = SDL_CreateWindow(
+			"Vulkan Engine",
+			SDL_WINDOWPOS_UNDEFINED,
+			SDL_WINDOWPOS_UNDEFINED,
+			windowExtent.width,
+			windowExtent.height,
+			windowFlags
+		);
+	}
 
 	init_vulkan();
 	init_swapchain();
 	init_commands();
 	init_sync_structures();
+	init_profiling();
+	init_uploads();
 	init_descriptors();
 	init_pipelines();
-	init_imgui();
+	init_default_data();
+
+	if (headless)
+	{
+		init_readback();
+	}
+	else
+	{
+		init_imgui();
+	}
 
 	//everything went fine
 	isInitialized = true;
+
+	const auto initEnd = std::chrono::steady_clock::now();
+	std::cout << "Init: " << std::chrono::duration<double, std::milli>(initEnd - initStart).count() << " ms" << std::endl;
 }
 
 void VulkanEngine::cleanup()
@@ -61,7 +96,61 @@ void VulkanEngine::cleanup()
 	{
 		vkDeviceWaitIdle(device);
 
-		mainDeletionQueue.flush();
+		if (headless)
+		{
+			// the last frames in flight were never waited on by draw()
+			for (int frame = frameNumber - framesInFlight; frame < frameNumber; frame++)
+			{
+				collect_readback(frame);
+			}
+			frameWriter.stop();
+
+			if (frameWriter.dropped_frames() > 0)
+			{
+				std::cout << "Headless: dropped " << frameWriter.dropped_frames() << " captured frames" << std::endl;
+			}
+		}
+
+		// the last frames in flight were never waited on by draw()
+		for (int frame = frameNumber - framesInFlight; frame < frameNumber; frame++)
+		{
+			gpuScene.collect_stats(allocator, frame);
+		}
+
+		uploads.print_summary();
+		renderGraph.print_summary();
+		gpuScene.print_summary();
+		cpuCuller.print_summary();
+		geometryQueue.print_summary();
+
+		workgroupTuner.print_summary();
+
+		gpuProfiler.collect_all(device);
+		gpuProfiler.print_summary();
+		if (!gpuProfilePath.empty() && gpuProfiler.write_report(gpuProfilePath))
+		{
+			std::cout << "GPU profile written to " << gpuProfilePath << std::endl;
+		}
+
+		// after collect_all, so the last frames' gpu scopes are in it too
+		if (!cpuTracePath.empty())
+		{
+			vkprofile::write_chrome_trace(cpuTracePath);
+		}
+
+		pipelineBuilds.wait_all();
+		pipelineCache.print_summary();
+		pipelineCache.save(device);
+
+		for (auto& frame : frames)
+		{
+			frame.frameDeletionQueue.flush(device, allocator);
+		}
+		mainDeletionQueue.flush(device, allocator);
+		assetPack.close();
+
+		// everything allocated through vma is gone once the queues are flushed
+		vmaDestroyAllocator(allocator);
 
 		for (const auto& frame : frames)
 		{
@@ -70,18 +159,25 @@ void VulkanEngine::cleanup()
 			// destroy sync objects
 			vkDestroySemaphore(device, frame.swapchainSemaphore, nullptr);
 			vkDestroySemaphore(device, frame.renderSemaphore, nullptr);
-			vkDestroyFence(device, frame.renderFence, nullptr);
 		}
 
-		destroy_swapchain();
+		if (!headless)
+		{
+			destroy_swapchain();
+			vkDestroySurfaceKHR(instance, surface, nullptr);
+		}
 
-		vkDestroySurfaceKHR(instance, surface, nullptr);
 		vkDestroyDevice(device, nullptr);
 
 		vkb::destroy_debug_utils_messenger(instance, debugMessenger);
 		vkDestroyInstance(instance, nullptr);
 
-		SDL_DestroyWindow(window);
+		if (!headless)
+		{
+			SDL_DestroyWindow(window);
+		}
+
+		jobs.shutdown();
 	}
 }
 
@@ -89,22 +185,65 @@ constexpr int OPERATION_TIMEOUT = 1000000000;
 
 void VulkanEngine::draw()
 {
-	auto currentFrame = get_current_frame();
+	PROFILE_ZONE("draw");
 
-	VK_CHECK(vkWaitForFences(device, 1, &currentFrame.renderFence, true, OPERATION_TIMEOUT));
-	currentFrame.frameDeletionQueue.flush();
-	VK_CHECK(vkResetFences(device, 1, &currentFrame.renderFence));
+	auto& currentFrame = get_current_frame();
 
-	uint32_t swapchainImageIndex;
-	VK_CHECK(vkAcquireNextImageKHR(
-		device,
-		swapchain,
-		OPERATION_TIMEOUT,
-		currentFrame.swapchainSemaphore,
-		nullptr,
-		&swapchainImageIndex));
+	// the slot is free once the frame that last used it is complete
+	if (frameNumber >= framesInFlight)
+	{
+		PROFILE_ZONE("wait for frame slot");
+		VK_CHECK(frameTimeline.wait(device, frameNumber - framesInFlight, OPERATION_TIMEOUT));
+	}
+	currentFrame.frameDeletionQueue.flush(device, allocator);
+	secondaryPools.reset(device, frameNumber % framesInFlight);
 
-	const auto currentSwapchainImage = swapchainImages[swapchainImageIndex];
+	// copies run on the transfer queue while this frame records
+	{
+		PROFILE_ZONE("upload submit");
+		uploads.submit();
+	}
+
+	// the gpu may have finished more frames than the one we waited on
+	const uint64_t completedFrames = frameTimeline.completed_frames(device);
+	if (completedFrames > 0)
+	{
+		bindless.retire(completedFrames - 1);
+	}
+
+	if (headless)
+	{
+		collect_readback(frameNumber - framesInFlight);
+	}
+	gpuScene.collect_stats(allocator, frameNumber - framesInFlight);
+
+	uint32_t swapchainImageIndex = 0;
+	if (!headless)
+	{
+		PROFILE_ZONE("acquire swapchain image");
+		VK_CHECK(vkAcquireNextImageKHR(
+			device,
+			swapchain,
+			OPERATION_TIMEOUT,
+			currentFrame.swapchainSemaphore,
+			nullptr,
+			&swapchainImageIndex));
+	}
+
+	// only block on the pipelines this frame records
+	if (gradientPipeline == VK_NULL_HANDLE || meshPipeline == VK_NULL_HANDLE || !gpuScene.is_ready() ||
+		!cpuCuller.is_ready() || (!headless && !presentPass.is_ready()))
+	{
+		PROFILE_ZONE("wait for pipeline build");
+		gradientPipeline = gradientPipelineBuild.get();
+		meshPipeline = meshPipelineBuild.get();
+		gpuScene.wait_for_pipelines();
+		cpuCuller.wait_for_pipelines();
+		if (!headless)
+		{
+			presentPass.wait_for_pipeline();
+		}
+	}
 
 	const auto cmd = currentFrame.mainCommandBuffer;
 
@@ -114,45 +253,170 @@ void VulkanEngine::draw()
 
 	VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
 
-	vkutil::transition_image(cmd, drawImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+	// the slot was last used MAX_FRAMES_IN_FLIGHT frames ago, already complete on the timeline
+	gpuProfiler.begin_frame(device, cmd, frameNumber);
+	const uint32_t frameScope = gpuProfiler.begin_scope(cmd, "frame");
 
-	draw_background(cmd);
+	// the newest finished frame's gpu time picks this frame's resolution. only the passes that scale with the
+	// render extent count: the rest cost the same at any scale, and under fifo the frame scope also holds
+	// the wait for the swapchain image, which would push the scale down to its minimum.
+	if (const auto results = gpuProfiler.latest_results(); !results.empty())
+	{
+		constexpr std::array<std::string_view, 4> scaledPasses{ "background" , "cull objects" , "cull clusters" , "geometry" };
 
-	vkutil::transition_image(
-		cmd,
-		drawImage.image,
-		VK_IMAGE_LAYOUT_GENERAL,
-		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-	vkutil::transition_image(
-		cmd,
-		currentSwapchainImage,
-		VK_IMAGE_LAYOUT_UNDEFINED,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		double scaledMs = 0.0;
+		for (const GpuScopeResult& result : results)
+		{
+			if (std::find(scaledPasses.begin(), scaledPasses.end(), result.name) != scaledPasses.end())
+			{
+				scaledMs += result.milliseconds;
+			}
+		}
+		dynamicResolution.update(gpuProfiler.latest_frame(), scaledMs);
+	}
+	renderExtent = dynamicResolution.begin_frame(frameNumber);
 
-	vkutil::copy_image_to_image(
-		cmd,
-		drawImage.image,
-		currentSwapchainImage,
-		VkExtent2D{ drawImage.imageExtent.width , drawImage.imageExtent.height },
-		swapchainExtent);
+	// hands finished uploads to the graphics queue before anything can use them
+	const uint32_t uploadScope = gpuProfiler.begin_scope(cmd, "upload acquire");
+	const uint64_t uploadWaitValue = uploads.record_acquires(cmd);
+	gpuProfiler.end_scope(cmd, uploadScope);
+	auto uploadWaitInfo = uploads.wait_info(uploadWaitValue, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
 
-	vkutil::transition_image(
-		cmd,
-		currentSwapchainImage,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+	// the heap stays bound for the whole command buffer
+	bindless.bind(cmd, VK_PIPELINE_BIND_POINT_COMPUTE);
+	bindless.bind(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+	renderGraph.reset();
 
+	// the background covers every pixel, last frame's contents are never read
+	const RGImage drawTarget = renderGraph.import_image(drawImage.image, VK_IMAGE_ASPECT_COLOR_BIT, true);
+
+	renderGraph.add_pass("background", PassType::Compute)
+		.write(drawTarget, ImageUsage::StorageWrite)
+		.execute([&](VkCommandBuffer cmd)
+		{
+			draw_background(cmd);
+		});
+
+	// only this pass uses the depth buffer, it starts cleared
+	const RGImage depthTarget = renderGraph.import_image(depthImage.image, VK_IMAGE_ASPECT_DEPTH_BIT, true);
+
+	// the gpu driven scene culls into its draw buffers first, the cpu path records every draw
+	const bool gpuDrivenFrame = gpuDriven && gpuScene.is_resident(uploads);
+	GpuScene::CullOutput cullOutput{};
+	if (gpuDrivenFrame)
+	{
+		cullOutput = gpuScene.add_cull_passes(
+			renderGraph,
+			bindless.pipelineLayout,
+			sceneView,
+			sceneProjection,
+			static_cast<float>(renderExtent.height),
+			frameNumber);
+	}
+
+	auto geometryPass = renderGraph.add_pass("geometry", PassType::Graphics);
+	geometryPass
+		.write(drawTarget, ImageUsage::ColorAttachment)
+		.write(depthTarget, ImageUsage::DepthAttachment);
+	if (gpuDrivenFrame)
+	{
+		geometryPass
+			.read(cullOutput.draws, BufferUsage::IndirectRead)
+			.read(cullOutput.drawCount, BufferUsage::IndirectRead);
+	}
+	geometryPass.execute([&, gpuDrivenFrame](VkCommandBuffer cmd)
+	{
+		draw_geometry(cmd, gpuDrivenFrame);
+	});
+
+	if (headless)
+	{
+		if (is_capture_frame(frameNumber))
+		{
+			renderGraph.add_pass("readback copy", PassType::Transfer)
+				.read(drawTarget, ImageUsage::TransferSrc)
+				.keep()
+				.execute([&](VkCommandBuffer cmd)
+				{
+					readbackRing.record_copy(cmd, drawImage.image, renderExtent, frameNumber);
+				});
+		}
+
+		// the frame's result, whether or not it is captured
+		renderGraph.export_image(drawTarget, ImageUsage::TransferSrc);
+	}
+	else
+	{
+		// the acquire semaphore is waited on at color attachment output, the first barrier chains from there
+		ResourceState acquired{};
+		acquired.writeStages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+		const RGImage swapchainTarget = renderGraph.import_image(
+			swapchainImages[swapchainImageIndex], VK_IMAGE_ASPECT_COLOR_BIT, acquired);
+
+		renderGraph.add_pass("present", PassType::Graphics)
+			.read(drawTarget, ImageUsage::Sampled)
+			.write(swapchainTarget, ImageUsage::ColorAttachment)
+			.execute([&](VkCommandBuffer cmd)
+			{
+				presentPass.record(
+					cmd,
+					bindless.pipelineLayout,
+					swapchainImageViews[swapchainImageIndex],
+					swapchainExtent,
+					renderExtent,
+					frameNumber);
+			});
+
+		// the panels go on top of the presented image, at the output resolution
+		renderGraph.add_pass("imgui", PassType::Graphics)
+			.write(swapchainTarget, ImageUsage::ColorAttachment)
+			.execute([&](VkCommandBuffer cmd)
+			{
+				draw_imgui(cmd, swapchainImageViews[swapchainImageIndex]);
+			});
+
+		renderGraph.export_image(swapchainTarget, ImageUsage::Present);
+	}
+
+	renderGraph.execute(cmd, &gpuProfiler);
+
+	gpuProfiler.end_scope(cmd, frameScope);
 	VK_CHECK(vkEndCommandBuffer(cmd));
 
+	if (headless)
+	{
+		auto cmdInfo = vkinit::command_buffer_submit_info(cmd);
+		auto timelineInfo = frameTimeline.signal_info(frameNumber, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+		const auto submitInfo = vkinit::submit_info(&cmdInfo, &timelineInfo,
+		                                            uploadWaitValue != 0 ? &uploadWaitInfo : nullptr);
+
+		PROFILE_ZONE("queue submit");
+		VK_CHECK(vkQueueSubmit2(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE));
+		return;
+	}
+
 	auto cmdInfo = vkinit::command_buffer_submit_info(cmd);
 
-	auto waitInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
-	                                              currentFrame.swapchainSemaphore);
-	auto signalInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, currentFrame.renderSemaphore);
+	VkSemaphoreSubmitInfo waitInfos[] = {
+		vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
+		                              currentFrame.swapchainSemaphore) ,
+		uploadWaitInfo
+	};
+	VkSemaphoreSubmitInfo signalInfos[] = {
+		// the graph's present transition ends at all commands
+		vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, currentFrame.renderSemaphore) ,
+		frameTimeline.signal_info(frameNumber, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT)
+	};
 
-	const auto submitInfo = vkinit::submit_info(&cmdInfo, &signalInfo, &waitInfo);
+	auto submitInfo = vkinit::submit_info(&cmdInfo, signalInfos, waitInfos);
+	submitInfo.signalSemaphoreInfoCount = 2;
+	submitInfo.waitSemaphoreInfoCount = uploadWaitValue != 0 ? 2 : 1;
 
-	VK_CHECK(vkQueueSubmit2(graphicsQueue, 1, &submitInfo, currentFrame.renderFence));
+	{
+		PROFILE_ZONE("queue submit");
+		VK_CHECK(vkQueueSubmit2(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE));
+	}
 
 	VkPresentInfoKHR presentInfo{};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -163,17 +427,26 @@ void VulkanEngine::draw()
 	presentInfo.pSwapchains = &swapchain;
 	presentInfo.pImageIndices = &swapchainImageIndex;
 
+	PROFILE_ZONE("present");
 	VK_CHECK(vkQueuePresentKHR(graphicsQueue, &presentInfo));
 }
 
 void VulkanEngine::run()
 {
+	if (headless)
+	{
+		run_headless();
+		return;
+	}
+
 	SDL_Event e;
 	bool bQuit = false;
 
 	//main loop
 	while (!bQuit)
 	{
+		PROFILE_ZONE("frame");
+
 		//Handle events on queue
 		while (SDL_PollEvent(&e) != 0)
 		{
@@ -187,6 +460,11 @@ void VulkanEngine::run()
 					std::cout << "Pressed H" << std::endl;
 				}
 
+				if (e.key.keysym.sym >= SDLK_1 && e.key.keysym.sym <= SDLK_4)
+				{
+					set_frames_in_flight(e.key.keysym.sym - SDLK_0);
+				}
+
 				if (e.key.keysym.sym == SDLK_q)
 				{
 					std::cout << "Quitting..." << std::endl;
@@ -203,6 +481,13 @@ void VulkanEngine::run()
 		//some imgui UI to test
 		ImGui::ShowDemoWindow();
 
+		gpuProfiler.draw_panel();
+		dynamicResolution.draw_panel();
+		presentPass.draw_panel();
+		gpuScene.draw_panel();
+		cpuCuller.draw_panel();
+		geometryQueue.draw_panel();
+
 		//make imgui calculate internal draw structures
 		ImGui::Render();
 
@@ -212,8 +497,91 @@ void VulkanEngine::run()
 	}
 }
 
-void VulkanEngine::immediate_submit(std::function<void(VkCommandBuffer cmd)>&& function) const
+void VulkanEngine::run_headless()
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < headlessFrameCount; i++)
+	{
+		PROFILE_ZONE("frame");
+		draw();
+
+		frameNumber ++;
+	}
+
+	// include the gpu work of the last frames in the measurement
+	VK_CHECK(vkDeviceWaitIdle(device));
+
+	const auto end = std::chrono::steady_clock::now();
+	const double seconds = std::chrono::duration<double>(end - start).count();
+
+	std::cout << "Headless: " << headlessFrameCount << " frames in " << seconds << " s ("
+		<< static_cast<double>(headlessFrameCount) / seconds << " fps, "
+		<< seconds * 1000.0 / static_cast<double>(headlessFrameCount) << " ms/frame)" << std::endl;
+}
+
+bool VulkanEngine::is_capture_frame(int frame) const
+{
+	return frameWriter.is_running() && frame % captureInterval == 0;
+}
+
+void VulkanEngine::collect_readback(int completedFrame)
+{
+	ReadbackFrame readback;
+	if (readbackRing.collect(allocator, completedFrame, readback))
+	{
+		frameWriter.enqueue(std::move(readback));
+	}
+}
+
+void VulkanEngine::set_frames_in_flight(int count)
 {
+	count = std::clamp(count, 1, MAX_FRAMES_IN_FLIGHT);
+	if (!isInitialized)
+	{
+		framesInFlight = count;
+		return;
+	}
+
+	if (count == framesInFlight)
+	{
+		return;
+	}
+
+	// frames map to different slots afterwards, so nothing submitted may still use one
+	if (frameNumber > 0)
+	{
+		VK_CHECK(frameTimeline.wait(device, frameNumber - 1, OPERATION_TIMEOUT));
+	}
+
+	for (auto& frame : frames)
+	{
+		frame.frameDeletionQueue.flush(device, allocator);
+	}
+	if (frameNumber > 0)
+	{
+		bindless.retire(frameNumber - 1);
+	}
+
+	if (headless)
+	{
+		for (int frame = frameNumber - framesInFlight; frame < frameNumber; frame++)
+		{
+			collect_readback(frame);
+		}
+
+		readbackRing.destroy(allocator);
+		readbackRing.init(allocator, count, VkExtent2D{ drawImage.imageExtent.width , drawImage.imageExtent.height });
+	}
+
+	framesInFlight = count;
+	std::cout << "Frames in flight: " << framesInFlight << std::endl;
+}
+
+void VulkanEngine::immediate_submit(std::function<void(VkCommandBuffer cmd)>&& function, const uint64_t timeoutNs) const
+{
+	PROFILE_ZONE("immediate submit");
+
 	VK_CHECK(vkResetFences(device, 1, &immFence));
 	VK_CHECK(vkResetCommandBuffer(immCommandBuffer, 0));
 
@@ -235,7 +603,164 @@ void VulkanEngine::immediate_submit(std::function<void(VkCommandBuffer cmd)>&& f
 	//  _renderFence will now block until the graphic commands finish execution
 	VK_CHECK(vkQueueSubmit2(graphicsQueue, 1, &submit, immFence));
 
-	VK_CHECK(vkWaitForFences(device, 1, &immFence, true, OPERATION_TIMEOUT));
+	PROFILE_ZONE("immediate fence wait");
+	VK_CHECK(vkWaitForFences(device, 1, &immFence, true, timeoutNs));
+}
+
+AllocatedBuffer VulkanEngine::create_buffer(size_t allocSize, VkBufferUsageFlags usage,
+                                            VmaMemoryUsage memoryUsage) const
+{
+	VkBufferCreateInfo bufferInfo = { .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+	bufferInfo.pNext = nullptr;
+	bufferInfo.size = allocSize;
+	bufferInfo.usage = usage;
+
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = memoryUsage;
+	allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+	AllocatedBuffer newBuffer;
+	VK_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &newBuffer.buffer, &newBuffer.allocation,
+		&newBuffer.info));
+
+	return newBuffer;
+}
+
+void VulkanEngine::destroy_buffer(const AllocatedBuffer& buffer) const
+{
+	vmaDestroyBuffer(allocator, buffer.buffer, buffer.allocation);
+}
+
+AllocatedImage VulkanEngine::create_image(VkExtent3D size, VkFormat format, VkImageUsageFlags usage,
+                                          uint32_t mipLevels) const
+{
+	AllocatedImage newImage;
+	newImage.imageFormat = format;
+	newImage.imageExtent = size;
+
+	VkImageCreateInfo imageInfo = vkinit::image_create_info(format, usage, size);
+	imageInfo.mipLevels = mipLevels;
+
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	allocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+	VK_CHECK(vmaCreateImage(allocator, &imageInfo, &allocInfo, &newImage.image, &newImage.allocation, nullptr));
+
+	VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(format, newImage.image, VK_IMAGE_ASPECT_COLOR_BIT);
+	viewInfo.subresourceRange.levelCount = mipLevels;
+
+	VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &newImage.imageView));
+
+	return newImage;
+}
+
+void VulkanEngine::destroy_image(const AllocatedImage& image) const
+{
+	vkDestroyImageView(device, image.imageView, nullptr);
+	vmaDestroyImage(allocator, image.image, image.allocation);
+}
+
+bool VulkanEngine::supports_texture_format(VkFormat format) const
+{
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(chosenGpu, format, &properties);
+
+	constexpr VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+	return (properties.optimalTilingFeatures & required) == required;
+}
+
+GPUMeshBuffers VulkanEngine::upload_mesh(std::span<const uint32_t> indices, std::span<const Vertex> vertices,
+                                         UploadTicket& outTicket)
+{
+	const size_t vertexBufferSize = vertices.size_bytes();
+	const size_t indexBufferSize = indices.size_bytes();
+
+	GPUMeshBuffers buffers;
+
+	buffers.vertexBuffer = create_buffer(
+		vertexBufferSize,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+		VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY);
+
+	VkBufferDeviceAddressInfo deviceAddressInfo{};
+	deviceAddressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+	deviceAddressInfo.buffer = buffers.vertexBuffer.buffer;
+	buffers.vertexBufferAddress = vkGetBufferDeviceAddress(device, &deviceAddressInfo);
+
+	buffers.indexBuffer = create_buffer(
+		indexBufferSize,
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY);
+
+	// requests complete in order, so the second ticket covers both
+	uploads.upload_buffer(buffers.vertexBuffer.buffer, 0, vertices.data(), vertexBufferSize);
+	outTicket = uploads.upload_buffer(buffers.indexBuffer.buffer, 0, indices.data(), indexBufferSize);
+
+	return buffers;
+}
+
+AllocatedImage VulkanEngine::upload_texture(VkFormat format, VkExtent2D extent,
+                                            std::span<const std::span<const uint8_t>> levels, UploadTicket& outTicket)
+{
+	const AllocatedImage image = create_image(
+		VkExtent3D{ extent.width , extent.height , 1 },
+		format,
+		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+		static_cast<uint32_t>(levels.size()));
+
+	for (uint32_t level = 0; level < levels.size(); level++)
+	{
+		const VkExtent3D levelExtent{
+			std::max(extent.width >> level, 1u) ,
+			std::max(extent.height >> level, 1u) ,
+			1
+		};
+
+		outTicket = uploads.upload_image(image.image, format, levelExtent, level, levels[level].data(),
+		                                 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
+
+	return image;
+}
+
+std::shared_ptr<MeshAsset> VulkanEngine::load_mesh(const std::string& name)
+{
+	std::shared_ptr<MeshAsset> mesh;
+
+	if (const AssetPackEntry* entry = assetPack.find(name, AssetType::Mesh))
+	{
+		mesh = std::make_shared<MeshAsset>();
+		mesh->name = name;
+
+		for (const AssetPackSurface& surface : assetPack.surfaces(*entry))
+		{
+			mesh->surfaces.push_back({ surface.startIndex , surface.count , std::string(asset_name(surface.material)) });
+		}
+
+		// no cpu copy, the copies into staging read from the mapping
+		mesh->sourceIndices = assetPack.indices(*entry);
+		mesh->sourceVertices = assetPack.vertices(*entry);
+	}
+	else
+	{
+		mesh = vkutil::load_obj_mesh(jobs, "../../assets/" + name + ".obj");
+		if (mesh == nullptr)
+		{
+			return nullptr;
+		}
+
+		mesh->sourceIndices = mesh->indices;
+		mesh->sourceVertices = mesh->vertices;
+	}
+
+	mesh->meshBuffers = upload_mesh(mesh->sourceIndices, mesh->sourceVertices, mesh->uploadTicket);
+
+	mainDeletionQueue.push_buffer(mesh->meshBuffers.vertexBuffer.buffer, mesh->meshBuffers.vertexBuffer.allocation);
+	mainDeletionQueue.push_buffer(mesh->meshBuffers.indexBuffer.buffer, mesh->meshBuffers.indexBuffer.allocation);
+
+	return mesh;
 }
 
 void VulkanEngine::init_vulkan()
@@ -247,6 +772,7 @@ void VulkanEngine::init_vulkan()
 	               .request_validation_layers(bUseValidationLayers)
 	               .use_default_debug_messenger()
 	               .require_api_version(1, 3, 0)
+	               .set_headless(headless)
 	               .build();
 
 	const auto vkbInst = instRet.value();
@@ -255,7 +781,10 @@ void VulkanEngine::init_vulkan()
 	instance = vkbInst.instance;
 	debugMessenger = vkbInst.debug_messenger;
 
-	SDL_Vulkan_CreateSurface(window, instance, &surface);
+	if (!headless)
+	{
+		SDL_Vulkan_CreateSurface(window, instance, &surface);
+	}
 
 	// VK 1.3 features
 	VkPhysicalDeviceVulkan13Features features13{};
@@ -265,19 +794,48 @@ void VulkanEngine::init_vulkan()
 	// VK 1.2 features
 	VkPhysicalDeviceVulkan12Features features12{};
 	features12.bufferDeviceAddress = true;
+	features12.timelineSemaphore = true;
 	features12.descriptorIndexing = true;
+	features12.runtimeDescriptorArray = true;
+	features12.descriptorBindingPartiallyBound = true;
+	features12.descriptorBindingStorageImageUpdateAfterBind = true;
+	features12.descriptorBindingSampledImageUpdateAfterBind = true;
+	features12.descriptorBindingStorageBufferUpdateAfterBind = true;
+	features12.shaderStorageImageArrayNonUniformIndexing = true;
+	features12.shaderSampledImageArrayNonUniformIndexing = true;
+	features12.shaderStorageBufferArrayNonUniformIndexing = true;
+
+	// the gpu driven path writes its own draw commands and count
+	features12.drawIndirectCount = true;
 
 	VkPhysicalDeviceFeatures deviceFeatures{};
+	deviceFeatures.multiDrawIndirect = true;
+	deviceFeatures.drawIndirectFirstInstance = true;
 
 	// Select gpu
 	vkb::PhysicalDeviceSelector selector{ vkbInst };
-	vkb::PhysicalDevice physicalDevice = selector
-	                                     .set_minimum_version(1, 3)
-	                                     .set_surface(surface)
-	                                     .set_required_features_12(features12)
-	                                     .set_required_features_13(features13)
-	                                     .select()
-	                                     .value();
+	selector
+		.set_minimum_version(1, 3)
+		.set_required_features(deviceFeatures)
+		.set_required_features_12(features12)
+		.set_required_features_13(features13);
+
+	// a headless instance needs no present support, which lets us run on lavapipe
+	if (!headless)
+	{
+		selector.set_surface(surface);
+	}
+
+	vkb::PhysicalDevice physicalDevice = selector.select().value();
+
+	// block compressed textures are used where the gpu has them, decompressed copies elsewhere
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(physicalDevice.physical_device, &supportedFeatures);
+	physicalDevice.features.textureCompressionBC = supportedFeatures.textureCompressionBC;
+	// lets the profiler count compute invocations
+	physicalDevice.features.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+	// lines gpu scopes up with cpu zones in the trace
+	calibratedTimestamps = physicalDevice.enable_extension_if_present(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
 
 	vkb::DeviceBuilder deviceBuilder{ physicalDevice };
 	vkb::Device vkbDevice = deviceBuilder.build().value();
@@ -285,31 +843,46 @@ void VulkanEngine::init_vulkan()
 	// get values
 	device = vkbDevice.device;
 	chosenGpu = physicalDevice.physical_device;
+	gpuProperties = physicalDevice.properties;
+	gpuFeatures = physicalDevice.features;
 
 	// get graphics queue
 	graphicsQueue = vkbDevice.get_queue(vkb::QueueType::graphics).value();
 	graphicsQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
 
+	// uploads overlap rendering on a separate family when there is one
+	const auto separateTransferQueue = vkbDevice.get_queue(vkb::QueueType::transfer);
+	if (separateTransferQueue.has_value())
+	{
+		transferQueue = separateTransferQueue.value();
+		transferQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::transfer).value();
+	}
+	else
+	{
+		transferQueue = graphicsQueue;
+		transferQueueFamily = graphicsQueueFamily;
+	}
+
 	VmaAllocatorCreateInfo allocatorInfo = {};
 	allocatorInfo.physicalDevice = chosenGpu;
 	allocatorInfo.device = device;
 	allocatorInfo.instance = instance;
 	allocatorInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
 	vmaCreateAllocator(&allocatorInfo, &allocator);
-
-	mainDeletionQueue.push_function([&]()
-	{
-		vmaDestroyAllocator(allocator);
-	});
 }
 
 void VulkanEngine::init_swapchain()
 {
-	create_swapchain(windowExtent.width, windowExtent.height);
+	if (!headless)
+	{
+		create_swapchain(windowExtent.width, windowExtent.height);
+	}
 
+	// sized for the highest scale the resolution can be raised to
+	const float maxScale = std::max(dynamicResolution.maxScale, 1.0f);
 	VkExtent3D drawImageExtent = {
-		windowExtent.width ,
-		windowExtent.height ,
+		static_cast<uint32_t>(std::ceil(windowExtent.width * maxScale)) ,
+		static_cast<uint32_t>(std::ceil(windowExtent.height * maxScale)) ,
 		1
 	};
 
@@ -320,6 +893,7 @@ void VulkanEngine::init_swapchain()
 		VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
 		VK_IMAGE_USAGE_TRANSFER_DST_BIT |
 		VK_IMAGE_USAGE_STORAGE_BIT |
+		VK_IMAGE_USAGE_SAMPLED_BIT |
 		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
 	auto renderImageInfo = vkinit::image_create_info(drawImage.imageFormat, drawImageUsages, drawImageExtent);
@@ -341,11 +915,33 @@ void VulkanEngine::init_swapchain()
 
 	VK_CHECK(vkCreateImageView(device, &renderViewInfo, nullptr, &drawImage.imageView));
 
-	mainDeletionQueue.push_function([=]()
-	{
-		vkDestroyImageView(device, drawImage.imageView, nullptr);
-		vmaDestroyImage(allocator, drawImage.image, drawImage.allocation);
-	});
+	mainDeletionQueue.push_image_view(drawImage.imageView);
+	mainDeletionQueue.push_image(drawImage.image, drawImage.allocation);
+
+	depthImage.imageFormat = VK_FORMAT_D32_SFLOAT;
+	depthImage.imageExtent = drawImageExtent;
+
+	const auto depthImageInfo = vkinit::image_create_info(
+		depthImage.imageFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, drawImageExtent);
+
+	vmaCreateImage(
+		allocator,
+		&depthImageInfo,
+		&renderImageAllocInfo,
+		&depthImage.image,
+		&depthImage.allocation,
+		nullptr);
+
+	const auto depthViewInfo = vkinit::imageview_create_info(depthImage.imageFormat, depthImage.image,
+	                                                         VK_IMAGE_ASPECT_DEPTH_BIT);
+
+	VK_CHECK(vkCreateImageView(device, &depthViewInfo, nullptr, &depthImage.imageView));
+
+	mainDeletionQueue.push_image_view(depthImage.imageView);
+	mainDeletionQueue.push_image(depthImage.image, depthImage.allocation);
+
+	dynamicResolution.init(windowExtent, VkExtent2D{ drawImageExtent.width , drawImageExtent.height });
+	renderExtent = windowExtent;
 }
 
 void VulkanEngine::init_commands()
@@ -371,9 +967,14 @@ void VulkanEngine::init_commands()
 
 	VK_CHECK(vkAllocateCommandBuffers(device, &cmdAllocInfo, &immCommandBuffer));
 
+	mainDeletionQueue.push_command_pool(immCommandPool);
+
+	// the main thread and every worker can record secondaries
+	secondaryPools.init(device, graphicsQueueFamily, MAX_FRAMES_IN_FLIGHT, jobs.worker_count() + 1);
+
 	mainDeletionQueue.push_function([=]()
 	{
-		vkDestroyCommandPool(device, immCommandPool, nullptr);
+		secondaryPools.destroy(device);
 	});
 }
 
@@ -382,99 +983,317 @@ void VulkanEngine::init_sync_structures()
 	const VkSemaphoreCreateInfo semaphoreInfo = vkinit::semaphore_create_info();
 	const VkFenceCreateInfo fenceInfo = vkinit::fence_create_info(true);
 
+	// every slot gets its objects so frames in flight can be raised later
 	for (auto& frame : frames)
 	{
 		VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frame.swapchainSemaphore));
 		VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frame.renderSemaphore));
-
-		VK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &frame.renderFence));
 	}
 
+	frameTimeline.init(device);
+	mainDeletionQueue.push_semaphore(frameTimeline.semaphore);
+
 	VK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &immFence));
+	mainDeletionQueue.push_fence(immFence);
+}
+
+void VulkanEngine::init_profiling()
+{
+	// one slot per frame that can be in flight, whatever framesInFlight is set to later
+	gpuProfiler.init(device, chosenGpu, graphicsQueueFamily, MAX_FRAMES_IN_FLIGHT, gpuFeatures.pipelineStatisticsQuery);
+	gpuProfiler.recordHistory = !gpuProfilePath.empty();
+	if (calibratedTimestamps)
+	{
+		gpuProfiler.enable_calibration(instance, chosenGpu, device);
+	}
+
+	mainDeletionQueue.push_function([=]()
+	{
+		gpuProfiler.destroy(device);
+	});
+}
+
+void VulkanEngine::init_uploads()
+{
+	constexpr VkDeviceSize stagingSize = 64 * 1024 * 1024;
+	// caps the bytes copied per frame, so a large asset streams over several frames
+	constexpr VkDeviceSize submitBudget = 16 * 1024 * 1024;
+
+	uploads.init(device, allocator, { transferQueue , transferQueueFamily , graphicsQueueFamily }, stagingSize,
+	             submitBudget);
+
 	mainDeletionQueue.push_function([=]()
 	{
-		vkDestroyFence(device, immFence, nullptr);
+		uploads.destroy();
 	});
 }
 
 void VulkanEngine::init_descriptors()
 {
-	std::vector<DescriptorAllocator::PoolSizeRatio> sizes = {
-		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE , 1 }
-	};
+	bindless.init(device, chosenGpu);
+
+	drawImageIndex = bindless.register_storage_image(device, drawImage.imageView);
+
+	mainDeletionQueue.push_function([=]()
+	{
+		bindless.release(BINDLESS_STORAGE_IMAGES, drawImageIndex, frameNumber);
+		bindless.destroy(device);
+	});
+}
+
+void VulkanEngine::init_pipelines()
+{
+	pipelineCache.init(device, gpuProperties, pipelineCachePath);
+	workgroupTuner.init(chosenGpu, graphicsQueueFamily, workgroupSizesPath);
+
+	pipelineBuilds.init(device, &pipelineCache, &jobs);
+
+	mainDeletionQueue.push_function([=]()
+	{
+		shaderModules.destroy(device);
+		pipelineCache.destroy(device);
+	});
+
+	// builds run on the job system while the rest of init carries on
+	init_background_pipelines();
+	init_present_pipelines();
+	init_mesh_pipelines();
+
+	mainDeletionQueue.push_function([=]()
+	{
+		pipelineBuilds.destroy();
+	});
 
-	globalDescriptorAllocator.init_pool(device, 10, sizes);
+	shaderModules.print_summary();
+}
 
+void VulkanEngine::init_default_data()
+{
+	// optional, every asset falls back to its source file
+	if (assetPack.open("../../assets/assets.pack"))
 	{
-		DescriptorLayoutBuilder builder;
-		builder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-		drawImageDescriptorLayout = builder.build(device, VK_SHADER_STAGE_COMPUTE_BIT);
+		std::cout << "Asset pack: " << assetPack.entries().size() << " entries" << std::endl;
+	}
+
+	for (const char* name : { "monkey_smooth" , "monkey_flat" })
+	{
+		if (auto mesh = load_mesh(name))
+		{
+			testMeshes.push_back(std::move(mesh));
+		}
 	}
 
-	drawImageDescriptors = globalDescriptorAllocator.allocate(device, drawImageDescriptorLayout);
+	build_mesh_lods();
+	init_scene();
+}
 
-	VkDescriptorImageInfo imgInfo{};
-	imgInfo.imageView = drawImage.imageView;
-	imgInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+void VulkanEngine::build_mesh_lods()
+{
+	const auto start = std::chrono::steady_clock::now();
 
-	VkWriteDescriptorSet drawImageWrite{};
-	drawImageWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	drawImageWrite.pNext = nullptr;
+	// the full mesh takes the first of the gpu scene's lod slots
+	jobs.parallel_for(testMeshes.size(), 1, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			MeshAsset& mesh = *testMeshes[i];
+			mesh.lods = vkutil::build_lod_chain(mesh.sourceVertices, mesh.sourceIndices, GpuScene::MAX_LODS - 1);
+		}
+	});
 
-	drawImageWrite.dstBinding = 0;
-	drawImageWrite.dstSet = drawImageDescriptors;
-	drawImageWrite.descriptorCount = 1;
-	drawImageWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-	drawImageWrite.pImageInfo = &imgInfo;
+	const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Mesh lods: " << testMeshes.size() << " meshes in " << ms << " ms" << std::endl;
 
-	vkUpdateDescriptorSets(device, 1, &drawImageWrite, 0, nullptr);
+	for (const auto& mesh : testMeshes)
+	{
+		const size_t fullTriangles = mesh->sourceIndices.size() / 3;
+		std::cout << "    " << mesh->name << ": " << fullTriangles << " triangles";
+		for (const MeshLodLevel& lod : mesh->lods)
+		{
+			const size_t triangles = lod.indices.size() / 3;
+			std::cout << " -> " << triangles << " ("
+				<< 100.0 * static_cast<double>(triangles) / static_cast<double>(fullTriangles)
+				<< "%, error " << lod.error << ")";
+		}
+		std::cout << std::endl;
+	}
 }
 
-void VulkanEngine::init_pipelines()
+void VulkanEngine::init_scene()
 {
-	init_background_pipelines();
+	if (testMeshes.empty())
+	{
+		return;
+	}
+
+	// a square grid of the test meshes taking turns, receding from the camera
+	constexpr float spacing = 3.f;
+	const int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(sceneDrawCount))));
+
+	// the whole mesh is one draw on the gpu, followed by its simplified lods
+	std::vector<uint32_t> gpuMeshes;
+	for (const auto& mesh : testMeshes)
+	{
+		std::vector<GpuScene::MeshLod> lods{ { mesh->sourceIndices , 0.f } };
+		for (const MeshLodLevel& lod : mesh->lods)
+		{
+			lods.push_back({ lod.indices , lod.error });
+		}
+		gpuMeshes.push_back(gpuScene.add_mesh(mesh->sourceVertices, lods));
+		cpuCuller.add_batch(&mesh->meshBuffers, mesh->surfaces, vkutil::compute_bounding_sphere(mesh->sourceVertices));
+	}
+
+	const TransformHierarchy::Node root = sceneTransforms.add_node(TransformHierarchy::NO_PARENT);
+	std::vector<TransformHierarchy::Node> nodes;
+	nodes.reserve(sceneDrawCount);
+	for (int i = 0; i < sceneDrawCount; i++)
+	{
+		LocalTransform local;
+		local.position = glm::vec3{
+			(static_cast<float>(i % side) - static_cast<float>(side) * 0.5f) * spacing ,
+			0.f ,
+			-static_cast<float>(i / side) * spacing
+		};
+		nodes.push_back(sceneTransforms.add_node(root, local));
+	}
+	sceneTransforms.update(&jobs);
+
+	// surfaces sharing a material name share an id, in order of first use
+	std::vector<std::string> materials;
+	const auto material_id = [&](const std::string& name)
+	{
+		const auto found = std::find(materials.begin(), materials.end(), name);
+		if (found != materials.end())
+		{
+			return static_cast<uint32_t>(found - materials.begin());
+		}
+		materials.push_back(name);
+		return static_cast<uint32_t>(materials.size() - 1);
+	};
+
+	sceneDraws.reserve(static_cast<size_t>(sceneDrawCount) * testMeshes.front()->surfaces.size());
+	for (int i = 0; i < sceneDrawCount; i++)
+	{
+		const size_t meshIndex = static_cast<size_t>(i) % testMeshes.size();
+		const MeshAsset& mesh = *testMeshes[meshIndex];
+		const glm::mat4& transform = sceneTransforms.world(nodes[i]);
+
+		for (const GeoSurface& surface : mesh.surfaces)
+		{
+			sceneDraws.push_back(MeshDraw{
+				&mesh.meshBuffers ,
+				surface.startIndex ,
+				surface.count ,
+				transform ,
+				static_cast<uint32_t>(meshIndex) ,
+				material_id(surface.material)
+			});
+		}
+		gpuScene.add_object(gpuMeshes[meshIndex], transform);
+		cpuCuller.add_instance(static_cast<uint32_t>(meshIndex), transform);
+	}
+
+	gpuScene.upload(device, allocator, uploads, MAX_FRAMES_IN_FLIGHT, gpuProperties.limits.maxComputeWorkGroupCount[0]);
+	cpuCuller.init_buffers(device, allocator, MAX_FRAMES_IN_FLIGHT);
+	mainDeletionQueue.push_function([=]()
+	{
+		cpuCuller.destroy(allocator);
+		gpuScene.destroy(allocator);
+	});
+
+	// above the near edge of the grid, looking into it. reverse z, the far plane maps to 0.
+	// an empty grid still gets a far plane past the near one.
+	const float depth = static_cast<float>(std::max(side, 1)) * spacing;
+	sceneView = glm::lookAt(
+		glm::vec3{ 0.f , 20.f , 15.f },
+		glm::vec3{ 0.f , 0.f , -depth * 0.25f },
+		glm::vec3{ 0.f , 1.f , 0.f });
+	sceneProjection = glm::perspectiveRH_ZO(
+		glm::radians(70.f),
+		static_cast<float>(windowExtent.width) / static_cast<float>(windowExtent.height),
+		depth * 2.f,
+		0.1f);
+	// vulkan clip space has y pointing down
+	sceneProjection[1][1] *= -1.f;
+
+	sceneViewProj = sceneProjection * sceneView;
 }
 
 void VulkanEngine::init_background_pipelines()
 {
-	VkPipelineLayoutCreateInfo createInfo{};
-	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	createInfo.pNext = nullptr;
-	createInfo.flags = 0;
-	createInfo.setLayoutCount = 1;
-	createInfo.pSetLayouts = &drawImageDescriptorLayout;
+	VkShaderModule shaderModule;
+	VK_CHECK(shaderModules.load(device, "../../shaders/gradient.comp.spv", &shaderModule));
 
-	VK_CHECK(vkCreatePipelineLayout(device, &createInfo, nullptr, &gradientPipelineLayout));
+	ComputePipelineDesc gradientDesc{};
+	gradientDesc.name = "gradient";
+	gradientDesc.shader = shaderModule;
+	gradientDesc.layout = bindless.pipelineLayout;
 
-	VkShaderModule shaderModule;
-	VK_CHECK(vkutil::load_shader_module("../../shaders/gradient.comp.spv", device, &shaderModule));
+	// timed over the whole draw image, the largest extent dynamic resolution renders at
+	const WorkgroupSize defaultSize{ 16 , 16 , 1 };
+	if (retuneWorkgroups || !workgroupTuner.is_tuned(gradientDesc.name))
+	{
+		PROFILE_ZONE("tune gradient workgroup");
+		const VkExtent2D extent{ drawImage.imageExtent.width , drawImage.imageExtent.height };
+		const std::vector<WorkgroupSize> candidates = vkutil::image_workgroup_candidates();
+
+		workgroupTuner.tune(device, pipelineCache, gradientDesc, candidates, defaultSize,
+			[&](const std::function<void(VkCommandBuffer)>& record)
+			{
+				// a candidate's dispatches over a large draw image can take seconds on a cpu device like lavapipe
+				immediate_submit([&](VkCommandBuffer cmd)
+				{
+					vkutil::transition_image(cmd, drawImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+					bindless.bind(cmd, VK_PIPELINE_BIND_POINT_COMPUTE);
+					record(cmd);
+				}, UINT64_MAX);
+			},
+			[&](VkCommandBuffer cmd, VkPipeline pipeline, WorkgroupSize size)
+			{
+				dispatch_gradient(cmd, pipeline, size, extent);
+			});
+	}
 
-	VkPipelineShaderStageCreateInfo stageInfo{};
-	stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	stageInfo.pNext = nullptr;
-	stageInfo.flags = 0;
-	stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-	stageInfo.module = shaderModule;
-	stageInfo.pName = "main";
+	gradientWorkgroup = workgroupTuner.size(gradientDesc.name, defaultSize);
+	gradientDesc.set_workgroup_size(gradientWorkgroup);
 
-	VkComputePipelineCreateInfo pipelineCreateInfo{};
-	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-	pipelineCreateInfo.pNext = nullptr;
-	pipelineCreateInfo.flags = 0;
-	pipelineCreateInfo.stage = stageInfo;
-	pipelineCreateInfo.layout = gradientPipelineLayout;
-	pipelineCreateInfo.basePipelineHandle = nullptr;
-	pipelineCreateInfo.basePipelineIndex = 0;
+	gradientPipelineBuild = pipelineBuilds.enqueue(gradientDesc);
+}
 
+void VulkanEngine::init_mesh_pipelines()
+{
+	VkShaderModule vertexShader;
+	VK_CHECK(shaderModules.load(device, "../../shaders/mesh.vert.spv", &vertexShader));
+	VkShaderModule fragmentShader;
+	VK_CHECK(shaderModules.load(device, "../../shaders/mesh.frag.spv", &fragmentShader));
+
+	GraphicsPipelineDesc meshDesc{};
+	meshDesc.name = "mesh";
+	meshDesc.vertexShader = vertexShader;
+	meshDesc.fragmentShader = fragmentShader;
+	meshDesc.layout = bindless.pipelineLayout;
+	meshDesc.depthTest = true;
+	meshDesc.depthWrite = true;
+	meshDesc.colorFormats = { drawImage.imageFormat };
+	meshDesc.depthFormat = depthImage.imageFormat;
+
+	meshPipelineBuild = pipelineBuilds.enqueue(std::move(meshDesc));
+
+	gpuScene.init_pipelines(device, bindless, shaderModules, pipelineBuilds, drawImage.imageFormat, depthImage.imageFormat);
+	cpuCuller.init_pipelines(device, bindless, shaderModules, pipelineBuilds, drawImage.imageFormat, depthImage.imageFormat);
+}
 
-	VK_CHECK(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &gradientPipeline));
+void VulkanEngine::init_present_pipelines()
+{
+	// headless has no swapchain, the pipeline is still built for the present benchmark
+	const VkFormat targetFormat = headless ? VK_FORMAT_B8G8R8A8_SRGB : swapchainImageFormat;
 
-	vkDestroyShaderModule(device, shaderModule, nullptr);
+	presentPass.init(device, bindless, shaderModules, pipelineBuilds, targetFormat);
+	presentPass.set_source(device, bindless, drawImage.imageView, frameNumber);
 
 	mainDeletionQueue.push_function([=]()
 	{
-		vkDestroyPipelineLayout(device, gradientPipelineLayout, nullptr);
-		vkDestroyPipeline(device, gradientPipeline, nullptr);
+		presentPass.destroy(device, bindless, frameNumber);
 	});
 }
 
@@ -521,11 +1340,13 @@ void VulkanEngine::init_imgui()
 	init_info.PhysicalDevice = chosenGpu;
 	init_info.Device = device;
 	init_info.Queue = graphicsQueue;
+	init_info.PipelineCache = pipelineCache.cache;
 	init_info.DescriptorPool = imguiPool;
 	init_info.MinImageCount = 3;
 	init_info.ImageCount = 3;
-	//init_info.UseDynamicRendering = true;
-	//init_info.ColorAttachmentFormat = swapchainImageFormat;
+	//drawn straight into the swapchain image after the present pass
+	init_info.UseDynamicRendering = true;
+	init_info.ColorAttachmentFormat = swapchainImageFormat;
 
 	init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
 
@@ -540,9 +1361,29 @@ void VulkanEngine::init_imgui()
 	// add the destroy the imgui created structures
 	mainDeletionQueue.push_function([=]()
 	{
-		vkDestroyDescriptorPool(device, imguiPool, nullptr);
 		ImGui_ImplVulkan_Shutdown();
 	});
+	mainDeletionQueue.push_descriptor_pool(imguiPool);
+}
+
+void VulkanEngine::init_readback()
+{
+	if (captureInterval < 1)
+	{
+		captureInterval = 1;
+	}
+
+	readbackRing.init(allocator, framesInFlight, VkExtent2D{ drawImage.imageExtent.width , drawImage.imageExtent.height });
+
+	if (!captureDirectory.empty())
+	{
+		frameWriter.start(captureDirectory);
+	}
+
+	mainDeletionQueue.push_function([=]()
+	{
+		readbackRing.destroy(allocator);
+	});
 }
 
 void VulkanEngine::draw_background(const VkCommandBuffer cmd) const
@@ -554,28 +1395,224 @@ void VulkanEngine::draw_background(const VkCommandBuffer cmd) const
 	//
 	//vkCmdClearColorImage(cmd, drawImage.image, VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &clearRange);
 
+	dispatch_gradient(cmd, gradientPipeline, gradientWorkgroup, renderExtent);
+}
+
+void VulkanEngine::dispatch_gradient(const VkCommandBuffer cmd, const VkPipeline pipeline, const WorkgroupSize size,
+                                     const VkExtent2D extent) const
+{
 	vkCmdBindPipeline(
 		cmd,
 		VK_PIPELINE_BIND_POINT_COMPUTE,
-		gradientPipeline);
+		pipeline);
 
-	vkCmdBindDescriptorSets(
+	struct BackgroundPushConstants
+	{
+		uint32_t outputImage;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	const BackgroundPushConstants pushConstants{ drawImageIndex , extent.width , extent.height };
+
+	vkCmdPushConstants(
 		cmd,
-		VK_PIPELINE_BIND_POINT_COMPUTE,
-		gradientPipelineLayout,
+		bindless.pipelineLayout,
+		VK_SHADER_STAGE_ALL,
 		0,
-		1,
-		&drawImageDescriptors,
-		0,
-		nullptr);
+		sizeof(pushConstants),
+		&pushConstants);
 
 	vkCmdDispatch(
 		cmd,
-		ceil_divide<uint32_t>(drawImage.imageExtent.width, 16),
-		ceil_divide<uint32_t>(drawImage.imageExtent.height, 16),
+		ceil_divide(extent.width, size.x),
+		ceil_divide(extent.height, size.y),
 		1);
 }
 
+void VulkanEngine::draw_imgui(const VkCommandBuffer cmd, const VkImageView targetImageView) const
+{
+	ImDrawData* drawData = ImGui::GetDrawData();
+	if (drawData == nullptr)
+	{
+		return;
+	}
+
+	VkRenderingAttachmentInfo colorAttachment = vkinit::attachment_info(
+		targetImageView, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	const VkRenderingInfo renderInfo = vkinit::rendering_info(swapchainExtent, &colorAttachment, nullptr);
+
+	vkCmdBeginRendering(cmd, &renderInfo);
+	ImGui_ImplVulkan_RenderDrawData(drawData, cmd);
+	vkCmdEndRendering(cmd);
+}
+
+void VulkanEngine::draw_geometry(const VkCommandBuffer cmd, const bool gpuDrivenFrame)
+{
+	// the meshes can be drawn once their uploads have been acquired on this queue
+	const bool resident = !gpuDrivenFrame && std::all_of(testMeshes.begin(), testMeshes.end(), [&](const auto& mesh)
+	{
+		return uploads.is_complete(mesh->uploadTicket);
+	});
+
+	// culled instancing draws a handful of batches straight into the frame, the per draw path goes through secondaries
+	const bool instanced = resident && cpuCulling;
+	std::span<const VkCommandBuffer> secondaries;
+	if (instanced)
+	{
+		cpuCuller.cull(allocator, sceneViewProj, frameNumber % framesInFlight, parallelRecording ? &jobs : nullptr);
+	}
+	else if (resident)
+	{
+		PROFILE_ZONE("record geometry");
+		secondaries = record_geometry(frameNumber % framesInFlight, renderExtent, parallelRecording);
+	}
+
+	VkRenderingAttachmentInfo colorAttachment = vkinit::attachment_info(
+		drawImage.imageView, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+	// reverse z clears to the far plane at 0. nothing reads the depth after the pass.
+	VkClearValue depthClear{};
+	depthClear.depthStencil.depth = 0.f;
+	VkRenderingAttachmentInfo depthAttachment = vkinit::attachment_info(
+		depthImage.imageView, &depthClear, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+	VkRenderingInfo renderInfo = vkinit::rendering_info(renderExtent, &colorAttachment, &depthAttachment);
+	if (!secondaries.empty())
+	{
+		renderInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+	}
+
+	vkCmdBeginRendering(cmd, &renderInfo);
+
+	if (gpuDrivenFrame)
+	{
+		PROFILE_ZONE("record gpu driven draws");
+		gpuScene.record_draws(cmd, bindless.pipelineLayout, sceneViewProj, renderExtent);
+	}
+	else if (instanced)
+	{
+		cpuCuller.record_draws(cmd, bindless.pipelineLayout, sceneViewProj, renderExtent);
+	}
+	else if (!secondaries.empty())
+	{
+		vkCmdExecuteCommands(cmd, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+	}
+
+	vkCmdEndRendering(cmd);
+}
+
+std::span<const VkCommandBuffer> VulkanEngine::record_geometry(uint32_t frameSlot, VkExtent2D extent, bool parallel)
+{
+	sort_geometry();
+
+	const size_t batchCount = (sceneDraws.size() + drawsPerSecondary - 1) / drawsPerSecondary;
+	geometrySecondaries.resize(batchCount);
+
+	// whichever thread records a batch, it lands in the batch's place, so the draw order is kept
+	const auto record_batches = [&](size_t begin, size_t end)
+	{
+		for (size_t batch = begin; batch < end; batch++)
+		{
+			const size_t firstDraw = batch * drawsPerSecondary;
+			const size_t lastDraw = std::min(sceneDraws.size(), firstDraw + drawsPerSecondary);
+			geometrySecondaries[batch] = record_geometry_batch(frameSlot, extent, firstDraw, lastDraw);
+		}
+	};
+
+	if (parallel)
+	{
+		jobs.parallel_for(batchCount, 1, record_batches);
+	}
+	else
+	{
+		record_batches(0, batchCount);
+	}
+
+	return geometrySecondaries;
+}
+
+void VulkanEngine::sort_geometry()
+{
+	PROFILE_ZONE("sort geometry");
+	const auto start = std::chrono::steady_clock::now();
+
+	// one opaque pass and pipeline for now. front to back within a mesh, so early depth rejects more.
+	geometryQueue.clear();
+	for (uint32_t i = 0; i < static_cast<uint32_t>(sceneDraws.size()); i++)
+	{
+		const MeshDraw& draw = sceneDraws[i];
+		const float depth = -(sceneView * draw.transform[3]).z;
+		geometryQueue.push(DrawSortKey::pack(0, 0, draw.material, draw.mesh, depth), i);
+	}
+	geometryQueue.sort();
+
+	const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	geometryQueue.record_stats(drawsPerSecondary, ms);
+}
+
+VkCommandBuffer VulkanEngine::record_geometry_batch(uint32_t frameSlot, VkExtent2D extent, size_t begin, size_t end)
+{
+	PROFILE_ZONE("record geometry batch");
+
+	const VkCommandBuffer cmd = secondaryPools.allocate(device, frameSlot, JobSystem::thread_index());
+
+	const vkinit::SecondaryRenderingInheritance inheritance(&drawImage.imageFormat, 1, depthImage.imageFormat);
+	VK_CHECK(vkBeginCommandBuffer(cmd, &inheritance.begin));
+
+	// only the attachments carry over from the primary, all other state starts unset
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipeline);
+	bindless.bind(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+	VkViewport viewport{};
+	viewport.x = 0.f;
+	viewport.y = 0.f;
+	viewport.width = static_cast<float>(extent.width);
+	viewport.height = static_cast<float>(extent.height);
+	viewport.minDepth = 0.f;
+	viewport.maxDepth = 1.f;
+	vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+	const VkRect2D scissor{ VkOffset2D{ 0 , 0 } , extent };
+	vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+	struct MeshPushConstants
+	{
+		glm::mat4 worldViewProj;
+		VkDeviceAddress vertexBuffer;
+	};
+
+	// every scene draw uses the mesh pipeline, so the sorted order only saves index buffer binds here
+	const std::span<const uint32_t> order = geometryQueue.order();
+	const GPUMeshBuffers* boundMesh = nullptr;
+	for (size_t i = begin; i < end; i++)
+	{
+		const MeshDraw& draw = sceneDraws[order[i]];
+
+		if (draw.meshBuffers != boundMesh)
+		{
+			vkCmdBindIndexBuffer(cmd, draw.meshBuffers->indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+			boundMesh = draw.meshBuffers;
+		}
+
+		const MeshPushConstants pushConstants{ sceneViewProj * draw.transform , draw.meshBuffers->vertexBufferAddress };
+
+		vkCmdPushConstants(
+			cmd,
+			bindless.pipelineLayout,
+			VK_SHADER_STAGE_ALL,
+			0,
+			sizeof(pushConstants),
+			&pushConstants);
+
+		vkCmdDrawIndexed(cmd, draw.indexCount, 1, draw.firstIndex, 0, 0);
+	}
+
+	VK_CHECK(vkEndCommandBuffer(cmd));
+	return cmd;
+}
+
 void VulkanEngine::create_swapchain(uint32_t width, uint32_t height)
 {
 	vkb::SwapchainBuilder swapchainBuilder{ chosenGpu , device , surface };
@@ -584,7 +1621,6 @@ void VulkanEngine::create_swapchain(uint32_t width, uint32_t height)
 	                    .use_default_format_selection()
 	                    .set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR)
 	                    .set_desired_extent(width, height)
-	                    .add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
 	                    .build()
 	                    .value();
 
@@ -3,24 +3,59 @@
 
 #pragma once
 
+#include <memory>
+#include <span>
+#include <string>
 #include <vector>
 #include <vk_types.h>
 
-#include "vk_descriptors.h"
+#include <glm/mat4x4.hpp>
+
+#include "vk_assetpack.h"
+#include "vk_bindless.h"
+#include "vk_commands.h"
+#include "vk_cpu_cull.h"
+#include "vk_gpu_profiler.h"
+#include "vk_gpu_scene.h"
+#include "vk_jobs.h"
+#include "vk_loader.h"
 #include "vk_mem_alloc.h"
+#include "vk_pipelines.h"
+#include "vk_present.h"
+#include "vk_readback.h"
+#include "vk_render_queue.h"
+#include "vk_rendergraph.h"
+#include "vk_resolution.h"
+#include "vk_timeline.h"
+#include "vk_transforms.h"
+#include "vk_upload.h"
+#include "vk_workgroup_tuner.h"
 
 struct FrameData
 {
 	VkCommandPool commandPool;
 	VkCommandBuffer mainCommandBuffer;
 
+	//binary, swapchain acquire and present cannot use the timeline
 	VkSemaphore swapchainSemaphore, renderSemaphore;
-	VkFence renderFence;
 
 	DeletionQueue frameDeletionQueue;
 };
 
-constexpr int FRAME_OVERLAP = 2;
+//frames in flight can be changed at runtime up to this many
+constexpr int MAX_FRAMES_IN_FLIGHT = 4;
+
+//one indexed draw of a mesh surface, the scene is a flat list of them
+struct MeshDraw
+{
+	const GPUMeshBuffers* meshBuffers;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	glm::mat4 transform;
+	//ids for the sort key, the mesh's place in testMeshes and the surface material's among the scene's materials
+	uint32_t mesh;
+	uint32_t material;
+};
 
 class VulkanEngine
 {
@@ -30,11 +65,26 @@ public:
 
 	VkExtent2D windowExtent{ 1700 , 900 };
 
+	//headless mode renders offscreen without SDL or a swapchain
+	bool headless{ false };
+	int headlessFrameCount{ 300 };
+	//empty means frames are not read back
+	std::string captureDirectory;
+	int captureInterval{ 1 };
+
+	//1 is lowest latency, more lets the cpu run further ahead of the gpu
+	int framesInFlight{ 2 };
+
 	struct SDL_Window* window{ nullptr };
 
 	VkInstance instance;
 	VkDebugUtilsMessengerEXT debugMessenger;
 	VkPhysicalDevice chosenGpu;
+	VkPhysicalDeviceProperties gpuProperties;
+	//required features plus the optional ones the gpu has
+	VkPhysicalDeviceFeatures gpuFeatures;
+	//VK_EXT_calibrated_timestamps is enabled
+	bool calibratedTimestamps{ false };
 	VkDevice device;
 	VkSurfaceKHR surface;
 	VkSwapchainKHR swapchain;
@@ -44,12 +94,27 @@ public:
 	std::vector<VkImageView> swapchainImageViews;
 	VkExtent2D swapchainExtent;
 
-	FrameData frames[FRAME_OVERLAP];
+	FrameData frames[MAX_FRAMES_IN_FLIGHT];
 	FrameData& get_current_frame();
 
+	//frame N signals N + 1 once it has finished on the gpu
+	FrameTimeline frameTimeline;
+
 	VkQueue graphicsQueue;
 	uint32_t graphicsQueueFamily;
 
+	//a queue family without graphics if the device has one, the graphics queue otherwise
+	VkQueue transferQueue;
+	uint32_t transferQueueFamily;
+
+	//streams buffers and images in through a staging ring, submitted once per frame
+	UploadManager uploads;
+
+	//built by the AssetPack target, stays mapped so uploads can read straight from it
+	AssetPack assetPack;
+
+	std::vector<std::shared_ptr<MeshAsset>> testMeshes;
+
 	DeletionQueue mainDeletionQueue;
 
 	VmaAllocator allocator;
@@ -57,13 +122,77 @@ public:
 	AllocatedImage drawImage;
 	//VkExtent2D drawImageExtent;
 
-	DescriptorAllocator globalDescriptorAllocator;
+	//the draw image holds the window extent at the max scale, frames render into its top left corner
+	DynamicResolution dynamicResolution;
+	VkExtent2D renderExtent{};
+
+	//tonemaps and upscales the draw image into the swapchain image
+	PresentPass presentPass;
+
+	//same extent as the draw image, reverse z
+	AllocatedImage depthImage;
+
+	//a grid of copies of the test meshes, a node each under one root node
+	int sceneDrawCount{ 10000 };
+	TransformHierarchy sceneTransforms;
+	std::vector<MeshDraw> sceneDraws;
+	glm::mat4 sceneView{ 1.f };
+	glm::mat4 sceneProjection{ 1.f };
+	glm::mat4 sceneViewProj{ 1.f };
+
+	//the same grid, culled and drawn from the gpu. off records sceneDraws on the cpu instead.
+	GpuScene gpuScene;
+	bool gpuDriven{ true };
+
+	//the cpu path culls the grid on the job system and draws each mesh instanced. off records every draw.
+	InstanceCuller cpuCuller;
+	bool cpuCulling{ true };
 
-	VkDescriptorSet drawImageDescriptors;
-	VkDescriptorSetLayout drawImageDescriptorLayout;
+	//the geometry pass is recorded into secondaries, a batch of draws each, on the job system
+	SecondaryCommandPools secondaryPools;
+	std::vector<VkCommandBuffer> geometrySecondaries;
+	uint32_t drawsPerSecondary{ 256 };
+	bool parallelRecording{ true };
+	//sceneDraws by sort key, rebuilt every frame they are recorded
+	RenderQueue geometryQueue;
 
-	VkPipeline gradientPipeline;
-	VkPipelineLayout gradientPipelineLayout;
+	//every shader visible resource lives in here, passes push indices into it
+	BindlessHeap bindless;
+	uint32_t drawImageIndex{ BINDLESS_INVALID_INDEX };
+
+	JobSystem jobs;
+
+	PipelineCache pipelineCache;
+	ShaderModuleCache shaderModules;
+	PipelineBuildQueue pipelineBuilds;
+	std::string pipelineCachePath{ "pipeline_cache.bin" };
+
+	//compute workgroup sizes picked per device, tuned on the first run of a device and read back after
+	WorkgroupTuner workgroupTuner;
+	std::string workgroupSizesPath{ "workgroup_sizes.txt" };
+	//tunes again even when this device already has sizes stored
+	bool retuneWorkgroups{ false };
+
+	//resolved from its build on first use
+	std::shared_future<VkPipeline> gradientPipelineBuild;
+	VkPipeline gradientPipeline{ VK_NULL_HANDLE };
+	WorkgroupSize gradientWorkgroup{ 16 , 16 , 1 };
+	std::shared_future<VkPipeline> meshPipelineBuild;
+	VkPipeline meshPipeline{ VK_NULL_HANDLE };
+
+	//headless readback
+	ReadbackRing readbackRing;
+	FrameWriter frameWriter;
+
+	//the frame's passes and the barriers between them, rebuilt every frame
+	RenderGraph renderGraph;
+
+	//timestamps of the passes in the frame command buffer
+	GpuProfiler gpuProfiler;
+	//empty means no report, .json for per scope averages, anything else a csv per frame
+	std::string gpuProfilePath;
+	//empty means no chrome trace of the cpu zones (and calibrated gpu scopes) at shutdown
+	std::string cpuTracePath;
 
 	//imgui
 	VkFence immFence;
@@ -82,20 +211,69 @@ public:
 	//run main loop
 	void run();
 
-	void immediate_submit(std::function<void(VkCommandBuffer cmd)>&& function) const;
+	//waits up to timeoutNs for the gpu to finish, a timeout is fatal
+	void immediate_submit(std::function<void(VkCommandBuffer cmd)>&& function, uint64_t timeoutNs = 1000000000) const;
+
+	AllocatedBuffer create_buffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage) const;
+	void destroy_buffer(const AllocatedBuffer& buffer) const;
+
+	AllocatedImage create_image(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, uint32_t mipLevels = 1) const;
+	void destroy_image(const AllocatedImage& image) const;
+
+	//sampled, optimally tiled images of the format can be created and filled by copies
+	bool supports_texture_format(VkFormat format) const;
+
+	//creates the device local buffers and queues their copies. the spans are read until outTicket completes
+	GPUMeshBuffers upload_mesh(std::span<const uint32_t> indices, std::span<const Vertex> vertices,
+	                           UploadTicket& outTicket);
+	//creates a sampled image with one mip per level and queues their copies, same lifetime rule as upload_mesh
+	AllocatedImage upload_texture(VkFormat format, VkExtent2D extent, std::span<const std::span<const uint8_t>> levels,
+	                              UploadTicket& outTicket);
+
+	//from the asset pack when it has the mesh, parsed from assets/<name>.obj otherwise. freed at cleanup
+	std::shared_ptr<MeshAsset> load_mesh(const std::string& name);
+
+	//waits for the frames already submitted, then changes how many may be in flight (clamped to 1..MAX_FRAMES_IN_FLIGHT)
+	void set_frames_in_flight(int count);
+
+	//records the scene into secondaries from the slot's pools in sort key order, split across the job system when
+	//parallel is set. the secondaries are valid until the slot is reset and must run inside the geometry pass's rendering.
+	std::span<const VkCommandBuffer> record_geometry(uint32_t frameSlot, VkExtent2D extent, bool parallel);
 
 private:
 	void init_vulkan();
 	void init_swapchain();
 	void init_commands();
 	void init_sync_structures();
+	void init_uploads();
 	void init_descriptors();
 	void init_pipelines();
 	void init_background_pipelines();
+	void init_present_pipelines();
+	void init_mesh_pipelines();
 	void init_imgui();
+	void init_default_data();
+	void init_readback();
+	void init_scene();
+	//simplifies the test meshes into lod chains, a mesh per job
+	void build_mesh_lods();
+	void init_profiling();
 
 	void create_swapchain(uint32_t width, uint32_t height);
 	void destroy_swapchain();
 
 	void draw_background(VkCommandBuffer cmd) const;
+	//the imgui draw data of the frame over the swapchain image, its contents are kept
+	void draw_imgui(VkCommandBuffer cmd, VkImageView targetImageView) const;
+	//the gradient over extent with a pipeline built for size, for the frame and the workgroup tuner
+	void dispatch_gradient(VkCommandBuffer cmd, VkPipeline pipeline, WorkgroupSize size, VkExtent2D extent) const;
+	void draw_geometry(VkCommandBuffer cmd, bool gpuDrivenFrame);
+	//builds the sort keys of sceneDraws from the current view and sorts them into geometryQueue
+	void sort_geometry();
+	VkCommandBuffer record_geometry_batch(uint32_t frameSlot, VkExtent2D extent, size_t begin, size_t end);
+
+	bool is_capture_frame(int frame) const;
+	void collect_readback(int completedFrame);
+
+	void run_headless();
 };
@@ -0,0 +1,501 @@
+#include "vk_gpu_profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <imgui.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+#include "vk_cpu_profiler.h"
+
+namespace
+{
+	constexpr uint32_t INVALID_SCOPE = ~0u;
+
+	// results come back as value, availability pairs
+	constexpr VkQueryResultFlags RESULT_FLAGS = VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT;
+
+	constexpr uint64_t RECALIBRATION_NS = 1000000000;
+
+	// the clock steady_clock reads, which is what vkprofile::now_ns returns
+#ifdef _WIN32
+	constexpr VkTimeDomainEXT HOST_TIME_DOMAIN = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+
+	uint64_t host_ticks_to_ns(uint64_t ticks)
+	{
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		const auto perSecond = static_cast<uint64_t>(frequency.QuadPart);
+		// split like steady_clock does, so large counters do not overflow
+		return ticks / perSecond * 1000000000 + ticks % perSecond * 1000000000 / perSecond;
+	}
+#else
+	constexpr VkTimeDomainEXT HOST_TIME_DOMAIN = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+
+	uint64_t host_ticks_to_ns(uint64_t ticks)
+	{
+		return ticks;
+	}
+#endif
+
+	VkQueryPool create_query_pool(VkDevice device, VkQueryType type, uint32_t count,
+	                              VkQueryPipelineStatisticFlags statistics)
+	{
+		VkQueryPoolCreateInfo info{};
+		info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		info.queryType = type;
+		info.queryCount = count;
+		info.pipelineStatistics = statistics;
+
+		VkQueryPool pool;
+		VK_CHECK(vkCreateQueryPool(device, &info, nullptr, &pool));
+		return pool;
+	}
+}
+
+void GpuProfiler::init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t frameSlots,
+                       bool pipelineStatistics)
+{
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+
+	const uint32_t validBits = families[queueFamily].timestampValidBits;
+	if (validBits == 0)
+	{
+		std::cout << "GPU profiler: the graphics queue has no timestamps, disabled" << std::endl;
+		return;
+	}
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	timestampPeriod = properties.limits.timestampPeriod;
+	timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+	timestampBits = validBits;
+	statisticsEnabled = pipelineStatistics;
+
+	slots.resize(frameSlots);
+	for (FrameSlot& slot : slots)
+	{
+		slot.timestamps = create_query_pool(device, VK_QUERY_TYPE_TIMESTAMP, MAX_GPU_SCOPES * 2, 0);
+		if (statisticsEnabled)
+		{
+			slot.statistics = create_query_pool(device, VK_QUERY_TYPE_PIPELINE_STATISTICS, MAX_GPU_SCOPES,
+			                                    VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT);
+		}
+		slot.scopes.reserve(MAX_GPU_SCOPES);
+	}
+
+	queryData.resize(MAX_GPU_SCOPES * 4);
+	enabled = true;
+}
+
+void GpuProfiler::destroy(VkDevice device)
+{
+	for (FrameSlot& slot : slots)
+	{
+		vkDestroyQueryPool(device, slot.timestamps, nullptr);
+		if (slot.statistics != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(device, slot.statistics, nullptr);
+		}
+	}
+	slots.clear();
+	currentSlot = nullptr;
+	enabled = false;
+}
+
+bool GpuProfiler::enable_calibration(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device)
+{
+	if (!enabled)
+	{
+		return false;
+	}
+
+	const auto getTimeDomains = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(
+		vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+	const auto getTimestamps = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(
+		vkGetDeviceProcAddr(device, "vkGetCalibratedTimestampsEXT"));
+	if (getTimeDomains == nullptr || getTimestamps == nullptr)
+	{
+		return false;
+	}
+
+	uint32_t domainCount = 0;
+	VK_CHECK(getTimeDomains(physicalDevice, &domainCount, nullptr));
+	std::vector<VkTimeDomainEXT> domains(domainCount);
+	VK_CHECK(getTimeDomains(physicalDevice, &domainCount, domains.data()));
+
+	const auto supports = [&](VkTimeDomainEXT domain)
+	{
+		return std::find(domains.begin(), domains.end(), domain) != domains.end();
+	};
+
+	if (!supports(VK_TIME_DOMAIN_DEVICE_EXT) || !supports(HOST_TIME_DOMAIN))
+	{
+		std::cout << "GPU profiler: cannot calibrate against the cpu clock, gpu scopes stay out of the cpu trace"
+			<< std::endl;
+		return false;
+	}
+
+	getCalibratedTimestamps = getTimestamps;
+	hostDomain = HOST_TIME_DOMAIN;
+	calibrate(device);
+	return true;
+}
+
+void GpuProfiler::calibrate(VkDevice device)
+{
+	VkCalibratedTimestampInfoEXT infos[2]{};
+	infos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+	infos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+	infos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+	infos[1].timeDomain = hostDomain;
+
+	uint64_t timestamps[2];
+	uint64_t maxDeviation;
+	VK_CHECK(getCalibratedTimestamps(device, 2, infos, timestamps, &maxDeviation));
+
+	calibrationTicks = timestamps[0];
+	calibrationHostNs = host_ticks_to_ns(timestamps[1]);
+}
+
+uint64_t GpuProfiler::to_host_ns(uint64_t ticks) const
+{
+	// sign extend the masked difference, ticks from before the calibration come out negative
+	const uint32_t shift = 64 - timestampBits;
+	const int64_t deltaTicks = static_cast<int64_t>(((ticks - calibrationTicks) & timestampMask) << shift) >> shift;
+	return calibrationHostNs + static_cast<int64_t>(static_cast<double>(deltaTicks) * timestampPeriod);
+}
+
+void GpuProfiler::begin_frame(VkDevice device, VkCommandBuffer cmd, uint64_t frame)
+{
+	if (!enabled)
+	{
+		return;
+	}
+
+	FrameSlot& slot = slots[frame % slots.size()];
+	if (slot.pending)
+	{
+		collect(device, slot);
+	}
+
+	vkCmdResetQueryPool(cmd, slot.timestamps, 0, MAX_GPU_SCOPES * 2);
+	if (slot.statistics != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(cmd, slot.statistics, 0, MAX_GPU_SCOPES);
+	}
+
+	slot.frame = frame;
+	slot.pending = true;
+	slot.scopes.clear();
+
+	currentSlot = &slot;
+	depth = 0;
+	statisticsOpen = false;
+}
+
+uint32_t GpuProfiler::begin_scope(VkCommandBuffer cmd, const char* name, bool statistics)
+{
+	if (currentSlot == nullptr || currentSlot->scopes.size() == MAX_GPU_SCOPES)
+	{
+		return INVALID_SCOPE;
+	}
+
+	const auto scope = static_cast<uint32_t>(currentSlot->scopes.size());
+	const bool withStatistics = statistics && statisticsEnabled && !statisticsOpen;
+	currentSlot->scopes.push_back({ name , depth , withStatistics });
+	depth++;
+
+	// all commands: the stamp lands once the work recorded before the scope has finished
+	vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, currentSlot->timestamps, scope * 2);
+
+	if (withStatistics)
+	{
+		vkCmdBeginQuery(cmd, currentSlot->statistics, scope, 0);
+		statisticsOpen = true;
+	}
+
+	return scope;
+}
+
+void GpuProfiler::end_scope(VkCommandBuffer cmd, uint32_t scope)
+{
+	if (currentSlot == nullptr || scope == INVALID_SCOPE)
+	{
+		return;
+	}
+
+	if (currentSlot->scopes[scope].statistics)
+	{
+		vkCmdEndQuery(cmd, currentSlot->statistics, scope);
+		statisticsOpen = false;
+	}
+
+	vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, currentSlot->timestamps, scope * 2 + 1);
+	depth--;
+}
+
+void GpuProfiler::collect_all(VkDevice device)
+{
+	if (!enabled)
+	{
+		return;
+	}
+
+	// oldest first, so the latest results end up being the newest frame
+	std::vector<FrameSlot*> pending;
+	for (FrameSlot& slot : slots)
+	{
+		if (slot.pending)
+		{
+			pending.push_back(&slot);
+		}
+	}
+	std::sort(pending.begin(), pending.end(), [](const FrameSlot* a, const FrameSlot* b) { return a->frame < b->frame; });
+
+	for (FrameSlot* slot : pending)
+	{
+		collect(device, *slot);
+	}
+}
+
+void GpuProfiler::collect(VkDevice device, FrameSlot& slot)
+{
+	slot.pending = false;
+
+	const auto scopeCount = static_cast<uint32_t>(slot.scopes.size());
+	if (scopeCount == 0)
+	{
+		return;
+	}
+
+	const VkResult result = vkGetQueryPoolResults(device, slot.timestamps, 0, scopeCount * 2,
+		scopeCount * 2 * 2 * sizeof(uint64_t), queryData.data(), 2 * sizeof(uint64_t), RESULT_FLAGS);
+	if (result != VK_NOT_READY)
+	{
+		VK_CHECK(result);
+	}
+
+	latestResults.clear();
+
+	for (uint32_t scope = 0; scope < scopeCount; scope++)
+	{
+		const uint64_t* begin = &queryData[scope * 4];
+		const uint64_t* end = &queryData[scope * 4 + 2];
+
+		// a scope left open or a query that never ran, drop the frame instead of guessing
+		if (begin[1] == 0 || end[1] == 0)
+		{
+			latestResults.clear();
+			droppedFrames++;
+			return;
+		}
+
+		GpuScopeResult scopeResult{};
+		scopeResult.name = slot.scopes[scope].name;
+		scopeResult.depth = slot.scopes[scope].depth;
+		scopeResult.milliseconds = static_cast<double>((end[0] - begin[0]) & timestampMask) * timestampPeriod / 1e6;
+
+		if (slot.scopes[scope].statistics)
+		{
+			uint64_t invocations[2] = {};
+			const VkResult statisticsResult = vkGetQueryPoolResults(device, slot.statistics, scope, 1,
+				sizeof(invocations), invocations, sizeof(invocations), RESULT_FLAGS);
+			if (statisticsResult != VK_NOT_READY)
+			{
+				VK_CHECK(statisticsResult);
+			}
+
+			scopeResult.hasStatistics = invocations[1] != 0;
+			scopeResult.computeInvocations = invocations[0];
+		}
+
+		latestResults.push_back(scopeResult);
+	}
+
+	latestFrame = slot.frame;
+
+	if (getCalibratedTimestamps != nullptr)
+	{
+		if (vkprofile::now_ns() - calibrationHostNs > RECALIBRATION_NS)
+		{
+			calibrate(device);
+		}
+
+		for (uint32_t scope = 0; scope < scopeCount; scope++)
+		{
+			vkprofile::record_gpu_zone(slot.scopes[scope].name, to_host_ns(queryData[scope * 4]),
+			                           to_host_ns(queryData[scope * 4 + 2]));
+		}
+	}
+
+	if (recordHistory)
+	{
+		history.push_back({ slot.frame , historyResults.size() , latestResults.size() });
+		historyResults.insert(historyResults.end(), latestResults.begin(), latestResults.end());
+	}
+
+	for (const GpuScopeResult& scopeResult : latestResults)
+	{
+		accumulate(scopeResult);
+	}
+}
+
+void GpuProfiler::accumulate(const GpuScopeResult& result)
+{
+	auto it = std::find_if(stats.begin(), stats.end(), [&](const ScopeStats& scope)
+	{
+		return scope.depth == result.depth && strcmp(scope.name, result.name) == 0;
+	});
+
+	if (it == stats.end())
+	{
+		stats.push_back({ result.name , result.depth });
+		it = stats.end() - 1;
+		it->minMs = result.milliseconds;
+		it->maxMs = result.milliseconds;
+		it->smoothedMs = result.milliseconds;
+	}
+
+	it->frames++;
+	it->totalMs += result.milliseconds;
+	it->minMs = std::min(it->minMs, result.milliseconds);
+	it->maxMs = std::max(it->maxMs, result.milliseconds);
+	it->smoothedMs += (result.milliseconds - it->smoothedMs) * 0.05;
+	it->totalInvocations += result.computeInvocations;
+}
+
+void GpuProfiler::draw_panel() const
+{
+	if (!ImGui::Begin("GPU profiler"))
+	{
+		ImGui::End();
+		return;
+	}
+
+	if (!enabled)
+	{
+		ImGui::TextUnformatted("Timestamps are not supported on the graphics queue");
+		ImGui::End();
+		return;
+	}
+
+	ImGui::Text("Frame %llu, %llu dropped", static_cast<unsigned long long>(latestFrame),
+	            static_cast<unsigned long long>(droppedFrames));
+	ImGui::Separator();
+
+	ImGui::Columns(4, "gpuScopes");
+	ImGui::TextUnformatted("scope");
+	ImGui::NextColumn();
+	ImGui::TextUnformatted("ms");
+	ImGui::NextColumn();
+	ImGui::TextUnformatted("average ms");
+	ImGui::NextColumn();
+	ImGui::TextUnformatted("compute invocations");
+	ImGui::NextColumn();
+	ImGui::Separator();
+
+	for (const GpuScopeResult& result : latestResults)
+	{
+		const auto scope = std::find_if(stats.begin(), stats.end(), [&](const ScopeStats& scopeStats)
+		{
+			return scopeStats.depth == result.depth && strcmp(scopeStats.name, result.name) == 0;
+		});
+
+		ImGui::Text("%*s%s", static_cast<int>(result.depth * 2), "", result.name);
+		ImGui::NextColumn();
+		ImGui::Text("%.3f", result.milliseconds);
+		ImGui::NextColumn();
+		ImGui::Text("%.3f", scope != stats.end() ? scope->smoothedMs : result.milliseconds);
+		ImGui::NextColumn();
+		if (result.hasStatistics)
+		{
+			ImGui::Text("%llu", static_cast<unsigned long long>(result.computeInvocations));
+		}
+		ImGui::NextColumn();
+	}
+
+	ImGui::Columns(1);
+	ImGui::End();
+}
+
+void GpuProfiler::print_summary() const
+{
+	if (!enabled || stats.empty())
+	{
+		return;
+	}
+
+	std::cout << "GPU profiler: " << stats.front().frames << " frames, " << droppedFrames << " dropped" << std::endl;
+
+	for (const ScopeStats& scope : stats)
+	{
+		std::cout << "  " << std::string(scope.depth * 2, ' ') << scope.name << ": " << scope.totalMs / scope.frames
+			<< " ms (min " << scope.minMs << ", max " << scope.maxMs << ")";
+		if (scope.totalInvocations > 0)
+		{
+			std::cout << ", " << scope.totalInvocations / scope.frames << " compute invocations";
+		}
+		std::cout << std::endl;
+	}
+}
+
+bool GpuProfiler::write_report(const std::filesystem::path& path) const
+{
+	std::ofstream out(path, std::ios::trunc);
+	if (!out.is_open())
+	{
+		std::cout << "GPU profiler: cannot write " << path.string() << std::endl;
+		return false;
+	}
+
+	// scope names are literals from the engine, nothing in them needs escaping
+	if (path.extension() == ".json")
+	{
+		out << "{\n";
+		out << "  \"timestampPeriodNs\": " << timestampPeriod << ",\n";
+		out << "  \"droppedFrames\": " << droppedFrames << ",\n";
+		out << "  \"scopes\": [";
+
+		for (size_t i = 0; i < stats.size(); i++)
+		{
+			const ScopeStats& scope = stats[i];
+			out << (i == 0 ? "\n" : ",\n");
+			out << "    { \"name\": \"" << scope.name << "\", \"depth\": " << scope.depth
+				<< ", \"frames\": " << scope.frames
+				<< ", \"meanMs\": " << scope.totalMs / scope.frames
+				<< ", \"minMs\": " << scope.minMs
+				<< ", \"maxMs\": " << scope.maxMs
+				<< ", \"computeInvocations\": " << scope.totalInvocations / scope.frames << " }";
+		}
+
+		out << "\n  ]\n}\n";
+	}
+	else
+	{
+		out << "frame,scope,depth,gpu_ms,compute_invocations\n";
+		for (const HistoryFrame& frame : history)
+		{
+			for (size_t i = frame.first; i < frame.first + frame.count; i++)
+			{
+				const GpuScopeResult& result = historyResults[i];
+				out << frame.frame << "," << result.name << "," << result.depth << "," << result.milliseconds << ","
+					<< result.computeInvocations << "\n";
+			}
+		}
+	}
+
+	return out.good();
+}
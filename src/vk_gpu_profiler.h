@@ -0,0 +1,135 @@
+#pragma once
+
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include "vk_types.h"
+
+constexpr uint32_t MAX_GPU_SCOPES = 64;
+
+struct GpuScopeResult
+{
+	// the literal passed to begin_scope
+	const char* name;
+	uint32_t depth;
+	double milliseconds;
+	// only scopes opened with statistics count invocations
+	bool hasStatistics;
+	uint64_t computeInvocations;
+};
+
+// gpu time of nested scopes in the frame command buffer, from timestamp queries.
+// every frame slot owns its query pools and is read back when the slot comes around again.
+// by then the frame timeline has already waited for the frame that used it, so reading never blocks.
+class GpuProfiler
+{
+public:
+	// disabled when the queue family cannot write timestamps
+	void init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t frameSlots,
+	          bool pipelineStatistics);
+	void destroy(VkDevice device);
+
+	bool is_enabled() const { return enabled; }
+
+	// needs VK_EXT_calibrated_timestamps enabled on the device. scopes then also go into the
+	// cpu profiler trace, on the cpu clock. false if the driver cannot calibrate against it.
+	bool enable_calibration(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device);
+
+	// collects the results the slot holds from its last frame, then resets its queries.
+	// record right after vkBeginCommandBuffer.
+	void begin_frame(VkDevice device, VkCommandBuffer cmd, uint64_t frame);
+
+	// scopes nest and must end in reverse order. names must outlive the profiler.
+	// statistics also counts compute invocations. pipeline statistics queries cannot nest,
+	// so only one statistics scope can be open at a time.
+	uint32_t begin_scope(VkCommandBuffer cmd, const char* name, bool statistics = false);
+	void end_scope(VkCommandBuffer cmd, uint32_t scope);
+
+	// reads every slot that still holds results, the device must be idle
+	void collect_all(VkDevice device);
+
+	// the newest frame with results, scopes in the order they were opened
+	std::span<const GpuScopeResult> latest_results() const { return latestResults; }
+	uint64_t latest_frame() const { return latestFrame; }
+
+	// keep the results of every frame for write_report
+	bool recordHistory{ false };
+
+	// imgui window with the latest and average time of each scope
+	void draw_panel() const;
+	void print_summary() const;
+	// .json writes per scope aggregates, anything else a csv with one row per scope and frame
+	bool write_report(const std::filesystem::path& path) const;
+
+private:
+	struct OpenScope
+	{
+		const char* name;
+		uint32_t depth;
+		bool statistics;
+	};
+
+	struct FrameSlot
+	{
+		VkQueryPool timestamps{ VK_NULL_HANDLE };
+		VkQueryPool statistics{ VK_NULL_HANDLE };
+		uint64_t frame{ 0 };
+		bool pending{ false };
+		std::vector<OpenScope> scopes;
+	};
+
+	struct ScopeStats
+	{
+		const char* name;
+		uint32_t depth;
+		uint64_t frames{ 0 };
+		double totalMs{ 0.0 };
+		double minMs{ 0.0 };
+		double maxMs{ 0.0 };
+		// exponential moving average, steadier to read than the latest frame
+		double smoothedMs{ 0.0 };
+		uint64_t totalInvocations{ 0 };
+	};
+
+	struct HistoryFrame
+	{
+		uint64_t frame;
+		size_t first;
+		size_t count;
+	};
+
+	void collect(VkDevice device, FrameSlot& slot);
+	void accumulate(const GpuScopeResult& result);
+
+	void calibrate(VkDevice device);
+	// gpu ticks to vkprofile::now_ns time, ticks may be before or after the calibration point
+	uint64_t to_host_ns(uint64_t ticks) const;
+
+	bool enabled{ false };
+	bool statisticsEnabled{ false };
+	double timestampPeriod{ 1.0 };
+	uint64_t timestampMask{ ~0ull };
+	uint32_t timestampBits{ 64 };
+
+	// a device and host timestamp taken together, redone every second so the clocks cannot drift apart
+	PFN_vkGetCalibratedTimestampsEXT getCalibratedTimestamps{ nullptr };
+	VkTimeDomainEXT hostDomain{};
+	uint64_t calibrationTicks{ 0 };
+	uint64_t calibrationHostNs{ 0 };
+
+	std::vector<FrameSlot> slots;
+	// query results with their availability words, reused across frames
+	std::vector<uint64_t> queryData;
+	FrameSlot* currentSlot{ nullptr };
+	uint32_t depth{ 0 };
+	bool statisticsOpen{ false };
+
+	std::vector<GpuScopeResult> latestResults;
+	uint64_t latestFrame{ 0 };
+	uint64_t droppedFrames{ 0 };
+
+	std::vector<ScopeStats> stats;
+	std::vector<HistoryFrame> history;
+	std::vector<GpuScopeResult> historyResults;
+};
@@ -0,0 +1,534 @@
+#include "vk_gpu_scene.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+#include <imgui.h>
+
+#include "vk_bindless.h"
+#include "vk_meshopt.h"
+#include "vk_pipelines.h"
+
+namespace
+{
+	constexpr uint32_t CULL_GROUP_SIZE = 64;
+
+	// flags in cull.comp
+	constexpr uint32_t CULL_CLUSTERS = 1;
+
+	// shared by cull.comp and cluster_cull.comp
+	struct CullPushConstants
+	{
+		glm::mat4 viewProj;
+		VkDeviceAddress scene;
+		uint32_t objectCount;
+		// pixels per world unit at distance 1, over the error allowed in pixels. 0 keeps every object at lod 0.
+		float lodScale;
+		glm::vec3 cameraPosition;
+		uint32_t flags;
+		// entries in the cluster work and draw buffers, the passes drop anything past them
+		uint32_t clusterWorkCapacity;
+		uint32_t drawCapacity;
+		// the cluster dispatch wraps into y past this many groups in x
+		uint32_t maxGroupsX;
+	};
+
+	struct DrawPushConstants
+	{
+		glm::mat4 viewProj;
+		VkDeviceAddress vertices;
+		VkDeviceAddress objects;
+	};
+
+	static_assert(sizeof(CullPushConstants) <= BINDLESS_PUSH_CONSTANT_SIZE);
+	static_assert(sizeof(DrawPushConstants) <= BINDLESS_PUSH_CONSTANT_SIZE);
+
+	AllocatedBuffer create_gpu_buffer(VmaAllocator allocator, VkDeviceSize size, VkBufferUsageFlags usage)
+	{
+		VkBufferCreateInfo bufferInfo = { .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+		bufferInfo.pNext = nullptr;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage;
+
+		VmaAllocationCreateInfo allocInfo = {};
+		allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+		AllocatedBuffer buffer{};
+		VK_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &buffer.buffer, &buffer.allocation, &buffer.info));
+		return buffer;
+	}
+
+	VkDeviceAddress buffer_address(VkDevice device, VkBuffer buffer)
+	{
+		VkBufferDeviceAddressInfo addressInfo{};
+		addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+		addressInfo.buffer = buffer;
+		return vkGetBufferDeviceAddress(device, &addressInfo);
+	}
+
+	template <typename T>
+	VkDeviceSize byte_size(const std::vector<T>& data)
+	{
+		return static_cast<VkDeviceSize>(data.size() * sizeof(T));
+	}
+}
+
+uint32_t GpuScene::add_mesh(std::span<const Vertex> meshVertices, std::span<const MeshLod> meshLods)
+{
+	assert(!uploaded && !meshLods.empty());
+
+	GpuMeshInfo mesh{};
+
+	mesh.boundingSphere = vkutil::compute_bounding_sphere(meshVertices);
+
+	mesh.vertexOffset = static_cast<int32_t>(vertices.size());
+	mesh.firstLod = static_cast<uint32_t>(lods.size());
+	mesh.lodCount = std::min(static_cast<uint32_t>(meshLods.size()), MAX_LODS);
+
+	vertices.insert(vertices.end(), meshVertices.begin(), meshVertices.end());
+
+	for (uint32_t i = 0; i < mesh.lodCount; i++)
+	{
+		const MeshLod& lod = meshLods[i];
+		const uint32_t firstIndex = static_cast<uint32_t>(indices.size());
+
+		indices.insert(indices.end(), lod.indices.begin(), lod.indices.end());
+
+		// reorders the lod's triangles so every meshlet is one index range
+		const std::vector<Meshlet> meshlets = vkutil::build_meshlets(
+			meshVertices,
+			std::span(indices).subspan(firstIndex, lod.indices.size()));
+
+		lods.push_back({
+			firstIndex ,
+			static_cast<uint32_t>(lod.indices.size()) ,
+			lod.error ,
+			static_cast<uint32_t>(clusters.size()) ,
+			static_cast<uint32_t>(meshlets.size()) ,
+			{ 0 , 0 , 0 }
+		});
+
+		for (const Meshlet& meshlet : meshlets)
+		{
+			clusters.push_back({
+				meshlet.boundingSphere ,
+				meshlet.coneAxis ,
+				meshlet.coneCutoff ,
+				firstIndex + meshlet.firstIndex ,
+				meshlet.indexCount ,
+				{ 0 , 0 }
+			});
+		}
+	}
+
+	meshes.push_back(mesh);
+	return static_cast<uint32_t>(meshes.size() - 1);
+}
+
+uint32_t GpuScene::add_object(uint32_t meshIndex, const glm::mat4& transform)
+{
+	assert(!uploaded && meshIndex < meshes.size());
+
+	const GpuMeshInfo& mesh = meshes[meshIndex];
+
+	const float scale = std::max({
+		glm::length(glm::vec3(transform[0])) ,
+		glm::length(glm::vec3(transform[1])) ,
+		glm::length(glm::vec3(transform[2]))
+	});
+	const glm::vec3 center = glm::vec3(transform * glm::vec4(glm::vec3(mesh.boundingSphere), 1.f));
+
+	objects.push_back({ transform , glm::vec4(center, mesh.boundingSphere.w * scale) , meshIndex , scale , { 0 , 0 } });
+	return static_cast<uint32_t>(objects.size() - 1);
+}
+
+void GpuScene::upload(VkDevice device, VmaAllocator allocator, UploadManager& uploads, uint32_t frameSlots,
+                      uint32_t maxGroupCountX)
+{
+	maxClusterGroupsX = maxGroupCountX;
+
+	// nothing to draw, and zero sized buffers are not allowed
+	if (objects.empty() || clusters.empty())
+	{
+		return;
+	}
+
+	// any lod can be picked, and a coarser one can hold more clusters, so each object counts its mesh's largest.
+	// an object draws its lod's clusters, or the whole lod in one draw when it has none or clusters are off.
+	uint64_t clusterWorkCapacity = 0;
+	uint64_t drawCapacity64 = 0;
+	for (const GpuObject& object : objects)
+	{
+		const GpuMeshInfo& mesh = meshes[object.meshIndex];
+		uint32_t maxClusters = 0;
+		for (uint32_t i = 0; i < mesh.lodCount; i++)
+		{
+			maxClusters = std::max(maxClusters, lods[mesh.firstLod + i].clusterCount);
+		}
+		clusterWorkCapacity += maxClusters;
+		drawCapacity64 += std::max(maxClusters, 1u);
+	}
+	clusterCapacity = static_cast<uint32_t>(std::min<uint64_t>(clusterWorkCapacity, UINT32_MAX));
+	drawCapacity = static_cast<uint32_t>(std::min<uint64_t>(drawCapacity64, UINT32_MAX));
+
+	constexpr VkBufferUsageFlags storageUsage =
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+		VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+	vertexBuffer = create_gpu_buffer(allocator, byte_size(vertices), storageUsage);
+	indexBuffer = create_gpu_buffer(allocator, byte_size(indices),
+	                                VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+	meshBuffer = create_gpu_buffer(allocator, byte_size(meshes), storageUsage);
+	lodBuffer = create_gpu_buffer(allocator, byte_size(lods), storageUsage);
+	clusterBuffer = create_gpu_buffer(allocator, byte_size(clusters), storageUsage);
+	objectBuffer = create_gpu_buffer(allocator, byte_size(objects), storageUsage);
+
+	drawBuffer = create_gpu_buffer(
+		allocator,
+		drawCapacity * sizeof(VkDrawIndexedIndirectCommand),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+	counterBuffer = create_gpu_buffer(
+		allocator,
+		sizeof(GpuCullCounters),
+		storageUsage | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+	clusterWorkBuffer = create_gpu_buffer(
+		allocator,
+		std::max<uint64_t>(clusterCapacity, 1) * 2 * sizeof(uint32_t),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+	clusterDispatchBuffer = create_gpu_buffer(
+		allocator,
+		sizeof(VkDispatchIndirectCommand),
+		storageUsage | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+
+	sceneAddresses = {
+		buffer_address(device, objectBuffer.buffer) ,
+		buffer_address(device, meshBuffer.buffer) ,
+		buffer_address(device, lodBuffer.buffer) ,
+		buffer_address(device, clusterBuffer.buffer) ,
+		buffer_address(device, drawBuffer.buffer) ,
+		buffer_address(device, counterBuffer.buffer) ,
+		buffer_address(device, clusterWorkBuffer.buffer) ,
+		buffer_address(device, clusterDispatchBuffer.buffer)
+	};
+	sceneBuffer = create_gpu_buffer(allocator, sizeof(GpuSceneAddresses), storageUsage);
+
+	vertexAddress = buffer_address(device, vertexBuffer.buffer);
+	sceneAddress = buffer_address(device, sceneBuffer.buffer);
+
+	// the vectors stay around, the uploads read from them. requests complete in order, so the last ticket covers all.
+	uploads.upload_buffer(vertexBuffer.buffer, 0, vertices.data(), byte_size(vertices));
+	uploads.upload_buffer(indexBuffer.buffer, 0, indices.data(), byte_size(indices));
+	uploads.upload_buffer(meshBuffer.buffer, 0, meshes.data(), byte_size(meshes));
+	uploads.upload_buffer(lodBuffer.buffer, 0, lods.data(), byte_size(lods));
+	uploads.upload_buffer(clusterBuffer.buffer, 0, clusters.data(), byte_size(clusters));
+	uploads.upload_buffer(sceneBuffer.buffer, 0, &sceneAddresses, sizeof(sceneAddresses));
+	uploadTicket = uploads.upload_buffer(objectBuffer.buffer, 0, objects.data(), byte_size(objects));
+
+	VkBufferCreateInfo readbackInfo = { .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+	readbackInfo.pNext = nullptr;
+	readbackInfo.size = static_cast<VkDeviceSize>(frameSlots) * sizeof(GpuCullCounters);
+	readbackInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+	VmaAllocationCreateInfo readbackAllocInfo = {};
+	readbackAllocInfo.usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+	readbackAllocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+	VK_CHECK(vmaCreateBuffer(allocator, &readbackInfo, &readbackAllocInfo, &statsReadback.buffer,
+		&statsReadback.allocation, &statsReadback.info));
+	statsPendingFrames.assign(frameSlots, -1);
+
+	uploaded = true;
+}
+
+void GpuScene::destroy(VmaAllocator allocator)
+{
+	if (!uploaded)
+	{
+		return;
+	}
+
+	for (const AllocatedBuffer* buffer : { &vertexBuffer , &indexBuffer , &meshBuffer , &lodBuffer , &clusterBuffer ,
+	                                       &objectBuffer , &drawBuffer , &counterBuffer , &clusterWorkBuffer ,
+	                                       &clusterDispatchBuffer , &sceneBuffer , &statsReadback })
+	{
+		vmaDestroyBuffer(allocator, buffer->buffer, buffer->allocation);
+	}
+	uploaded = false;
+}
+
+bool GpuScene::is_resident(const UploadManager& uploads) const
+{
+	return uploaded && uploads.is_complete(uploadTicket);
+}
+
+void GpuScene::init_pipelines(VkDevice device, const BindlessHeap& bindless, ShaderModuleCache& shaderModules,
+                              PipelineBuildQueue& pipelineBuilds, VkFormat colorFormat, VkFormat depthFormat)
+{
+	VkShaderModule cullShader;
+	VK_CHECK(shaderModules.load(device, "../../shaders/cull.comp.spv", &cullShader));
+
+	ComputePipelineDesc cullDesc{};
+	cullDesc.name = "cull";
+	cullDesc.shader = cullShader;
+	cullDesc.layout = bindless.pipelineLayout;
+
+	cullPipelineBuild = pipelineBuilds.enqueue(std::move(cullDesc));
+
+	VkShaderModule clusterCullShader;
+	VK_CHECK(shaderModules.load(device, "../../shaders/cluster_cull.comp.spv", &clusterCullShader));
+
+	ComputePipelineDesc clusterCullDesc{};
+	clusterCullDesc.name = "cluster cull";
+	clusterCullDesc.shader = clusterCullShader;
+	clusterCullDesc.layout = bindless.pipelineLayout;
+
+	clusterCullPipelineBuild = pipelineBuilds.enqueue(std::move(clusterCullDesc));
+
+	VkShaderModule vertexShader;
+	VK_CHECK(shaderModules.load(device, "../../shaders/mesh_indirect.vert.spv", &vertexShader));
+	VkShaderModule fragmentShader;
+	VK_CHECK(shaderModules.load(device, "../../shaders/mesh.frag.spv", &fragmentShader));
+
+	GraphicsPipelineDesc drawDesc{};
+	drawDesc.name = "mesh indirect";
+	drawDesc.vertexShader = vertexShader;
+	drawDesc.fragmentShader = fragmentShader;
+	drawDesc.layout = bindless.pipelineLayout;
+	drawDesc.depthTest = true;
+	drawDesc.depthWrite = true;
+	// the cluster pass drops clusters that only face away, so the whole lods drawn without it drop their
+	// back faces here. meshes wind counter clockwise, and the flipped y keeps it that way on screen.
+	drawDesc.cullMode = VK_CULL_MODE_BACK_BIT;
+	drawDesc.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	drawDesc.colorFormats = { colorFormat };
+	drawDesc.depthFormat = depthFormat;
+
+	drawPipelineBuild = pipelineBuilds.enqueue(std::move(drawDesc));
+}
+
+void GpuScene::wait_for_pipelines()
+{
+	if (cullPipeline == VK_NULL_HANDLE)
+	{
+		cullPipeline = cullPipelineBuild.get();
+	}
+	if (clusterCullPipeline == VK_NULL_HANDLE)
+	{
+		clusterCullPipeline = clusterCullPipelineBuild.get();
+	}
+	if (drawPipeline == VK_NULL_HANDLE)
+	{
+		drawPipeline = drawPipelineBuild.get();
+	}
+}
+
+GpuScene::CullOutput GpuScene::add_cull_passes(RenderGraph& graph, VkPipelineLayout layout, const glm::mat4& view,
+                                               const glm::mat4& projection, float viewportHeight, int frameNumber)
+{
+	const CullOutput output{ graph.import_buffer(drawBuffer.buffer) , graph.import_buffer(counterBuffer.buffer) };
+	const RGBuffer clusterWork = graph.import_buffer(clusterWorkBuffer.buffer);
+	const RGBuffer clusterDispatch = graph.import_buffer(clusterDispatchBuffer.buffer);
+
+	graph.add_pass("clear cull counters", PassType::Transfer)
+		.write(output.drawCount, BufferUsage::TransferDst)
+		.write(clusterDispatch, BufferUsage::TransferDst)
+		.execute([this](VkCommandBuffer cmd)
+		{
+			vkCmdFillBuffer(cmd, counterBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+
+			// the object pass grows x, and y past the device limit, to cover the clusters it hands over
+			const VkDispatchIndirectCommand emptyDispatch{ 0 , 1 , 1 };
+			vkCmdUpdateBuffer(cmd, clusterDispatchBuffer.buffer, 0, sizeof(emptyDispatch), &emptyDispatch);
+		});
+
+	// the projection's y scale turns a size at some distance into a fraction of half the viewport height
+	const float lodScale = lodSelection
+		                       ? std::abs(projection[1][1]) * viewportHeight * 0.5f / std::max(lodErrorPixels, 0.01f)
+		                       : 0.f;
+
+	const CullPushConstants pushConstants{
+		projection * view ,
+		sceneAddress ,
+		object_count() ,
+		lodScale ,
+		glm::vec3(glm::inverse(view)[3]) ,
+		clusterCulling ? CULL_CLUSTERS : 0u ,
+		clusterCapacity ,
+		drawCapacity ,
+		maxClusterGroupsX
+	};
+
+	auto objectPass = graph.add_pass("cull objects", PassType::Compute);
+	objectPass
+		.write(output.draws, BufferUsage::StorageWrite)
+		.write(output.drawCount, BufferUsage::StorageReadWrite);
+	if (clusterCulling)
+	{
+		objectPass
+			.write(clusterWork, BufferUsage::StorageWrite)
+			.write(clusterDispatch, BufferUsage::StorageReadWrite);
+	}
+	objectPass.execute([this, layout, pushConstants](VkCommandBuffer cmd)
+	{
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+		vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_ALL, 0, sizeof(pushConstants), &pushConstants);
+		vkCmdDispatch(cmd, ceil_divide(object_count(), CULL_GROUP_SIZE), 1, 1);
+	});
+
+	if (clusterCulling)
+	{
+		graph.add_pass("cull clusters", PassType::Compute)
+			.read(clusterWork, BufferUsage::StorageRead)
+			.read(clusterDispatch, BufferUsage::IndirectRead)
+			.write(output.draws, BufferUsage::StorageWrite)
+			.write(output.drawCount, BufferUsage::StorageReadWrite)
+			.execute([this, layout, pushConstants](VkCommandBuffer cmd)
+			{
+				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, clusterCullPipeline);
+				vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_ALL, 0, sizeof(pushConstants), &pushConstants);
+				vkCmdDispatchIndirect(cmd, clusterDispatchBuffer.buffer, 0);
+			});
+	}
+
+	const uint32_t statsSlot = static_cast<uint32_t>(frameNumber) % static_cast<uint32_t>(statsPendingFrames.size());
+	statsPendingFrames[statsSlot] = frameNumber;
+
+	graph.add_pass("cull stats copy", PassType::Transfer)
+		.read(output.drawCount, BufferUsage::TransferSrc)
+		.keep()
+		.execute([this, statsSlot](VkCommandBuffer cmd)
+		{
+			VkBufferCopy copy{};
+			copy.srcOffset = 0;
+			copy.dstOffset = statsSlot * sizeof(GpuCullCounters);
+			copy.size = sizeof(GpuCullCounters);
+			vkCmdCopyBuffer(cmd, counterBuffer.buffer, statsReadback.buffer, 1, &copy);
+
+			// the readback buffer is not in the graph, the copy is made visible to the host here
+			VkMemoryBarrier2 hostBarrier{};
+			hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+			hostBarrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+			hostBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+			hostBarrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+			hostBarrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+
+			VkDependencyInfo depInfo{};
+			depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+			depInfo.pNext = nullptr;
+			depInfo.memoryBarrierCount = 1;
+			depInfo.pMemoryBarriers = &hostBarrier;
+
+			vkCmdPipelineBarrier2(cmd, &depInfo);
+		});
+
+	return output;
+}
+
+void GpuScene::record_draws(VkCommandBuffer cmd, VkPipelineLayout layout, const glm::mat4& viewProj, VkExtent2D extent) const
+{
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, drawPipeline);
+
+	VkViewport viewport{};
+	viewport.x = 0.f;
+	viewport.y = 0.f;
+	viewport.width = static_cast<float>(extent.width);
+	viewport.height = static_cast<float>(extent.height);
+	viewport.minDepth = 0.f;
+	viewport.maxDepth = 1.f;
+	vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+	const VkRect2D scissor{ VkOffset2D{ 0 , 0 } , extent };
+	vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+	vkCmdBindIndexBuffer(cmd, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+	const DrawPushConstants pushConstants{ viewProj , vertexAddress , sceneAddresses.objects };
+	vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_ALL, 0, sizeof(pushConstants), &pushConstants);
+
+	// the cull passes wrote one command per visible object or cluster, and how many into the counters
+	vkCmdDrawIndexedIndirectCount(
+		cmd,
+		drawBuffer.buffer,
+		0,
+		counterBuffer.buffer,
+		offsetof(GpuCullCounters, drawCount),
+		drawCapacity,
+		sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void GpuScene::collect_stats(VmaAllocator allocator, int completedFrame)
+{
+	if (completedFrame < 0 || statsPendingFrames.empty())
+	{
+		return;
+	}
+
+	const uint32_t slot = static_cast<uint32_t>(completedFrame) % static_cast<uint32_t>(statsPendingFrames.size());
+	if (statsPendingFrames[slot] != completedFrame)
+	{
+		return;
+	}
+
+	VK_CHECK(vmaInvalidateAllocation(allocator, statsReadback.allocation, 0, VK_WHOLE_SIZE));
+
+	GpuCullCounters counters;
+	std::memcpy(&counters, static_cast<const uint8_t*>(statsReadback.info.pMappedData) + slot * sizeof(GpuCullCounters),
+	            sizeof(counters));
+
+	lastStats = { counters.objectCulledTriangles , counters.clusterCulledTriangles , counters.drawnTriangles };
+	totalStats.objectCulledTriangles += lastStats.objectCulledTriangles;
+	totalStats.clusterCulledTriangles += lastStats.clusterCulledTriangles;
+	totalStats.drawnTriangles += lastStats.drawnTriangles;
+	statsFrames++;
+
+	statsPendingFrames[slot] = -1;
+}
+
+void GpuScene::print_summary() const
+{
+	if (statsFrames == 0)
+	{
+		return;
+	}
+
+	const double frames = static_cast<double>(statsFrames);
+	const double objectCulled = static_cast<double>(totalStats.objectCulledTriangles) / frames;
+	const double clusterCulled = static_cast<double>(totalStats.clusterCulledTriangles) / frames;
+	const double drawn = static_cast<double>(totalStats.drawnTriangles) / frames;
+	const double total = objectCulled + clusterCulled + drawn;
+
+	std::cout << "GPU culling: " << object_count() << " objects in " << cluster_count() << " clusters, per frame "
+		<< static_cast<uint64_t>(objectCulled) << " triangles culled by object and "
+		<< static_cast<uint64_t>(clusterCulled) << " by cluster, " << static_cast<uint64_t>(drawn) << " drawn ("
+		<< (total > 0.0 ? 100.0 * (objectCulled + clusterCulled) / total : 0.0) << "% culled)" << std::endl;
+}
+
+void GpuScene::draw_panel()
+{
+	if (!ImGui::Begin("GPU scene"))
+	{
+		ImGui::End();
+		return;
+	}
+
+	ImGui::Text("%u objects, %u clusters", object_count(), cluster_count());
+	ImGui::Checkbox("Cluster culling", &clusterCulling);
+	ImGui::Checkbox("LOD selection", &lodSelection);
+	ImGui::SliderFloat("LOD error (px)", &lodErrorPixels, 0.25f, 8.0f);
+
+	ImGui::Separator();
+	ImGui::Text("Triangles drawn: %llu", static_cast<unsigned long long>(lastStats.drawnTriangles));
+	ImGui::Text("Culled by object: %llu", static_cast<unsigned long long>(lastStats.objectCulledTriangles));
+	ImGui::Text("Culled by cluster: %llu", static_cast<unsigned long long>(lastStats.clusterCulledTriangles));
+
+	ImGui::End();
+}
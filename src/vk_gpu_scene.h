@@ -0,0 +1,214 @@
+#pragma once
+
+#include <future>
+#include <span>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+
+#include "vk_rendergraph.h"
+#include "vk_types.h"
+#include "vk_upload.h"
+
+class BindlessHeap;
+class PipelineBuildQueue;
+struct ShaderModuleCache;
+
+// std430 layouts shared with gpu_scene.glsl
+
+struct GpuMeshLod
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	// object space distance the lod's surface may be off from the full mesh
+	float error;
+	// the meshlets the lod's index range is split into
+	uint32_t firstCluster;
+	uint32_t clusterCount;
+	uint32_t padding[3];
+};
+
+struct GpuCluster
+{
+	// object space, xyz center and w radius
+	glm::vec4 boundingSphere;
+	// backface cone, see Meshlet
+	glm::vec3 coneAxis;
+	float coneCutoff;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t padding[2];
+};
+
+struct GpuMeshInfo
+{
+	// object space, xyz center and w radius
+	glm::vec4 boundingSphere;
+	int32_t vertexOffset;
+	uint32_t firstLod;
+	uint32_t lodCount;
+	uint32_t padding;
+};
+
+struct GpuObject
+{
+	glm::mat4 transform;
+	// world space, already through the transform
+	glm::vec4 boundingSphere;
+	uint32_t meshIndex;
+	// largest axis scale of the transform, lod errors are scaled by it
+	float scale;
+	uint32_t padding[2];
+};
+
+// cleared every frame, the triangle counts are read back for the stats
+struct GpuCullCounters
+{
+	uint32_t drawCount;
+	uint32_t clusterWorkCount;
+	uint32_t objectCulledTriangles;
+	uint32_t clusterCulledTriangles;
+	uint32_t drawnTriangles;
+	uint32_t padding[3];
+};
+
+// SceneBuffer in gpu_scene.glsl, the cull shaders reach every buffer through it
+struct GpuSceneAddresses
+{
+	VkDeviceAddress objects;
+	VkDeviceAddress meshes;
+	VkDeviceAddress lods;
+	VkDeviceAddress clusters;
+	VkDeviceAddress draws;
+	VkDeviceAddress counters;
+	VkDeviceAddress clusterWork;
+	VkDeviceAddress clusterDispatch;
+};
+
+// the gpu driven geometry path. every mesh lives in one vertex and one index buffer, every object
+// in one storage buffer, uploaded once. each lod is split into meshlets when it is added.
+// each frame a compute pass tests every object against the frustum and picks its lod from the
+// projected size, then hands the lod's meshlets to a second pass that culls them against the
+// frustum and their backface cones and appends an indexed indirect draw per survivor. the
+// geometry pass draws them all with a single vkCmdDrawIndexedIndirectCount.
+// the cpu records the same few commands no matter how many objects there are.
+class GpuScene
+{
+public:
+	static constexpr uint32_t MAX_LODS = 8;
+
+	// one level of detail, finest first. error is in object space, 0 for the full mesh.
+	struct MeshLod
+	{
+		std::span<const uint32_t> indices;
+		float error;
+	};
+
+	// a lod is drawn once its error covers less than this many pixels
+	float lodErrorPixels{ 1.0f };
+	// off draws every object at lod 0, for comparing
+	bool lodSelection{ true };
+	// off draws whole lods once their object is in the frustum
+	bool clusterCulling{ true };
+
+	// triangles per frame, read back a few frames late
+	struct CullStats
+	{
+		uint64_t objectCulledTriangles;
+		uint64_t clusterCulledTriangles;
+		uint64_t drawnTriangles;
+	};
+
+	// the data is copied, the spans can go away after the call. every lod is split into meshlets.
+	uint32_t add_mesh(std::span<const Vertex> vertices, std::span<const MeshLod> lods);
+	uint32_t add_object(uint32_t meshIndex, const glm::mat4& transform);
+
+	uint32_t object_count() const { return static_cast<uint32_t>(objects.size()); }
+	uint32_t mesh_count() const { return static_cast<uint32_t>(meshes.size()); }
+	uint32_t cluster_count() const { return static_cast<uint32_t>(clusters.size()); }
+
+	// creates the buffers and queues the uploads. meshes and objects can not be added afterwards.
+	// the stats are read back through frameSlots buffers, one per frame that can be in flight.
+	// maxGroupCountX is the device's maxComputeWorkGroupCount[0], the cluster pass goes 2d past it.
+	void upload(VkDevice device, VmaAllocator allocator, UploadManager& uploads, uint32_t frameSlots,
+	            uint32_t maxGroupCountX);
+	void destroy(VmaAllocator allocator);
+
+	bool is_resident(const UploadManager& uploads) const;
+
+	void init_pipelines(VkDevice device, const BindlessHeap& bindless, ShaderModuleCache& shaderModules,
+	                    PipelineBuildQueue& pipelineBuilds, VkFormat colorFormat, VkFormat depthFormat);
+	bool is_ready() const
+	{
+		return cullPipeline != VK_NULL_HANDLE && clusterCullPipeline != VK_NULL_HANDLE && drawPipeline != VK_NULL_HANDLE;
+	}
+	void wait_for_pipelines();
+
+	struct CullOutput
+	{
+		RGBuffer draws;
+		RGBuffer drawCount;
+	};
+
+	// the passes that fill this frame's draws. the pass that calls record_draws reads both outputs as IndirectRead.
+	// viewportHeight is in pixels, for the lod metric.
+	CullOutput add_cull_passes(RenderGraph& graph, VkPipelineLayout layout, const glm::mat4& view,
+	                           const glm::mat4& projection, float viewportHeight, int frameNumber);
+
+	// inside dynamic rendering with the formats given to init_pipelines, with the bindless heap bound for graphics
+	void record_draws(VkCommandBuffer cmd, VkPipelineLayout layout, const glm::mat4& viewProj, VkExtent2D extent) const;
+
+	// reads the counters of a frame the gpu has finished, if its cull passes ran
+	void collect_stats(VmaAllocator allocator, int completedFrame);
+	const CullStats& last_stats() const { return lastStats; }
+	void print_summary() const;
+	void draw_panel();
+
+private:
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<GpuMeshInfo> meshes;
+	std::vector<GpuMeshLod> lods;
+	std::vector<GpuCluster> clusters;
+	std::vector<GpuObject> objects;
+
+	AllocatedBuffer vertexBuffer{};
+	AllocatedBuffer indexBuffer{};
+	AllocatedBuffer meshBuffer{};
+	AllocatedBuffer lodBuffer{};
+	AllocatedBuffer clusterBuffer{};
+	AllocatedBuffer objectBuffer{};
+	// room for every cluster of every object's finest lod, or one draw per object if that is more
+	AllocatedBuffer drawBuffer{};
+	AllocatedBuffer counterBuffer{};
+	// object and cluster pairs from the object pass, and the cluster pass's indirect dispatch
+	AllocatedBuffer clusterWorkBuffer{};
+	AllocatedBuffer clusterDispatchBuffer{};
+	// holds sceneAddresses, which the upload reads from
+	AllocatedBuffer sceneBuffer{};
+	GpuSceneAddresses sceneAddresses{};
+	// entries in clusterWorkBuffer and drawBuffer
+	uint32_t clusterCapacity{ 0 };
+	uint32_t drawCapacity{ 0 };
+	uint32_t maxClusterGroupsX{ 65535 };
+
+	VkDeviceAddress vertexAddress{ 0 };
+	VkDeviceAddress sceneAddress{ 0 };
+
+	// a GpuCullCounters per frame slot
+	AllocatedBuffer statsReadback{};
+	std::vector<int> statsPendingFrames;
+	CullStats lastStats{};
+	CullStats totalStats{};
+	uint64_t statsFrames{ 0 };
+
+	UploadTicket uploadTicket;
+	bool uploaded{ false };
+
+	std::shared_future<VkPipeline> cullPipelineBuild;
+	std::shared_future<VkPipeline> clusterCullPipelineBuild;
+	std::shared_future<VkPipeline> drawPipelineBuild;
+	VkPipeline cullPipeline{ VK_NULL_HANDLE };
+	VkPipeline clusterCullPipeline{ VK_NULL_HANDLE };
+	VkPipeline drawPipeline{ VK_NULL_HANDLE };
+};
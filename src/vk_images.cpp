@@ -4,6 +4,45 @@
 #include <ostream>
 
 #include "vk_initializers.h"
+#include "vk_mem_alloc.h"
+
+FormatBlockInfo vkutil::format_block_info(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_R8_UNORM:
+		return { 1 , 1 , 1 };
+	case VK_FORMAT_R8G8_UNORM:
+		return { 1 , 1 , 2 };
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+	case VK_FORMAT_R32_SFLOAT:
+	case VK_FORMAT_R32_UINT:
+		return { 1 , 1 , 4 };
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+	case VK_FORMAT_R32G32_SFLOAT:
+		return { 1 , 1 , 8 };
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		return { 1 , 1 , 16 };
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+		return { 4 , 4 , 8 };
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		return { 4 , 4 , 16 };
+	default:
+		std::cout << "No block info for format " << format << std::endl;
+		abort();
+	}
+}
 
 void vkutil::transition_image(
 	VkCommandBuffer cmd,
@@ -85,18 +124,103 @@ void vkutil::copy_image_to_image(
 	vkCmdBlitImage2(cmd, &blitInfo);
 }
 
+void DeletionQueue::push_image(VkImage image, VmaAllocation allocation)
+{
+	images.push_back({ image , allocation });
+}
+
+void DeletionQueue::push_buffer(VkBuffer buffer, VmaAllocation allocation)
+{
+	buffers.push_back({ buffer , allocation });
+}
+
+void DeletionQueue::push_image_view(VkImageView view)
+{
+	imageViews.push_back(view);
+}
+
+void DeletionQueue::push_sampler(VkSampler sampler)
+{
+	samplers.push_back(sampler);
+}
+
+void DeletionQueue::push_pipeline(VkPipeline pipeline)
+{
+	pipelines.push_back(pipeline);
+}
+
+void DeletionQueue::push_pipeline_layout(VkPipelineLayout layout)
+{
+	pipelineLayouts.push_back(layout);
+}
+
+void DeletionQueue::push_descriptor_set_layout(VkDescriptorSetLayout layout)
+{
+	descriptorSetLayouts.push_back(layout);
+}
+
+void DeletionQueue::push_descriptor_pool(VkDescriptorPool pool)
+{
+	descriptorPools.push_back(pool);
+}
+
+void DeletionQueue::push_command_pool(VkCommandPool pool)
+{
+	commandPools.push_back(pool);
+}
+
+void DeletionQueue::push_fence(VkFence fence)
+{
+	fences.push_back(fence);
+}
+
+void DeletionQueue::push_semaphore(VkSemaphore semaphore)
+{
+	semaphores.push_back(semaphore);
+}
+
 void DeletionQueue::push_function(std::function<void()>&& function)
 {
-	deletors.push_back(function);
+	deletors.push_back(std::move(function));
 }
 
-void DeletionQueue::flush()
+namespace
 {
-	//reverse iterate the deletion queue to execute all the functions
-	for (auto it = deletors.rbegin(); it != deletors.rend(); ++it)
+	// destroys in reverse push order and empties the array without giving up its capacity
+	template <typename T, typename F>
+	void destroy_reversed(std::vector<T>& handles, F&& destroy)
 	{
-		(*it)(); //call functions
+		for (auto it = handles.rbegin(); it != handles.rend(); ++it)
+		{
+			destroy(*it);
+		}
+		handles.clear();
 	}
-	deletors.clear();
 }
 
+void DeletionQueue::flush(VkDevice device, VmaAllocator allocator)
+{
+	//reverse iterate the deletion queue to execute all the functions
+	destroy_reversed(deletors, [](std::function<void()>& function) { function(); });
+
+	destroy_reversed(pipelines, [&](VkPipeline pipeline) { vkDestroyPipeline(device, pipeline, nullptr); });
+	destroy_reversed(pipelineLayouts, [&](VkPipelineLayout layout) { vkDestroyPipelineLayout(device, layout, nullptr); });
+	destroy_reversed(descriptorPools, [&](VkDescriptorPool pool) { vkDestroyDescriptorPool(device, pool, nullptr); });
+	destroy_reversed(descriptorSetLayouts, [&](VkDescriptorSetLayout layout)
+	{
+		vkDestroyDescriptorSetLayout(device, layout, nullptr);
+	});
+	destroy_reversed(samplers, [&](VkSampler sampler) { vkDestroySampler(device, sampler, nullptr); });
+	destroy_reversed(imageViews, [&](VkImageView view) { vkDestroyImageView(device, view, nullptr); });
+	destroy_reversed(images, [&](const Allocated<VkImage>& image)
+	{
+		vmaDestroyImage(allocator, image.handle, image.allocation);
+	});
+	destroy_reversed(buffers, [&](const Allocated<VkBuffer>& buffer)
+	{
+		vmaDestroyBuffer(allocator, buffer.handle, buffer.allocation);
+	});
+	destroy_reversed(commandPools, [&](VkCommandPool pool) { vkDestroyCommandPool(device, pool, nullptr); });
+	destroy_reversed(fences, [&](VkFence fence) { vkDestroyFence(device, fence, nullptr); });
+	destroy_reversed(semaphores, [&](VkSemaphore semaphore) { vkDestroySemaphore(device, semaphore, nullptr); });
+}
@@ -4,8 +4,21 @@
 #include <functional>
 #include <vulkan/vulkan.h>
 
+// size of one addressable block of a format: 1x1 texels for plain formats, 4x4 for BCn
+struct FormatBlockInfo
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t bytes;
+};
+
 namespace vkutil
 {
+	// covers the formats the engine creates images with, aborts on anything else
+	FormatBlockInfo format_block_info(VkFormat format);
+
+	// full pipeline barrier, every stage waits on every write. fine for one off setup work,
+	// the frame's passes go through RenderGraph instead.
 	void transition_image(
 		VkCommandBuffer cmd,
 		VkImage image,
@@ -36,5 +36,14 @@ namespace vkinit {
 		VkFormat format, 
 		VkImage image, 
 		VkImageAspectFlags aspectFlags);
+	//clear is optional, without it the attachment is loaded
+	VkRenderingAttachmentInfo attachment_info(
+		VkImageView view,
+		VkClearValue* clear,
+		VkImageLayout layout);
+	VkRenderingInfo rendering_info(
+		VkExtent2D renderExtent,
+		VkRenderingAttachmentInfo* colorAttachment,
+		VkRenderingAttachmentInfo* depthAttachment);
 }
 
@@ -0,0 +1,142 @@
+#include "vk_jobs.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include "vk_cpu_profiler.h"
+
+void JobSystem::init(uint32_t workerCount)
+{
+	if (workerCount == 0)
+	{
+		const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	stopRequested = false;
+
+	workers.reserve(workerCount);
+	for (uint32_t i = 0; i < workerCount; i++)
+	{
+		workers.emplace_back(&JobSystem::worker_loop, this, i + 1);
+	}
+}
+
+void JobSystem::shutdown()
+{
+	{
+		std::lock_guard lock(queueMutex);
+		stopRequested = true;
+	}
+	queueCondition.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+	workers.clear();
+}
+
+void JobSystem::parallel_for(
+	const size_t count,
+	const size_t minBatch,
+	const std::function<void(size_t begin, size_t end)>& function)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	// a few batches per thread so uneven ranges still balance out
+	const size_t threadCount = workers.size() + 1;
+	const size_t batchSize = std::max(std::max<size_t>(minBatch, 1), count / (threadCount * 4) + 1);
+	const size_t batchCount = (count + batchSize - 1) / batchSize;
+
+	if (batchCount == 1 || workers.empty())
+	{
+		function(0, count);
+		return;
+	}
+
+	// helper jobs can start after the call has returned, when the caller took every batch itself,
+	// so the state they share is owned by them. function is only touched after claiming a batch,
+	// and the caller waits for every claimed batch.
+	struct Batches
+	{
+		const std::function<void(size_t begin, size_t end)>* function;
+		size_t count;
+		size_t batchSize;
+		size_t batchCount;
+		std::atomic<size_t> next{ 0 };
+		std::atomic<size_t> done{ 0 };
+
+		void run()
+		{
+			for (size_t batch = next.fetch_add(1, std::memory_order_relaxed); batch < batchCount;
+			     batch = next.fetch_add(1, std::memory_order_relaxed))
+			{
+				const size_t begin = batch * batchSize;
+				(*function)(begin, std::min(count, begin + batchSize));
+				done.fetch_add(1, std::memory_order_release);
+			}
+		}
+	};
+
+	const auto batches = std::make_shared<Batches>();
+	batches->function = &function;
+	batches->count = count;
+	batches->batchSize = batchSize;
+	batches->batchCount = batchCount;
+
+	// one helper per worker at most, each takes batches until none are left
+	const size_t helperCount = std::min(workers.size(), batchCount - 1);
+	for (size_t i = 0; i < helperCount; i++)
+	{
+		push_job([batches]()
+		{
+			batches->run();
+		});
+	}
+
+	batches->run();
+
+	while (batches->done.load(std::memory_order_acquire) != batchCount)
+	{
+		std::this_thread::yield();
+	}
+}
+
+void JobSystem::push_job(std::function<void()>&& job)
+{
+	{
+		std::lock_guard lock(queueMutex);
+		jobs.push_back(std::move(job));
+	}
+	queueCondition.notify_one();
+}
+
+void JobSystem::worker_loop(const uint32_t index)
+{
+	PROFILE_THREAD("job worker");
+	threadIndex = index;
+
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock lock(queueMutex);
+			queueCondition.wait(lock, [&] { return stopRequested || !jobs.empty(); });
+
+			if (jobs.empty())
+			{
+				return;
+			}
+
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+
+		PROFILE_ZONE("job");
+		job();
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// fixed pool of worker threads pulling from one shared queue.
+// meant for coarse jobs (pipeline compiles, asset chunks), not for fine grained tasks.
+class JobSystem
+{
+public:
+	// workerCount 0 picks one worker per hardware thread, minus the main thread
+	void init(uint32_t workerCount = 0);
+	// finishes queued jobs, then joins the workers
+	void shutdown();
+
+	uint32_t worker_count() const { return static_cast<uint32_t>(workers.size()); }
+
+	// 1 + the worker's index on a worker thread, 0 on any other thread.
+	// indexes per thread resources, like command pools, that jobs must not share.
+	static uint32_t thread_index() { return threadIndex; }
+
+	template <typename F>
+	auto submit(F&& function) -> std::future<std::invoke_result_t<F>>
+	{
+		using Result = std::invoke_result_t<F>;
+
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(function));
+		std::future<Result> future = task->get_future();
+
+		push_job([task]() { (*task)(); });
+
+		return future;
+	}
+
+	// splits [0, count) into ranges of at least minBatch and runs them across the workers.
+	// the calling thread takes ranges too, and only waits on ranges other threads are already
+	// running. it never picks up unrelated queued jobs, like pipeline compiles, and it is safe
+	// to call from inside a job as well.
+	void parallel_for(size_t count, size_t minBatch, const std::function<void(size_t begin, size_t end)>& function);
+
+private:
+	void push_job(std::function<void()>&& job);
+	void worker_loop(uint32_t index);
+
+	static inline thread_local uint32_t threadIndex = 0;
+
+	std::vector<std::thread> workers;
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	std::deque<std::function<void()>> jobs;
+	bool stopRequested{ false };
+};
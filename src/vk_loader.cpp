@@ -0,0 +1,538 @@
+#include "vk_loader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+#include <glm/vec2.hpp>
+
+#include "vk_jobs.h"
+#include "vk_mapped_file.h"
+#include "vk_meshopt.h"
+
+namespace
+{
+	// smallest slice of the file one job parses
+	constexpr size_t MIN_CHUNK_BYTES = 1024 * 1024;
+
+	// one face corner, indices are 0 based into the global attribute arrays, -1 when absent
+	struct ObjCorner
+	{
+		int32_t position;
+		int32_t uv;
+		int32_t normal;
+
+		bool operator==(const ObjCorner&) const = default;
+	};
+
+	struct MaterialRun
+	{
+		uint32_t firstTriangle;
+		std::string material;
+	};
+
+	struct ObjChunk
+	{
+		const char* begin;
+		const char* end;
+
+		// counted in the first pass, turned into global offsets before the second
+		uint32_t positionCount{ 0 };
+		uint32_t uvCount{ 0 };
+		uint32_t normalCount{ 0 };
+		uint32_t positionOffset{ 0 };
+		uint32_t uvOffset{ 0 };
+		uint32_t normalOffset{ 0 };
+
+		// three per triangle, polygons are fanned
+		std::vector<ObjCorner> corners;
+		std::vector<MaterialRun> materialRuns;
+	};
+
+	struct ObjAttributes
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> colors;
+		std::vector<glm::vec2> uvs;
+		std::vector<glm::vec3> normals;
+		std::atomic<bool> hasColors{ false };
+	};
+
+	const char* skip_spaces(const char* p, const char* end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t'))
+		{
+			p++;
+		}
+		return p;
+	}
+
+	const char* parse_float(const char* p, const char* end, float& out)
+	{
+		p = skip_spaces(p, end);
+		const auto result = std::from_chars(p, end, out);
+		return result.ec == std::errc() ? result.ptr : nullptr;
+	}
+
+	// turns a 1 based or negative (relative) obj index into a 0 based one, -1 if missing
+	int32_t resolve_index(const char*& p, const char* end, uint32_t countSoFar)
+	{
+		int32_t value = 0;
+		const auto result = std::from_chars(p, end, value);
+		if (result.ec != std::errc())
+		{
+			return -1;
+		}
+
+		p = result.ptr;
+		return value > 0 ? value - 1 : static_cast<int32_t>(countSoFar) + value;
+	}
+
+	bool line_starts_with(const char* line, const char* end, const char* prefix)
+	{
+		const size_t length = strlen(prefix);
+		return static_cast<size_t>(end - line) > length
+			&& memcmp(line, prefix, length) == 0
+			&& (line[length] == ' ' || line[length] == '\t');
+	}
+
+	template <typename F>
+	void for_each_line(const char* begin, const char* end, F&& function)
+	{
+		const char* line = begin;
+		while (line < end)
+		{
+			const char* lineEnd = static_cast<const char*>(memchr(line, '\n', end - line));
+			if (lineEnd == nullptr)
+			{
+				lineEnd = end;
+			}
+
+			const char* contentEnd = lineEnd;
+			if (contentEnd > line && contentEnd[-1] == '\r')
+			{
+				contentEnd--;
+			}
+
+			function(skip_spaces(line, contentEnd), contentEnd);
+			line = lineEnd + 1;
+		}
+	}
+
+	void count_attributes(ObjChunk& chunk)
+	{
+		for_each_line(chunk.begin, chunk.end, [&](const char* line, const char* end)
+		{
+			if (line_starts_with(line, end, "v"))
+			{
+				chunk.positionCount++;
+			}
+			else if (line_starts_with(line, end, "vt"))
+			{
+				chunk.uvCount++;
+			}
+			else if (line_starts_with(line, end, "vn"))
+			{
+				chunk.normalCount++;
+			}
+		});
+	}
+
+	void parse_chunk(ObjChunk& chunk, ObjAttributes& attributes)
+	{
+		uint32_t positionCursor = chunk.positionOffset;
+		uint32_t uvCursor = chunk.uvOffset;
+		uint32_t normalCursor = chunk.normalOffset;
+
+		std::vector<ObjCorner> polygon;
+
+		for_each_line(chunk.begin, chunk.end, [&](const char* line, const char* end)
+		{
+			if (line_starts_with(line, end, "v"))
+			{
+				glm::vec3 position{ 0.f };
+				const char* p = line + 1;
+				for (int i = 0; i < 3 && p != nullptr; i++)
+				{
+					p = parse_float(p, end, position[i]);
+				}
+				attributes.positions[positionCursor] = position;
+
+				// some exporters append an rgb color to the position
+				glm::vec3 color{ 1.f };
+				if (p != nullptr && skip_spaces(p, end) < end)
+				{
+					for (int i = 0; i < 3 && p != nullptr; i++)
+					{
+						p = parse_float(p, end, color[i]);
+					}
+					attributes.hasColors.store(true, std::memory_order_relaxed);
+				}
+				attributes.colors[positionCursor] = color;
+
+				positionCursor++;
+			}
+			else if (line_starts_with(line, end, "vt"))
+			{
+				glm::vec2 uv{ 0.f };
+				const char* p = line + 2;
+				for (int i = 0; i < 2 && p != nullptr; i++)
+				{
+					p = parse_float(p, end, uv[i]);
+				}
+				attributes.uvs[uvCursor++] = uv;
+			}
+			else if (line_starts_with(line, end, "vn"))
+			{
+				glm::vec3 normal{ 0.f };
+				const char* p = line + 2;
+				for (int i = 0; i < 3 && p != nullptr; i++)
+				{
+					p = parse_float(p, end, normal[i]);
+				}
+				attributes.normals[normalCursor++] = normal;
+			}
+			else if (line_starts_with(line, end, "f"))
+			{
+				polygon.clear();
+
+				const char* p = skip_spaces(line + 1, end);
+				while (p < end)
+				{
+					// v, v/vt, v//vn or v/vt/vn
+					ObjCorner corner{ -1 , -1 , -1 };
+					corner.position = resolve_index(p, end, positionCursor);
+					if (p < end && *p == '/')
+					{
+						p++;
+						if (p < end && *p != '/')
+						{
+							corner.uv = resolve_index(p, end, uvCursor);
+						}
+						if (p < end && *p == '/')
+						{
+							p++;
+							corner.normal = resolve_index(p, end, normalCursor);
+						}
+					}
+
+					if (corner.position < 0)
+					{
+						break;
+					}
+					polygon.push_back(corner);
+
+					while (p < end && *p != ' ' && *p != '\t')
+					{
+						p++;
+					}
+					p = skip_spaces(p, end);
+				}
+
+				for (size_t i = 2; i < polygon.size(); i++)
+				{
+					chunk.corners.push_back(polygon[0]);
+					chunk.corners.push_back(polygon[i - 1]);
+					chunk.corners.push_back(polygon[i]);
+				}
+			}
+			else if (line_starts_with(line, end, "usemtl"))
+			{
+				const char* name = skip_spaces(line + 6, end);
+				const uint32_t firstTriangle = static_cast<uint32_t>(chunk.corners.size() / 3);
+				chunk.materialRuns.push_back({ firstTriangle , std::string(name, end) });
+			}
+		});
+	}
+
+	// open addressing table from a corner to its vertex, sized once for the whole file
+	class CornerTable
+	{
+	public:
+		explicit CornerTable(size_t cornerCount)
+		{
+			size_t capacity = 16;
+			while (capacity < cornerCount * 2)
+			{
+				capacity *= 2;
+			}
+			keys.resize(capacity);
+			values.assign(capacity, EMPTY);
+			mask = capacity - 1;
+		}
+
+		// returns the existing vertex for the corner, or stores and returns newVertex
+		uint32_t find_or_insert(const ObjCorner& corner, uint32_t newVertex)
+		{
+			size_t slot = hash(corner) & mask;
+			while (values[slot] != EMPTY)
+			{
+				if (keys[slot] == corner)
+				{
+					return values[slot];
+				}
+				slot = (slot + 1) & mask;
+			}
+
+			keys[slot] = corner;
+			values[slot] = newVertex;
+			return newVertex;
+		}
+
+	private:
+		static constexpr uint32_t EMPTY = UINT32_MAX;
+
+		static size_t hash(const ObjCorner& corner)
+		{
+			uint64_t h = static_cast<uint32_t>(corner.position) * 0x9E3779B97F4A7C15ull;
+			h ^= static_cast<uint32_t>(corner.uv) * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+			h ^= static_cast<uint32_t>(corner.normal) * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+			return static_cast<size_t>(h ^ (h >> 32));
+		}
+
+		std::vector<ObjCorner> keys;
+		std::vector<uint32_t> values;
+		size_t mask;
+	};
+
+	double elapsed_ms(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+std::shared_ptr<MeshAsset> vkutil::load_obj_mesh(JobSystem& jobs, const std::filesystem::path& path,
+                                                 bool optimize, MeshLoadStats* stats)
+{
+	MappedFile file;
+	if (!file.open(path))
+	{
+		std::cout << "Failed to open mesh " << path.string() << std::endl;
+		return nullptr;
+	}
+
+	auto parseStart = std::chrono::steady_clock::now();
+
+	const char* text = reinterpret_cast<const char*>(file.data());
+	const char* textEnd = text + file.size();
+
+	// a few chunks per thread, every boundary moved to the start of a line
+	const size_t threadCount = jobs.worker_count() + 1;
+	const size_t chunkBytes = std::max(MIN_CHUNK_BYTES, file.size() / (threadCount * 4) + 1);
+
+	std::vector<ObjChunk> chunks;
+	for (const char* begin = text; begin < textEnd;)
+	{
+		const char* end = begin + std::min(chunkBytes, static_cast<size_t>(textEnd - begin));
+		if (end < textEnd)
+		{
+			const char* newline = static_cast<const char*>(memchr(end, '\n', textEnd - end));
+			end = newline != nullptr ? newline + 1 : textEnd;
+		}
+
+		ObjChunk chunk{};
+		chunk.begin = begin;
+		chunk.end = end;
+		chunks.push_back(std::move(chunk));
+
+		begin = end;
+	}
+
+	jobs.parallel_for(chunks.size(), 1, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			count_attributes(chunks[i]);
+		}
+	});
+
+	// every chunk writes its attributes straight into its slice of the global arrays
+	uint32_t positionCount = 0;
+	uint32_t uvCount = 0;
+	uint32_t normalCount = 0;
+	for (auto& chunk : chunks)
+	{
+		chunk.positionOffset = positionCount;
+		chunk.uvOffset = uvCount;
+		chunk.normalOffset = normalCount;
+		positionCount += chunk.positionCount;
+		uvCount += chunk.uvCount;
+		normalCount += chunk.normalCount;
+	}
+
+	ObjAttributes attributes;
+	attributes.positions.resize(positionCount);
+	attributes.colors.resize(positionCount);
+	attributes.uvs.resize(uvCount);
+	attributes.normals.resize(normalCount);
+
+	jobs.parallel_for(chunks.size(), 1, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			parse_chunk(chunks[i], attributes);
+		}
+	});
+
+	const double parseMs = elapsed_ms(parseStart);
+	const auto dedupStart = std::chrono::steady_clock::now();
+
+	size_t cornerCount = 0;
+	for (const auto& chunk : chunks)
+	{
+		cornerCount += chunk.corners.size();
+	}
+
+	auto mesh = std::make_shared<MeshAsset>();
+	mesh->name = path.stem().string();
+	mesh->vertices.reserve(cornerCount / 2);
+
+	// triangles are bucketed per material, in file order within each
+	std::unordered_map<std::string, uint32_t> materialIds;
+	std::vector<std::string> materialNames;
+	std::vector<std::vector<uint32_t>> materialIndices;
+
+	const auto material_id = [&](const std::string& name)
+	{
+		const auto [it, inserted] = materialIds.try_emplace(name, static_cast<uint32_t>(materialNames.size()));
+		if (inserted)
+		{
+			materialNames.push_back(name);
+			materialIndices.emplace_back();
+		}
+		return it->second;
+	};
+
+	uint32_t currentMaterial = material_id("");
+	const bool hasColors = attributes.hasColors.load();
+
+	CornerTable table(cornerCount);
+
+	for (const auto& chunk : chunks)
+	{
+		size_t nextRun = 0;
+		const uint32_t triangleCount = static_cast<uint32_t>(chunk.corners.size() / 3);
+
+		for (uint32_t triangle = 0; triangle < triangleCount; triangle++)
+		{
+			while (nextRun < chunk.materialRuns.size() && chunk.materialRuns[nextRun].firstTriangle == triangle)
+			{
+				currentMaterial = material_id(chunk.materialRuns[nextRun].material);
+				nextRun++;
+			}
+
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				ObjCorner corner = chunk.corners[triangle * 3 + c];
+				if (corner.position >= static_cast<int32_t>(positionCount))
+				{
+					std::cout << "Mesh " << path.string() << " references missing vertex " << corner.position + 1 << std::endl;
+					return nullptr;
+				}
+				// a dangling uv or normal is treated like an absent one
+				if (corner.uv >= static_cast<int32_t>(uvCount))
+				{
+					corner.uv = -1;
+				}
+				if (corner.normal >= static_cast<int32_t>(normalCount))
+				{
+					corner.normal = -1;
+				}
+
+				const uint32_t newVertex = static_cast<uint32_t>(mesh->vertices.size());
+				const uint32_t vertex = table.find_or_insert(corner, newVertex);
+
+				if (vertex == newVertex)
+				{
+					Vertex v{};
+					v.position = attributes.positions[corner.position];
+					v.normal = corner.normal >= 0 ? attributes.normals[corner.normal] : glm::vec3{ 0.f };
+
+					const glm::vec2 uv = corner.uv >= 0 ? attributes.uvs[corner.uv] : glm::vec2{ 0.f };
+					v.uv_x = uv.x;
+					// obj has v pointing up, vulkan samples with y down
+					v.uv_y = 1.f - uv.y;
+
+					v.color = hasColors ? glm::vec4{ attributes.colors[corner.position] , 1.f } : glm::vec4{ 1.f };
+
+					mesh->vertices.push_back(v);
+				}
+
+				materialIndices[currentMaterial].push_back(vertex);
+			}
+		}
+
+		// runs after the last triangle still switch the material for the next chunk
+		for (; nextRun < chunk.materialRuns.size(); nextRun++)
+		{
+			currentMaterial = material_id(chunk.materialRuns[nextRun].material);
+		}
+	}
+
+	for (uint32_t material = 0; material < materialNames.size(); material++)
+	{
+		if (materialIndices[material].empty())
+		{
+			continue;
+		}
+
+		GeoSurface surface{};
+		surface.startIndex = static_cast<uint32_t>(mesh->indices.size());
+		surface.count = static_cast<uint32_t>(materialIndices[material].size());
+		surface.material = materialNames[material];
+		mesh->surfaces.push_back(surface);
+
+		mesh->indices.insert(mesh->indices.end(), materialIndices[material].begin(), materialIndices[material].end());
+	}
+
+	const double dedupMs = elapsed_ms(dedupStart);
+	const auto optimizeStart = std::chrono::steady_clock::now();
+
+	const uint32_t vertexCount = static_cast<uint32_t>(mesh->vertices.size());
+
+	MeshLoadStats loadStats{};
+	if (stats != nullptr)
+	{
+		loadStats.acmrBefore = compute_acmr(mesh->indices, vertexCount);
+		loadStats.atvrBefore = compute_atvr(mesh->indices, vertexCount);
+	}
+
+	if (optimize)
+	{
+		// surfaces are independent ranges of the index buffer
+		jobs.parallel_for(mesh->surfaces.size(), 1, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				const GeoSurface& surface = mesh->surfaces[i];
+				optimize_vertex_cache(std::span(mesh->indices).subspan(surface.startIndex, surface.count), vertexCount);
+			}
+		});
+
+		optimize_vertex_fetch(mesh->vertices, mesh->indices);
+	}
+
+	const double optimizeMs = elapsed_ms(optimizeStart);
+
+	if (stats != nullptr)
+	{
+		loadStats.fileBytes = file.size();
+		loadStats.chunks = static_cast<uint32_t>(chunks.size());
+		loadStats.parseMs = parseMs;
+		loadStats.dedupMs = dedupMs;
+		loadStats.optimizeMs = optimizeMs;
+		loadStats.corners = static_cast<uint32_t>(cornerCount);
+		loadStats.vertices = static_cast<uint32_t>(mesh->vertices.size());
+		loadStats.triangles = static_cast<uint32_t>(mesh->indices.size() / 3);
+		loadStats.acmrAfter = compute_acmr(mesh->indices, loadStats.vertices);
+		loadStats.atvrAfter = compute_atvr(mesh->indices, loadStats.vertices);
+
+		*stats = loadStats;
+	}
+
+	return mesh;
+}
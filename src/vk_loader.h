@@ -0,0 +1,72 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "vk_simplify.h"
+#include "vk_types.h"
+#include "vk_upload.h"
+
+class JobSystem;
+
+// one material's triangles inside the mesh index buffer
+struct GeoSurface
+{
+	uint32_t startIndex;
+	uint32_t count;
+	std::string material;
+};
+
+struct MeshAsset
+{
+	std::string name;
+
+	std::vector<GeoSurface> surfaces;
+
+	// the upload reads straight from these, keep them alive until uploadTicket completes
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+
+	// the cpu side data wherever it lives: the vectors above, or the asset pack mapping
+	std::span<const Vertex> sourceVertices;
+	std::span<const uint32_t> sourceIndices;
+
+	// coarser versions of the whole index buffer, each about half the one before. empty until built.
+	std::vector<MeshLodLevel> lods;
+
+	GPUMeshBuffers meshBuffers{};
+	UploadTicket uploadTicket;
+};
+
+struct MeshLoadStats
+{
+	size_t fileBytes{ 0 };
+	uint32_t chunks{ 0 };
+
+	double parseMs{ 0.0 };
+	double dedupMs{ 0.0 };
+	double optimizeMs{ 0.0 };
+
+	// face corners in the file after triangulation, against unique vertices after deduplication
+	uint32_t corners{ 0 };
+	uint32_t vertices{ 0 };
+	uint32_t triangles{ 0 };
+
+	float acmrBefore{ 0.f };
+	float acmrAfter{ 0.f };
+	float atvrBefore{ 0.f };
+	float atvrAfter{ 0.f };
+};
+
+namespace vkutil
+{
+	// parses the obj in line aligned chunks on the job system, deduplicates the v/vt/vn corners
+	// and groups triangles into one surface per material. with optimize set, every surface is
+	// reordered for the post transform cache and the vertices for fetch locality.
+	// returns nullptr if the file cannot be read.
+	std::shared_ptr<MeshAsset> load_obj_mesh(JobSystem& jobs, const std::filesystem::path& path,
+	                                         bool optimize = true, MeshLoadStats* stats = nullptr);
+}
@@ -0,0 +1,154 @@
+#include "vk_mapped_file.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		close();
+
+		mappedData = std::exchange(other.mappedData, nullptr);
+		mappedSize = std::exchange(other.mappedSize, 0);
+#ifdef _WIN32
+		mappingHandle = std::exchange(other.mappingHandle, nullptr);
+#endif
+	}
+	return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::filesystem::path& path)
+{
+	close();
+
+	const HANDLE file = CreateFileW(
+		path.c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+		nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize{};
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	const HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+	// the mapping keeps the file alive on its own
+	CloseHandle(file);
+
+	if (mapping == nullptr)
+	{
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr)
+	{
+		CloseHandle(mapping);
+		return false;
+	}
+
+	mappedData = view;
+	mappedSize = static_cast<size_t>(fileSize.QuadPart);
+	mappingHandle = mapping;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mappedData != nullptr)
+	{
+		UnmapViewOfFile(mappedData);
+		CloseHandle(mappingHandle);
+	}
+
+	mappedData = nullptr;
+	mappedSize = 0;
+	mappingHandle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::filesystem::path& path)
+{
+	close();
+
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat fileStat{};
+	if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	const auto fileSize = static_cast<size_t>(fileStat.st_size);
+	void* view = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	// the mapping keeps the file alive on its own
+	::close(fd);
+
+	if (view == MAP_FAILED)
+	{
+		return false;
+	}
+
+	mappedData = view;
+	mappedSize = fileSize;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mappedData != nullptr)
+	{
+		munmap(mappedData, mappedSize);
+	}
+
+	mappedData = nullptr;
+	mappedSize = 0;
+}
+
+#endif
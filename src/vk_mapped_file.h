@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+// read-only memory mapping of a whole file.
+// the mapping is page aligned, so its contents can be reinterpreted as any trivially aligned type.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	bool open(const std::filesystem::path& path);
+	void close();
+
+	bool is_open() const { return mappedData != nullptr; }
+	const uint8_t* data() const { return static_cast<const uint8_t*>(mappedData); }
+	size_t size() const { return mappedSize; }
+
+private:
+	void* mappedData{ nullptr };
+	size_t mappedSize{ 0 };
+#ifdef _WIN32
+	void* mappingHandle{ nullptr };
+#endif
+};
@@ -0,0 +1,500 @@
+#include "vk_meshopt.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+namespace
+{
+	// number of vertex shader invocations a fifo cache of cacheSize entries needs for the index stream
+	uint64_t count_transforms(std::span<const uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize)
+	{
+		// an entry inserted at time t is evicted by the cacheSize'th insertion after it
+		std::vector<uint64_t> insertedAt(vertexCount, 0);
+		uint64_t time = cacheSize + 1;
+		uint64_t transforms = 0;
+
+		for (const uint32_t index : indices)
+		{
+			if (time - insertedAt[index] > cacheSize)
+			{
+				insertedAt[index] = time++;
+				transforms++;
+			}
+		}
+
+		return transforms;
+	}
+
+	// compact vertex -> triangle lists, the layout tipsify walks
+	struct TriangleAdjacency
+	{
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> triangles;
+	};
+
+	TriangleAdjacency build_adjacency(std::span<const uint32_t> indices, uint32_t vertexCount)
+	{
+		TriangleAdjacency adjacency;
+		adjacency.offsets.assign(vertexCount + 1, 0);
+		adjacency.triangles.resize(indices.size());
+
+		for (const uint32_t index : indices)
+		{
+			adjacency.offsets[index + 1]++;
+		}
+		for (uint32_t v = 0; v < vertexCount; v++)
+		{
+			adjacency.offsets[v + 1] += adjacency.offsets[v];
+		}
+
+		std::vector<uint32_t> cursor(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			adjacency.triangles[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		return adjacency;
+	}
+}
+
+float vkutil::compute_acmr(std::span<const uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize)
+{
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return 0.f;
+	}
+
+	return static_cast<float>(count_transforms(indices, vertexCount, cacheSize)) / static_cast<float>(triangleCount);
+}
+
+float vkutil::compute_atvr(std::span<const uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize)
+{
+	std::vector<bool> used(vertexCount, false);
+	uint32_t usedCount = 0;
+	for (const uint32_t index : indices)
+	{
+		if (!used[index])
+		{
+			used[index] = true;
+			usedCount++;
+		}
+	}
+
+	if (usedCount == 0)
+	{
+		return 0.f;
+	}
+
+	return static_cast<float>(count_transforms(indices, vertexCount, cacheSize)) / static_cast<float>(usedCount);
+}
+
+void vkutil::optimize_vertex_cache(std::span<uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize)
+{
+	const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	const TriangleAdjacency adjacency = build_adjacency(indices, vertexCount);
+
+	// triangles still to emit per vertex
+	std::vector<uint32_t> liveTriangles(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+	}
+
+	std::vector<uint64_t> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEndStack;
+	std::vector<uint32_t> candidates;
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	uint64_t time = cacheSize + 1;
+	uint32_t cursor = 0;
+	int64_t fanningVertex = 0;
+
+	while (fanningVertex >= 0)
+	{
+		const uint32_t fan = static_cast<uint32_t>(fanningVertex);
+		candidates.clear();
+
+		// emit every remaining triangle around the fanning vertex
+		for (uint32_t i = adjacency.offsets[fan]; i < adjacency.offsets[fan + 1]; i++)
+		{
+			const uint32_t triangle = adjacency.triangles[i];
+			if (emitted[triangle])
+			{
+				continue;
+			}
+
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t v = indices[triangle * 3 + corner];
+				output.push_back(v);
+				deadEndStack.push_back(v);
+				candidates.push_back(v);
+				liveTriangles[v]--;
+
+				if (time - cacheTime[v] > cacheSize)
+				{
+					cacheTime[v] = time++;
+				}
+			}
+			emitted[triangle] = true;
+		}
+
+		// next fan: the candidate that will still be in cache after its remaining triangles, oldest first
+		int64_t best = -1;
+		int64_t bestPriority = -1;
+		for (const uint32_t v : candidates)
+		{
+			if (liveTriangles[v] == 0)
+			{
+				continue;
+			}
+
+			int64_t priority = 0;
+			if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+			{
+				priority = static_cast<int64_t>(time - cacheTime[v]);
+			}
+
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				best = v;
+			}
+		}
+
+		// dead end: back up through recently used vertices, then scan forward for any work left
+		while (best < 0 && !deadEndStack.empty())
+		{
+			const uint32_t v = deadEndStack.back();
+			deadEndStack.pop_back();
+			if (liveTriangles[v] > 0)
+			{
+				best = v;
+			}
+		}
+		while (best < 0 && cursor < vertexCount)
+		{
+			if (liveTriangles[cursor] > 0)
+			{
+				best = cursor;
+			}
+			cursor++;
+		}
+
+		fanningVertex = best;
+	}
+
+	std::copy(output.begin(), output.end(), indices.begin());
+}
+
+glm::vec4 vkutil::compute_bounding_sphere(std::span<const Vertex> vertices)
+{
+	if (vertices.empty())
+	{
+		return glm::vec4{ 0.f };
+	}
+
+	glm::vec3 minimum{ FLT_MAX };
+	glm::vec3 maximum{ -FLT_MAX };
+	for (const Vertex& vertex : vertices)
+	{
+		minimum = glm::min(minimum, vertex.position);
+		maximum = glm::max(maximum, vertex.position);
+	}
+
+	const glm::vec3 center = (minimum + maximum) * 0.5f;
+	float radiusSquared = 0.f;
+	for (const Vertex& vertex : vertices)
+	{
+		const glm::vec3 offset = vertex.position - center;
+		radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+	}
+
+	return glm::vec4(center, std::sqrt(radiusSquared));
+}
+
+void vkutil::optimize_vertex_fetch(std::vector<Vertex>& vertices, std::span<uint32_t> indices)
+{
+	constexpr uint32_t UNASSIGNED = UINT32_MAX;
+
+	std::vector<uint32_t> remap(vertices.size(), UNASSIGNED);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertices.size());
+
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == UNASSIGNED)
+		{
+			remap[index] = static_cast<uint32_t>(reordered.size());
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	vertices = std::move(reordered);
+}
+
+namespace
+{
+	// unit face normal, turned to agree with the vertex normals so either winding convention works. zero if degenerate.
+	glm::vec3 face_normal(const Vertex& a, const Vertex& b, const Vertex& c)
+	{
+		const glm::vec3 normal = glm::cross(b.position - a.position, c.position - a.position);
+		const float length = glm::length(normal);
+		if (length == 0.f)
+		{
+			return glm::vec3{ 0.f };
+		}
+		return (glm::dot(normal, a.normal + b.normal + c.normal) < 0.f ? -normal : normal) / length;
+	}
+
+	void compute_meshlet_bounds(std::span<const Vertex> vertices, std::span<const uint32_t> indices, Meshlet& meshlet)
+	{
+		glm::vec3 minimum{ FLT_MAX };
+		glm::vec3 maximum{ -FLT_MAX };
+		for (const uint32_t index : indices)
+		{
+			minimum = glm::min(minimum, vertices[index].position);
+			maximum = glm::max(maximum, vertices[index].position);
+		}
+
+		const glm::vec3 center = (minimum + maximum) * 0.5f;
+		float radiusSquared = 0.f;
+		for (const uint32_t index : indices)
+		{
+			const glm::vec3 offset = vertices[index].position - center;
+			radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+		}
+		meshlet.boundingSphere = glm::vec4(center, std::sqrt(radiusSquared));
+
+		std::vector<glm::vec3> normals;
+		normals.reserve(indices.size() / 3);
+		glm::vec3 normalSum{ 0.f };
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			const glm::vec3 normal = face_normal(vertices[indices[i]], vertices[indices[i + 1]], vertices[indices[i + 2]]);
+			if (normal != glm::vec3{ 0.f })
+			{
+				normals.push_back(normal);
+				normalSum += normal;
+			}
+		}
+
+		meshlet.coneAxis = glm::vec3{ 0.f , 0.f , 1.f };
+		meshlet.coneCutoff = 1.f;
+
+		const float sumLength = glm::length(normalSum);
+		if (normals.empty() || sumLength == 0.f)
+		{
+			return;
+		}
+		meshlet.coneAxis = normalSum / sumLength;
+
+		// the widest normal off the axis sets the cone. past about 84 degrees the test would hardly ever pass.
+		float minimumDot = 1.f;
+		for (const glm::vec3& normal : normals)
+		{
+			minimumDot = std::min(minimumDot, glm::dot(normal, meshlet.coneAxis));
+		}
+		if (minimumDot > 0.1f)
+		{
+			meshlet.coneCutoff = std::sqrt(1.f - minimumDot * minimumDot);
+		}
+	}
+}
+
+std::vector<Meshlet> vkutil::build_meshlets(std::span<const Vertex> vertices, std::span<uint32_t> indices,
+                                            uint32_t maxVertices, uint32_t maxTriangles)
+{
+	constexpr uint32_t NONE = UINT32_MAX;
+	constexpr uint32_t DISCONNECTED_SEARCH = 32;
+	// once a meshlet has a quarter of its triangles, one more than about 70 degrees off its average normal
+	// starts a new meshlet instead. that keeps backface cones narrow enough to cull on curved surfaces
+	// without shredding meshes whose normals are noisy.
+	constexpr float CONE_LIMIT = 0.35f;
+
+	const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+	const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+	const TriangleAdjacency adjacency = build_adjacency(indices.first(static_cast<size_t>(triangleCount) * 3), vertexCount);
+
+	std::vector<bool> emitted(triangleCount, false);
+	// the meshlet a vertex was last added to, for counting new vertices without a set
+	std::vector<uint32_t> vertexMeshlet(vertexCount, NONE);
+
+	std::vector<uint32_t> output;
+	output.reserve(static_cast<size_t>(triangleCount) * 3);
+
+	std::vector<Meshlet> meshlets;
+	std::vector<uint32_t> meshletVertices;
+	uint32_t meshletTriangles = 0;
+	glm::vec3 centroidSum{ 0.f };
+	glm::vec3 normalSum{ 0.f };
+	uint32_t seedCursor = 0;
+
+	const auto triangle_centroid = [&](uint32_t triangle)
+	{
+		return (vertices[indices[triangle * 3]].position +
+			vertices[indices[triangle * 3 + 1]].position +
+			vertices[indices[triangle * 3 + 2]].position) / 3.f;
+	};
+
+	const auto triangle_normal = [&](uint32_t triangle)
+	{
+		return face_normal(vertices[indices[triangle * 3]], vertices[indices[triangle * 3 + 1]], vertices[indices[triangle * 3 + 2]]);
+	};
+
+	const auto fits_cone = [&](uint32_t triangle)
+	{
+		const float length = glm::length(normalSum);
+		return meshletTriangles * 4 < maxTriangles || length == 0.f ||
+			glm::dot(triangle_normal(triangle), normalSum) >= CONE_LIMIT * length;
+	};
+
+	const auto new_vertices = [&](uint32_t triangle)
+	{
+		const uint32_t meshletIndex = static_cast<uint32_t>(meshlets.size());
+		uint32_t count = 0;
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			count += vertexMeshlet[indices[triangle * 3 + corner]] != meshletIndex ? 1 : 0;
+		}
+		return count;
+	};
+
+	const auto close_meshlet = [&]()
+	{
+		if (meshletTriangles == 0)
+		{
+			return;
+		}
+
+		Meshlet meshlet{};
+		meshlet.indexCount = meshletTriangles * 3;
+		meshlet.firstIndex = static_cast<uint32_t>(output.size()) - meshlet.indexCount;
+		meshlet.vertexCount = static_cast<uint32_t>(meshletVertices.size());
+		compute_meshlet_bounds(vertices, std::span(output).subspan(meshlet.firstIndex, meshlet.indexCount), meshlet);
+		meshlets.push_back(meshlet);
+
+		meshletVertices.clear();
+		meshletTriangles = 0;
+		centroidSum = glm::vec3{ 0.f };
+		normalSum = glm::vec3{ 0.f };
+	};
+
+	for (uint32_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+	{
+		// the unused neighbour adding the fewest vertices, ties going to the one closest to the meshlet's middle
+		uint32_t best = NONE;
+		uint32_t bestNewVertices = 4;
+		float bestDistance = FLT_MAX;
+		bool unusedNeighbours = false;
+
+		if (meshletTriangles > 0 && meshletTriangles < maxTriangles)
+		{
+			const glm::vec3 center = centroidSum / static_cast<float>(meshletTriangles);
+			for (const uint32_t v : meshletVertices)
+			{
+				for (uint32_t i = adjacency.offsets[v]; i < adjacency.offsets[v + 1]; i++)
+				{
+					const uint32_t triangle = adjacency.triangles[i];
+					if (emitted[triangle])
+					{
+						continue;
+					}
+					unusedNeighbours = true;
+
+					const uint32_t added = new_vertices(triangle);
+					if (meshletVertices.size() + added > maxVertices || added > bestNewVertices || !fits_cone(triangle))
+					{
+						continue;
+					}
+
+					const glm::vec3 offset = triangle_centroid(triangle) - center;
+					const float distance = glm::dot(offset, offset);
+					if (added < bestNewVertices || distance < bestDistance)
+					{
+						best = triangle;
+						bestNewVertices = added;
+						bestDistance = distance;
+					}
+				}
+			}
+		}
+
+		while (emitted[seedCursor])
+		{
+			seedCursor++;
+		}
+
+		// nothing connected is left, as with the split vertices of flat shading: the closest that fits of
+		// the next few unused triangles in index order, which the vertex cache order keeps nearby
+		if (best == NONE && !unusedNeighbours && meshletTriangles > 0 && meshletTriangles < maxTriangles)
+		{
+			const glm::vec3 center = centroidSum / static_cast<float>(meshletTriangles);
+			uint32_t looked = 0;
+			for (uint32_t triangle = seedCursor; triangle < triangleCount && looked < DISCONNECTED_SEARCH; triangle++)
+			{
+				if (emitted[triangle])
+				{
+					continue;
+				}
+				looked++;
+
+				if (meshletVertices.size() + new_vertices(triangle) > maxVertices || !fits_cone(triangle))
+				{
+					continue;
+				}
+
+				const glm::vec3 offset = triangle_centroid(triangle) - center;
+				const float distance = glm::dot(offset, offset);
+				if (distance < bestDistance)
+				{
+					best = triangle;
+					bestDistance = distance;
+				}
+			}
+		}
+
+		// full, or boxed in: the meshlet is done and the next unused triangle starts another
+		if (best == NONE)
+		{
+			close_meshlet();
+			best = seedCursor;
+		}
+
+		emitted[best] = true;
+		meshletTriangles++;
+		centroidSum += triangle_centroid(best);
+		normalSum += triangle_normal(best);
+
+		const uint32_t meshletIndex = static_cast<uint32_t>(meshlets.size());
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			const uint32_t v = indices[best * 3 + corner];
+			if (vertexMeshlet[v] != meshletIndex)
+			{
+				vertexMeshlet[v] = meshletIndex;
+				meshletVertices.push_back(v);
+			}
+			output.push_back(v);
+		}
+	}
+	close_meshlet();
+
+	std::copy(output.begin(), output.end(), indices.begin());
+	return meshlets;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "vk_types.h"
+
+// post transform cache size the optimizer targets and the acmr figures are measured with.
+// 16 entries of 16 floats is a conservative fit for the cache of current desktop gpus.
+constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+// cluster limits, the sizes mesh shading hardware is happiest with
+constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// a run of triangles in the index buffer with few unique vertices, culled as a unit
+struct Meshlet
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t vertexCount;
+	// object space, xyz center and w radius
+	glm::vec4 boundingSphere;
+	// every triangle faces away from a viewer at v when dot(normalize(center - v), coneAxis) >= coneCutoff.
+	// a cutoff of 1 never culls.
+	glm::vec3 coneAxis;
+	float coneCutoff;
+};
+
+namespace vkutil
+{
+	// average cache miss ratio: vertex shader invocations per triangle with a fifo cache.
+	// 0.5 is the ideal for a regular grid, 3.0 means no reuse at all.
+	float compute_acmr(std::span<const uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+	// average transform to vertex ratio: invocations per unique vertex, 1.0 is ideal
+	float compute_atvr(std::span<const uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+	// xyz center and w radius, around the center of the bounds. a little looser than the smallest sphere but cheap.
+	glm::vec4 compute_bounding_sphere(std::span<const Vertex> vertices);
+
+	// reorders triangles in place for post transform cache reuse (tipsify, Sander et al. 2007).
+	// runs in linear time, the triangle set and its winding are unchanged.
+	void optimize_vertex_cache(std::span<uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+	// reorders vertices by first use in the index buffer and rewrites the indices to match,
+	// so vertex fetch walks memory mostly forward. vertices no index refers to are dropped.
+	void optimize_vertex_fetch(std::vector<Vertex>& vertices, std::span<uint32_t> indices);
+
+	// splits the triangles into meshlets of at most maxVertices unique vertices and maxTriangles triangles,
+	// growing each one through shared edges so it stays compact. the indices are reordered in place so
+	// every meshlet is a contiguous range; the triangle set and its winding are unchanged.
+	std::vector<Meshlet> build_meshlets(std::span<const Vertex> vertices, std::span<uint32_t> indices,
+	                                    uint32_t maxVertices = MESHLET_MAX_VERTICES,
+	                                    uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+}
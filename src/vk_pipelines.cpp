@@ -1,53 +1,577 @@
 #include "vk_pipelines.h"
 
+#include <cstring>
 #include <iostream>
+#include <iterator>
 #include <fstream>
 #include <vector>
 
+#include "vk_types.h"
 
-VkResult vkutil::load_shader_module(const char* filePath,
-                                    VkDevice device,
-                                    VkShaderModule* outShaderModule)
+namespace
 {
-	// open the file. With cursor at the end
-	std::ifstream file(filePath, std::_Iosb<int>::ate | std::_Iosb<int>::binary);
+	constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+	// magic, version, generator, bound, schema
+	constexpr size_t SPIRV_HEADER_WORDS = 5;
+	constexpr uint32_t SPIRV_OP_DECORATE = 71;
+	constexpr uint32_t SPIRV_DECORATION_SPEC_ID = 1;
 
-	if (!file.is_open())
+	uint64_t fnv1a_64(const uint8_t* data, size_t size)
 	{
-		return VK_ERROR_UNKNOWN;
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= data[i];
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
 	}
 
-	// find what the size of the file is by looking up the location of the cursor
-	// because the cursor is at the end, it gives the size directly in bytes
-	const auto fileSize = static_cast<std::streamsize>(file.tellg());
+	VkResult map_spirv(const char* filePath, MappedFile& file)
+	{
+		if (!file.open(filePath))
+		{
+			std::cout << "Shader: could not open " << filePath << std::endl;
+			return VK_ERROR_UNKNOWN;
+		}
 
-	// spirv expects the buffer to be on uint32, so make sure to reserve an int
-	// vector big enough for the entire file
-	std::vector<uint32_t> buffer(fileSize / sizeof(uint32_t));
+		if (!vkutil::is_valid_spirv(file.data(), file.size()))
+		{
+			std::cout << "Shader: " << filePath << " is not a valid SPIR-V binary" << std::endl;
+			return VK_ERROR_INITIALIZATION_FAILED;
+		}
 
-	// put file cursor at beginning
-	file.seekg(0);
+		return VK_SUCCESS;
+	}
 
-	// load the entire file into the buffer
-	file.read(reinterpret_cast<char*>(buffer.data()), fileSize);
+	VkResult create_shader_module(VkDevice device, const MappedFile& file, VkShaderModule* outShaderModule)
+	{
+		// the mapping is page aligned, so the words can be handed to the driver in place
+		VkShaderModuleCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.pNext = nullptr;
+		createInfo.codeSize = file.size();
+		createInfo.pCode = reinterpret_cast<const uint32_t*>(file.data());
 
-	// now that the file is loaded into the buffer, we can close it
-	file.close();
+		return vkCreateShaderModule(device, &createInfo, nullptr, outShaderModule);
+	}
+}
 
-	// create a new shader module, using the buffer we loaded
-	VkShaderModuleCreateInfo createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.pNext = nullptr;
+bool vkutil::is_valid_spirv(const uint8_t* code, size_t size)
+{
+	if (code == nullptr || size < SPIRV_HEADER_WORDS * sizeof(uint32_t) || size % sizeof(uint32_t) != 0)
+	{
+		return false;
+	}
 
-	// codeSize has to be in bytes, so multiply the ints in the buffer by size of
-	// int to know the real size of the buffer
-	createInfo.codeSize = buffer.size() * sizeof(uint32_t);
-	createInfo.pCode = buffer.data();
+	uint32_t magic;
+	std::memcpy(&magic, code, sizeof(magic));
+
+	// vulkan only accepts modules in host endianness, so a byte swapped magic is an error too
+	return magic == SPIRV_MAGIC;
+}
+
+std::vector<uint32_t> vkutil::spirv_spec_ids(const uint8_t* code, size_t size)
+{
+	std::vector<uint32_t> ids;
+	if (!is_valid_spirv(code, size))
+	{
+		return ids;
+	}
+
+	std::vector<uint32_t> words(size / sizeof(uint32_t));
+	std::memcpy(words.data(), code, size);
+
+	// every instruction starts with its word count in the high half and its opcode in the low half
+	size_t offset = SPIRV_HEADER_WORDS;
+	while (offset < words.size())
+	{
+		const uint32_t wordCount = words[offset] >> 16;
+		const uint32_t opcode = words[offset] & 0xffff;
+		if (wordCount == 0 || offset + wordCount > words.size())
+		{
+			break;
+		}
+
+		// OpDecorate target SpecId id
+		if (opcode == SPIRV_OP_DECORATE && wordCount >= 4 && words[offset + 2] == SPIRV_DECORATION_SPEC_ID)
+		{
+			ids.push_back(words[offset + 3]);
+		}
+		offset += wordCount;
+	}
+	return ids;
+}
+
+VkResult ShaderModuleCache::load(VkDevice device, const char* filePath, VkShaderModule* outShaderModule)
+{
+	MappedFile file;
+	if (const VkResult result = map_spirv(filePath, file); result != VK_SUCCESS)
+	{
+		return result;
+	}
+
+	const Key key{ fnv1a_64(file.data(), file.size()) , file.size() };
+
+	std::lock_guard lock(modulesMutex);
+
+	if (const auto it = modules.find(key); it != modules.end())
+	{
+		reuseCount++;
+		*outShaderModule = it->second;
+		return VK_SUCCESS;
+	}
 
-	// check that the creation goes well.
 	VkShaderModule shaderModule;
-	const auto result = vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule);
-	
+	const VkResult result = create_shader_module(device, file, &shaderModule);
+	if (result != VK_SUCCESS)
+	{
+		return result;
+	}
+
+	modules.emplace(key, shaderModule);
 	*outShaderModule = shaderModule;
-	return result;
+	return VK_SUCCESS;
+}
+
+void ShaderModuleCache::destroy(VkDevice device)
+{
+	std::lock_guard lock(modulesMutex);
+
+	for (const auto& [key, shaderModule] : modules)
+	{
+		vkDestroyShaderModule(device, shaderModule, nullptr);
+	}
+	modules.clear();
+}
+
+void ShaderModuleCache::print_summary() const
+{
+	std::cout << "Shader modules: " << modules.size() << " unique, " << reuseCount << " reused" << std::endl;
+}
+
+const void* PipelineFeedback::chain(const uint32_t stageCount, const void* next)
+{
+	pipelineFeedback = {};
+	stageFeedbacks.assign(stageCount, VkPipelineCreationFeedback{});
+
+	createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO;
+	createInfo.pNext = next;
+	createInfo.pPipelineCreationFeedback = &pipelineFeedback;
+	createInfo.pipelineStageCreationFeedbackCount = stageCount;
+	createInfo.pPipelineStageCreationFeedbacks = stageFeedbacks.data();
+
+	return &createInfo;
+}
+
+bool PipelineFeedback::cache_hit() const
+{
+	return (pipelineFeedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT) &&
+		(pipelineFeedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT);
+}
+
+uint64_t PipelineFeedback::duration_ns() const
+{
+	return (pipelineFeedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT) ? pipelineFeedback.duration : 0;
+}
+
+namespace
+{
+	constexpr uint32_t PIPELINE_CACHE_MAGIC = 0x43504B56; // "VKPC"
+	constexpr uint32_t PIPELINE_CACHE_FILE_VERSION = 1;
+
+	// prefixed to the driver blob. the driver checks its own header too, but it does not
+	// know about driver updates that keep the cache uuid, so we check the version ourselves.
+	struct PipelineCacheFileHeader
+	{
+		uint32_t magic;
+		uint32_t fileVersion;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		uint64_t dataSize;
+		uint64_t dataHash;
+	};
+
+	PipelineCacheFileHeader make_header(const VkPhysicalDeviceProperties& properties)
+	{
+		PipelineCacheFileHeader header{};
+		header.magic = PIPELINE_CACHE_MAGIC;
+		header.fileVersion = PIPELINE_CACHE_FILE_VERSION;
+		header.vendorID = properties.vendorID;
+		header.deviceID = properties.deviceID;
+		header.driverVersion = properties.driverVersion;
+		std::memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+		return header;
+	}
+
+	// returns the driver blob if the file on disk matches this device and driver
+	std::vector<uint8_t> read_cache_file(const std::filesystem::path& path, const VkPhysicalDeviceProperties& properties)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+		{
+			return {};
+		}
+
+		const auto fileSize = static_cast<size_t>(file.tellg());
+		if (fileSize < sizeof(PipelineCacheFileHeader))
+		{
+			std::cout << "Pipeline cache: " << path.string() << " is truncated, ignoring it" << std::endl;
+			return {};
+		}
+
+		file.seekg(0);
+
+		PipelineCacheFileHeader header{};
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+		const PipelineCacheFileHeader expected = make_header(properties);
+		if (header.magic != expected.magic ||
+			header.fileVersion != expected.fileVersion ||
+			header.vendorID != expected.vendorID ||
+			header.deviceID != expected.deviceID ||
+			header.driverVersion != expected.driverVersion ||
+			std::memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+		{
+			std::cout << "Pipeline cache: " << path.string() << " was written by another device or driver, ignoring it" << std::endl;
+			return {};
+		}
+
+		if (header.dataSize != fileSize - sizeof(PipelineCacheFileHeader))
+		{
+			std::cout << "Pipeline cache: " << path.string() << " has a bad size, ignoring it" << std::endl;
+			return {};
+		}
+
+		std::vector<uint8_t> data(header.dataSize);
+		file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+		if (!file || fnv1a_64(data.data(), data.size()) != header.dataHash)
+		{
+			std::cout << "Pipeline cache: " << path.string() << " is corrupt, ignoring it" << std::endl;
+			return {};
+		}
+
+		return data;
+	}
+}
+
+void PipelineCache::init(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::filesystem::path& path)
+{
+	filePath = path;
+	deviceProperties = properties;
+
+	const std::vector<uint8_t> initialData = read_cache_file(filePath, deviceProperties);
+
+	VkPipelineCacheCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.pNext = nullptr;
+	createInfo.flags = 0;
+	createInfo.initialDataSize = initialData.size();
+	createInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+	VK_CHECK(vkCreatePipelineCache(device, &createInfo, nullptr, &cache));
+
+	if (initialData.empty())
+	{
+		std::cout << "Pipeline cache: cold start" << std::endl;
+	}
+	else
+	{
+		std::cout << "Pipeline cache: loaded " << initialData.size() << " bytes from " << filePath.string() << std::endl;
+	}
+}
+
+void PipelineCache::save(VkDevice device) const
+{
+	if (cache == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	size_t dataSize = 0;
+	VK_CHECK(vkGetPipelineCacheData(device, cache, &dataSize, nullptr));
+
+	std::vector<uint8_t> data(dataSize);
+	VK_CHECK(vkGetPipelineCacheData(device, cache, &dataSize, data.data()));
+	data.resize(dataSize);
+
+	PipelineCacheFileHeader header = make_header(deviceProperties);
+	header.dataSize = data.size();
+	header.dataHash = fnv1a_64(data.data(), data.size());
+
+	// write next to the real file and swap it in, so a crash mid-write never leaves a torn cache
+	std::filesystem::path tempPath = filePath;
+	tempPath += ".tmp";
+
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cout << "Pipeline cache: could not open " << tempPath.string() << std::endl;
+			return;
+		}
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+		if (!file.good())
+		{
+			std::cout << "Pipeline cache: failed to write " << tempPath.string() << std::endl;
+			return;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, filePath, error);
+	if (error)
+	{
+		std::cout << "Pipeline cache: failed to replace " << filePath.string() << ": " << error.message() << std::endl;
+		std::filesystem::remove(tempPath, error);
+	}
+}
+
+void PipelineCache::destroy(VkDevice device)
+{
+	vkDestroyPipelineCache(device, cache, nullptr);
+	cache = VK_NULL_HANDLE;
+}
+
+void PipelineCache::record_feedback(const char* pipelineName, const PipelineFeedback& feedback)
+{
+	const bool hit = feedback.cache_hit();
+	const uint64_t durationNs = feedback.duration_ns();
+
+	std::lock_guard lock(statsMutex);
+
+	hit ? hits++ : misses++;
+	totalCompileNs += durationNs;
+
+	if (logEachPipeline)
+	{
+		std::cout << "Pipeline '" << pipelineName << "': cache " << (hit ? "hit" : "miss") << ", "
+			<< static_cast<double>(durationNs) / 1000000.0 << " ms" << std::endl;
+	}
+}
+
+void PipelineCache::print_summary() const
+{
+	std::lock_guard lock(statsMutex);
+
+	std::cout << "Pipeline cache: " << hits << " hits, " << misses << " misses, "
+		<< static_cast<double>(totalCompileNs) / 1000000.0 << " ms creating pipelines" << std::endl;
+}
+
+void ComputePipelineDesc::set_workgroup_size(WorkgroupSize size)
+{
+	const uint32_t values[] = { size.x , size.y , size.z };
+
+	specializationEntries.clear();
+	specializationData.resize(sizeof(values));
+	std::memcpy(specializationData.data(), values, sizeof(values));
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		specializationEntries.push_back({ i , i * static_cast<uint32_t>(sizeof(uint32_t)) , sizeof(uint32_t) });
+	}
+}
+
+VkPipeline vkutil::create_compute_pipeline(VkDevice device, PipelineCache& cache, const ComputePipelineDesc& desc)
+{
+	VkSpecializationInfo specialization{};
+	specialization.mapEntryCount = static_cast<uint32_t>(desc.specializationEntries.size());
+	specialization.pMapEntries = desc.specializationEntries.data();
+	specialization.dataSize = desc.specializationData.size();
+	specialization.pData = desc.specializationData.data();
+
+	VkPipelineShaderStageCreateInfo stageInfo{};
+	stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stageInfo.pNext = nullptr;
+	stageInfo.flags = 0;
+	stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	stageInfo.module = desc.shader;
+	stageInfo.pName = "main";
+	stageInfo.pSpecializationInfo = desc.specializationEntries.empty() ? nullptr : &specialization;
+
+	VkComputePipelineCreateInfo pipelineCreateInfo{};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.pNext = nullptr;
+	pipelineCreateInfo.flags = 0;
+	pipelineCreateInfo.stage = stageInfo;
+	pipelineCreateInfo.layout = desc.layout;
+	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineCreateInfo.basePipelineIndex = 0;
+
+	PipelineFeedback feedback;
+	pipelineCreateInfo.pNext = feedback.chain(1, pipelineCreateInfo.pNext);
+
+	VkPipeline pipeline;
+	VK_CHECK(vkCreateComputePipelines(device, cache.cache, 1, &pipelineCreateInfo, nullptr, &pipeline));
+
+	cache.record_feedback(desc.name.c_str(), feedback);
+
+	return pipeline;
+}
+
+VkPipeline vkutil::create_graphics_pipeline(VkDevice device, PipelineCache& cache, const GraphicsPipelineDesc& desc)
+{
+	VkPipelineShaderStageCreateInfo stages[2]{};
+	for (auto& stage : stages)
+	{
+		stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stage.pNext = nullptr;
+		stage.pName = "main";
+	}
+	stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	stages[0].module = desc.vertexShader;
+	stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	stages[1].module = desc.fragmentShader;
+
+	// vertices are pulled from buffers in the shaders, so there is no fixed function vertex input
+	VkPipelineVertexInputStateCreateInfo vertexInput{};
+	vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = desc.topology;
+	inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+	VkPipelineViewportStateCreateInfo viewportState{};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer{};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.polygonMode = desc.polygonMode;
+	rasterizer.cullMode = desc.cullMode;
+	rasterizer.frontFace = desc.frontFace;
+	rasterizer.lineWidth = 1.0f;
+
+	VkPipelineMultisampleStateCreateInfo multisampling{};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+	multisampling.minSampleShading = 1.0f;
+
+	VkPipelineDepthStencilStateCreateInfo depthStencil{};
+	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable = desc.depthTest;
+	depthStencil.depthWriteEnable = desc.depthWrite;
+	depthStencil.depthCompareOp = desc.depthTest ? desc.depthCompare : VK_COMPARE_OP_NEVER;
+	depthStencil.minDepthBounds = 0.0f;
+	depthStencil.maxDepthBounds = 1.0f;
+
+	VkPipelineColorBlendAttachmentState blendAttachment{};
+	blendAttachment.colorWriteMask =
+		VK_COLOR_COMPONENT_R_BIT |
+		VK_COLOR_COMPONENT_G_BIT |
+		VK_COLOR_COMPONENT_B_BIT |
+		VK_COLOR_COMPONENT_A_BIT;
+
+	if (desc.alphaBlend)
+	{
+		blendAttachment.blendEnable = VK_TRUE;
+		blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+		blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+		blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+	}
+
+	const std::vector<VkPipelineColorBlendAttachmentState> blendAttachments(desc.colorFormats.size(), blendAttachment);
+
+	VkPipelineColorBlendStateCreateInfo colorBlending{};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.logicOpEnable = VK_FALSE;
+	colorBlending.logicOp = VK_LOGIC_OP_COPY;
+	colorBlending.attachmentCount = static_cast<uint32_t>(blendAttachments.size());
+	colorBlending.pAttachments = blendAttachments.data();
+
+	constexpr VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT , VK_DYNAMIC_STATE_SCISSOR };
+
+	VkPipelineDynamicStateCreateInfo dynamicInfo{};
+	dynamicInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicInfo.dynamicStateCount = static_cast<uint32_t>(std::size(dynamicStates));
+	dynamicInfo.pDynamicStates = dynamicStates;
+
+	VkPipelineRenderingCreateInfo renderingInfo{};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+	renderingInfo.pNext = nullptr;
+	renderingInfo.colorAttachmentCount = static_cast<uint32_t>(desc.colorFormats.size());
+	renderingInfo.pColorAttachmentFormats = desc.colorFormats.data();
+	renderingInfo.depthAttachmentFormat = desc.depthFormat;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = static_cast<uint32_t>(std::size(stages));
+	pipelineInfo.pStages = stages;
+	pipelineInfo.pVertexInputState = &vertexInput;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = &depthStencil;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = &dynamicInfo;
+	pipelineInfo.layout = desc.layout;
+	pipelineInfo.renderPass = VK_NULL_HANDLE;
+
+	PipelineFeedback feedback;
+	pipelineInfo.pNext = feedback.chain(pipelineInfo.stageCount, &renderingInfo);
+
+	VkPipeline pipeline;
+	VK_CHECK(vkCreateGraphicsPipelines(device, cache.cache, 1, &pipelineInfo, nullptr, &pipeline));
+
+	cache.record_feedback(desc.name.c_str(), feedback);
+
+	return pipeline;
+}
+
+void PipelineBuildQueue::init(VkDevice device, PipelineCache* cache, JobSystem* jobs)
+{
+	this->device = device;
+	this->cache = cache;
+	this->jobs = jobs;
+}
+
+std::shared_future<VkPipeline> PipelineBuildQueue::enqueue(ComputePipelineDesc desc)
+{
+	std::shared_future<VkPipeline> build = jobs->submit([this, desc = std::move(desc)]()
+	{
+		return vkutil::create_compute_pipeline(device, *cache, desc);
+	}).share();
+
+	builds.push_back(build);
+	return build;
+}
+
+std::shared_future<VkPipeline> PipelineBuildQueue::enqueue(GraphicsPipelineDesc desc)
+{
+	std::shared_future<VkPipeline> build = jobs->submit([this, desc = std::move(desc)]()
+	{
+		return vkutil::create_graphics_pipeline(device, *cache, desc);
+	}).share();
+
+	builds.push_back(build);
+	return build;
+}
+
+void PipelineBuildQueue::wait_all() const
+{
+	for (const auto& build : builds)
+	{
+		build.wait();
+	}
+}
+
+void PipelineBuildQueue::destroy()
+{
+	for (const auto& build : builds)
+	{
+		vkDestroyPipeline(device, build.get(), nullptr);
+	}
+	builds.clear();
 }
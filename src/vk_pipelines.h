@@ -1,8 +1,169 @@
+#pragma once
 
-
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include <vulkan/vulkan.h>
 
+#include "vk_jobs.h"
+#include "vk_mapped_file.h"
+
+namespace vkutil
+{
+	// checks size and magic before anything is handed to the driver
+	bool is_valid_spirv(const uint8_t* code, size_t size);
+
+	// the constant ids of the module's SpecId decorations, in the order they appear. empty for invalid SPIR-V.
+	std::vector<uint32_t> spirv_spec_ids(const uint8_t* code, size_t size);
+}
+
+// shader modules keyed by the hash of their SPIR-V, so pipelines sharing a shader share one module.
+// modules stay alive until destroy(), pipelines do not own them. files are mapped and the modules
+// created straight from the mapping.
+struct ShaderModuleCache
+{
+	VkResult load(VkDevice device, const char* filePath, VkShaderModule* outShaderModule);
+	void destroy(VkDevice device);
+
+	void print_summary() const;
+
+private:
+	struct Key
+	{
+		uint64_t hash;
+		size_t size;
+
+		bool operator==(const Key&) const = default;
+	};
+
+	struct KeyHasher
+	{
+		size_t operator()(const Key& key) const { return static_cast<size_t>(key.hash ^ key.size); }
+	};
+
+	std::mutex modulesMutex;
+	std::unordered_map<Key, VkShaderModule, KeyHasher> modules;
+	uint32_t reuseCount{ 0 };
+};
+
+// pipeline creation feedback (core in 1.3, VK_EXT_pipeline_creation_feedback before that).
+// chain it into a pipeline create info before the create call, read it afterwards.
+struct PipelineFeedback
+{
+	VkPipelineCreationFeedback pipelineFeedback{};
+	std::vector<VkPipelineCreationFeedback> stageFeedbacks;
+	VkPipelineCreationFeedbackCreateInfo createInfo{};
+
+	// returns the pNext to put on the create info, with the previous chain behind it
+	const void* chain(uint32_t stageCount, const void* next);
+
+	bool cache_hit() const;
+	uint64_t duration_ns() const;
+};
+
+// engine wide VkPipelineCache, persisted to disk between runs.
+// the file is only reused when it was written by the same device and driver.
+struct PipelineCache
+{
+	VkPipelineCache cache{ VK_NULL_HANDLE };
+
+	void init(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::filesystem::path& path);
+	// writes to a temporary file and renames it over the old one
+	void save(VkDevice device) const;
+	void destroy(VkDevice device);
+
+	// thread safe, pipelines may be built on worker threads
+	void record_feedback(const char* pipelineName, const PipelineFeedback& feedback);
+	void print_summary() const;
+
+	bool logEachPipeline{ true };
+
+private:
+	std::filesystem::path filePath;
+	VkPhysicalDeviceProperties deviceProperties{};
+
+	mutable std::mutex statsMutex;
+
+	uint32_t hits{ 0 };
+	uint32_t misses{ 0 };
+	uint64_t totalCompileNs{ 0 };
+};
+
+// a compute shader's local size, given as specialization constants to shaders that declare
+// local_size_x_id = 0, local_size_y_id = 1 and local_size_z_id = 2
+struct WorkgroupSize
+{
+	uint32_t x{ 1 };
+	uint32_t y{ 1 };
+	uint32_t z{ 1 };
+
+	uint32_t invocations() const { return x * y * z; }
+	bool operator==(const WorkgroupSize&) const = default;
+};
+
+struct ComputePipelineDesc
+{
+	std::string name;
+	VkShaderModule shader;
+	VkPipelineLayout layout;
+
+	// owned, so the desc can be queued for a build and outlive the caller's data
+	std::vector<VkSpecializationMapEntry> specializationEntries;
+	std::vector<uint8_t> specializationData;
+
+	// sets constants 0, 1 and 2 to the size
+	void set_workgroup_size(WorkgroupSize size);
+};
+
+// graphics pipelines always use dynamic rendering and dynamic viewport/scissor
+struct GraphicsPipelineDesc
+{
+	std::string name;
+	VkShaderModule vertexShader;
+	VkShaderModule fragmentShader;
+	VkPipelineLayout layout;
+
+	VkPrimitiveTopology topology{ VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST };
+	VkPolygonMode polygonMode{ VK_POLYGON_MODE_FILL };
+	VkCullModeFlags cullMode{ VK_CULL_MODE_NONE };
+	VkFrontFace frontFace{ VK_FRONT_FACE_CLOCKWISE };
+
+	bool depthTest{ false };
+	bool depthWrite{ false };
+	VkCompareOp depthCompare{ VK_COMPARE_OP_GREATER_OR_EQUAL };
+	bool alphaBlend{ false };
+
+	std::vector<VkFormat> colorFormats;
+	VkFormat depthFormat{ VK_FORMAT_UNDEFINED };
+};
+
 namespace vkutil
 {
-	VkResult load_shader_module(const char* filePath, VkDevice device, VkShaderModule* outShaderModule);
+	VkPipeline create_compute_pipeline(VkDevice device, PipelineCache& cache, const ComputePipelineDesc& desc);
+	VkPipeline create_graphics_pipeline(VkDevice device, PipelineCache& cache, const GraphicsPipelineDesc& desc);
 }
+
+// compiles pipelines on the job system. every build shares the one pipeline cache,
+// and callers only block on the futures of the pipelines they actually need.
+class PipelineBuildQueue
+{
+public:
+	void init(VkDevice device, PipelineCache* cache, JobSystem* jobs);
+
+	std::shared_future<VkPipeline> enqueue(ComputePipelineDesc desc);
+	std::shared_future<VkPipeline> enqueue(GraphicsPipelineDesc desc);
+
+	void wait_all() const;
+	// waits for outstanding builds, then destroys every pipeline built through the queue
+	void destroy();
+
+private:
+	VkDevice device{ VK_NULL_HANDLE };
+	PipelineCache* cache{ nullptr };
+	JobSystem* jobs{ nullptr };
+
+	std::vector<std::shared_future<VkPipeline>> builds;
+};
@@ -0,0 +1,181 @@
+#include "vk_present.h"
+
+#include <imgui.h>
+
+#include "vk_bindless.h"
+#include "vk_initializers.h"
+#include "vk_pipelines.h"
+
+namespace
+{
+	// flags in present.frag
+	constexpr uint32_t PRESENT_TONEMAP = 1;
+	constexpr uint32_t PRESENT_DITHER = 2;
+	constexpr uint32_t PRESENT_SRGB_TARGET = 4;
+
+	struct PresentPushConstants
+	{
+		uint32_t sourceImage;
+		uint32_t sourceSampler;
+		uint32_t renderWidth;
+		uint32_t renderHeight;
+		uint32_t outputWidth;
+		uint32_t outputHeight;
+		float exposure;
+		float sharpness;
+		uint32_t flags;
+		uint32_t frame;
+	};
+
+	static_assert(sizeof(PresentPushConstants) <= BINDLESS_PUSH_CONSTANT_SIZE);
+
+	// the hardware encodes these on store, the shader encodes for everything else
+	bool is_srgb(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+		case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+			return true;
+		default:
+			return false;
+		}
+	}
+}
+
+void PresentPass::init(VkDevice device, BindlessHeap& bindless, ShaderModuleCache& shaderModules,
+                       PipelineBuildQueue& pipelineBuilds, VkFormat targetFormat)
+{
+	format = targetFormat;
+
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.pNext = nullptr;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = 0.0f;
+
+	VK_CHECK(vkCreateSampler(device, &samplerInfo, nullptr, &sampler));
+	samplerIndex = bindless.register_sampler(device, sampler);
+
+	VkShaderModule vertexShader;
+	VK_CHECK(shaderModules.load(device, "../../shaders/fullscreen.vert.spv", &vertexShader));
+	VkShaderModule fragmentShader;
+	VK_CHECK(shaderModules.load(device, "../../shaders/present.frag.spv", &fragmentShader));
+
+	GraphicsPipelineDesc desc{};
+	desc.name = "present";
+	desc.vertexShader = vertexShader;
+	desc.fragmentShader = fragmentShader;
+	desc.layout = bindless.pipelineLayout;
+	desc.colorFormats = { targetFormat };
+
+	pipelineBuild = pipelineBuilds.enqueue(std::move(desc));
+}
+
+void PresentPass::destroy(VkDevice device, BindlessHeap& bindless, uint64_t frame)
+{
+	if (sourceIndex != BINDLESS_INVALID_INDEX)
+	{
+		bindless.release(BINDLESS_SAMPLED_IMAGES, sourceIndex, frame);
+		sourceIndex = BINDLESS_INVALID_INDEX;
+	}
+	if (samplerIndex != BINDLESS_INVALID_INDEX)
+	{
+		bindless.release(BINDLESS_SAMPLERS, samplerIndex, frame);
+		samplerIndex = BINDLESS_INVALID_INDEX;
+	}
+
+	// the pipeline belongs to the build queue
+	vkDestroySampler(device, sampler, nullptr);
+	sampler = VK_NULL_HANDLE;
+}
+
+void PresentPass::set_source(VkDevice device, BindlessHeap& bindless, VkImageView sourceView, uint64_t frame)
+{
+	if (sourceIndex != BINDLESS_INVALID_INDEX)
+	{
+		bindless.release(BINDLESS_SAMPLED_IMAGES, sourceIndex, frame);
+	}
+	sourceIndex = bindless.register_sampled_image(device, sourceView);
+}
+
+void PresentPass::wait_for_pipeline()
+{
+	if (pipeline == VK_NULL_HANDLE)
+	{
+		pipeline = pipelineBuild.get();
+	}
+}
+
+void PresentPass::record(VkCommandBuffer cmd, VkPipelineLayout layout, VkImageView target, VkExtent2D targetExtent,
+                         VkExtent2D renderExtent, uint64_t frame)
+{
+	wait_for_pipeline();
+
+	// every pixel is written, the old contents are never loaded
+	VkRenderingAttachmentInfo colorAttachment = vkinit::attachment_info(target, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+
+	const VkRenderingInfo renderInfo = vkinit::rendering_info(targetExtent, &colorAttachment, nullptr);
+	vkCmdBeginRendering(cmd, &renderInfo);
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+	VkViewport viewport{};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = static_cast<float>(targetExtent.width);
+	viewport.height = static_cast<float>(targetExtent.height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+	const VkRect2D scissor{ VkOffset2D{ 0 , 0 } , targetExtent };
+	vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+	uint32_t flags = 0;
+	flags |= tonemap ? PRESENT_TONEMAP : 0;
+	flags |= dither ? PRESENT_DITHER : 0;
+	flags |= is_srgb(format) ? PRESENT_SRGB_TARGET : 0;
+
+	const PresentPushConstants pushConstants{
+		sourceIndex ,
+		samplerIndex ,
+		renderExtent.width ,
+		renderExtent.height ,
+		targetExtent.width ,
+		targetExtent.height ,
+		exposure ,
+		sharpness ,
+		flags ,
+		static_cast<uint32_t>(frame)
+	};
+
+	vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_ALL, 0, sizeof(pushConstants), &pushConstants);
+
+	vkCmdDraw(cmd, 3, 1, 0, 0);
+
+	vkCmdEndRendering(cmd);
+}
+
+void PresentPass::draw_panel()
+{
+	if (!ImGui::Begin("Present"))
+	{
+		ImGui::End();
+		return;
+	}
+
+	ImGui::SliderFloat("Exposure", &exposure, 0.1f, 8.0f);
+	ImGui::SliderFloat("Sharpness", &sharpness, 0.0f, 1.0f);
+	ImGui::Checkbox("Tonemap", &tonemap);
+	ImGui::Checkbox("Dither", &dither);
+
+	ImGui::End();
+}
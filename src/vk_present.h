@@ -0,0 +1,55 @@
+#pragma once
+
+#include <future>
+
+#include "vk_types.h"
+
+class BindlessHeap;
+class PipelineBuildQueue;
+struct ShaderModuleCache;
+
+// the last pass of the frame, a fullscreen triangle into the swapchain image as a color attachment.
+// it tonemaps the hdr draw image, upscales it from the render extent with an edge adaptive filter,
+// sharpens and dithers, in place of the linear blit. a fragment pass rather than compute, because
+// the srgb swapchain formats can not be storage images.
+class PresentPass
+{
+public:
+	// applied before the tonemap
+	float exposure{ 1.0f };
+	// 0 is off, 1 is the strongest
+	float sharpness{ 0.25f };
+	// aces, off clamps the hdr color instead
+	bool tonemap{ true };
+	bool dither{ true };
+
+	// targetFormat is the format of every image the pass will write
+	void init(VkDevice device, BindlessHeap& bindless, ShaderModuleCache& shaderModules,
+	          PipelineBuildQueue& pipelineBuilds, VkFormat targetFormat);
+	// frame is the last one that may still sample the pass's descriptors
+	void destroy(VkDevice device, BindlessHeap& bindless, uint64_t frame);
+
+	// the hdr image frames are rendered into, read in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+	// the previous source's index goes back to the heap once frame has finished.
+	void set_source(VkDevice device, BindlessHeap& bindless, VkImageView sourceView, uint64_t frame);
+
+	bool is_ready() const { return pipeline != VK_NULL_HANDLE; }
+	void wait_for_pipeline();
+
+	// target must be in VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL and the bindless heap bound for graphics.
+	// renderExtent is the top left of the source the frame was rendered into.
+	void record(VkCommandBuffer cmd, VkPipelineLayout layout, VkImageView target, VkExtent2D targetExtent,
+	            VkExtent2D renderExtent, uint64_t frame);
+
+	// imgui window with the settings
+	void draw_panel();
+
+private:
+	std::shared_future<VkPipeline> pipelineBuild;
+	VkPipeline pipeline{ VK_NULL_HANDLE };
+	VkFormat format{ VK_FORMAT_UNDEFINED };
+
+	VkSampler sampler{ VK_NULL_HANDLE };
+	uint32_t samplerIndex{ UINT32_MAX };
+	uint32_t sourceIndex{ UINT32_MAX };
+};
@@ -0,0 +1,339 @@
+#include "vk_readback.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include <glm/gtc/packing.hpp>
+
+void ReadbackRing::init(VmaAllocator allocator, uint32_t slotCount, VkExtent2D extent)
+{
+	this->extent = extent;
+
+	// the draw image is RGBA16F, 8 bytes per texel
+	slotSize = static_cast<VkDeviceSize>(extent.width) * extent.height * 4 * sizeof(uint16_t);
+
+	VkBufferCreateInfo bufferInfo = { .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+	bufferInfo.pNext = nullptr;
+	bufferInfo.size = slotSize;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+	allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+	slots.resize(slotCount);
+	for (auto& slot : slots)
+	{
+		VK_CHECK(vmaCreateBuffer(
+			allocator,
+			&bufferInfo,
+			&allocInfo,
+			&slot.buffer.buffer,
+			&slot.buffer.allocation,
+			&slot.buffer.info));
+		slot.pendingFrame = -1;
+	}
+}
+
+void ReadbackRing::destroy(VmaAllocator allocator)
+{
+	for (const auto& slot : slots)
+	{
+		vmaDestroyBuffer(allocator, slot.buffer.buffer, slot.buffer.allocation);
+	}
+	slots.clear();
+}
+
+void ReadbackRing::record_copy(VkCommandBuffer cmd, VkImage image, VkExtent2D copyExtent, int frameNumber)
+{
+	auto& slot = slots[frameNumber % slots.size()];
+	slot.extent = VkExtent2D{ std::min(copyExtent.width, extent.width) , std::min(copyExtent.height, extent.height) };
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+
+	region.imageOffset = VkOffset3D{ 0 , 0 , 0 };
+	region.imageExtent = VkExtent3D{ slot.extent.width , slot.extent.height , 1 };
+
+	vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer.buffer, 1, &region);
+
+	// make the transfer write visible to host reads once the frame has completed
+	VkMemoryBarrier2 hostBarrier{};
+	hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+	hostBarrier.pNext = nullptr;
+	hostBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+	hostBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+	hostBarrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+	hostBarrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+
+	VkDependencyInfo depInfo{};
+	depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	depInfo.pNext = nullptr;
+	depInfo.memoryBarrierCount = 1;
+	depInfo.pMemoryBarriers = &hostBarrier;
+
+	vkCmdPipelineBarrier2(cmd, &depInfo);
+
+	slot.pendingFrame = frameNumber;
+}
+
+bool ReadbackRing::collect(VmaAllocator allocator, int completedFrame, ReadbackFrame& out)
+{
+	if (completedFrame < 0 || slots.empty())
+	{
+		return false;
+	}
+
+	auto& slot = slots[completedFrame % slots.size()];
+	if (slot.pendingFrame != completedFrame)
+	{
+		return false;
+	}
+
+	VK_CHECK(vmaInvalidateAllocation(allocator, slot.buffer.allocation, 0, VK_WHOLE_SIZE));
+
+	out.frameNumber = completedFrame;
+	out.extent = slot.extent;
+	out.pixels.resize(static_cast<size_t>(slot.extent.width) * slot.extent.height * 4);
+	std::memcpy(out.pixels.data(), slot.buffer.info.pMappedData, out.pixels.size() * sizeof(uint16_t));
+
+	slot.pendingFrame = -1;
+	return true;
+}
+
+void FrameWriter::start(const std::filesystem::path& directory, size_t maxQueuedFrames)
+{
+	outputDirectory = directory;
+	maxQueued = maxQueuedFrames;
+	droppedFrames = 0;
+	stopRequested = false;
+
+	std::filesystem::create_directories(outputDirectory);
+
+	worker = std::thread(&FrameWriter::worker_loop, this);
+}
+
+void FrameWriter::stop()
+{
+	if (!worker.joinable())
+	{
+		return;
+	}
+
+	{
+		std::lock_guard lock(queueMutex);
+		stopRequested = true;
+	}
+	queueCondition.notify_one();
+
+	worker.join();
+}
+
+void FrameWriter::enqueue(ReadbackFrame&& frame)
+{
+	{
+		std::lock_guard lock(queueMutex);
+		if (queue.size() >= maxQueued)
+		{
+			droppedFrames++;
+			return;
+		}
+		queue.push_back(std::move(frame));
+	}
+	queueCondition.notify_one();
+}
+
+void FrameWriter::worker_loop()
+{
+	// the draw image holds linear values, the swapchain it is normally blitted to is sRGB.
+	// encode through a table so the pngs match what ends up on screen.
+	constexpr size_t lutSize = 4096;
+	std::array<uint8_t, lutSize> srgbLut{};
+	for (size_t i = 0; i < lutSize; i++)
+	{
+		const float linear = static_cast<float>(i) / static_cast<float>(lutSize - 1);
+		const float srgb = linear <= 0.0031308f
+			                   ? linear * 12.92f
+			                   : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+		srgbLut[i] = static_cast<uint8_t>(std::lround(srgb * 255.0f));
+	}
+
+	const auto to_lut_index = [](float value)
+	{
+		value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+		return static_cast<size_t>(value * static_cast<float>(lutSize - 1) + 0.5f);
+	};
+
+	std::vector<uint8_t> rgba;
+
+	while (true)
+	{
+		ReadbackFrame frame;
+		{
+			std::unique_lock lock(queueMutex);
+			queueCondition.wait(lock, [&] { return stopRequested || !queue.empty(); });
+
+			if (queue.empty())
+			{
+				return;
+			}
+
+			frame = std::move(queue.front());
+			queue.pop_front();
+		}
+
+		const size_t texelCount = static_cast<size_t>(frame.extent.width) * frame.extent.height;
+		rgba.resize(texelCount * 4);
+
+		for (size_t i = 0; i < texelCount; i++)
+		{
+			const uint16_t* texel = &frame.pixels[i * 4];
+			rgba[i * 4 + 0] = srgbLut[to_lut_index(glm::unpackHalf1x16(texel[0]))];
+			rgba[i * 4 + 1] = srgbLut[to_lut_index(glm::unpackHalf1x16(texel[1]))];
+			rgba[i * 4 + 2] = srgbLut[to_lut_index(glm::unpackHalf1x16(texel[2]))];
+			// alpha is stored linearly
+			rgba[i * 4 + 3] = static_cast<uint8_t>(
+				to_lut_index(glm::unpackHalf1x16(texel[3])) * 255 / (lutSize - 1));
+		}
+
+		char fileName[32];
+		std::snprintf(fileName, sizeof(fileName), "frame_%05d.png", frame.frameNumber);
+
+		if (!vkutil::write_png(outputDirectory / fileName, frame.extent.width, frame.extent.height, rgba.data()))
+		{
+			std::cout << "Failed to write " << (outputDirectory / fileName).string() << std::endl;
+		}
+	}
+}
+
+namespace
+{
+	uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t size)
+	{
+		static const auto table = []
+		{
+			std::array<uint32_t, 256> t{};
+			for (uint32_t n = 0; n < 256; n++)
+			{
+				uint32_t c = n;
+				for (int k = 0; k < 8; k++)
+				{
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				}
+				t[n] = c;
+			}
+			return t;
+		}();
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++)
+		{
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	void append_u32_be(std::vector<uint8_t>& out, uint32_t value)
+	{
+		out.push_back(static_cast<uint8_t>(value >> 24));
+		out.push_back(static_cast<uint8_t>(value >> 16));
+		out.push_back(static_cast<uint8_t>(value >> 8));
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	void write_chunk(std::ofstream& file, const char type[4], const std::vector<uint8_t>& data)
+	{
+		std::vector<uint8_t> chunk;
+		chunk.reserve(data.size() + 12);
+
+		append_u32_be(chunk, static_cast<uint32_t>(data.size()));
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+
+		// the crc covers the type and the data, not the length
+		append_u32_be(chunk, crc32_update(0, chunk.data() + 4, data.size() + 4));
+
+		file.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+	}
+}
+
+bool vkutil::write_png(const std::filesystem::path& path, uint32_t width, uint32_t height, const uint8_t* rgba)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	constexpr uint8_t signature[] = { 0x89 , 'P' , 'N' , 'G' , '\r' , '\n' , 0x1A , '\n' };
+	file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+	std::vector<uint8_t> header;
+	append_u32_be(header, width);
+	append_u32_be(header, height);
+	header.push_back(8); // bit depth
+	header.push_back(6); // color type: RGBA
+	header.push_back(0); // compression
+	header.push_back(0); // filter
+	header.push_back(0); // interlace
+	write_chunk(file, "IHDR", header);
+
+	// every scanline is prefixed with filter type 0 (none)
+	const size_t rowSize = static_cast<size_t>(width) * 4;
+	std::vector<uint8_t> raw;
+	raw.reserve((rowSize + 1) * height);
+	for (uint32_t y = 0; y < height; y++)
+	{
+		raw.push_back(0);
+		raw.insert(raw.end(), rgba + y * rowSize, rgba + (y + 1) * rowSize);
+	}
+
+	// zlib stream made of stored deflate blocks, capped at 65535 bytes each
+	std::vector<uint8_t> zlib;
+	zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+	zlib.push_back(0x78);
+	zlib.push_back(0x01);
+
+	uint32_t adlerA = 1, adlerB = 0;
+	size_t offset = 0;
+	do
+	{
+		const size_t blockSize = std::min<size_t>(65535, raw.size() - offset);
+		const bool finalBlock = offset + blockSize == raw.size();
+
+		zlib.push_back(finalBlock ? 1 : 0);
+		zlib.push_back(static_cast<uint8_t>(blockSize));
+		zlib.push_back(static_cast<uint8_t>(blockSize >> 8));
+		zlib.push_back(static_cast<uint8_t>(~blockSize));
+		zlib.push_back(static_cast<uint8_t>(~blockSize >> 8));
+		zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+
+		for (size_t i = offset; i < offset + blockSize; i++)
+		{
+			adlerA = (adlerA + raw[i]) % 65521;
+			adlerB = (adlerB + adlerA) % 65521;
+		}
+
+		offset += blockSize;
+	}
+	while (offset < raw.size());
+
+	append_u32_be(zlib, (adlerB << 16) | adlerA);
+	write_chunk(file, "IDAT", zlib);
+
+	write_chunk(file, "IEND", {});
+
+	return file.good();
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "vk_types.h"
+
+// pixels copied out of a readback slot, ready to be encoded off the render thread
+struct ReadbackFrame
+{
+	int frameNumber;
+	VkExtent2D extent;
+	std::vector<uint16_t> pixels; // RGBA16F, tightly packed
+};
+
+// ring of persistently mapped host buffers the draw image is copied into.
+// a slot written on frame N is only read back once frame N has been waited on,
+// so the copy never stalls the frame that recorded it.
+class ReadbackRing
+{
+public:
+	void init(VmaAllocator allocator, uint32_t slotCount, VkExtent2D extent);
+	void destroy(VmaAllocator allocator);
+
+	// image must be in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL. copies the top left copyExtent,
+	// at most the extent the ring was created with.
+	void record_copy(VkCommandBuffer cmd, VkImage image, VkExtent2D copyExtent, int frameNumber);
+
+	// copies out the slot written by completedFrame, if there is one
+	bool collect(VmaAllocator allocator, int completedFrame, ReadbackFrame& out);
+
+private:
+	struct Slot
+	{
+		AllocatedBuffer buffer;
+		int pendingFrame{ -1 };
+		VkExtent2D extent{};
+	};
+
+	std::vector<Slot> slots;
+	VkExtent2D extent{};
+	VkDeviceSize slotSize{ 0 };
+};
+
+// encodes readback frames to PNG on a worker thread
+class FrameWriter
+{
+public:
+	void start(const std::filesystem::path& directory, size_t maxQueuedFrames = 8);
+
+	// drains the queue and joins the worker
+	void stop();
+
+	// never blocks on encoding; frames are dropped if the worker falls behind
+	void enqueue(ReadbackFrame&& frame);
+
+	bool is_running() const { return worker.joinable(); }
+	size_t dropped_frames() const { return droppedFrames; }
+
+private:
+	void worker_loop();
+
+	std::filesystem::path outputDirectory;
+	size_t maxQueued{ 0 };
+	size_t droppedFrames{ 0 };
+
+	std::thread worker;
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	std::deque<ReadbackFrame> queue;
+	bool stopRequested{ false };
+};
+
+namespace vkutil
+{
+	// writes an 8 bit RGBA image as an uncompressed (stored deflate) png
+	bool write_png(const std::filesystem::path& path, uint32_t width, uint32_t height, const uint8_t* rgba);
+}
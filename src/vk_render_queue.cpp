@@ -0,0 +1,189 @@
+#include "vk_render_queue.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <iostream>
+
+#include <imgui.h>
+
+namespace
+{
+	constexpr uint32_t RADIX_BITS = 8;
+	constexpr uint32_t RADIX_BUCKETS = 1u << RADIX_BITS;
+	constexpr uint32_t RADIX_PASSES = 64 / RADIX_BITS;
+
+	void print_binds(const char* label, uint64_t unsorted, uint64_t sorted, double frames)
+	{
+		std::cout << "  " << label << ": " << static_cast<double>(unsorted) / frames << " -> "
+			<< static_cast<double>(sorted) / frames << " binds/frame" << std::endl;
+	}
+}
+
+uint64_t DrawSortKey::pack(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth)
+{
+	const auto bits = [](uint32_t value, uint32_t width)
+	{
+		return static_cast<uint64_t>(value & ((1u << width) - 1));
+	};
+
+	// a positive float's bits order the same as its value, the top ones keep the exponent and some mantissa
+	const uint32_t depthBits = std::bit_cast<uint32_t>(std::max(depth, 0.f)) >> (32 - DEPTH_BITS);
+
+	return bits(pass, PASS_BITS) << PASS_SHIFT
+		| bits(pipeline, PIPELINE_BITS) << PIPELINE_SHIFT
+		| bits(material, MATERIAL_BITS) << MATERIAL_SHIFT
+		| bits(mesh, MESH_BITS) << MESH_SHIFT
+		| static_cast<uint64_t>(depthBits) << DEPTH_SHIFT;
+}
+
+void vkutil::radix_sort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values,
+                        std::vector<uint64_t>& keyScratch, std::vector<uint32_t>& valueScratch)
+{
+	const size_t count = keys.size();
+	keyScratch.resize(count);
+	valueScratch.resize(count);
+
+	// every digit's histogram in one read of the keys
+	std::array<std::array<uint32_t, RADIX_BUCKETS>, RADIX_PASSES> histograms{};
+	for (const uint64_t key : keys)
+	{
+		for (uint32_t pass = 0; pass < RADIX_PASSES; pass++)
+		{
+			histograms[pass][(key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+		}
+	}
+
+	for (uint32_t pass = 0; pass < RADIX_PASSES; pass++)
+	{
+		std::array<uint32_t, RADIX_BUCKETS>& histogram = histograms[pass];
+
+		// one bucket holding everything would copy the keys over in the same order
+		if (count == 0 || histogram[(keys[0] >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)] == count)
+		{
+			continue;
+		}
+
+		uint32_t offset = 0;
+		for (uint32_t& bucket : histogram)
+		{
+			const uint32_t bucketCount = bucket;
+			bucket = offset;
+			offset += bucketCount;
+		}
+
+		const uint32_t shift = pass * RADIX_BITS;
+		for (size_t i = 0; i < count; i++)
+		{
+			const uint32_t target = histogram[(keys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+			keyScratch[target] = keys[i];
+			valueScratch[target] = values[i];
+		}
+
+		keys.swap(keyScratch);
+		values.swap(valueScratch);
+	}
+}
+
+void RenderQueue::clear()
+{
+	keys.clear();
+	draws.clear();
+}
+
+void RenderQueue::push(uint64_t key, uint32_t draw)
+{
+	keys.push_back(key);
+	draws.push_back(draw);
+}
+
+void RenderQueue::sort()
+{
+	sortedKeys.assign(keys.begin(), keys.end());
+	sortedDraws.assign(draws.begin(), draws.end());
+
+	if (enabled)
+	{
+		vkutil::radix_sort(sortedKeys, sortedDraws, keyScratch, drawScratch);
+	}
+}
+
+RenderQueue::BindCounts RenderQueue::count_binds(std::span<const uint64_t> keys, uint32_t drawsPerRecording)
+{
+	assert(drawsPerRecording > 0);
+
+	BindCounts binds{};
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		const uint64_t key = keys[i];
+
+		if (i % drawsPerRecording == 0)
+		{
+			binds.pipelines++;
+			binds.materials++;
+			binds.indexBuffers++;
+			continue;
+		}
+
+		const uint64_t previous = keys[i - 1];
+		binds.pipelines += DrawSortKey::pass(key) != DrawSortKey::pass(previous) ||
+			DrawSortKey::pipeline(key) != DrawSortKey::pipeline(previous);
+		binds.materials += DrawSortKey::material(key) != DrawSortKey::material(previous);
+		binds.indexBuffers += DrawSortKey::mesh(key) != DrawSortKey::mesh(previous);
+	}
+	return binds;
+}
+
+void RenderQueue::record_stats(uint32_t drawsPerRecording, double sortMs)
+{
+	lastStats.draws = static_cast<uint32_t>(keys.size());
+	lastStats.unsorted = count_binds(keys, drawsPerRecording);
+	lastStats.sorted = count_binds(sortedKeys, drawsPerRecording);
+	lastStats.sortMs = sortMs;
+
+	statsFrames++;
+	totalDraws += lastStats.draws;
+	totalUnsorted.pipelines += lastStats.unsorted.pipelines;
+	totalUnsorted.materials += lastStats.unsorted.materials;
+	totalUnsorted.indexBuffers += lastStats.unsorted.indexBuffers;
+	totalSorted.pipelines += lastStats.sorted.pipelines;
+	totalSorted.materials += lastStats.sorted.materials;
+	totalSorted.indexBuffers += lastStats.sorted.indexBuffers;
+	totalSortMs += sortMs;
+}
+
+void RenderQueue::print_summary() const
+{
+	if (statsFrames == 0)
+	{
+		return;
+	}
+
+	const double frames = static_cast<double>(statsFrames);
+	std::cout << "Draw sorting (" << (enabled ? "on" : "off") << "): " << static_cast<uint64_t>(totalDraws / statsFrames)
+		<< " draws/frame, keys and sort " << totalSortMs / frames << " ms/frame" << std::endl;
+	print_binds("pipelines", totalUnsorted.pipelines, totalSorted.pipelines, frames);
+	print_binds("materials", totalUnsorted.materials, totalSorted.materials, frames);
+	print_binds("index buffers", totalUnsorted.indexBuffers, totalSorted.indexBuffers, frames);
+}
+
+void RenderQueue::draw_panel()
+{
+	if (!ImGui::Begin("Draw sorting"))
+	{
+		ImGui::End();
+		return;
+	}
+
+	ImGui::Checkbox("Sort draws", &enabled);
+	ImGui::Text("%u draws, keys and sort %.3f ms", lastStats.draws, lastStats.sortMs);
+
+	ImGui::Separator();
+	ImGui::Text("Binds          unsorted   sorted");
+	ImGui::Text("Pipelines      %8u %8u", lastStats.unsorted.pipelines, lastStats.sorted.pipelines);
+	ImGui::Text("Materials      %8u %8u", lastStats.unsorted.materials, lastStats.sorted.materials);
+	ImGui::Text("Index buffers  %8u %8u", lastStats.unsorted.indexBuffers, lastStats.sorted.indexBuffers);
+
+	ImGui::End();
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// a draw's place in the submission order packed into 64 bits, the most significant field first:
+// pass, pipeline, material, mesh, depth. sorting the keys groups draws by the state they need,
+// the costliest change outermost, and orders each group front to back.
+struct DrawSortKey
+{
+	static constexpr uint32_t PASS_BITS = 4;
+	static constexpr uint32_t PIPELINE_BITS = 10;
+	static constexpr uint32_t MATERIAL_BITS = 14;
+	static constexpr uint32_t MESH_BITS = 16;
+	static constexpr uint32_t DEPTH_BITS = 20;
+
+	static constexpr uint32_t DEPTH_SHIFT = 0;
+	static constexpr uint32_t MESH_SHIFT = DEPTH_SHIFT + DEPTH_BITS;
+	static constexpr uint32_t MATERIAL_SHIFT = MESH_SHIFT + MESH_BITS;
+	static constexpr uint32_t PIPELINE_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+	static constexpr uint32_t PASS_SHIFT = PIPELINE_SHIFT + PIPELINE_BITS;
+	static_assert(PASS_SHIFT + PASS_BITS == 64);
+
+	// depth is the view distance, 0 or more. ids past their field's width are truncated.
+	static uint64_t pack(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+
+	static uint32_t pass(uint64_t key) { return field(key, PASS_SHIFT, PASS_BITS); }
+	static uint32_t pipeline(uint64_t key) { return field(key, PIPELINE_SHIFT, PIPELINE_BITS); }
+	static uint32_t material(uint64_t key) { return field(key, MATERIAL_SHIFT, MATERIAL_BITS); }
+	static uint32_t mesh(uint64_t key) { return field(key, MESH_SHIFT, MESH_BITS); }
+
+private:
+	static uint32_t field(uint64_t key, uint32_t shift, uint32_t bits)
+	{
+		return static_cast<uint32_t>(key >> shift) & ((1u << bits) - 1);
+	}
+};
+
+namespace vkutil
+{
+	// least significant digit first radix sort of the keys, 8 bits a pass, carrying values along. stable.
+	// a digit every key shares is skipped, so keys that only differ in a few fields take a few passes.
+	// the scratch vectors are resized as needed and hold garbage afterwards.
+	void radix_sort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values,
+	                std::vector<uint64_t>& keyScratch, std::vector<uint32_t>& valueScratch);
+}
+
+// the draws of a frame in the order they get recorded. push a key per draw, sort, then record
+// the draws in order(), binding only what changed from the draw before.
+class RenderQueue
+{
+public:
+	// the binds a recording needs when it binds each piece of state only when it changes
+	struct BindCounts
+	{
+		uint32_t pipelines;
+		// per material descriptor sets. the bindless heap needs none, this is what the order would cost with them.
+		uint32_t materials;
+		uint32_t indexBuffers;
+	};
+
+	struct FrameStats
+	{
+		uint32_t draws;
+		// in push order, and after sorting
+		BindCounts unsorted;
+		BindCounts sorted;
+		// building the keys and sorting them
+		double sortMs;
+	};
+
+	// off leaves the draws in push order
+	bool enabled{ true };
+
+	void clear();
+	void push(uint64_t key, uint32_t draw);
+	void sort();
+
+	size_t size() const { return keys.size(); }
+	// the draws and their keys in recording order, valid after sort
+	std::span<const uint32_t> order() const { return sortedDraws; }
+	std::span<const uint64_t> sorted_keys() const { return sortedKeys; }
+
+	// binds for the keys in push order and in sorted order, when every run of drawsPerRecording
+	// draws is recorded on its own and starts with nothing bound
+	static BindCounts count_binds(std::span<const uint64_t> keys, uint32_t drawsPerRecording);
+
+	// counts the binds and adds them with sortMs to the running averages
+	void record_stats(uint32_t drawsPerRecording, double sortMs);
+	const FrameStats& last_stats() const { return lastStats; }
+	void print_summary() const;
+	void draw_panel();
+
+private:
+	// in push order
+	std::vector<uint64_t> keys;
+	std::vector<uint32_t> draws;
+	std::vector<uint64_t> sortedKeys;
+	std::vector<uint32_t> sortedDraws;
+	std::vector<uint64_t> keyScratch;
+	std::vector<uint32_t> drawScratch;
+
+	struct BindTotals
+	{
+		uint64_t pipelines;
+		uint64_t materials;
+		uint64_t indexBuffers;
+	};
+
+	FrameStats lastStats{};
+	uint64_t statsFrames{ 0 };
+	uint64_t totalDraws{ 0 };
+	BindTotals totalUnsorted{};
+	BindTotals totalSorted{};
+	double totalSortMs{ 0.0 };
+};
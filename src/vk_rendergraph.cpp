@@ -0,0 +1,444 @@
+#include "vk_rendergraph.h"
+
+#include <iostream>
+
+#include "vk_gpu_profiler.h"
+#include "vk_initializers.h"
+
+namespace
+{
+	constexpr VkAccessFlags2 WRITE_ACCESS =
+		VK_ACCESS_2_SHADER_WRITE_BIT
+		| VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT
+		| VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT
+		| VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+		| VK_ACCESS_2_TRANSFER_WRITE_BIT
+		| VK_ACCESS_2_HOST_WRITE_BIT
+		| VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+	struct UsageInfo
+	{
+		VkPipelineStageFlags2 stages;
+		VkAccessFlags2 access;
+		// buffers have none
+		VkImageLayout layout{ VK_IMAGE_LAYOUT_UNDEFINED };
+	};
+
+	VkPipelineStageFlags2 shader_stages(PassType type)
+	{
+		switch (type)
+		{
+		case PassType::Compute:
+			return VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+		case PassType::Graphics:
+			return VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+		default:
+			// transfer passes run no shaders
+			return VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+		}
+	}
+
+	UsageInfo image_usage_info(ImageUsage usage, PassType type)
+	{
+		switch (usage)
+		{
+		case ImageUsage::StorageRead:
+			return { shader_stages(type) , VK_ACCESS_2_SHADER_STORAGE_READ_BIT , VK_IMAGE_LAYOUT_GENERAL };
+		case ImageUsage::StorageWrite:
+			return { shader_stages(type) , VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT , VK_IMAGE_LAYOUT_GENERAL };
+		case ImageUsage::StorageReadWrite:
+			return {
+				shader_stages(type) ,
+				VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT ,
+				VK_IMAGE_LAYOUT_GENERAL
+			};
+		case ImageUsage::Sampled:
+			return { shader_stages(type) , VK_ACCESS_2_SHADER_SAMPLED_READ_BIT , VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		case ImageUsage::ColorAttachment:
+			return {
+				VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT ,
+				VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT ,
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+			};
+		case ImageUsage::DepthAttachment:
+			return {
+				VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT ,
+				VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT ,
+				VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL
+			};
+		case ImageUsage::DepthRead:
+			return { shader_stages(type) , VK_ACCESS_2_SHADER_SAMPLED_READ_BIT , VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL };
+		case ImageUsage::TransferSrc:
+			return { VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT , VK_ACCESS_2_TRANSFER_READ_BIT , VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL };
+		case ImageUsage::TransferDst:
+			return { VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT , VK_ACCESS_2_TRANSFER_WRITE_BIT , VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+		case ImageUsage::Present:
+			// nothing is recorded after it. all commands is what the render semaphore signal waits on,
+			// which the transition has to chain into.
+			return { VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT , VK_ACCESS_2_NONE , VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
+		}
+		return { VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT , VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT , VK_IMAGE_LAYOUT_GENERAL };
+	}
+
+	UsageInfo buffer_usage_info(BufferUsage usage, PassType type)
+	{
+		switch (usage)
+		{
+		case BufferUsage::StorageRead:
+			return { shader_stages(type) , VK_ACCESS_2_SHADER_STORAGE_READ_BIT };
+		case BufferUsage::StorageWrite:
+			return { shader_stages(type) , VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT };
+		case BufferUsage::StorageReadWrite:
+			return { shader_stages(type) , VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT };
+		case BufferUsage::IndirectRead:
+			return { VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT , VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT };
+		case BufferUsage::IndexRead:
+			return { VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT , VK_ACCESS_2_INDEX_READ_BIT };
+		case BufferUsage::TransferSrc:
+			return { VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT , VK_ACCESS_2_TRANSFER_READ_BIT };
+		case BufferUsage::TransferDst:
+			return { VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT , VK_ACCESS_2_TRANSFER_WRITE_BIT };
+		case BufferUsage::HostRead:
+			return { VK_PIPELINE_STAGE_2_HOST_BIT , VK_ACCESS_2_HOST_READ_BIT };
+		}
+		return { VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT , VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT };
+	}
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::read(RGImage image, ImageUsage usage)
+{
+	const UsageInfo info = image_usage_info(usage, graph.passes[pass].type);
+	graph.add_access(pass, { true , false , image.index , info.stages , info.access , info.layout });
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::write(RGImage image, ImageUsage usage)
+{
+	const UsageInfo info = image_usage_info(usage, graph.passes[pass].type);
+	graph.add_access(pass, { true , true , image.index , info.stages , info.access , info.layout });
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::read(RGBuffer buffer, BufferUsage usage)
+{
+	const UsageInfo info = buffer_usage_info(usage, graph.passes[pass].type);
+	graph.add_access(pass, { false , false , buffer.index , info.stages , info.access , VK_IMAGE_LAYOUT_UNDEFINED });
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::write(RGBuffer buffer, BufferUsage usage)
+{
+	const UsageInfo info = buffer_usage_info(usage, graph.passes[pass].type);
+	graph.add_access(pass, { false , true , buffer.index , info.stages , info.access , VK_IMAGE_LAYOUT_UNDEFINED });
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::keep()
+{
+	graph.passes[pass].keep = true;
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::execute(std::function<void(VkCommandBuffer cmd)>&& function)
+{
+	graph.passes[pass].function = std::move(function);
+	return *this;
+}
+
+void RenderGraph::reset()
+{
+	passes.clear();
+	images.clear();
+	buffers.clear();
+}
+
+RGImage RenderGraph::import_image(VkImage image, VkImageAspectFlags aspect, bool discard)
+{
+	ResourceState state{};
+	if (const auto it = retainedImages.find(image); it != retainedImages.end())
+	{
+		state = it->second;
+	}
+
+	// the next use transitions from undefined, still waiting on whatever used the image last
+	if (discard)
+	{
+		state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	}
+
+	images.push_back({ image , aspect , state , true });
+	return { static_cast<uint32_t>(images.size() - 1) };
+}
+
+RGImage RenderGraph::import_image(VkImage image, VkImageAspectFlags aspect, const ResourceState& state)
+{
+	images.push_back({ image , aspect , state , false });
+	return { static_cast<uint32_t>(images.size() - 1) };
+}
+
+RGBuffer RenderGraph::import_buffer(VkBuffer buffer)
+{
+	ResourceState state{};
+	if (const auto it = retainedBuffers.find(buffer); it != retainedBuffers.end())
+	{
+		state = it->second;
+	}
+
+	buffers.push_back({ buffer , state });
+	return { static_cast<uint32_t>(buffers.size() - 1) };
+}
+
+void RenderGraph::export_image(RGImage image, ImageUsage finalUsage)
+{
+	images[image.index].exported = true;
+	images[image.index].finalUsage = finalUsage;
+}
+
+void RenderGraph::export_buffer(RGBuffer buffer)
+{
+	buffers[buffer.index].exported = true;
+}
+
+void RenderGraph::forget_image(VkImage image)
+{
+	retainedImages.erase(image);
+}
+
+void RenderGraph::forget_buffer(VkBuffer buffer)
+{
+	retainedBuffers.erase(buffer);
+}
+
+RenderGraph::PassBuilder RenderGraph::add_pass(const char* name, PassType type)
+{
+	Pass& pass = passes.emplace_back();
+	pass.name = name;
+	pass.type = type;
+	return { *this , static_cast<uint32_t>(passes.size() - 1) };
+}
+
+void RenderGraph::add_access(uint32_t pass, const Access& access)
+{
+	passes[pass].accesses.push_back(access);
+}
+
+void RenderGraph::cull()
+{
+	// walking back from the exports, a pass lives if it writes something a later live pass needs.
+	// a write never clears the need, it may only cover part of the resource.
+	std::vector<bool> imageNeeded(images.size(), false);
+	std::vector<bool> bufferNeeded(buffers.size(), false);
+
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		imageNeeded[i] = images[i].exported;
+	}
+	for (size_t i = 0; i < buffers.size(); i++)
+	{
+		bufferNeeded[i] = buffers[i].exported;
+	}
+
+	for (auto pass = passes.rbegin(); pass != passes.rend(); ++pass)
+	{
+		bool live = pass->keep;
+		for (const Access& access : pass->accesses)
+		{
+			if (access.write && (access.image ? imageNeeded[access.resource] : bufferNeeded[access.resource]))
+			{
+				live = true;
+			}
+		}
+
+		pass->culled = !live;
+		if (!live)
+		{
+			continue;
+		}
+
+		for (const Access& access : pass->accesses)
+		{
+			if (!access.write || (access.access & ~WRITE_ACCESS) != 0)
+			{
+				if (access.image)
+				{
+					imageNeeded[access.resource] = true;
+				}
+				else
+				{
+					bufferNeeded[access.resource] = true;
+				}
+			}
+		}
+	}
+}
+
+void RenderGraph::sync(const Access& access)
+{
+	ResourceState& state = access.image ? images[access.resource].state : buffers[access.resource].state;
+
+	const VkAccessFlags2 writes = access.access & WRITE_ACCESS;
+	const bool transition = access.image && state.layout != access.layout;
+
+	const auto add_memory_barrier = [&](VkPipelineStageFlags2 srcStages, VkAccessFlags2 srcAccess)
+	{
+		memoryBarrier.srcStageMask |= srcStages;
+		memoryBarrier.srcAccessMask |= srcAccess;
+		memoryBarrier.dstStageMask |= access.stages;
+		memoryBarrier.dstAccessMask |= access.access;
+	};
+
+	if (writes != 0 || transition)
+	{
+		// a write (and a layout transition is one) waits for every earlier write and read.
+		// only writes need to be made available, reads just need to be done.
+		const VkPipelineStageFlags2 srcStages = state.writeStages | state.readStages;
+
+		if (transition)
+		{
+			const ImageResource& image = images[access.resource];
+
+			VkImageMemoryBarrier2 barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+			barrier.srcStageMask = srcStages;
+			barrier.srcAccessMask = state.writeAccess;
+			barrier.dstStageMask = access.stages;
+			barrier.dstAccessMask = access.access;
+			barrier.oldLayout = state.layout;
+			barrier.newLayout = access.layout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = image.image;
+			barrier.subresourceRange = vkinit::image_subresource_range(image.aspect);
+			imageBarriers.push_back(barrier);
+
+			state.layout = access.layout;
+		}
+		else if (srcStages != VK_PIPELINE_STAGE_2_NONE)
+		{
+			add_memory_barrier(srcStages, state.writeAccess);
+		}
+
+		if (writes != 0)
+		{
+			state.writeStages = access.stages;
+			state.writeAccess = writes;
+			state.readStages = VK_PIPELINE_STAGE_2_NONE;
+			state.readAccess = VK_ACCESS_2_NONE;
+		}
+		else
+		{
+			// the transition happens before the reading stages, later reads elsewhere chain from them
+			state.writeStages = access.stages;
+			state.writeAccess = VK_ACCESS_2_NONE;
+			state.readStages = access.stages;
+			state.readAccess = access.access;
+		}
+		return;
+	}
+
+	// read after read in the same layout needs nothing, a read after a write needs it made visible
+	// once per stage and access
+	const bool covered = (access.stages & ~state.readStages) == 0 && (access.access & ~state.readAccess) == 0;
+	if (state.writeStages != VK_PIPELINE_STAGE_2_NONE && !covered)
+	{
+		add_memory_barrier(state.writeStages, state.writeAccess);
+	}
+
+	state.readStages |= access.stages;
+	state.readAccess |= access.access;
+}
+
+void RenderGraph::flush_barriers(VkCommandBuffer cmd)
+{
+	const bool hasMemoryBarrier = memoryBarrier.dstStageMask != VK_PIPELINE_STAGE_2_NONE;
+	if (imageBarriers.empty() && !hasMemoryBarrier)
+	{
+		return;
+	}
+
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+
+	VkDependencyInfo depInfo{};
+	depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	depInfo.memoryBarrierCount = hasMemoryBarrier ? 1 : 0;
+	depInfo.pMemoryBarriers = &memoryBarrier;
+	depInfo.imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size());
+	depInfo.pImageMemoryBarriers = imageBarriers.data();
+
+	vkCmdPipelineBarrier2(cmd, &depInfo);
+
+	stats.barrierBatches++;
+	stats.imageBarriers += static_cast<uint32_t>(imageBarriers.size());
+	stats.memoryBarriers += hasMemoryBarrier ? 1 : 0;
+
+	imageBarriers.clear();
+	memoryBarrier = {};
+}
+
+void RenderGraph::execute(VkCommandBuffer cmd, GpuProfiler* profiler)
+{
+	cull();
+
+	stats = {};
+	stats.passes = static_cast<uint32_t>(passes.size());
+
+	for (const Pass& pass : passes)
+	{
+		if (pass.culled)
+		{
+			stats.culledPasses++;
+			continue;
+		}
+
+		for (const Access& access : pass.accesses)
+		{
+			sync(access);
+		}
+		flush_barriers(cmd);
+
+		// statistics count compute invocations, so only compute passes ask for them
+		const uint32_t scope = profiler != nullptr
+			? profiler->begin_scope(cmd, pass.name, pass.type == PassType::Compute)
+			: 0;
+
+		if (pass.function)
+		{
+			pass.function(cmd);
+		}
+
+		if (profiler != nullptr)
+		{
+			profiler->end_scope(cmd, scope);
+		}
+	}
+
+	for (uint32_t i = 0; i < images.size(); i++)
+	{
+		if (images[i].exported)
+		{
+			// the pass type only matters for shader usages, which then take the most general stages
+			const UsageInfo info = image_usage_info(images[i].finalUsage, PassType::Graphics);
+			sync({ true , false , i , info.stages , info.access , info.layout });
+		}
+	}
+	flush_barriers(cmd);
+
+	for (const ImageResource& image : images)
+	{
+		if (image.retained)
+		{
+			retainedImages[image.image] = image.state;
+		}
+	}
+	for (const BufferResource& buffer : buffers)
+	{
+		retainedBuffers[buffer.buffer] = buffer.state;
+	}
+}
+
+void RenderGraph::print_summary() const
+{
+	std::cout << "Render graph: " << stats.passes << " passes (" << stats.culledPasses << " culled), "
+		<< stats.barrierBatches << " barrier batches with " << stats.imageBarriers << " image and "
+		<< stats.memoryBarriers << " memory barriers in the last frame" << std::endl;
+}
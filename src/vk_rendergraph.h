@@ -0,0 +1,184 @@
+#pragma once
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "vk_types.h"
+
+class GpuProfiler;
+
+// what a pass does with an image. the pass type picks the shader stages for the shader usages.
+enum class ImageUsage : uint8_t
+{
+	StorageRead,
+	StorageWrite,
+	StorageReadWrite,
+	Sampled,
+	ColorAttachment,
+	DepthAttachment,
+	DepthRead,
+	TransferSrc,
+	TransferDst,
+	// final usage only, for export_image
+	Present,
+};
+
+enum class BufferUsage : uint8_t
+{
+	StorageRead,
+	StorageWrite,
+	StorageReadWrite,
+	IndirectRead,
+	IndexRead,
+	TransferSrc,
+	TransferDst,
+	HostRead,
+};
+
+enum class PassType : uint8_t
+{
+	Compute,
+	Graphics,
+	Transfer,
+};
+
+struct RGImage
+{
+	uint32_t index;
+};
+
+struct RGBuffer
+{
+	uint32_t index;
+};
+
+// where a resource was left: its layout, the last write, and the stages that have seen that write
+struct ResourceState
+{
+	VkImageLayout layout{ VK_IMAGE_LAYOUT_UNDEFINED };
+	VkPipelineStageFlags2 writeStages{ VK_PIPELINE_STAGE_2_NONE };
+	VkAccessFlags2 writeAccess{ VK_ACCESS_2_NONE };
+	VkPipelineStageFlags2 readStages{ VK_PIPELINE_STAGE_2_NONE };
+	VkAccessFlags2 readAccess{ VK_ACCESS_2_NONE };
+};
+
+struct RenderGraphStats
+{
+	uint32_t passes;
+	uint32_t culledPasses;
+	// vkCmdPipelineBarrier2 calls, at most one per pass plus one for the exports
+	uint32_t barrierBatches;
+	uint32_t imageBarriers;
+	uint32_t memoryBarriers;
+};
+
+// passes declare what they read and write, the graph puts the barriers between them.
+// each resource's layout and last access are tracked, so a barrier only waits on the stages
+// that touched the resource and only makes visible what was written. all barriers needed
+// before a pass go out as one dependency info. passes whose results nothing uses are culled.
+// rebuilt every frame: reset, import, add passes, execute.
+class RenderGraph
+{
+public:
+	class PassBuilder
+	{
+	public:
+		PassBuilder& read(RGImage image, ImageUsage usage);
+		PassBuilder& write(RGImage image, ImageUsage usage);
+		PassBuilder& read(RGBuffer buffer, BufferUsage usage);
+		PassBuilder& write(RGBuffer buffer, BufferUsage usage);
+		// never culled, for passes with effects outside the graph (readback copies)
+		PassBuilder& keep();
+		PassBuilder& execute(std::function<void(VkCommandBuffer cmd)>&& function);
+
+	private:
+		friend class RenderGraph;
+		PassBuilder(RenderGraph& graph, uint32_t pass) : graph(graph), pass(pass) {}
+
+		RenderGraph& graph;
+		uint32_t pass;
+	};
+
+	// drops the passes and imports of the last frame, the retained states stay
+	void reset();
+
+	// the graph remembers where it left every image and buffer imported this way, so persistent
+	// resources carry their layout and last access into the next frame. discard drops the contents.
+	RGImage import_image(VkImage image, VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT, bool discard = false);
+	// state handed over from outside, like a swapchain image after its acquire wait. not retained.
+	RGImage import_image(VkImage image, VkImageAspectFlags aspect, const ResourceState& state);
+	RGBuffer import_buffer(VkBuffer buffer);
+
+	// used after the graph. the image ends up in the usage's layout and its passes are never culled.
+	void export_image(RGImage image, ImageUsage finalUsage);
+	void export_buffer(RGBuffer buffer);
+
+	// call before destroying a resource the graph has seen
+	void forget_image(VkImage image);
+	void forget_buffer(VkBuffer buffer);
+
+	PassBuilder add_pass(const char* name, PassType type);
+
+	// culls, then records every live pass with its barriers. each pass gets a gpu profiler scope.
+	void execute(VkCommandBuffer cmd, GpuProfiler* profiler = nullptr);
+
+	const RenderGraphStats& last_stats() const { return stats; }
+	void print_summary() const;
+
+private:
+	struct Access
+	{
+		bool image;
+		bool write;
+		uint32_t resource;
+		VkPipelineStageFlags2 stages;
+		VkAccessFlags2 access;
+		VkImageLayout layout;
+	};
+
+	struct Pass
+	{
+		const char* name;
+		PassType type;
+		bool keep{ false };
+		bool culled{ false };
+		std::vector<Access> accesses;
+		std::function<void(VkCommandBuffer cmd)> function;
+	};
+
+	struct ImageResource
+	{
+		VkImage image;
+		VkImageAspectFlags aspect;
+		ResourceState state;
+		bool retained;
+		bool exported{ false };
+		ImageUsage finalUsage{ ImageUsage::TransferSrc };
+	};
+
+	struct BufferResource
+	{
+		VkBuffer buffer;
+		ResourceState state;
+		bool exported{ false };
+	};
+
+	void add_access(uint32_t pass, const Access& access);
+	void cull();
+	void sync(const Access& access);
+	void flush_barriers(VkCommandBuffer cmd);
+
+	std::vector<Pass> passes;
+	std::vector<ImageResource> images;
+	std::vector<BufferResource> buffers;
+
+	std::unordered_map<VkImage, ResourceState> retainedImages;
+	std::unordered_map<VkBuffer, ResourceState> retainedBuffers;
+
+	// the barriers gathered for the next pass boundary
+	std::vector<VkImageMemoryBarrier2> imageBarriers;
+	VkMemoryBarrier2 memoryBarrier{};
+
+	RenderGraphStats stats{};
+};
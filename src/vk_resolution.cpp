@@ -0,0 +1,99 @@
+#include "vk_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <imgui.h>
+
+namespace
+{
+	// aims a little under the target, so the steady state has room for small spikes
+	constexpr double TARGET_HEADROOM = 0.95;
+	// part of the way to the ideal scale taken per frame while there is time to spare
+	constexpr float RAISE_RATE = 0.05f;
+	constexpr float SCALE_FLOOR = 0.25f;
+	// render extents are whole compute tiles
+	constexpr uint32_t EXTENT_ALIGNMENT = 8;
+
+	uint32_t scaled_size(uint32_t size, float scale, uint32_t maxSize)
+	{
+		const auto scaled = static_cast<uint32_t>(static_cast<float>(size) * scale + EXTENT_ALIGNMENT / 2);
+		return std::clamp(scaled / EXTENT_ALIGNMENT * EXTENT_ALIGNMENT, std::min(EXTENT_ALIGNMENT, maxSize), maxSize);
+	}
+}
+
+void DynamicResolution::init(VkExtent2D outputExtent, VkExtent2D maxRenderExtent)
+{
+	this->outputExtent = outputExtent;
+	maxExtent = maxRenderExtent;
+	currentScale = maxScale;
+	measured = false;
+	frameScales.fill(0.0f);
+}
+
+void DynamicResolution::update(uint64_t frame, double gpuMs)
+{
+	if (!enabled || (measured && frame <= lastMeasuredFrame) || gpuMs <= 0.0)
+	{
+		return;
+	}
+	measured = true;
+	lastMeasuredFrame = frame;
+
+	const float measuredScale = frameScales[frame % frameScales.size()];
+	if (measuredScale <= 0.0f)
+	{
+		return;
+	}
+
+	// gpu time follows the pixel count, which goes with the square of the scale
+	const double budgetMs = targetFrameMs * TARGET_HEADROOM;
+	const float idealScale = std::clamp(
+		measuredScale * static_cast<float>(std::sqrt(budgetMs / gpuMs)), minScale, maxScale);
+
+	if (idealScale < currentScale)
+	{
+		currentScale = idealScale;
+	}
+	else
+	{
+		currentScale += (idealScale - currentScale) * RAISE_RATE;
+	}
+}
+
+VkExtent2D DynamicResolution::begin_frame(uint64_t frame)
+{
+	// the draw image cannot hold more than it was allocated for
+	const float allocatedScale = static_cast<float>(maxExtent.width) / static_cast<float>(outputExtent.width);
+	minScale = std::clamp(minScale, SCALE_FLOOR, allocatedScale);
+	maxScale = std::clamp(maxScale, minScale, allocatedScale);
+
+	currentScale = enabled ? std::clamp(currentScale, minScale, maxScale) : maxScale;
+	frameScales[frame % frameScales.size()] = currentScale;
+
+	return {
+		scaled_size(outputExtent.width, currentScale, maxExtent.width),
+		scaled_size(outputExtent.height, currentScale, maxExtent.height)
+	};
+}
+
+void DynamicResolution::draw_panel()
+{
+	if (!ImGui::Begin("Dynamic resolution"))
+	{
+		ImGui::End();
+		return;
+	}
+
+	const float allocatedScale = static_cast<float>(maxExtent.width) / static_cast<float>(outputExtent.width);
+
+	ImGui::Checkbox("Enabled", &enabled);
+	ImGui::SliderFloat("Target gpu ms", &targetFrameMs, 2.0f, 50.0f);
+	ImGui::SliderFloat("Min scale", &minScale, SCALE_FLOOR, allocatedScale);
+	ImGui::SliderFloat("Max scale", &maxScale, SCALE_FLOOR, allocatedScale);
+	ImGui::Text("Scale %.2f, %ux%u", currentScale,
+	            scaled_size(outputExtent.width, currentScale, maxExtent.width),
+	            scaled_size(outputExtent.height, currentScale, maxExtent.height));
+
+	ImGui::End();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+
+#include "vk_types.h"
+
+// picks the fraction of the output resolution each frame renders at, from the gpu time of
+// finished frames. a frame over budget drops the scale right away, so a load spike costs
+// resolution instead of a missed frame. the scale then climbs back slowly so it does not oscillate.
+class DynamicResolution
+{
+public:
+	// gpu time per frame to hold, in ms
+	float targetFrameMs{ 16.6f };
+	// of the output extent, per axis. maxScale above 1 supersamples.
+	float minScale{ 0.5f };
+	float maxScale{ 1.0f };
+	// off renders every frame at maxScale
+	bool enabled{ true };
+
+	// maxRenderExtent is what the draw image was allocated with, the output extent at maxScale
+	void init(VkExtent2D outputExtent, VkExtent2D maxRenderExtent);
+
+	// the gpu time of a finished frame's passes whose cost follows the render extent, in order of
+	// completion. frames already seen are ignored.
+	void update(uint64_t frame, double gpuMs);
+
+	// the extent to render the frame at, remembered with the frame so update can tell
+	// how much of its gpu time came from the scale
+	VkExtent2D begin_frame(uint64_t frame);
+
+	float scale() const { return currentScale; }
+	VkExtent2D output_extent() const { return outputExtent; }
+
+	// imgui window with the settings and the current scale
+	void draw_panel();
+
+private:
+	VkExtent2D outputExtent{};
+	VkExtent2D maxExtent{};
+	float currentScale{ 1.0f };
+	uint64_t lastMeasuredFrame{ 0 };
+	bool measured{ false };
+
+	// more than any number of frames in flight
+	std::array<float, 8> frameScales{};
+};
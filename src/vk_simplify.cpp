@@ -0,0 +1,715 @@
+#include "vk_simplify.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include <glm/geometric.hpp>
+
+namespace
+{
+	constexpr uint32_t NO_VERTEX = ~0u;
+
+	// a level that cannot get below this fraction of the one before ends the chain
+	constexpr float MIN_LEVEL_REDUCTION = 0.9f;
+	// border and seam edges pull this much harder on their vertices than the faces around them
+	constexpr double SEAM_WEIGHT = 10.0;
+	// a collapse may not turn any triangle further than about 75 degrees
+	constexpr double FLIP_LIMIT = 0.25;
+
+	// symmetric 4x4 matrix of summed squared plane distances, plus the weight summed into it
+	struct Quadric
+	{
+		double a00, a01, a02, a11, a12, a22;
+		double b0, b1, b2;
+		double c;
+		double weight;
+	};
+
+	Quadric plane_quadric(const glm::dvec3& normal, double distance, double weight)
+	{
+		const glm::dvec3 n = normal * weight;
+		return Quadric{
+			n.x * normal.x , n.x * normal.y , n.x * normal.z , n.y * normal.y , n.y * normal.z , n.z * normal.z ,
+			n.x * distance , n.y * distance , n.z * distance ,
+			distance * distance * weight ,
+			weight
+		};
+	}
+
+	void add_quadric(Quadric& q, const Quadric& other)
+	{
+		q.a00 += other.a00;
+		q.a01 += other.a01;
+		q.a02 += other.a02;
+		q.a11 += other.a11;
+		q.a12 += other.a12;
+		q.a22 += other.a22;
+		q.b0 += other.b0;
+		q.b1 += other.b1;
+		q.b2 += other.b2;
+		q.c += other.c;
+		q.weight += other.weight;
+	}
+
+	// root mean square distance of p from the planes summed into q
+	double quadric_error(const Quadric& q, const glm::dvec3& p)
+	{
+		if (q.weight <= 0.0)
+		{
+			return 0.0;
+		}
+
+		const double rx = q.a00 * p.x + q.a01 * p.y + q.a02 * p.z + q.b0;
+		const double ry = q.a01 * p.x + q.a11 * p.y + q.a12 * p.z + q.b1;
+		const double rz = q.a02 * p.x + q.a12 * p.y + q.a22 * p.z + q.b2;
+		const double squared = rx * p.x + ry * p.y + rz * p.z + q.b0 * p.x + q.b1 * p.y + q.b2 * p.z + q.c;
+
+		return std::sqrt(std::max(squared, 0.0) / q.weight);
+	}
+
+	// hashes float keys by their bits, so welding only merges exact copies
+	template <size_t N>
+	struct FloatKeyHash
+	{
+		size_t operator()(const std::array<float, N>& key) const
+		{
+			size_t hash = 0;
+			for (const float f : key)
+			{
+				uint32_t bits;
+				std::memcpy(&bits, &f, sizeof(bits));
+				hash = (hash ^ bits) * 0x100000001b3ull;
+			}
+			return hash;
+		}
+	};
+
+	enum class VertexKind : uint8_t
+	{
+		// surrounded by triangles that agree on its attributes, moves freely
+		Manifold,
+		// on a single border or seam, slides along it
+		Curve,
+		// junction, corner or non-manifold, never moves
+		Locked,
+	};
+
+	// a triangle of the working mesh, made of wedges: the distinct position, uv and color
+	// combinations. several input vertices can share a wedge when only their normals differ.
+	struct WorkTriangle
+	{
+		std::array<uint32_t, 3> wedges;
+		bool alive;
+	};
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		double error;
+	};
+
+	class Simplifier
+	{
+	public:
+		Simplifier(std::span<const Vertex> vertices, std::span<const uint32_t> indices);
+
+		uint32_t triangle_count() const { return aliveTriangles; }
+		double max_error() const { return maxError; }
+
+		// collapses until at most targetTriangles remain, false once no collapse is allowed
+		bool simplify(uint32_t targetTriangles);
+
+		std::vector<uint32_t> write_indices() const;
+
+	private:
+		std::span<const Vertex> vertices;
+
+		// welded positions, the topology the collapses work on
+		std::vector<glm::dvec3> positions;
+		std::vector<Quadric> quadrics;
+		std::vector<VertexKind> kinds;
+		// the other ends of a curve vertex's border or seam edges
+		std::vector<std::array<uint32_t, 2>> curveNeighbours;
+		// alive and dead triangles around each position, filtered on use
+		std::vector<std::vector<uint32_t>> positionTriangles;
+
+		std::vector<uint32_t> wedgePosition;
+		// every input vertex of a wedge, differing in normal
+		std::vector<std::vector<uint32_t>> wedgeVertices;
+
+		std::vector<WorkTriangle> triangles;
+		uint32_t aliveTriangles{ 0 };
+		double maxError{ 0.0 };
+
+		uint32_t position_of(const WorkTriangle& triangle, uint32_t corner) const
+		{
+			return wedgePosition[triangle.wedges[corner]];
+		}
+
+		bool allowed(uint32_t from, uint32_t to) const;
+		bool try_collapse(uint32_t from, uint32_t to, std::vector<bool>& touched);
+	};
+
+	Simplifier::Simplifier(std::span<const Vertex> vertices, std::span<const uint32_t> indices)
+		: vertices(vertices)
+	{
+		std::unordered_map<std::array<float, 3>, uint32_t, FloatKeyHash<3>> positionIds;
+		std::unordered_map<std::array<float, 9>, uint32_t, FloatKeyHash<9>> wedgeIds;
+		std::vector<uint32_t> vertexWedge(vertices.size(), NO_VERTEX);
+
+		for (size_t v = 0; v < vertices.size(); v++)
+		{
+			const Vertex& vertex = vertices[v];
+			const std::array<float, 3> positionKey{ vertex.position.x , vertex.position.y , vertex.position.z };
+			const auto [position, newPosition] = positionIds.try_emplace(positionKey, static_cast<uint32_t>(positions.size()));
+			if (newPosition)
+			{
+				positions.push_back(glm::dvec3{ vertex.position });
+			}
+
+			const std::array<float, 9> wedgeKey{
+				vertex.position.x , vertex.position.y , vertex.position.z ,
+				vertex.uv_x , vertex.uv_y ,
+				vertex.color.r , vertex.color.g , vertex.color.b , vertex.color.a
+			};
+			const auto [wedge, newWedge] = wedgeIds.try_emplace(wedgeKey, static_cast<uint32_t>(wedgePosition.size()));
+			if (newWedge)
+			{
+				wedgePosition.push_back(position->second);
+				wedgeVertices.emplace_back();
+			}
+			wedgeVertices[wedge->second].push_back(static_cast<uint32_t>(v));
+			vertexWedge[v] = wedge->second;
+		}
+
+		const size_t positionCount = positions.size();
+		quadrics.assign(positionCount, Quadric{});
+		kinds.assign(positionCount, VertexKind::Manifold);
+		curveNeighbours.assign(positionCount, { NO_VERTEX , NO_VERTEX });
+		positionTriangles.resize(positionCount);
+
+		// triangles that are already degenerate in position take no part
+		triangles.reserve(indices.size() / 3);
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			const WorkTriangle triangle{ { vertexWedge[indices[i]] , vertexWedge[indices[i + 1]] , vertexWedge[indices[i + 2]] } , true };
+			const uint32_t p0 = position_of(triangle, 0);
+			const uint32_t p1 = position_of(triangle, 1);
+			const uint32_t p2 = position_of(triangle, 2);
+			if (p0 == p1 || p1 == p2 || p2 == p0)
+			{
+				continue;
+			}
+
+			const uint32_t t = static_cast<uint32_t>(triangles.size());
+			triangles.push_back(triangle);
+			positionTriangles[p0].push_back(t);
+			positionTriangles[p1].push_back(t);
+			positionTriangles[p2].push_back(t);
+		}
+		aliveTriangles = static_cast<uint32_t>(triangles.size());
+
+		// face planes, weighted by area so slivers do not count as much as the faces around them
+		for (const WorkTriangle& triangle : triangles)
+		{
+			const glm::dvec3& a = positions[position_of(triangle, 0)];
+			const glm::dvec3 cross = glm::cross(positions[position_of(triangle, 1)] - a, positions[position_of(triangle, 2)] - a);
+			const double length = glm::length(cross);
+			if (length <= 0.0)
+			{
+				continue;
+			}
+
+			const glm::dvec3 normal = cross / length;
+			const Quadric q = plane_quadric(normal, -glm::dot(normal, a), length * 0.5);
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				add_quadric(quadrics[position_of(triangle, corner)], q);
+			}
+		}
+
+		// every edge with the triangles on either side of it
+		struct EdgeTriangles
+		{
+			uint32_t count;
+			std::array<uint32_t, 2> triangles;
+		};
+		std::unordered_map<uint64_t, EdgeTriangles> edges;
+		edges.reserve(triangles.size() * 2);
+		for (uint32_t t = 0; t < triangles.size(); t++)
+		{
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t p = position_of(triangles[t], corner);
+				const uint32_t q = position_of(triangles[t], (corner + 1) % 3);
+				const uint64_t key = (static_cast<uint64_t>(std::min(p, q)) << 32) | std::max(p, q);
+
+				EdgeTriangles& edge = edges.try_emplace(key, EdgeTriangles{ 0 , { NO_VERTEX , NO_VERTEX } }).first->second;
+				if (edge.count < 2)
+				{
+					edge.triangles[edge.count] = t;
+				}
+				edge.count++;
+			}
+		}
+
+		auto wedge_at = [&](uint32_t t, uint32_t p)
+		{
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				if (position_of(triangles[t], corner) == p)
+				{
+					return triangles[t].wedges[corner];
+				}
+			}
+			return NO_VERTEX;
+		};
+
+		// borders and seams: a border has one triangle, a seam two that disagree on the attributes at an end
+		std::vector<uint32_t> specialEdgeCounts(positionCount, 0);
+		for (const auto& [key, edge] : edges)
+		{
+			const uint32_t p = static_cast<uint32_t>(key >> 32);
+			const uint32_t q = static_cast<uint32_t>(key);
+
+			if (edge.count > 2)
+			{
+				kinds[p] = VertexKind::Locked;
+				kinds[q] = VertexKind::Locked;
+				continue;
+			}
+
+			const uint32_t t0 = edge.triangles[0];
+			const uint32_t t1 = edge.triangles[1];
+			const bool special = edge.count == 1 || wedge_at(t0, p) != wedge_at(t1, p) || wedge_at(t0, q) != wedge_at(t1, q);
+			if (!special)
+			{
+				continue;
+			}
+
+			for (const uint32_t end : { p , q })
+			{
+				const uint32_t other = end == p ? q : p;
+				if (specialEdgeCounts[end] < 2)
+				{
+					curveNeighbours[end][specialEdgeCounts[end]] = other;
+				}
+				specialEdgeCounts[end]++;
+			}
+
+			// a plane through the edge, perpendicular to the face, keeps the vertices on the line
+			const WorkTriangle& triangle = triangles[t0];
+			const glm::dvec3& a = positions[position_of(triangle, 0)];
+			const glm::dvec3 faceNormal = glm::cross(positions[position_of(triangle, 1)] - a, positions[position_of(triangle, 2)] - a);
+			const glm::dvec3 edgeVector = positions[q] - positions[p];
+			const glm::dvec3 cross = glm::cross(edgeVector, faceNormal);
+			const double length = glm::length(cross);
+			if (length > 0.0)
+			{
+				const glm::dvec3 normal = cross / length;
+				const Quadric quadric = plane_quadric(normal, -glm::dot(normal, positions[p]),
+				                                      glm::dot(edgeVector, edgeVector) * SEAM_WEIGHT);
+				add_quadric(quadrics[p], quadric);
+				add_quadric(quadrics[q], quadric);
+			}
+		}
+
+		for (size_t p = 0; p < positionCount; p++)
+		{
+			if (kinds[p] == VertexKind::Locked || specialEdgeCounts[p] == 0)
+			{
+				continue;
+			}
+			kinds[p] = specialEdgeCounts[p] == 2 ? VertexKind::Curve : VertexKind::Locked;
+		}
+	}
+
+	bool Simplifier::allowed(uint32_t from, uint32_t to) const
+	{
+		switch (kinds[from])
+		{
+		case VertexKind::Manifold:
+			return true;
+		case VertexKind::Curve:
+			return curveNeighbours[from][0] == to || curveNeighbours[from][1] == to;
+		default:
+			return false;
+		}
+	}
+
+	bool Simplifier::try_collapse(uint32_t from, uint32_t to, std::vector<bool>& touched)
+	{
+		// the wedges of from become the wedges of to that the triangles on the collapsed edge pair them with
+		std::array<std::pair<uint32_t, uint32_t>, 8> wedgeMap;
+		uint32_t wedgeMapSize = 0;
+		uint32_t sharedTriangles = 0;
+
+		std::vector<uint32_t> fromNeighbours;
+		std::vector<uint32_t> toNeighbours;
+
+		for (const uint32_t t : positionTriangles[from])
+		{
+			const WorkTriangle& triangle = triangles[t];
+			if (!triangle.alive)
+			{
+				continue;
+			}
+
+			uint32_t fromWedge = NO_VERTEX;
+			uint32_t toWedge = NO_VERTEX;
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t p = position_of(triangle, corner);
+				if (p == from)
+				{
+					fromWedge = triangle.wedges[corner];
+				}
+				else
+				{
+					fromNeighbours.push_back(p);
+					if (p == to)
+					{
+						toWedge = triangle.wedges[corner];
+					}
+				}
+			}
+
+			if (toWedge == NO_VERTEX)
+			{
+				continue;
+			}
+
+			sharedTriangles++;
+			bool mapped = false;
+			for (uint32_t i = 0; i < wedgeMapSize; i++)
+			{
+				if (wedgeMap[i].first == fromWedge)
+				{
+					if (wedgeMap[i].second != toWedge)
+					{
+						return false;
+					}
+					mapped = true;
+				}
+			}
+			if (!mapped)
+			{
+				if (wedgeMapSize == wedgeMap.size())
+				{
+					return false;
+				}
+				wedgeMap[wedgeMapSize++] = { fromWedge , toWedge };
+			}
+		}
+
+		if (sharedTriangles == 0)
+		{
+			return false;
+		}
+
+		// a curve vertex ending its curve in a two vertex loop would flatten the loop
+		if (kinds[from] == VertexKind::Curve)
+		{
+			const uint32_t other = curveNeighbours[from][0] == to ? curveNeighbours[from][1] : curveNeighbours[from][0];
+			if (kinds[to] == VertexKind::Curve && (curveNeighbours[to][0] == other || curveNeighbours[to][1] == other))
+			{
+				return false;
+			}
+		}
+
+		// link condition: the two rings may only meet at the triangles that go away, or the surface pinches
+		for (const uint32_t t : positionTriangles[to])
+		{
+			const WorkTriangle& triangle = triangles[t];
+			if (!triangle.alive)
+			{
+				continue;
+			}
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t p = position_of(triangle, corner);
+				if (p != to && p != from)
+				{
+					toNeighbours.push_back(p);
+				}
+			}
+		}
+		std::sort(fromNeighbours.begin(), fromNeighbours.end());
+		fromNeighbours.erase(std::unique(fromNeighbours.begin(), fromNeighbours.end()), fromNeighbours.end());
+		std::sort(toNeighbours.begin(), toNeighbours.end());
+		toNeighbours.erase(std::unique(toNeighbours.begin(), toNeighbours.end()), toNeighbours.end());
+
+		uint32_t commonNeighbours = 0;
+		for (const uint32_t p : fromNeighbours)
+		{
+			if (p != to && std::binary_search(toNeighbours.begin(), toNeighbours.end(), p))
+			{
+				commonNeighbours++;
+			}
+		}
+		if (commonNeighbours > sharedTriangles)
+		{
+			return false;
+		}
+
+		// the surviving triangles must keep their facing and some area, and every wedge needs somewhere to go
+		for (const uint32_t t : positionTriangles[from])
+		{
+			const WorkTriangle& triangle = triangles[t];
+			if (!triangle.alive)
+			{
+				continue;
+			}
+
+			std::array<glm::dvec3, 3> before;
+			std::array<glm::dvec3, 3> after;
+			bool shared = false;
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t p = position_of(triangle, corner);
+				before[corner] = positions[p];
+				after[corner] = p == from ? positions[to] : positions[p];
+				shared |= p == to;
+
+				if (p == from)
+				{
+					bool mapped = false;
+					for (uint32_t i = 0; i < wedgeMapSize; i++)
+					{
+						mapped |= wedgeMap[i].first == triangle.wedges[corner];
+					}
+					if (!mapped)
+					{
+						return false;
+					}
+				}
+			}
+			if (shared)
+			{
+				continue;
+			}
+
+			const glm::dvec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+			const glm::dvec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+			const double length0 = glm::length(n0);
+			const double length1 = glm::length(n1);
+			if (length1 <= length0 * 1e-6 || glm::dot(n0, n1) < FLIP_LIMIT * length0 * length1)
+			{
+				return false;
+			}
+		}
+
+		// apply
+		for (const uint32_t t : positionTriangles[from])
+		{
+			WorkTriangle& triangle = triangles[t];
+			if (!triangle.alive)
+			{
+				continue;
+			}
+
+			bool shared = false;
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t p = position_of(triangle, corner);
+				touched[p] = true;
+				shared |= p == to;
+			}
+
+			if (shared)
+			{
+				triangle.alive = false;
+				aliveTriangles--;
+				continue;
+			}
+
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				if (position_of(triangle, corner) != from)
+				{
+					continue;
+				}
+				for (uint32_t i = 0; i < wedgeMapSize; i++)
+				{
+					if (wedgeMap[i].first == triangle.wedges[corner])
+					{
+						triangle.wedges[corner] = wedgeMap[i].second;
+						break;
+					}
+				}
+			}
+			positionTriangles[to].push_back(t);
+		}
+		for (const uint32_t p : toNeighbours)
+		{
+			touched[p] = true;
+		}
+		touched[to] = true;
+
+		if (kinds[from] == VertexKind::Curve)
+		{
+			// the curve now runs straight from to on to from's other neighbour
+			const uint32_t other = curveNeighbours[from][0] == to ? curveNeighbours[from][1] : curveNeighbours[from][0];
+			for (const uint32_t end : { to , other })
+			{
+				auto& neighbours = curveNeighbours[end];
+				for (uint32_t& neighbour : neighbours)
+				{
+					if (neighbour == from)
+					{
+						neighbour = end == to ? other : to;
+					}
+				}
+			}
+		}
+
+		add_quadric(quadrics[to], quadrics[from]);
+		positionTriangles[from].clear();
+		kinds[from] = VertexKind::Locked;
+		return true;
+	}
+
+	bool Simplifier::simplify(uint32_t targetTriangles)
+	{
+		std::vector<Collapse> collapses;
+		std::vector<bool> touched(positions.size(), false);
+
+		while (aliveTriangles > targetTriangles)
+		{
+			collapses.clear();
+			for (const WorkTriangle& triangle : triangles)
+			{
+				if (!triangle.alive)
+				{
+					continue;
+				}
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					const uint32_t p = position_of(triangle, corner);
+					const uint32_t q = position_of(triangle, (corner + 1) % 3);
+					if (allowed(p, q))
+					{
+						collapses.push_back({ p , q , quadric_error(quadrics[p], positions[q]) });
+					}
+					if (allowed(q, p))
+					{
+						collapses.push_back({ q , p , quadric_error(quadrics[q], positions[p]) });
+					}
+				}
+			}
+			if (collapses.empty())
+			{
+				return false;
+			}
+
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b)
+			{
+				return a.error < b.error;
+			});
+
+			// a collapse removes about two triangles. stopping at the error the cheapest ones needed reach
+			// keeps a pass from spending expensive collapses where a later pass would find cheap ones,
+			// unless none of those cheap ones could be made.
+			const size_t needed = (aliveTriangles - targetTriangles + 1) / 2;
+			const double errorLimit = collapses[std::min(collapses.size() - 1, needed)].error;
+
+			std::fill(touched.begin(), touched.end(), false);
+			uint32_t applied = 0;
+			for (const Collapse& collapse : collapses)
+			{
+				if ((collapse.error > errorLimit && applied > 0) || aliveTriangles <= targetTriangles)
+				{
+					break;
+				}
+				if (touched[collapse.from] || touched[collapse.to] || !allowed(collapse.from, collapse.to))
+				{
+					continue;
+				}
+				if (try_collapse(collapse.from, collapse.to, touched))
+				{
+					maxError = std::max(maxError, collapse.error);
+					applied++;
+				}
+			}
+
+			if (applied == 0)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	std::vector<uint32_t> Simplifier::write_indices() const
+	{
+		std::vector<uint32_t> indices;
+		indices.reserve(static_cast<size_t>(aliveTriangles) * 3);
+
+		for (const WorkTriangle& triangle : triangles)
+		{
+			if (!triangle.alive)
+			{
+				continue;
+			}
+
+			const glm::dvec3& a = positions[position_of(triangle, 0)];
+			const glm::vec3 faceNormal(glm::cross(positions[position_of(triangle, 1)] - a, positions[position_of(triangle, 2)] - a));
+
+			// the vertex whose normal is closest to the face, which is the face's own for flat shading
+			for (const uint32_t wedge : triangle.wedges)
+			{
+				uint32_t best = wedgeVertices[wedge].front();
+				float bestDot = -INFINITY;
+				for (const uint32_t v : wedgeVertices[wedge])
+				{
+					const float d = glm::dot(vertices[v].normal, faceNormal);
+					if (d > bestDot)
+					{
+						best = v;
+						bestDot = d;
+					}
+				}
+				indices.push_back(best);
+			}
+		}
+
+		return indices;
+	}
+}
+
+std::vector<MeshLodLevel> vkutil::build_lod_chain(std::span<const Vertex> vertices, std::span<const uint32_t> indices,
+                                                  uint32_t maxLevels, float reduction)
+{
+	std::vector<MeshLodLevel> levels;
+
+	Simplifier simplifier(vertices, indices);
+	uint32_t previousTriangles = static_cast<uint32_t>(indices.size() / 3);
+
+	while (levels.size() < maxLevels)
+	{
+		const uint32_t target = static_cast<uint32_t>(static_cast<float>(previousTriangles) * reduction);
+		const bool reached = simplifier.simplify(target);
+
+		// a level stuck short of its target is still worth having if it got somewhere
+		const uint32_t triangles = simplifier.triangle_count();
+		if (triangles == 0 || static_cast<float>(triangles) > static_cast<float>(previousTriangles) * MIN_LEVEL_REDUCTION)
+		{
+			break;
+		}
+
+		levels.push_back(MeshLodLevel{ simplifier.write_indices() , static_cast<float>(simplifier.max_error()) });
+		previousTriangles = triangles;
+
+		if (!reached)
+		{
+			break;
+		}
+	}
+
+	return levels;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "vk_types.h"
+
+// one level of a simplified mesh, indexing the same vertices as the full mesh
+struct MeshLodLevel
+{
+	std::vector<uint32_t> indices;
+	// object space distance estimate between this level's surface and the full mesh
+	float error;
+};
+
+namespace vkutil
+{
+	// builds a chain of successively coarser levels by edge collapse with quadric error metrics
+	// (Garland and Heckbert 1997). every collapse moves a vertex onto a neighbour, so the levels
+	// reference the input vertices and need no vertex buffer of their own.
+	//
+	// corners with the same position but different uv or color sit on a seam. seam and border
+	// vertices only slide along their seam or border, and junctions of several never move, so
+	// texture and color seams keep their shape. normals may differ across an edge freely: each
+	// corner of a level picks whichever vertex at its position has the normal closest to its face,
+	// which lets flat shaded meshes simplify too.
+	//
+	// each level targets reduction times the triangles of the one before. the chain ends after
+	// maxLevels levels, or when a level cannot get below 90% of the one before.
+	// the full mesh is not part of the result.
+	std::vector<MeshLodLevel> build_lod_chain(std::span<const Vertex> vertices, std::span<const uint32_t> indices,
+	                                          uint32_t maxLevels, float reduction = 0.5f);
+}
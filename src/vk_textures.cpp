@@ -0,0 +1,213 @@
+#include "vk_textures.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "vk_blockcompress.h"
+#include "vk_jobs.h"
+
+namespace
+{
+	float srgb_to_linear(float c)
+	{
+		return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	float linear_to_srgb(float c)
+	{
+		return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+	}
+
+	// 8 bit sRGB to linear, and linear quantized to 12 bits back to 8 bit sRGB
+	constexpr uint32_t LINEAR_STEPS = 4096;
+
+	struct SrgbTables
+	{
+		std::array<float, 256> toLinear;
+		std::array<uint8_t, LINEAR_STEPS> toSrgb;
+
+		SrgbTables()
+		{
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				toLinear[i] = srgb_to_linear(static_cast<float>(i) / 255.f);
+			}
+			for (uint32_t i = 0; i < LINEAR_STEPS; i++)
+			{
+				const float linear = static_cast<float>(i) / static_cast<float>(LINEAR_STEPS - 1);
+				toSrgb[i] = static_cast<uint8_t>(std::lround(linear_to_srgb(linear) * 255.f));
+			}
+		}
+	};
+
+	const SrgbTables& srgb_tables()
+	{
+		static const SrgbTables tables;
+		return tables;
+	}
+
+	bool is_srgb(VkFormat format)
+	{
+		return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_B8G8R8A8_SRGB;
+	}
+}
+
+uint32_t vkutil::mip_level_count(uint32_t width, uint32_t height)
+{
+	return static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+}
+
+bool vkutil::load_image_rgba8(const std::filesystem::path& path, bool srgb, TextureData& out)
+{
+	int width;
+	int height;
+	int channels;
+	stbi_uc* pixels = stbi_load(path.string().c_str(), &width, &height, &channels, STBI_rgb_alpha);
+	if (pixels == nullptr)
+	{
+		return false;
+	}
+
+	out.width = static_cast<uint32_t>(width);
+	out.height = static_cast<uint32_t>(height);
+	out.format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	out.mips.clear();
+	out.mips.emplace_back(pixels, pixels + static_cast<size_t>(width) * height * 4);
+
+	stbi_image_free(pixels);
+	return true;
+}
+
+void vkutil::generate_mips_rgba8(JobSystem& jobs, TextureData& texture)
+{
+	const bool srgb = is_srgb(texture.format);
+	const SrgbTables& tables = srgb_tables();
+
+	texture.mips.resize(1);
+
+	uint32_t srcWidth = texture.width;
+	uint32_t srcHeight = texture.height;
+
+	while (srcWidth > 1 || srcHeight > 1)
+	{
+		const uint32_t dstWidth = std::max(srcWidth / 2, 1u);
+		const uint32_t dstHeight = std::max(srcHeight / 2, 1u);
+
+		std::vector<uint8_t> level(static_cast<size_t>(dstWidth) * dstHeight * 4);
+		const uint8_t* src = texture.mips.back().data();
+
+		jobs.parallel_for(dstHeight, 16, [&](size_t begin, size_t end)
+		{
+			for (size_t y = begin; y < end; y++)
+			{
+				// odd sizes clamp, so the last row or column is counted twice
+				const uint32_t y0 = std::min(static_cast<uint32_t>(y) * 2, srcHeight - 1);
+				const uint32_t y1 = std::min(y0 + 1, srcHeight - 1);
+
+				for (uint32_t x = 0; x < dstWidth; x++)
+				{
+					const uint32_t x0 = std::min(x * 2, srcWidth - 1);
+					const uint32_t x1 = std::min(x0 + 1, srcWidth - 1);
+
+					const uint8_t* texels[4] = {
+						src + (static_cast<size_t>(y0) * srcWidth + x0) * 4 ,
+						src + (static_cast<size_t>(y0) * srcWidth + x1) * 4 ,
+						src + (static_cast<size_t>(y1) * srcWidth + x0) * 4 ,
+						src + (static_cast<size_t>(y1) * srcWidth + x1) * 4
+					};
+
+					uint8_t* dst = level.data() + (y * dstWidth + x) * 4;
+
+					for (uint32_t c = 0; c < 4; c++)
+					{
+						// alpha is always linear
+						if (srgb && c < 3)
+						{
+							float sum = 0.f;
+							for (const uint8_t* texel : texels)
+							{
+								sum += tables.toLinear[texel[c]];
+							}
+							const auto step = static_cast<uint32_t>(sum * 0.25f * (LINEAR_STEPS - 1) + 0.5f);
+							dst[c] = tables.toSrgb[std::min(step, LINEAR_STEPS - 1)];
+						}
+						else
+						{
+							const uint32_t sum = texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c];
+							dst[c] = static_cast<uint8_t>((sum + 2) / 4);
+						}
+					}
+				}
+			}
+		});
+
+		texture.mips.push_back(std::move(level));
+		srcWidth = dstWidth;
+		srcHeight = dstHeight;
+	}
+}
+
+bool vkutil::is_srgb_texture(std::string_view name)
+{
+	return name.find("-Alpha") == std::string_view::npos;
+}
+
+VkFormat vkutil::select_block_format(std::string_view name, bool preferBc3)
+{
+	const bool srgb = is_srgb_texture(name);
+
+	// -RGBA contains -RGB, so it is checked first
+	if (name.find("-RGBA") != std::string_view::npos)
+	{
+		return preferBc3 ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC7_SRGB_BLOCK;
+	}
+	if (name.find("-RGB") != std::string_view::npos || name.find("-Alpha") != std::string_view::npos)
+	{
+		return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+	}
+
+	if (preferBc3)
+	{
+		return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+	}
+	return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+}
+
+void vkutil::compress_texture(JobSystem& jobs, TextureData& texture, VkFormat format, TextureCompressionStats* stats)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::vector<uint8_t>> blocks;
+	uint64_t texelCount = 0;
+	uint64_t sourceBytes = 0;
+	uint64_t compressedBytes = 0;
+
+	for (uint32_t level = 0; level < texture.mips.size(); level++)
+	{
+		const uint32_t width = std::max(texture.width >> level, 1u);
+		const uint32_t height = std::max(texture.height >> level, 1u);
+
+		blocks.push_back(compress_surface(jobs, texture.mips[level].data(), width, height, format));
+
+		texelCount += static_cast<uint64_t>(width) * height;
+		sourceBytes += texture.mips[level].size();
+		compressedBytes += blocks.back().size();
+	}
+
+	if (stats != nullptr)
+	{
+		stats->encodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		stats->megapixelsPerSecond = static_cast<double>(texelCount) / (stats->encodeMs * 1000.0);
+		stats->sourceBytes = sourceBytes;
+		stats->compressedBytes = compressedBytes;
+		stats->psnr = compute_psnr(jobs, texture.mips[0].data(), blocks[0], texture.width, texture.height, format);
+	}
+
+	texture.format = format;
+	texture.mips = std::move(blocks);
+}
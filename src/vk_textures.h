@@ -0,0 +1,49 @@
+#pragma once
+
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+#include "vk_types.h"
+
+class JobSystem;
+
+// texels or blocks of every mip level, level 0 first, each level tightly packed
+struct TextureData
+{
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	VkFormat format{ VK_FORMAT_UNDEFINED };
+	std::vector<std::vector<uint8_t>> mips;
+};
+
+struct TextureCompressionStats
+{
+	double encodeMs{ 0 };
+	double megapixelsPerSecond{ 0 };
+	// level 0 against the rgba8 source
+	double psnr{ 0 };
+	uint64_t sourceBytes{ 0 };
+	uint64_t compressedBytes{ 0 };
+};
+
+namespace vkutil
+{
+	uint32_t mip_level_count(uint32_t width, uint32_t height);
+
+	// decodes any stb_image format to RGBA8, level 0 only. returns false if the file cannot be decoded.
+	bool load_image_rgba8(const std::filesystem::path& path, bool srgb, TextureData& out);
+
+	// box filters level 0 down to 1x1. sRGB textures are averaged in linear space.
+	void generate_mips_rgba8(JobSystem& jobs, TextureData& texture);
+
+	// the lost_empire atlas comes in -RGB, -RGBA and -Alpha variants. the -Alpha masks hold linear coverage.
+	bool is_srgb_texture(std::string_view name);
+	// -RGB is opaque color: BC1. -Alpha is a black and white mask: BC1 unorm.
+	// -RGBA and anything unknown keeps its alpha: BC7, or BC3 where BC7 is unwanted.
+	VkFormat select_block_format(std::string_view name, bool preferBc3 = false);
+
+	// replaces every rgba8 mip with its blocks. stats are optional, the psnr costs a decode of level 0.
+	void compress_texture(JobSystem& jobs, TextureData& texture, VkFormat format,
+	                      TextureCompressionStats* stats = nullptr);
+}
@@ -0,0 +1,56 @@
+#include "vk_timeline.h"
+
+#include "vk_initializers.h"
+
+void FrameTimeline::init(VkDevice device)
+{
+	VkSemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo = vkinit::semaphore_create_info();
+	semaphoreInfo.pNext = &typeInfo;
+
+	VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore));
+}
+
+void FrameTimeline::destroy(VkDevice device)
+{
+	vkDestroySemaphore(device, semaphore, nullptr);
+	semaphore = VK_NULL_HANDLE;
+}
+
+VkSemaphoreSubmitInfo FrameTimeline::signal_info(uint64_t frame, VkPipelineStageFlags2 stageMask) const
+{
+	VkSemaphoreSubmitInfo submitInfo = vkinit::semaphore_submit_info(stageMask, semaphore);
+	submitInfo.value = completion_value(frame);
+
+	return submitInfo;
+}
+
+VkResult FrameTimeline::wait(VkDevice device, uint64_t frame, uint64_t timeout) const
+{
+	const uint64_t value = completion_value(frame);
+
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &semaphore;
+	waitInfo.pValues = &value;
+
+	return vkWaitSemaphores(device, &waitInfo, timeout);
+}
+
+bool FrameTimeline::is_complete(VkDevice device, uint64_t frame) const
+{
+	return completed_frames(device) >= completion_value(frame);
+}
+
+uint64_t FrameTimeline::completed_frames(VkDevice device) const
+{
+	uint64_t value = 0;
+	VK_CHECK(vkGetSemaphoreCounterValue(device, semaphore, &value));
+
+	return value;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "vk_types.h"
+
+// one timeline semaphore counting finished frames: the submission of frame N signals N + 1.
+// anything that has to outlive a frame (uploads, deferred deletion, readback) waits on
+// "frame N complete" through this instead of owning a fence. every call is thread safe.
+class FrameTimeline
+{
+public:
+	void init(VkDevice device);
+	void destroy(VkDevice device);
+
+	static uint64_t completion_value(uint64_t frame) { return frame + 1; }
+
+	// add to the submission of frame so it advances the timeline when it retires
+	VkSemaphoreSubmitInfo signal_info(uint64_t frame, VkPipelineStageFlags2 stageMask) const;
+
+	// blocks until frame has finished on the gpu, VK_TIMEOUT if it did not within timeout
+	VkResult wait(VkDevice device, uint64_t frame, uint64_t timeout) const;
+	bool is_complete(VkDevice device, uint64_t frame) const;
+
+	// how many frames have finished, every frame below this number is complete
+	uint64_t completed_frames(VkDevice device) const;
+
+	VkSemaphore semaphore{ VK_NULL_HANDLE };
+};
@@ -0,0 +1,387 @@
+#include "vk_transforms.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <xmmintrin.h>
+#define VKUTIL_TRANSFORMS_SSE2 1
+#endif
+
+#include "vk_cpu_profiler.h"
+#include "vk_jobs.h"
+
+namespace
+{
+	// levels are split into batches of at least this many nodes
+	constexpr uint32_t UPDATE_BATCH = 1024;
+
+	// roots multiply by this instead of a parent
+	const glm::mat4 IDENTITY{ 1.f };
+}
+
+TransformHierarchy::Node TransformHierarchy::add_node(Node parent, const LocalTransform& local)
+{
+	const Node node = static_cast<Node>(slotNodes.size());
+	const uint32_t slot = node;
+
+	// appended out of order, the next update sorts it into its level
+	for (auto& component : locals)
+	{
+		component.push_back(0.f);
+	}
+	worlds.push_back(IDENTITY);
+	parentSlots.push_back(parent == NO_PARENT ? NO_PARENT : nodeSlots[parent]);
+	depths.push_back(parent == NO_PARENT ? 0 : depths[nodeSlots[parent]] + 1);
+	dirty.push_back(0);
+	slotNodes.push_back(node);
+	nodeSlots.push_back(slot);
+	unsorted = true;
+
+	set_local(node, local);
+	return node;
+}
+
+void TransformHierarchy::set_local(Node node, const LocalTransform& local)
+{
+	set_position(node, local.position);
+	set_rotation(node, local.rotation);
+	set_scale(node, local.scale);
+}
+
+void TransformHierarchy::set_position(Node node, const glm::vec3& position)
+{
+	const uint32_t slot = nodeSlots[node];
+	locals[PositionX][slot] = position.x;
+	locals[PositionY][slot] = position.y;
+	locals[PositionZ][slot] = position.z;
+	mark_dirty(slot);
+}
+
+void TransformHierarchy::set_rotation(Node node, const glm::quat& rotation)
+{
+	const uint32_t slot = nodeSlots[node];
+	const glm::quat unit = glm::normalize(rotation);
+	locals[RotationX][slot] = unit.x;
+	locals[RotationY][slot] = unit.y;
+	locals[RotationZ][slot] = unit.z;
+	locals[RotationW][slot] = unit.w;
+	mark_dirty(slot);
+}
+
+void TransformHierarchy::set_scale(Node node, const glm::vec3& scale)
+{
+	const uint32_t slot = nodeSlots[node];
+	locals[ScaleX][slot] = scale.x;
+	locals[ScaleY][slot] = scale.y;
+	locals[ScaleZ][slot] = scale.z;
+	mark_dirty(slot);
+}
+
+LocalTransform TransformHierarchy::local(Node node) const
+{
+	const uint32_t slot = nodeSlots[node];
+	return LocalTransform{
+		glm::vec3{ locals[PositionX][slot] , locals[PositionY][slot] , locals[PositionZ][slot] } ,
+		glm::quat{ locals[RotationW][slot] , locals[RotationX][slot] , locals[RotationY][slot] , locals[RotationZ][slot] } ,
+		glm::vec3{ locals[ScaleX][slot] , locals[ScaleY][slot] , locals[ScaleZ][slot] }
+	};
+}
+
+TransformHierarchy::Node TransformHierarchy::parent(Node node) const
+{
+	const uint32_t parentSlot = parentSlots[nodeSlots[node]];
+	return parentSlot == NO_PARENT ? NO_PARENT : slotNodes[parentSlot];
+}
+
+void TransformHierarchy::mark_dirty(uint32_t slot)
+{
+	dirty[slot] = 1;
+	firstDirtyDepth = std::min(firstDirtyDepth, depths[slot]);
+}
+
+void TransformHierarchy::sort_by_depth()
+{
+	const uint32_t count = node_count();
+	const uint32_t levels = *std::max_element(depths.begin(), depths.end()) + 1;
+
+	// counting sort, stable so siblings added together stay together
+	levelOffsets.assign(levels + 1, 0);
+	for (const uint32_t depth : depths)
+	{
+		levelOffsets[depth + 1]++;
+	}
+	for (uint32_t level = 0; level < levels; level++)
+	{
+		levelOffsets[level + 1] += levelOffsets[level];
+	}
+
+	std::vector<uint32_t> newSlots(count);
+	std::vector<uint32_t> cursor(levelOffsets.begin(), levelOffsets.end() - 1);
+	for (uint32_t slot = 0; slot < count; slot++)
+	{
+		newSlots[slot] = cursor[depths[slot]]++;
+	}
+
+	auto permute = [&](auto& values)
+	{
+		std::remove_reference_t<decltype(values)> sorted(values.size());
+		for (uint32_t slot = 0; slot < count; slot++)
+		{
+			sorted[newSlots[slot]] = values[slot];
+		}
+		values = std::move(sorted);
+	};
+
+	for (auto& component : locals)
+	{
+		permute(component);
+	}
+	permute(worlds);
+	permute(depths);
+	permute(dirty);
+	permute(slotNodes);
+	permute(parentSlots);
+
+	for (uint32_t& parentSlot : parentSlots)
+	{
+		if (parentSlot != NO_PARENT)
+		{
+			parentSlot = newSlots[parentSlot];
+		}
+	}
+	for (uint32_t slot = 0; slot < count; slot++)
+	{
+		nodeSlots[slotNodes[slot]] = slot;
+	}
+
+	unsorted = false;
+}
+
+uint32_t TransformHierarchy::update(JobSystem* jobs)
+{
+	if (unsorted)
+	{
+		sort_by_depth();
+	}
+	if (firstDirtyDepth == NO_PARENT)
+	{
+		return 0;
+	}
+
+	PROFILE_ZONE("transform update");
+
+	std::atomic<uint32_t> updated{ 0 };
+
+	// a level only reads its parents' flags and matrices, which the level before has finished
+	for (uint32_t level = firstDirtyDepth; level < level_count(); level++)
+	{
+		const uint32_t begin = levelOffsets[level];
+		const uint32_t count = levelOffsets[level + 1] - begin;
+
+		auto update_batch = [&](size_t batchBegin, size_t batchEnd)
+		{
+			const uint32_t first = begin + static_cast<uint32_t>(batchBegin);
+			const uint32_t last = begin + static_cast<uint32_t>(batchEnd);
+
+			// children inherit their parent's flag, the roots of level 0 have none to inherit
+			if (level > 0)
+			{
+				for (uint32_t slot = first; slot < last; slot++)
+				{
+					dirty[slot] |= dirty[parentSlots[slot]];
+				}
+			}
+			updated += update_range(first, last);
+		};
+
+		if (jobs == nullptr)
+		{
+			update_batch(0, count);
+		}
+		else
+		{
+			jobs->parallel_for(count, UPDATE_BATCH, update_batch);
+		}
+	}
+
+	std::fill(dirty.begin() + levelOffsets[firstDirtyDepth], dirty.end(), 0);
+	firstDirtyDepth = NO_PARENT;
+
+	return updated.load();
+}
+
+#ifdef VKUTIL_TRANSFORMS_SSE2
+
+uint32_t TransformHierarchy::update_range(uint32_t begin, uint32_t end)
+{
+	uint32_t updated = 0;
+
+	// four nodes at a time, a node per lane. the tail repeats the last node and never stores it.
+	for (uint32_t first = begin; first < end; first += 4)
+	{
+		// mostly clean when little has changed, so test all four flags at once
+		const bool fullGroup = first + 4 <= end;
+		if (fullGroup)
+		{
+			uint32_t flags;
+			std::memcpy(&flags, &dirty[first], sizeof(flags));
+			if (flags == 0)
+			{
+				continue;
+			}
+		}
+
+		uint32_t slots[4];
+		bool store[4];
+		bool anyDirty = false;
+		for (uint32_t lane = 0; lane < 4; lane++)
+		{
+			slots[lane] = std::min(first + lane, end - 1);
+			store[lane] = first + lane < end && dirty[slots[lane]];
+			anyDirty |= store[lane];
+		}
+		if (!anyDirty)
+		{
+			continue;
+		}
+
+		// the components sit side by side, only the tail has to be gathered
+		auto component = [&](LocalComponent c)
+		{
+			const float* values = locals[c].data();
+			return fullGroup ? _mm_loadu_ps(values + first)
+			                 : _mm_setr_ps(values[slots[0]], values[slots[1]], values[slots[2]], values[slots[3]]);
+		};
+
+		const __m128 qx = component(RotationX);
+		const __m128 qy = component(RotationY);
+		const __m128 qz = component(RotationZ);
+		const __m128 qw = component(RotationW);
+		const __m128 sx = component(ScaleX);
+		const __m128 sy = component(ScaleY);
+		const __m128 sz = component(ScaleZ);
+
+		const __m128 one = _mm_set1_ps(1.f);
+		const __m128 two = _mm_set1_ps(2.f);
+		const __m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+		const __m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+		const __m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+
+		// local[column][row] of the four nodes: the quaternion's rotation, a column per scale axis, then the position
+		__m128 local[4][3];
+		local[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+		local[0][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+		local[0][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+		local[1][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+		local[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+		local[1][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+		local[2][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+		local[2][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+		local[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+		local[3][0] = component(PositionX);
+		local[3][1] = component(PositionY);
+		local[3][2] = component(PositionZ);
+
+		// the parents' columns, transposed so each register holds one element of all four
+		const float* parents[4];
+		for (uint32_t lane = 0; lane < 4; lane++)
+		{
+			const uint32_t parentSlot = parentSlots[slots[lane]];
+			parents[lane] = &(parentSlot == NO_PARENT ? IDENTITY : worlds[parentSlot])[0][0];
+		}
+
+		__m128 parent[4][4];
+		for (uint32_t column = 0; column < 4; column++)
+		{
+			parent[column][0] = _mm_loadu_ps(parents[0] + column * 4);
+			parent[column][1] = _mm_loadu_ps(parents[1] + column * 4);
+			parent[column][2] = _mm_loadu_ps(parents[2] + column * 4);
+			parent[column][3] = _mm_loadu_ps(parents[3] + column * 4);
+			_MM_TRANSPOSE4_PS(parent[column][0], parent[column][1], parent[column][2], parent[column][3]);
+		}
+
+		// every matrix here is affine, so only the top three rows take any work
+		for (uint32_t column = 0; column < 4; column++)
+		{
+			__m128 world[4];
+			for (uint32_t row = 0; row < 3; row++)
+			{
+				__m128 sum = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(parent[0][row], local[column][0]), _mm_mul_ps(parent[1][row], local[column][1])),
+					_mm_mul_ps(parent[2][row], local[column][2]));
+				if (column == 3)
+				{
+					sum = _mm_add_ps(sum, parent[3][row]);
+				}
+				world[row] = sum;
+			}
+			world[3] = column == 3 ? one : _mm_setzero_ps();
+
+			_MM_TRANSPOSE4_PS(world[0], world[1], world[2], world[3]);
+			for (uint32_t lane = 0; lane < 4; lane++)
+			{
+				if (store[lane])
+				{
+					_mm_storeu_ps(&worlds[slots[lane]][column][0], world[lane]);
+				}
+			}
+		}
+
+		for (uint32_t lane = 0; lane < 4; lane++)
+		{
+			updated += store[lane];
+		}
+	}
+
+	return updated;
+}
+
+#else
+
+namespace
+{
+	// local to parent matrix of a unit quaternion rotation between a scale and a translation
+	glm::mat4 local_matrix(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+	{
+		const float xx = rotation.x * rotation.x, yy = rotation.y * rotation.y, zz = rotation.z * rotation.z;
+		const float xy = rotation.x * rotation.y, xz = rotation.x * rotation.z, yz = rotation.y * rotation.z;
+		const float wx = rotation.w * rotation.x, wy = rotation.w * rotation.y, wz = rotation.w * rotation.z;
+
+		return glm::mat4{
+			glm::vec4{ 1.f - 2.f * (yy + zz) , 2.f * (xy + wz) , 2.f * (xz - wy) , 0.f } * scale.x ,
+			glm::vec4{ 2.f * (xy - wz) , 1.f - 2.f * (xx + zz) , 2.f * (yz + wx) , 0.f } * scale.y ,
+			glm::vec4{ 2.f * (xz + wy) , 2.f * (yz - wx) , 1.f - 2.f * (xx + yy) , 0.f } * scale.z ,
+			glm::vec4{ position , 1.f }
+		};
+	}
+}
+
+uint32_t TransformHierarchy::update_range(uint32_t begin, uint32_t end)
+{
+	uint32_t updated = 0;
+
+	for (uint32_t slot = begin; slot < end; slot++)
+	{
+		if (!dirty[slot])
+		{
+			continue;
+		}
+
+		const uint32_t parentSlot = parentSlots[slot];
+
+		const glm::vec3 position{ locals[PositionX][slot] , locals[PositionY][slot] , locals[PositionZ][slot] };
+		const glm::quat rotation{ locals[RotationW][slot] , locals[RotationX][slot] , locals[RotationY][slot] , locals[RotationZ][slot] };
+		const glm::vec3 scale{ locals[ScaleX][slot] , locals[ScaleY][slot] , locals[ScaleZ][slot] };
+
+		const glm::mat4& parentWorld = parentSlot == NO_PARENT ? IDENTITY : worlds[parentSlot];
+		worlds[slot] = parentWorld * local_matrix(position, rotation, scale);
+		updated++;
+	}
+
+	return updated;
+}
+
+#endif
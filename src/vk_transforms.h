@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <glm/gtc/quaternion.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+class JobSystem;
+
+// a node's transform relative to its parent
+struct LocalTransform
+{
+	glm::vec3 position{ 0.f };
+	glm::quat rotation{ 1.f , 0.f , 0.f , 0.f };
+	glm::vec3 scale{ 1.f };
+};
+
+// a flat transform hierarchy laid out for updating many nodes at once. nodes are kept sorted by
+// depth, so every parent comes before its children and each level is one contiguous run. the
+// local transforms are stored a component per array, which lets the update load four nodes'
+// worth of each component in one go and build their world matrices side by side.
+//
+// changing a node marks it dirty. update walks the levels from the shallowest one with a change,
+// passes the flags down from parents and recomputes only the dirty nodes, splitting each level
+// across the job system. everything above and beside a change is left alone.
+class TransformHierarchy
+{
+public:
+	using Node = uint32_t;
+	static constexpr Node NO_PARENT = ~0u;
+
+	// the parent must already exist. the new node is dirty.
+	Node add_node(Node parent, const LocalTransform& local = {});
+
+	void set_local(Node node, const LocalTransform& local);
+	void set_position(Node node, const glm::vec3& position);
+	// normalized on the way in, the update assumes unit quaternions
+	void set_rotation(Node node, const glm::quat& rotation);
+	void set_scale(Node node, const glm::vec3& scale);
+
+	LocalTransform local(Node node) const;
+	Node parent(Node node) const;
+	// parent world times local, current as of the last update
+	const glm::mat4& world(Node node) const { return worlds[nodeSlots[node]]; }
+
+	// recomputes every dirty node and everything below it. with jobs, each level is split across its
+	// threads, one level at a time. returns how many world matrices were recomputed.
+	uint32_t update(JobSystem* jobs = nullptr);
+
+	uint32_t node_count() const { return static_cast<uint32_t>(slotNodes.size()); }
+	uint32_t level_count() const { return levelOffsets.empty() ? 0 : static_cast<uint32_t>(levelOffsets.size() - 1); }
+
+private:
+	enum LocalComponent
+	{
+		PositionX, PositionY, PositionZ,
+		RotationX, RotationY, RotationZ, RotationW,
+		ScaleX, ScaleY, ScaleZ,
+		LOCAL_COMPONENT_COUNT
+	};
+
+	void mark_dirty(uint32_t slot);
+	void sort_by_depth();
+	// recomputes the dirty slots in [begin, end) of one level, whose flags already include their parents'. returns how many.
+	uint32_t update_range(uint32_t begin, uint32_t end);
+
+	// everything below is indexed by slot, the node's position in depth order
+	std::array<std::vector<float>, LOCAL_COMPONENT_COUNT> locals;
+	std::vector<glm::mat4> worlds;
+	std::vector<uint32_t> parentSlots;
+	std::vector<uint32_t> depths;
+	std::vector<uint8_t> dirty;
+	std::vector<Node> slotNodes;
+
+	std::vector<uint32_t> nodeSlots;
+	// slots of level i are [levelOffsets[i], levelOffsets[i + 1])
+	std::vector<uint32_t> levelOffsets;
+
+	// nodes added since the last sort sit unsorted at the end
+	bool unsorted{ false };
+	// the shallowest depth with a dirty node, NO_PARENT when nothing changed
+	uint32_t firstDirtyDepth{ NO_PARENT };
+};
@@ -3,11 +3,14 @@
 
 #pragma once
 
-#include <deque>
 #include <functional>
+#include <vector>
 #include <vulkan/vulkan.h>
 #include <iostream>
 
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
 #include "vk_mem_alloc.h"
 
 //we will add our main reusable types here
@@ -35,11 +38,50 @@ inline T ceil_divide(T dividend, T divisor)
 
 #define GATE(signal, base) ((base)?(signal):0)
 
+// deferred destruction, stored as one contiguous array per handle type.
+// flush() destroys dependents before what they depend on (pipelines before layouts,
+// views before images), each type in reverse push order. the arrays keep their
+// capacity, so a queue that is flushed every frame stops allocating after warm up.
 struct DeletionQueue
 {
-	std::deque<std::function<void()>> deletors;
+	void push_image(VkImage image, VmaAllocation allocation);
+	void push_buffer(VkBuffer buffer, VmaAllocation allocation);
+	void push_image_view(VkImageView view);
+	void push_sampler(VkSampler sampler);
+	void push_pipeline(VkPipeline pipeline);
+	void push_pipeline_layout(VkPipelineLayout layout);
+	void push_descriptor_set_layout(VkDescriptorSetLayout layout);
+	void push_descriptor_pool(VkDescriptorPool pool);
+	void push_command_pool(VkCommandPool pool);
+	void push_fence(VkFence fence);
+	void push_semaphore(VkSemaphore semaphore);
+
+	// escape hatch for anything without a typed entry. these run first, in reverse order.
 	void push_function(std::function<void()>&& function);
-	void flush();
+
+	void flush(VkDevice device, VmaAllocator allocator);
+
+private:
+	template <typename T>
+	struct Allocated
+	{
+		T handle;
+		VmaAllocation allocation;
+	};
+
+	std::vector<std::function<void()>> deletors;
+
+	std::vector<VkPipeline> pipelines;
+	std::vector<VkPipelineLayout> pipelineLayouts;
+	std::vector<VkDescriptorPool> descriptorPools;
+	std::vector<VkDescriptorSetLayout> descriptorSetLayouts;
+	std::vector<VkSampler> samplers;
+	std::vector<VkImageView> imageViews;
+	std::vector<Allocated<VkImage>> images;
+	std::vector<Allocated<VkBuffer>> buffers;
+	std::vector<VkCommandPool> commandPools;
+	std::vector<VkFence> fences;
+	std::vector<VkSemaphore> semaphores;
 };
 
 struct AllocatedImage
@@ -50,3 +92,28 @@ struct AllocatedImage
 	VkExtent3D imageExtent;
 	VkFormat imageFormat;
 };
+
+struct AllocatedBuffer
+{
+	VkBuffer buffer;
+	VmaAllocation allocation;
+	VmaAllocationInfo info;
+};
+
+// interleaved so a vertex is three 16 byte loads, uvs fill the padding after the vec3s
+struct Vertex
+{
+	glm::vec3 position;
+	float uv_x;
+	glm::vec3 normal;
+	float uv_y;
+	glm::vec4 color;
+};
+
+// vertices are read from the shader through their device address, not bound as vertex buffers
+struct GPUMeshBuffers
+{
+	AllocatedBuffer indexBuffer;
+	AllocatedBuffer vertexBuffer;
+	VkDeviceAddress vertexBufferAddress;
+};
@@ -0,0 +1,530 @@
+#include "vk_upload.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "vk_initializers.h"
+
+namespace
+{
+	// keeps every staging offset valid for buffer copies and for any block size we upload
+	constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+	VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+void UploadManager::init(VkDevice device, VmaAllocator allocator, const QueueInfo& queues,
+                         VkDeviceSize stagingSize, VkDeviceSize submitBudget)
+{
+	this->device = device;
+	this->allocator = allocator;
+	this->queues = queues;
+	this->submitBudget = submitBudget;
+
+	stagingCapacity = align_up(stagingSize, STAGING_ALIGNMENT);
+
+	VkBufferCreateInfo bufferInfo = { .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+	bufferInfo.pNext = nullptr;
+	bufferInfo.size = stagingCapacity;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+	// host coherent, so writes through the mapping need no flush
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+	allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+	VK_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &staging.buffer, &staging.allocation, &staging.info));
+	stagingData = static_cast<uint8_t*>(staging.info.pMappedData);
+
+	VkSemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo = vkinit::semaphore_create_info();
+	semaphoreInfo.pNext = &typeInfo;
+
+	VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &timeline));
+
+	const VkCommandPoolCreateInfo poolInfo = vkinit::command_pool_create_info(
+		queues.transferFamily,
+		VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+
+	VK_CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool));
+}
+
+void UploadManager::destroy()
+{
+	vkDestroyCommandPool(device, commandPool, nullptr);
+	vkDestroySemaphore(device, timeline, nullptr);
+	vmaDestroyBuffer(allocator, staging.buffer, staging.allocation);
+
+	freeCommandBuffers.clear();
+	inFlight.clear();
+	queued.clear();
+	incoming.clear();
+}
+
+UploadTicket UploadManager::upload_buffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size)
+{
+	if (size == 0)
+	{
+		return UploadTicket{};
+	}
+
+	Request request{};
+	request.data = static_cast<const uint8_t*>(data);
+	request.size = size;
+	request.buffer = buffer;
+	request.bufferOffset = offset;
+
+	std::lock_guard lock(incomingMutex);
+	request.id = nextRequestId++;
+	incoming.push_back(request);
+
+	return UploadTicket{ request.id };
+}
+
+UploadTicket UploadManager::upload_image(VkImage image, VkFormat format, VkExtent3D extent, uint32_t mipLevel,
+                                         const void* data, VkImageLayout finalLayout)
+{
+	Request request{};
+	request.data = static_cast<const uint8_t*>(data);
+	request.image = image;
+	request.extent = extent;
+	request.mipLevel = mipLevel;
+	request.finalLayout = finalLayout;
+	request.block = vkutil::format_block_info(format);
+
+	// images are split into whole rows of blocks
+	request.rowBytes = static_cast<VkDeviceSize>(ceil_divide(extent.width, request.block.width)) * request.block.bytes;
+	request.rowCount = ceil_divide(extent.height, request.block.height);
+	request.size = request.rowBytes * request.rowCount;
+
+	if (request.rowBytes > stagingCapacity / 2)
+	{
+		std::cout << "Upload: a row of " << request.rowBytes << " bytes does not fit the staging ring" << std::endl;
+		abort();
+	}
+
+	std::lock_guard lock(incomingMutex);
+	request.id = nextRequestId++;
+	incoming.push_back(request);
+
+	return UploadTicket{ request.id };
+}
+
+void UploadManager::submit()
+{
+	retire_batches();
+
+	{
+		std::lock_guard lock(incomingMutex);
+		queued.insert(queued.end(), incoming.begin(), incoming.end());
+		incoming.clear();
+	}
+
+	if (queued.empty())
+	{
+		return;
+	}
+
+	stagedCopies.clear();
+	imageBarriers.clear();
+	finalImageBarriers.clear();
+	finalBufferBarriers.clear();
+
+	Batch batch{};
+
+	// half the ring at most, so one chunk can always follow the batch still in flight
+	const VkDeviceSize maxChunk = std::min(submitBudget, stagingCapacity / 2);
+	VkDeviceSize budget = submitBudget;
+
+	while (!queued.empty() && budget > 0)
+	{
+		Request& request = queued.front();
+		VkDeviceSize stagingOffset = 0;
+
+		if (request.image == VK_NULL_HANDLE)
+		{
+			const VkDeviceSize chunk = std::min({ request.size - request.progress , budget , maxChunk });
+			if (!allocate_staging(chunk, stagingOffset))
+			{
+				uploadStats.ringFullStalls++;
+				break;
+			}
+
+			memcpy(stagingData + stagingOffset, request.data + request.progress, chunk);
+
+			StagedCopy copy{};
+			copy.buffer = request.buffer;
+			copy.bufferCopy.srcOffset = stagingOffset;
+			copy.bufferCopy.dstOffset = request.bufferOffset + request.progress;
+			copy.bufferCopy.size = chunk;
+			stagedCopies.push_back(copy);
+
+			request.progress += chunk;
+			budget -= chunk;
+			batch.bytes += chunk;
+		}
+		else
+		{
+			const VkDeviceSize rows = std::min<VkDeviceSize>(
+				request.rowCount - request.progress,
+				std::max<VkDeviceSize>(1, std::min(budget, maxChunk) / request.rowBytes));
+			const VkDeviceSize chunk = rows * request.rowBytes;
+
+			if (!allocate_staging(chunk, stagingOffset))
+			{
+				uploadStats.ringFullStalls++;
+				break;
+			}
+
+			if (request.progress == 0)
+			{
+				Ownership target{};
+				target.image = request.image;
+				target.mipLevel = request.mipLevel;
+				target.layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+				VkImageMemoryBarrier2 barrier = image_barrier(target, false);
+				barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+				barrier.srcAccessMask = 0;
+				barrier.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+				barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+				barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				imageBarriers.push_back(barrier);
+			}
+
+			memcpy(stagingData + stagingOffset, request.data + request.progress * request.rowBytes, chunk);
+
+			const uint32_t firstTexelRow = static_cast<uint32_t>(request.progress) * request.block.height;
+
+			StagedCopy copy{};
+			copy.image = request.image;
+			copy.imageCopy.bufferOffset = stagingOffset;
+			copy.imageCopy.bufferRowLength = 0;
+			copy.imageCopy.bufferImageHeight = 0;
+			copy.imageCopy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			copy.imageCopy.imageSubresource.mipLevel = request.mipLevel;
+			copy.imageCopy.imageSubresource.baseArrayLayer = 0;
+			copy.imageCopy.imageSubresource.layerCount = 1;
+			copy.imageCopy.imageOffset = VkOffset3D{ 0 , static_cast<int32_t>(firstTexelRow) , 0 };
+			copy.imageCopy.imageExtent = VkExtent3D{
+				request.extent.width ,
+				std::min(static_cast<uint32_t>(rows) * request.block.height, request.extent.height - firstTexelRow) ,
+				1
+			};
+			stagedCopies.push_back(copy);
+
+			request.progress += rows;
+			// a single row is allowed to overshoot the budget
+			budget -= std::min(budget, chunk);
+			batch.bytes += chunk;
+		}
+
+		const bool finished = request.image == VK_NULL_HANDLE
+			                      ? request.progress == request.size
+			                      : request.progress == request.rowCount;
+		if (!finished)
+		{
+			continue;
+		}
+
+		Ownership ownership{};
+		ownership.buffer = request.buffer;
+		ownership.offset = request.bufferOffset;
+		ownership.size = request.size;
+		ownership.image = request.image;
+		ownership.mipLevel = request.mipLevel;
+		ownership.layout = request.finalLayout;
+
+		// release on the transfer family, or just make the copy visible when there is only one
+		if (request.image == VK_NULL_HANDLE)
+		{
+			finalBufferBarriers.push_back(buffer_barrier(ownership, false));
+		}
+		else
+		{
+			finalImageBarriers.push_back(image_barrier(ownership, false));
+		}
+
+		if (uses_dedicated_queue())
+		{
+			batch.acquires.push_back(ownership);
+		}
+
+		batch.lastRequest = request.id;
+		queued.pop_front();
+	}
+
+	if (stagedCopies.empty())
+	{
+		return;
+	}
+
+	VkCommandBuffer cmd;
+	if (freeCommandBuffers.empty())
+	{
+		const VkCommandBufferAllocateInfo cmdAllocInfo = vkinit::command_buffer_allocate_info(commandPool);
+		VK_CHECK(vkAllocateCommandBuffers(device, &cmdAllocInfo, &cmd));
+	}
+	else
+	{
+		cmd = freeCommandBuffers.back();
+		freeCommandBuffers.pop_back();
+	}
+
+	const auto cmdBeginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
+
+	if (!imageBarriers.empty())
+	{
+		VkDependencyInfo depInfo{};
+		depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		depInfo.imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size());
+		depInfo.pImageMemoryBarriers = imageBarriers.data();
+
+		vkCmdPipelineBarrier2(cmd, &depInfo);
+	}
+
+	for (const StagedCopy& copy : stagedCopies)
+	{
+		if (copy.image == VK_NULL_HANDLE)
+		{
+			vkCmdCopyBuffer(cmd, staging.buffer, copy.buffer, 1, &copy.bufferCopy);
+		}
+		else
+		{
+			vkCmdCopyBufferToImage(cmd, staging.buffer, copy.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+			                       &copy.imageCopy);
+		}
+	}
+
+	if (!finalImageBarriers.empty() || !finalBufferBarriers.empty())
+	{
+		VkDependencyInfo depInfo{};
+		depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		depInfo.imageMemoryBarrierCount = static_cast<uint32_t>(finalImageBarriers.size());
+		depInfo.pImageMemoryBarriers = finalImageBarriers.data();
+		depInfo.bufferMemoryBarrierCount = static_cast<uint32_t>(finalBufferBarriers.size());
+		depInfo.pBufferMemoryBarriers = finalBufferBarriers.data();
+
+		vkCmdPipelineBarrier2(cmd, &depInfo);
+	}
+
+	VK_CHECK(vkEndCommandBuffer(cmd));
+
+	batch.timelineValue = ++lastSubmittedValue;
+	batch.ringEnd = ringHead;
+	batch.cmd = cmd;
+	batch.submitTime = std::chrono::steady_clock::now();
+
+	auto cmdInfo = vkinit::command_buffer_submit_info(cmd);
+	auto signalInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, timeline);
+	signalInfo.value = batch.timelineValue;
+
+	const auto submitInfo = vkinit::submit_info(&cmdInfo, &signalInfo, nullptr);
+	VK_CHECK(vkQueueSubmit2(queues.transferQueue, 1, &submitInfo, VK_NULL_HANDLE));
+
+	uploadStats.copies += stagedCopies.size();
+	uploadStats.batches++;
+
+	inFlight.push_back(std::move(batch));
+}
+
+uint64_t UploadManager::record_acquires(VkCommandBuffer cmd)
+{
+	retire_batches();
+
+	if (readyAcquires.empty())
+	{
+		return 0;
+	}
+
+	finalImageBarriers.clear();
+	finalBufferBarriers.clear();
+
+	for (const Ownership& ownership : readyAcquires)
+	{
+		if (ownership.image == VK_NULL_HANDLE)
+		{
+			finalBufferBarriers.push_back(buffer_barrier(ownership, true));
+		}
+		else
+		{
+			finalImageBarriers.push_back(image_barrier(ownership, true));
+		}
+	}
+
+	VkDependencyInfo depInfo{};
+	depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	depInfo.imageMemoryBarrierCount = static_cast<uint32_t>(finalImageBarriers.size());
+	depInfo.pImageMemoryBarriers = finalImageBarriers.data();
+	depInfo.bufferMemoryBarrierCount = static_cast<uint32_t>(finalBufferBarriers.size());
+	depInfo.pBufferMemoryBarriers = finalBufferBarriers.data();
+
+	vkCmdPipelineBarrier2(cmd, &depInfo);
+
+	readyAcquires.clear();
+
+	// anything recorded after the acquire may use these resources
+	completedRequest.store(readyAcquireRequest, std::memory_order_release);
+	uploadStats.requestsCompleted = readyAcquireRequest;
+
+	return readyAcquireValue;
+}
+
+VkSemaphoreSubmitInfo UploadManager::wait_info(uint64_t value, VkPipelineStageFlags2 stageMask) const
+{
+	VkSemaphoreSubmitInfo submitInfo = vkinit::semaphore_submit_info(stageMask, timeline);
+	submitInfo.value = value;
+
+	return submitInfo;
+}
+
+bool UploadManager::is_complete(UploadTicket ticket) const
+{
+	return ticket.id <= completedRequest.load(std::memory_order_acquire);
+}
+
+void UploadManager::print_summary() const
+{
+	const double megabytes = static_cast<double>(uploadStats.bytesUploaded) / (1024.0 * 1024.0);
+
+	std::cout << "Uploads: " << megabytes << " MB, " << uploadStats.requestsCompleted << " requests in "
+		<< uploadStats.batches << " batches (" << uploadStats.copies << " copies) on the "
+		<< (uses_dedicated_queue() ? "transfer" : "graphics") << " queue" << std::endl;
+
+	if (uploadStats.busySeconds > 0.0)
+	{
+		std::cout << "  " << megabytes / uploadStats.busySeconds << " MB/s while busy, "
+			<< uploadStats.ringFullStalls << " ring full stalls" << std::endl;
+	}
+}
+
+void UploadManager::retire_batches()
+{
+	uint64_t completedValue = 0;
+	VK_CHECK(vkGetSemaphoreCounterValue(device, timeline, &completedValue));
+
+	const auto now = std::chrono::steady_clock::now();
+
+	while (!inFlight.empty() && inFlight.front().timelineValue <= completedValue)
+	{
+		Batch& batch = inFlight.front();
+
+		ringTail = batch.ringEnd;
+		freeCommandBuffers.push_back(batch.cmd);
+
+		// batches overlap, so only count time no earlier batch was already charged for
+		const auto busyStart = std::max(batch.submitTime, busyUntil);
+		if (now > busyStart)
+		{
+			uploadStats.busySeconds += std::chrono::duration<double>(now - busyStart).count();
+			busyUntil = now;
+		}
+		uploadStats.bytesUploaded += batch.bytes;
+
+		if (batch.lastRequest != 0)
+		{
+			if (uses_dedicated_queue())
+			{
+				// usable once the graphics queue has acquired them
+				readyAcquires.insert(readyAcquires.end(), batch.acquires.begin(), batch.acquires.end());
+				readyAcquireValue = batch.timelineValue;
+				readyAcquireRequest = batch.lastRequest;
+			}
+			else
+			{
+				completedRequest.store(batch.lastRequest, std::memory_order_release);
+				uploadStats.requestsCompleted = batch.lastRequest;
+			}
+		}
+
+		inFlight.pop_front();
+	}
+}
+
+bool UploadManager::allocate_staging(VkDeviceSize size, VkDeviceSize& outOffset)
+{
+	VkDeviceSize begin = align_up(ringHead, STAGING_ALIGNMENT);
+
+	// never split a chunk across the end of the ring
+	const VkDeviceSize offset = begin % stagingCapacity;
+	if (offset + size > stagingCapacity)
+	{
+		begin += stagingCapacity - offset;
+	}
+
+	if (begin + size - ringTail > stagingCapacity)
+	{
+		return false;
+	}
+
+	ringHead = begin + size;
+	outOffset = begin % stagingCapacity;
+	return true;
+}
+
+VkBufferMemoryBarrier2 UploadManager::buffer_barrier(const Ownership& ownership, bool acquire) const
+{
+	const bool transferOwnership = uses_dedicated_queue();
+	const bool release = transferOwnership && !acquire;
+
+	VkBufferMemoryBarrier2 barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+	barrier.pNext = nullptr;
+
+	// the release half only makes the writes available, the acquire half makes them visible
+	barrier.srcStageMask = acquire ? VK_PIPELINE_STAGE_2_NONE : VK_PIPELINE_STAGE_2_COPY_BIT;
+	barrier.srcAccessMask = acquire ? 0 : VK_ACCESS_2_TRANSFER_WRITE_BIT;
+	barrier.dstStageMask = release ? VK_PIPELINE_STAGE_2_NONE : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+	barrier.dstAccessMask = release ? 0 : VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+	barrier.srcQueueFamilyIndex = transferOwnership ? queues.transferFamily : VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = transferOwnership ? queues.graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+
+	barrier.buffer = ownership.buffer;
+	barrier.offset = ownership.offset;
+	barrier.size = ownership.size;
+
+	return barrier;
+}
+
+VkImageMemoryBarrier2 UploadManager::image_barrier(const Ownership& ownership, bool acquire) const
+{
+	const bool transferOwnership = uses_dedicated_queue();
+	const bool release = transferOwnership && !acquire;
+
+	VkImageMemoryBarrier2 barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+	barrier.pNext = nullptr;
+
+	barrier.srcStageMask = acquire ? VK_PIPELINE_STAGE_2_NONE : VK_PIPELINE_STAGE_2_COPY_BIT;
+	barrier.srcAccessMask = acquire ? 0 : VK_ACCESS_2_TRANSFER_WRITE_BIT;
+	barrier.dstStageMask = release ? VK_PIPELINE_STAGE_2_NONE : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+	barrier.dstAccessMask = release ? 0 : VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+	// release and acquire must describe the same layout transition
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = ownership.layout;
+
+	barrier.srcQueueFamilyIndex = transferOwnership ? queues.transferFamily : VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = transferOwnership ? queues.graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+
+	barrier.image = ownership.image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = ownership.mipLevel;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	return barrier;
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "vk_images.h"
+#include "vk_types.h"
+
+// handed out per request. the resource may be used by graphics work recorded
+// after UploadManager::is_complete() returned true for it.
+struct UploadTicket
+{
+	uint64_t id{ 0 };
+};
+
+struct UploadStats
+{
+	uint64_t bytesUploaded{ 0 };
+	uint64_t requestsCompleted{ 0 };
+	uint64_t copies{ 0 };
+	uint64_t batches{ 0 };
+	// submits that left work queued because the staging ring had no room
+	uint64_t ringFullStalls{ 0 };
+	// union of the intervals during which at least one batch was in flight
+	double busySeconds{ 0.0 };
+};
+
+// streams buffer and image data to the gpu through one persistently mapped staging ring.
+// requests can be queued from any thread. submit() runs once per frame on the render thread:
+// it copies as much as the ring and the per submit budget allow into a single command buffer
+// on the transfer queue, which signals the next value of the upload timeline. large requests
+// are split across several submits, so they stream in over a few frames instead of hitching one.
+// nothing waits on the cpu; finished batches are found by polling the timeline.
+class UploadManager
+{
+public:
+	struct QueueInfo
+	{
+		VkQueue transferQueue;
+		uint32_t transferFamily;
+		uint32_t graphicsFamily;
+	};
+
+	void init(VkDevice device, VmaAllocator allocator, const QueueInfo& queues,
+	          VkDeviceSize stagingSize, VkDeviceSize submitBudget);
+	// the device must be idle
+	void destroy();
+
+	// data is copied into the ring lazily, so it has to stay valid until the ticket completes
+	UploadTicket upload_buffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size);
+	// one tightly packed mip level of a 2D image, left in finalLayout and owned by the graphics family
+	UploadTicket upload_image(VkImage image, VkFormat format, VkExtent3D extent, uint32_t mipLevel,
+	                          const void* data, VkImageLayout finalLayout);
+
+	void submit();
+
+	// records the queue family acquire for every batch the transfer queue has finished.
+	// returns the upload timeline value the graphics submit should wait on, 0 if none.
+	uint64_t record_acquires(VkCommandBuffer cmd);
+	VkSemaphoreSubmitInfo wait_info(uint64_t value, VkPipelineStageFlags2 stageMask) const;
+
+	bool is_complete(UploadTicket ticket) const;
+
+	bool uses_dedicated_queue() const { return queues.transferFamily != queues.graphicsFamily; }
+	const UploadStats& stats() const { return uploadStats; }
+	void print_summary() const;
+
+private:
+	struct Request
+	{
+		uint64_t id;
+		const uint8_t* data;
+		VkDeviceSize size;
+
+		VkBuffer buffer;
+		VkDeviceSize bufferOffset;
+
+		VkImage image;
+		VkExtent3D extent;
+		uint32_t mipLevel;
+		VkImageLayout finalLayout;
+		FormatBlockInfo block;
+		VkDeviceSize rowBytes;
+		uint32_t rowCount;
+
+		// bytes staged for buffers, block rows staged for images
+		VkDeviceSize progress;
+	};
+
+	// one resource handed from the transfer to the graphics family
+	struct Ownership
+	{
+		VkBuffer buffer;
+		VkDeviceSize offset;
+		VkDeviceSize size;
+
+		VkImage image;
+		uint32_t mipLevel;
+		VkImageLayout layout;
+	};
+
+	struct Batch
+	{
+		uint64_t timelineValue;
+		// highest request id whose last bytes went out in this batch
+		uint64_t lastRequest;
+		VkDeviceSize ringEnd;
+		VkDeviceSize bytes;
+		VkCommandBuffer cmd;
+		std::vector<Ownership> acquires;
+		std::chrono::steady_clock::time_point submitTime;
+	};
+
+	struct StagedCopy
+	{
+		VkBuffer buffer;
+		VkBufferCopy bufferCopy;
+
+		VkImage image;
+		VkBufferImageCopy imageCopy;
+	};
+
+	void retire_batches();
+	bool allocate_staging(VkDeviceSize size, VkDeviceSize& outOffset);
+	VkBufferMemoryBarrier2 buffer_barrier(const Ownership& ownership, bool acquire) const;
+	VkImageMemoryBarrier2 image_barrier(const Ownership& ownership, bool acquire) const;
+
+	VkDevice device{ VK_NULL_HANDLE };
+	VmaAllocator allocator{ VK_NULL_HANDLE };
+	QueueInfo queues{};
+
+	AllocatedBuffer staging{};
+	uint8_t* stagingData{ nullptr };
+	VkDeviceSize stagingCapacity{ 0 };
+	VkDeviceSize submitBudget{ 0 };
+	// monotonic byte positions, the ring offset is position % stagingCapacity
+	VkDeviceSize ringHead{ 0 };
+	VkDeviceSize ringTail{ 0 };
+
+	VkSemaphore timeline{ VK_NULL_HANDLE };
+	uint64_t lastSubmittedValue{ 0 };
+
+	VkCommandPool commandPool{ VK_NULL_HANDLE };
+	std::vector<VkCommandBuffer> freeCommandBuffers;
+
+	std::mutex incomingMutex;
+	std::vector<Request> incoming;
+	uint64_t nextRequestId{ 1 };
+
+	// render thread only from here on
+	std::deque<Request> queued;
+	std::deque<Batch> inFlight;
+
+	// reused every submit so steady state streaming does not allocate
+	std::vector<StagedCopy> stagedCopies;
+	std::vector<VkImageMemoryBarrier2> imageBarriers;
+	std::vector<VkImageMemoryBarrier2> finalImageBarriers;
+	std::vector<VkBufferMemoryBarrier2> finalBufferBarriers;
+
+	std::vector<Ownership> readyAcquires;
+	uint64_t readyAcquireValue{ 0 };
+	uint64_t readyAcquireRequest{ 0 };
+
+	std::atomic<uint64_t> completedRequest{ 0 };
+
+	UploadStats uploadStats;
+	std::chrono::steady_clock::time_point busyUntil{};
+};
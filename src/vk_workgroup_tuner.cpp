@@ -0,0 +1,268 @@
+#include "vk_workgroup_tuner.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+void WorkgroupTuner::init(VkPhysicalDevice physicalDevice, uint32_t queueFamily, const std::filesystem::path& path)
+{
+	filePath = path;
+
+	VkPhysicalDeviceIDProperties idProperties{};
+	idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+	idProperties.pNext = nullptr;
+
+	VkPhysicalDeviceProperties2 properties{};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &idProperties;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+	limits = properties.properties.limits;
+	msPerTick = limits.timestampPeriod / 1e6;
+	deviceName = properties.properties.deviceName;
+
+	// a cpu implementation reports the same uuid whatever machine it runs on, its best shape follows the thread count
+	std::ostringstream key;
+	key << std::hex << std::setfill('0');
+	for (const uint8_t byte : idProperties.deviceUUID)
+	{
+		key << std::setw(2) << static_cast<uint32_t>(byte);
+	}
+	key << std::dec << "-" << properties.properties.driverVersion;
+	if (properties.properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU)
+	{
+		key << "-t" << std::thread::hardware_concurrency();
+	}
+	deviceKey = key.str();
+
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+	const uint32_t validBits = queueFamily < familyCount ? families[queueFamily].timestampValidBits : 0;
+	timestamps = validBits != 0;
+	timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+	// one entry per line: device key, pipeline, size and the winner's time. anything unreadable is dropped.
+	std::ifstream file(filePath);
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream fields(line);
+		Entry entry{};
+		if (fields >> entry.device >> entry.pipeline >> entry.size.x >> entry.size.y >> entry.size.z >> entry.ms)
+		{
+			entries.push_back(std::move(entry));
+		}
+	}
+
+	uint32_t stored = 0;
+	for (const Entry& entry : entries)
+	{
+		stored += entry.device == deviceKey;
+	}
+	std::cout << "Workgroup tuner: " << stored << " stored sizes for " << deviceName << std::endl;
+}
+
+WorkgroupSize WorkgroupTuner::size(const std::string& pipeline, WorkgroupSize fallback) const
+{
+	for (const Entry& entry : entries)
+	{
+		if (entry.device == deviceKey && entry.pipeline == pipeline && supports(entry.size))
+		{
+			return entry.size;
+		}
+	}
+	return fallback;
+}
+
+bool WorkgroupTuner::is_tuned(const std::string& pipeline) const
+{
+	return std::any_of(entries.begin(), entries.end(), [&](const Entry& entry)
+	{
+		return entry.device == deviceKey && entry.pipeline == pipeline && supports(entry.size);
+	});
+}
+
+WorkgroupSize WorkgroupTuner::tune(VkDevice device, PipelineCache& cache, ComputePipelineDesc desc,
+                                   std::span<const WorkgroupSize> candidates, WorkgroupSize fallback,
+                                   const Submit& submit, const RecordDispatch& record, const int iterations)
+{
+	std::vector<WorkgroupSize> sizes;
+	for (const WorkgroupSize& candidate : candidates)
+	{
+		if (supports(candidate))
+		{
+			sizes.push_back(candidate);
+		}
+	}
+
+	if (!timestamps || sizes.empty() || iterations <= 0)
+	{
+		return fallback;
+	}
+
+	std::vector<VkPipeline> pipelines;
+	for (const WorkgroupSize& candidate : sizes)
+	{
+		desc.set_workgroup_size(candidate);
+		pipelines.push_back(vkutil::create_compute_pipeline(device, cache, desc));
+	}
+
+	// a query pair reused by every candidate
+	VkQueryPoolCreateInfo queryPoolInfo{ .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+	queryPoolInfo.pNext = nullptr;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = 2;
+
+	VkQueryPool queryPool;
+	VK_CHECK(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool));
+
+	// each dispatch waits for the writes of the one before, like consecutive frames
+	const auto serialize = [](VkCommandBuffer cmd)
+	{
+		VkMemoryBarrier2 barrier{ .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2 };
+		barrier.pNext = nullptr;
+		barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+		barrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+		barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+		barrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+
+		VkDependencyInfo depInfo{ .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+		depInfo.pNext = nullptr;
+		depInfo.memoryBarrierCount = 1;
+		depInfo.pMemoryBarriers = &barrier;
+
+		vkCmdPipelineBarrier2(cmd, &depInfo);
+	};
+
+	// one submission per candidate, so a slow device only has to finish one candidate's dispatches per wait
+	std::vector<uint64_t> ticks(sizes.size() * 2);
+	for (size_t i = 0; i < sizes.size(); i++)
+	{
+		submit([&](VkCommandBuffer cmd)
+		{
+			vkCmdResetQueryPool(cmd, queryPool, 0, 2);
+
+			// the first dispatch of a pipeline pays for warming caches, it stays out of the timing
+			record(cmd, pipelines[i], sizes[i]);
+
+			vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, queryPool, 0);
+			for (int iteration = 0; iteration < iterations; iteration++)
+			{
+				serialize(cmd);
+				record(cmd, pipelines[i], sizes[i]);
+			}
+			vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, queryPool, 1);
+		});
+
+		VK_CHECK(vkGetQueryPoolResults(
+			device, queryPool, 0, 2, 2 * sizeof(uint64_t), &ticks[i * 2], sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+	}
+
+	vkDestroyQueryPool(device, queryPool, nullptr);
+	for (const VkPipeline pipeline : pipelines)
+	{
+		vkDestroyPipeline(device, pipeline, nullptr);
+	}
+
+	std::cout << "Workgroup tuner: " << desc.name << " on " << deviceName << ", ms per dispatch:";
+	size_t best = 0;
+	std::vector<double> times(sizes.size());
+	for (size_t i = 0; i < sizes.size(); i++)
+	{
+		times[i] = static_cast<double>((ticks[i * 2 + 1] - ticks[i * 2]) & timestampMask) * msPerTick / iterations;
+		if (times[i] < times[best])
+		{
+			best = i;
+		}
+		std::cout << " " << sizes[i].x << "x" << sizes[i].y << "x" << sizes[i].z << " " << times[i];
+	}
+	std::cout << std::endl;
+
+	const auto stale = std::remove_if(entries.begin(), entries.end(), [&](const Entry& entry)
+	{
+		return entry.device == deviceKey && entry.pipeline == desc.name;
+	});
+	entries.erase(stale, entries.end());
+	entries.push_back({ deviceKey , desc.name , sizes[best] , times[best] });
+	tunedThisRun.push_back(desc.name);
+
+	save();
+	return sizes[best];
+}
+
+void WorkgroupTuner::print_summary() const
+{
+	for (const Entry& entry : entries)
+	{
+		if (entry.device != deviceKey)
+		{
+			continue;
+		}
+
+		const bool tunedNow = std::find(tunedThisRun.begin(), tunedThisRun.end(), entry.pipeline) != tunedThisRun.end();
+		std::cout << "Workgroup tuner: " << entry.pipeline << " " << entry.size.x << "x" << entry.size.y << "x"
+			<< entry.size.z << ", " << entry.ms << " ms per dispatch (" << (tunedNow ? "tuned this run" : "stored")
+			<< ")" << std::endl;
+	}
+}
+
+bool WorkgroupTuner::supports(WorkgroupSize size) const
+{
+	return size.x >= 1 && size.y >= 1 && size.z >= 1 &&
+		size.x <= limits.maxComputeWorkGroupSize[0] &&
+		size.y <= limits.maxComputeWorkGroupSize[1] &&
+		size.z <= limits.maxComputeWorkGroupSize[2] &&
+		size.invocations() <= limits.maxComputeWorkGroupInvocations;
+}
+
+void WorkgroupTuner::save() const
+{
+	// write next to the real file and swap it in, so a crash mid-write keeps the old results
+	std::filesystem::path tempPath = filePath;
+	tempPath += ".tmp";
+
+	{
+		std::ofstream file(tempPath, std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cout << "Workgroup tuner: could not open " << tempPath.string() << std::endl;
+			return;
+		}
+
+		for (const Entry& entry : entries)
+		{
+			file << entry.device << " " << entry.pipeline << " " << entry.size.x << " " << entry.size.y << " "
+				<< entry.size.z << " " << entry.ms << "\n";
+		}
+
+		if (!file.good())
+		{
+			std::cout << "Workgroup tuner: failed to write " << tempPath.string() << std::endl;
+			return;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, filePath, error);
+	if (error)
+	{
+		std::cout << "Workgroup tuner: failed to replace " << filePath.string() << ": " << error.message() << std::endl;
+		std::filesystem::remove(tempPath, error);
+	}
+}
+
+std::vector<WorkgroupSize> vkutil::image_workgroup_candidates()
+{
+	return {
+		{ 8 , 4 , 1 } , { 8 , 8 , 1 } ,
+		{ 16 , 2 , 1 } , { 16 , 4 , 1 } , { 16 , 8 , 1 } , { 16 , 16 , 1 } ,
+		{ 32 , 1 , 1 } , { 32 , 2 , 1 } , { 32 , 4 , 1 } , { 32 , 8 , 1 } , { 32 , 16 , 1 } , { 32 , 32 , 1 } ,
+		{ 64 , 1 , 1 } , { 64 , 2 , 1 } , { 64 , 4 , 1 } , { 128 , 1 , 1 } , { 256 , 1 , 1 }
+	};
+}
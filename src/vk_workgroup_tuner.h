@@ -0,0 +1,71 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "vk_pipelines.h"
+#include "vk_types.h"
+
+// picks the workgroup size of compute pipelines per device. a pipeline is built once per candidate
+// size, every candidate is timed with timestamp queries on the device itself, and the fastest one is
+// stored in a text file keyed by the device's uuid and driver version (and thread count, for cpu
+// implementations like lavapipe). later runs on the same device read the winner back instead of tuning.
+class WorkgroupTuner
+{
+public:
+	// records one dispatch of the pipeline with the size it was built with
+	using RecordDispatch = std::function<void(VkCommandBuffer cmd, VkPipeline pipeline, WorkgroupSize size)>;
+	// records the commands of its argument into a command buffer, submits it and waits
+	using Submit = std::function<void(const std::function<void(VkCommandBuffer)>& record)>;
+
+	// loads this device's stored sizes. tuning is disabled when the queue family cannot write timestamps.
+	void init(VkPhysicalDevice physicalDevice, uint32_t queueFamily, const std::filesystem::path& path);
+
+	// the stored size for the pipeline, fallback when it has not been tuned on this device
+	WorkgroupSize size(const std::string& pipeline, WorkgroupSize fallback) const;
+	bool is_tuned(const std::string& pipeline) const;
+
+	// times iterations dispatches of desc built with each candidate the device supports, keeps the
+	// fastest for desc.name and saves the file. the dispatches are serialized like consecutive frames.
+	// returns fallback without tuning when there are no timestamps or no usable candidates.
+	WorkgroupSize tune(VkDevice device, PipelineCache& cache, ComputePipelineDesc desc,
+	                   std::span<const WorkgroupSize> candidates, WorkgroupSize fallback,
+	                   const Submit& submit, const RecordDispatch& record, int iterations = 20);
+
+	void print_summary() const;
+
+private:
+	struct Entry
+	{
+		std::string device;
+		std::string pipeline;
+		WorkgroupSize size;
+		// of the winner, per dispatch
+		double ms;
+	};
+
+	bool supports(WorkgroupSize size) const;
+	void save() const;
+
+	std::filesystem::path filePath;
+	// uuid, driver version and cpu threads, what an entry must match to be used
+	std::string deviceKey;
+	std::string deviceName;
+	VkPhysicalDeviceLimits limits{};
+	double msPerTick{ 0.0 };
+	uint64_t timestampMask{ ~0ull };
+	bool timestamps{ false };
+
+	// every device's entries, so saving keeps the other devices' results
+	std::vector<Entry> entries;
+	std::vector<std::string> tunedThisRun;
+};
+
+namespace vkutil
+{
+	// 2d shapes for a pass over an image, 32 to 1024 invocations, square and wide
+	std::vector<WorkgroupSize> image_workgroup_candidates();
+}
@@ -40,6 +40,11 @@ struct ImGui_ImplVulkan_InitInfo
     VkSampleCountFlagBits        MSAASamples;   // >= VK_SAMPLE_COUNT_1_BIT
     const VkAllocationCallbacks* Allocator;
     void                (*CheckVkResultFn)(VkResult err);
+
+    // Dynamic rendering (Vulkan 1.3): pass VK_NULL_HANDLE as the render pass to ImGui_ImplVulkan_Init()
+    // and record ImGui_ImplVulkan_RenderDrawData() inside vkCmdBeginRendering() on an attachment of this format.
+    bool                UseDynamicRendering;
+    VkFormat            ColorAttachmentFormat;
 };
 
 // Called by user code
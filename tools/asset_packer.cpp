@@ -0,0 +1,125 @@
+// offline packer: parses and optimizes meshes, decodes, mips and block compresses images, and writes one asset pack.
+//   asset_packer [--uncompressed] [--bc3] <output.pack> <input.obj|input.png>...
+// --uncompressed keeps textures as rgba8, --bc3 replaces BC7 for textures with alpha.
+// entries are named after the input file without its extension.
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include <vk_assetpack.h>
+#include <vk_blockcompress.h>
+#include <vk_jobs.h>
+#include <vk_loader.h>
+#include <vk_textures.h>
+
+int main(int argc, char* argv[])
+{
+	bool compress = true;
+	bool preferBc3 = false;
+
+	int firstArgument = 1;
+	for (; firstArgument < argc; firstArgument++)
+	{
+		const std::string_view arg = argv[firstArgument];
+		if (arg == "--uncompressed")
+		{
+			compress = false;
+		}
+		else if (arg == "--bc3")
+		{
+			preferBc3 = true;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if (argc - firstArgument < 2)
+	{
+		std::cout << "usage: asset_packer [--uncompressed] [--bc3] <output.pack> <input.obj|input.png>..." << std::endl;
+		return 1;
+	}
+	const char* outputPath = argv[firstArgument];
+
+	const auto start = std::chrono::steady_clock::now();
+
+	JobSystem jobs;
+	jobs.init();
+
+	AssetPackWriter writer;
+	bool succeeded = true;
+
+	for (int i = firstArgument + 1; i < argc; i++)
+	{
+		const std::filesystem::path input = argv[i];
+		const std::string name = input.stem().string();
+		const std::string extension = input.extension().string();
+
+		if (extension == ".obj")
+		{
+			MeshLoadStats stats;
+			const auto mesh = vkutil::load_obj_mesh(jobs, input, true, &stats);
+			if (mesh == nullptr)
+			{
+				succeeded = false;
+				continue;
+			}
+
+			writer.add_mesh(name, *mesh);
+			std::cout << "  mesh " << name << ": " << stats.vertices << " vertices, " << stats.triangles
+				<< " triangles, acmr " << stats.acmrAfter << std::endl;
+		}
+		else if (extension == ".png")
+		{
+			TextureData texture;
+			if (!vkutil::load_image_rgba8(input, vkutil::is_srgb_texture(name), texture))
+			{
+				std::cout << "Failed to decode " << input.string() << std::endl;
+				succeeded = false;
+				continue;
+			}
+			vkutil::generate_mips_rgba8(jobs, texture);
+
+			std::cout << "  texture " << name << ": " << texture.width << "x" << texture.height << ", "
+				<< texture.mips.size() << " mips";
+
+			if (compress)
+			{
+				TextureCompressionStats stats;
+				vkutil::compress_texture(jobs, texture, vkutil::select_block_format(name, preferBc3), &stats);
+
+				std::cout << ", " << vkutil::block_format_name(texture.format) << ": " << stats.megapixelsPerSecond << " MP/s, psnr "
+					<< stats.psnr << " dB, " << stats.sourceBytes / 1024 << " KB -> " << stats.compressedBytes / 1024
+					<< " KB";
+			}
+			std::cout << std::endl;
+
+			writer.add_texture(name, texture);
+		}
+		else
+		{
+			std::cout << "Skipping " << input.string() << ": unknown asset type" << std::endl;
+		}
+	}
+
+	if (succeeded && !writer.write(outputPath))
+	{
+		std::cout << "Failed to write " << outputPath << std::endl;
+		succeeded = false;
+	}
+
+	jobs.shutdown();
+
+	if (succeeded)
+	{
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "Wrote " << outputPath << " (" << writer.blob_size() / (1024 * 1024) << " MB) in " << seconds
+			<< " s" << std::endl;
+	}
+
+	return succeeded ? 0 : 1;
+}